@@ -0,0 +1,41 @@
+/**
+ * @file battery.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Battery voltage, sampled continuously by ADC and DMA, and the low voltage policy of battery_monitor.h
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_BATTERY_H_
+#define INC_BATTERY_H_
+
+#include <stdint.h>
+
+#include "User/battery_monitor.h"
+
+#define BATTERY_DIVIDER      2.0f // Battery to PA4, 10k over 10k
+#define BATTERY_BLOCK        32   // Conversion pairs averaged per DMA interrupt
+#define BATTERY_IRQ_PRIORITY 5    // With the encoder, the wheel controller reads a consistent state
+
+typedef struct
+{
+    float           mv;      // Filtered
+    float           min_mv;  // Lowest filtered voltage since the reset
+    float           vdda_mv; // From the internal reference
+    battery_level_e level;
+    float           limit;   // Largest motor duty
+    uint32_t        blocks;  // Since the reset
+    uint32_t        cutoffs; // Since the reset
+} battery_state_t;
+
+void              battery_init(void);
+void              battery_reset(void);
+void              battery_get(battery_state_t* state);
+float             battery_get_supply(void);
+float             battery_get_limit(void);
+battery_config_t* battery_get_config(void);
+
+#endif /* INC_BATTERY_H_ */
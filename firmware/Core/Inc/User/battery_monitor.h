@@ -0,0 +1,67 @@
+/**
+ * @file battery_monitor.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Battery voltage filter and low voltage policy
+ *
+ * Takes the mean voltage of every block of conversions and low pass filters it. The filter is fast enough
+ * to follow the sag under a motor current step, the wheel controller scales its duty by the filtered voltage.
+ * Below low_mv the duty limit ramps down linearly, to low_limit at cutoff_mv. Less current sags the pack
+ * less, the voltage settles above cutoff_mv instead of dropping to where the regulator of the MCU browns out.
+ * Below cutoff_mv the motor is cut. It stays cut until the voltage has been back above recover_mv for
+ * recover_s, an empty pack does not recover and does not chatter on and off with the load.
+ * No hardware access, the same code runs on target and on the host.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_BATTERY_MONITOR_H_
+#define INC_BATTERY_MONITOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Four NiMH cells, the MCU regulator drops out below 3.6 V
+#define BATTERY_NOMINAL_MV 4800.0f
+#define BATTERY_LOW_MV     4000.0f
+#define BATTERY_CUTOFF_MV  3700.0f
+#define BATTERY_RECOVER_MV 4200.0f
+
+typedef enum
+{
+    eBATTERY_OK,
+    eBATTERY_LOW,    // Duty limited
+    eBATTERY_CUTOFF, // Motor off until recovered
+} battery_level_e;
+
+typedef struct
+{
+    float nominal_mv; // Voltage the wheel controller is tuned at
+    float low_mv;     // The duty limit starts below
+    float cutoff_mv;  // The motor is cut below
+    float recover_mv; // Cut until above for recover_s
+    float low_limit;  // Duty limit at cutoff_mv
+    float recover_s;
+    float tau_s;      // Filter time constant
+} battery_config_t;
+
+typedef struct
+{
+    battery_config_t config;
+    bool             started;
+    float            mv;        // Filtered
+    float            min_mv;    // Lowest filtered voltage since the reset
+    battery_level_e  level;
+    float            limit;     // Largest duty, 0 to 1
+    float            recover_s; // Left before the motor is on again
+    uint32_t         blocks;    // Since the reset
+    uint32_t         cutoffs;   // Since the reset
+} battery_monitor_t;
+
+void battery_monitor_init(battery_monitor_t* monitor);
+void battery_monitor_reset(battery_monitor_t* monitor);
+void battery_monitor_update(battery_monitor_t* monitor, float mv, float dt_s);
+
+#endif /* INC_BATTERY_MONITOR_H_ */
@@ -0,0 +1,67 @@
+/**
+ * @file bench.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Microbenchmark runner
+ * 
+ * Benchmarks are registered at compile time and collected in the 'bench_registry' section,
+ * the same registrations are run on target by the 'bench' CLI command and on Linux by host/bench_host.
+ * @code
+ * static void s_run(void) { ... }
+ * BENCH_REGISTER(my_kernel, NULL, s_run, 16); // s_run performs 16 operations
+ * @endcode
+ * @version 0.1
+ * @date 2023-11-21
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_BENCH_H_
+#define INC_BENCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BENCH_DEFAULT_REPS 100
+
+typedef struct
+{
+    const char* name;
+    void (*setup)(void); // Called before every repetition, not timed, can be NULL
+    void (*run)(void);   // Timed
+    uint32_t ops;        // Number of operations performed by one call of run
+} bench_t;
+
+#ifndef DONATELLO_HOST
+// The linker scripts align the bench_registry section to 4, __start_bench_registry must be the first benchmark
+_Static_assert(_Alignof(bench_t) <= 4, "bench_registry is aligned to 4 in the linker scripts");
+#endif
+
+typedef struct
+{
+    uint32_t reps;
+    float    mean;   // Cycles per operation
+    float    stddev; // Cycles per operation
+    float    min;    // Cycles per operation
+    float    max;    // Cycles per operation
+} bench_result_t;
+
+/**
+ * @brief Register a benchmark
+ * 
+ * @param id Unique identifier, also used as the benchmark name
+ * @param setup_fn Untimed setup run before every repetition, or NULL
+ * @param run_fn Timed function
+ * @param n_ops Operations performed by one call of run_fn
+ */
+#define BENCH_REGISTER(id, setup_fn, run_fn, n_ops)                                                            \
+    __attribute__((section("bench_registry"), used, aligned(4))) const bench_t bench_##id = {.name = #id,     \
+                                                                                             .setup = setup_fn, \
+                                                                                             .run = run_fn,     \
+                                                                                             .ops = n_ops}
+
+const bench_t* bench_next(const bench_t* bench);
+const bench_t* bench_find(const char* name);
+void           bench_run(const bench_t* bench, uint32_t reps, bool mask_irq, bench_result_t* result);
+
+#endif /* INC_BENCH_H_ */
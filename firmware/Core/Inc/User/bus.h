@@ -0,0 +1,135 @@
+/**
+ * @file bus.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Publish/subscribe between tasks and interrupts through statically declared topics
+ *
+ * A topic owns preallocated slots for its messages. The publisher claims a slot, writes the message in place
+ * and publishes it, subscribers get a pointer to the slot. Messages are never copied by the bus.
+ * Two kinds of topics:
+ * - latest: state, every subscriber reads the newest message wait-free. Messages a subscriber did not read
+ *           in time are overwritten and counted as dropped. One set of slots for all subscribers.
+ * - queue:  events, one subscriber receives every message in order. A message that does not fit is dropped.
+ * A topic has one publisher and every subscriber is used from one context at a time, any of them may be an
+ * interrupt. Topics are placed in the 'bus_topics' section so they are all known at link time, like prof.h.
+ * @code
+ * BUS_LATEST(speeds, "speeds", speed_t, 2);
+ *
+ * // Publisher
+ * speed_t* speed = bus_claim(&speeds);
+ * speed->mm_s = 1;
+ * bus_publish(&speeds);
+ *
+ * // Subscriber 1
+ * const speed_t* speed = bus_read(&speeds, 1, &fresh);
+ * @endcode
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_BUS_H_
+#define INC_BUS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUS_SUBSCRIBERS_MAX 8  // Of a latest topic
+#define BUS_DEPTH_MAX       32 // Of a queue topic
+
+typedef enum {
+    eBUS_LATEST,
+    eBUS_QUEUE,
+} bus_kind_e;
+
+typedef struct
+{
+    _Atomic uint8_t middle;   // Slot handed over by the publisher and a flag set when it has not been read
+    uint8_t         front;    // Owned by the subscriber
+    uint8_t         held;     // Owned by the publisher, the slot the subscriber holds besides the middle
+    uint32_t        received; // Messages read, owned by the subscriber
+} bus_subscriber_t;
+
+typedef struct
+{
+    const char*       name;
+    bus_kind_e        kind;
+    uint8_t           slots;
+    uint8_t           subscribers; // Latest only, a queue has one
+    uint16_t          size;        // Of a message
+    uint8_t*          data;        // slots * size bytes
+    bus_subscriber_t* subscriber;  // Latest only
+    uint8_t           latest;      // Latest only, slot published last
+    _Atomic uint32_t  head;        // Queue only, messages published
+    _Atomic uint32_t  tail;        // Queue only, messages released
+    uint32_t          received;    // Queue only
+    uint32_t          published;
+    uint32_t          dropped;
+    uint32_t          stamp;       // cycles_now() of the last publish
+    uint32_t          period;      // Filtered cycles between publishes
+} bus_topic_t;
+
+#ifndef DONATELLO_HOST
+// The linker scripts align the bus_topics section to 4, __start_bus_topics must be the first topic
+_Static_assert(_Alignof(bus_topic_t) <= 4, "bus_topics is aligned to 4 in the linker scripts");
+#endif
+
+typedef struct
+{
+    uint32_t published;
+    uint32_t dropped;  // Overwritten before a subscriber read them, or did not fit in the queue
+    uint32_t received; // By all subscribers
+    uint32_t pending;  // Queue only, published and not released
+    float    rate_hz;  // 0 when nothing was published for four periods
+    uint32_t age_us;   // Since the last publish
+} bus_stats_t;
+
+/**
+ * @brief Define a latest value topic of messages of type with count subscribers, numbered 0 to count - 1
+ * Uses count + 2 slots, zeroed static storage like the topic. May be preceded by static.
+ */
+#define BUS_LATEST(var, label, type, count)                                                \
+    __attribute__((section("bus_topics"), used, aligned(4))) bus_topic_t var = {           \
+        .name = label,                                                                     \
+        .kind = eBUS_LATEST,                                                               \
+        .slots = (count) + 2,                                                              \
+        .subscribers = (count),                                                            \
+        .size = sizeof(type),                                                              \
+        .data = (uint8_t*)__extension__(type[(count) + 2]){},                              \
+        .subscriber = __extension__(bus_subscriber_t[count]){},                            \
+    };                                                                                     \
+    _Static_assert((count) > 0 && (count) <= BUS_SUBSCRIBERS_MAX, "Subscribers of " label)
+
+/**
+ * @brief Define a queue topic of depth messages of type, depth is a power of two. May be preceded by static.
+ */
+#define BUS_QUEUE(var, label, type, depth)                                                                 \
+    __attribute__((section("bus_topics"), used, aligned(4))) bus_topic_t var = {                           \
+        .name = label,                                                                                     \
+        .kind = eBUS_QUEUE,                                                                                \
+        .slots = (depth),                                                                                  \
+        .subscribers = 1,                                                                                  \
+        .size = sizeof(type),                                                                              \
+        .data = (uint8_t*)__extension__(type[depth]){},                                                    \
+    };                                                                                                     \
+    _Static_assert((depth) > 1 && (depth) <= BUS_DEPTH_MAX && !((depth) & ((depth)-1)), "Depth of " label)
+
+// Publisher
+void* bus_claim(bus_topic_t* topic);
+void  bus_publish(bus_topic_t* topic);
+
+// Subscriber of a latest topic
+const void* bus_read(bus_topic_t* topic, uint8_t subscriber, bool* fresh);
+
+// Subscriber of a queue topic
+const void* bus_receive(bus_topic_t* topic);
+void        bus_release(bus_topic_t* topic);
+
+bus_topic_t* bus_next(bus_topic_t* topic);
+void         bus_get_stats(const bus_topic_t* topic, bus_stats_t* stats);
+void         bus_reset_stats(void);
+
+#endif /* INC_BUS_H_ */
@@ -11,8 +11,22 @@
 
 #include <stdint.h>
 
+#include "User/bus.h"
+
 typedef enum { eBUTTON_STATE_NOT_PRESSED = 0, eBUTTON_STATE_PRESSED } button_state_e;
 
+typedef enum { eBUTTON_EVENT_PRESS, eBUTTON_EVENT_RELEASE, eBUTTON_EVENT_CLICK } button_event_e;
+
+typedef struct
+{
+    uint32_t       tick; // HAL_GetTick() of the event
+    button_event_e event;
+    uint8_t        clicks; // Of a click event
+} button_event_t;
+
+// Queue of button_event_t, published by the button task
+extern bus_topic_t button_events;
+
 void           button_init(void);
-void           button_task(void);
+void           button_task(void const* argument);
 button_state_e button_get_state(void);
\ No newline at end of file
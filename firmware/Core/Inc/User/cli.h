@@ -10,19 +10,19 @@
 
 #include "embedded_cli.h"
 
-// Definitions for CLI sizes
-#define CLI_BUFFER_SIZE        4096
+#include "User/pool.h"
+
+// Definitions for CLI sizes, the buffer of the CLI is sized from them in cli.c
 #define CLI_RX_BUFFER_SIZE     16
 #define CLI_CMD_BUFFER_SIZE    32
 #define CLI_HISTORY_SIZE       32
 #define CLI_MAX_BINDING_COUNT  32
 
 /**
- * Definition of the cli_printf() buffer size.
- * Can make smaller to decrease RAM usage,
- * make larger to be able to print longer strings.
+ * Longest string cli_printf() prints, longer ones are cut and end in "...".
+ * It formats into a block of pool.h instead of the stack of the caller, the block sets the limit.
  */
-#define CLI_PRINTF_BUFFER_SIZE 1048
+#define CLI_PRINTF_BUFFER_SIZE POOL_MESSAGE_SIZE
 
 void         cli_init(void);
 void         cli_process(void);
@@ -10,10 +10,19 @@
 
 #include <stdint.h>
 
+#include "User/ring.h"
+
+// Every byte between USB and the CLI passes through one of these two rings, nothing else stages it
+#define COMS_RX_SIZE 256  // Received, not yet handed to the CLI. Several USB packets of 64 bytes.
+#define COMS_TX_SIZE 2048 // To send, USB transmits straight out of it
+
 void coms_add_rx(uint8_t c);
 void coms_add_tx(uint8_t c);
+void coms_transmit(const uint8_t* buffer, uint16_t len);
+void coms_tx_done(void);
 void coms_task(void const* argument);
 
-//TODO: coms_trannsmit(const uint8_t * buffer, uint16_t len)
+void coms_get_stats(ring_stats_t* rx, ring_stats_t* tx);
+void coms_reset_stats(void);
 
 #endif /* INC_COMS_H_ */
@@ -0,0 +1,92 @@
+/**
+ * @file control.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Control executive, sense, estimate, plan and act at a fixed rate from a hardware timer
+ *
+ * Every cycle runs the stages in a fixed order and measures each against its budget:
+ * - sense:    latest encoder state and lidar scan
+ * - estimate: odometry from travel and steering, the scan deskewed into points
+ * - plan:     steering towards the most open direction, speed to stop short of what is ahead
+ * - act:      wheel speed, steering and the lidar timing regime
+ * Sense, estimate and act always run. Planning is skipped, and the last command held, when it would not
+ * finish before the next trigger or when it overran its budget in the cycle before. After
+ * CONTROL_HOLD_CYCLES cycles without a plan the command becomes a stop, so does a plan on a scan older than
+ * CONTROL_STALE_CYCLES cycles.
+ * The cycle in control_exec.c uses no RTOS, control.c triggers it from TIM4 through a task.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_CONTROL_H_
+#define INC_CONTROL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/prof.h"
+
+#define CONTROL_RATE_HZ      100
+#define CONTROL_PERIOD_US    (1000000 / CONTROL_RATE_HZ)
+#define CONTROL_IRQ_PRIORITY 6    // Below the encoder, may signal the task
+#define CONTROL_HOLD_CYCLES  10   // Cycles acting on an older plan before stopping
+#define CONTROL_STALE_CYCLES 25   // Cycles without a new scan before stopping
+#define CONTROL_STOP_MM      300  // Clearance ahead of the front axle the plan stops at, along the arc
+#define CONTROL_DECEL_MM_S2  4000 // Braking the speed is limited by, to stop at CONTROL_STOP_MM
+#define CONTROL_MARGIN_MM    60   // Beside the wheels, what is closer to the path is in the way
+#define CONTROL_OPEN_MM      1300 // Range of a beam without a target, the shortest range of any regime
+#define CONTROL_LOOKAHEAD_MM 600  // Farthest goal steered for, on the way to the most open direction
+
+typedef enum {
+    eCONTROL_SENSE,
+    eCONTROL_ESTIMATE,
+    eCONTROL_PLAN,
+    eCONTROL_ACT,
+    eCONTROL_STAGES,
+} control_stage_e;
+
+typedef struct
+{
+    float speed_mm_s; // Positive forward
+    float steer_deg;  // Positive to the left
+} control_command_t;
+
+typedef struct
+{
+    const char*  name;
+    uint32_t     budget_us;
+    uint32_t     runs;
+    uint32_t     overruns; // Took longer than the budget
+    uint32_t     skips;
+    prof_stats_t exec;     // Cycles
+} control_stage_stats_t;
+
+typedef struct
+{
+    bool                  driving;
+    uint32_t              cycles;
+    uint32_t              late;    // Started more than half a period late
+    uint32_t              holds;   // Cycles acting on an older plan
+    uint32_t              stops;   // Cycles stopped for lack of a plan or a new scan
+    prof_stats_t          latency; // Cycles from the trigger to the start
+    prof_stats_t          exec;    // Cycles of the whole cycle
+    control_stage_stats_t stage[eCONTROL_STAGES];
+    control_command_t     command; // Last acted on
+} control_stats_t;
+
+// control.c, the trigger
+void control_init(void);
+void control_trigger(void);
+void control_task(void const* argument);
+
+// control_exec.c, the cycle
+void control_cycle(uint32_t trigger);
+void control_start(float cruise_mm_s);
+void control_stop(void);
+bool control_set_budget(control_stage_e stage, uint32_t budget_us);
+void control_get_stats(control_stats_t* stats);
+void control_reset_stats(void);
+
+#endif /* INC_CONTROL_H_ */
@@ -0,0 +1,57 @@
+/**
+ * @file cycles.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Cycle counter used for timing code sections
+ * On target the DWT cycle counter is used, on the host build clock_gettime() in nanoseconds.
+ * @version 0.1
+ * @date 2023-11-20
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_CYCLES_H_
+#define INC_CYCLES_H_
+
+#include <stdint.h>
+
+#ifdef DONATELLO_HOST
+#include <time.h>
+
+#define CYCLES_UNIT "ns" // Of cycles_now(), for printing
+
+static inline void cycles_init(void) {}
+
+static inline uint32_t cycles_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+static inline uint32_t cycles_per_us(void) {
+    return 1000;
+}
+#else
+#include "main.h"
+
+#define CYCLES_UNIT "cycles" // Of cycles_now(), for printing
+
+/**
+ * @brief Enable the DWT cycle counter, call once at boot
+ */
+static inline void cycles_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t cycles_now(void) {
+    return DWT->CYCCNT;
+}
+
+static inline uint32_t cycles_per_us(void) {
+    return SystemCoreClock / 1000000;
+}
+#endif
+
+#endif /* INC_CYCLES_H_ */
@@ -0,0 +1,39 @@
+/**
+ * @file encoder.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Motor encoder, travel and speed of the wheels sampled at a fixed rate
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_ENCODER_H_
+#define INC_ENCODER_H_
+
+#include <stdint.h>
+
+#define ENCODER_RATE_HZ      1000
+#define ENCODER_IRQ_PRIORITY 5
+
+typedef struct
+{
+    uint32_t stamp;       // cycles_now() of the sample
+    uint32_t samples;     // Taken since the reset
+    int32_t  counts;      // Quadrature counts since the reset
+    float    distance_mm; // Travel since the reset, negative backwards
+    float    speed_mm_s;  // Positive forward
+} encoder_state_t;
+
+/**
+ * @brief Called from the sample interrupt with every new sample
+ */
+typedef void (*encoder_listener_t)(const encoder_state_t* state);
+
+void encoder_init(void);
+void encoder_reset(void);
+void encoder_get(encoder_state_t* state);
+void encoder_set_listener(encoder_listener_t listener);
+
+#endif /* INC_ENCODER_H_ */
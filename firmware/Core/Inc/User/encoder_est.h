@@ -0,0 +1,55 @@
+/**
+ * @file encoder_est.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Position and speed of a quadrature encoder from periodic samples of its counter, M/T method
+ *
+ * Every sample holds the quadrature counter and, latched by hardware, the counter and time of the last
+ * captured edge. The speed is the counts between the last captured edges of two samples over the exact
+ * time between those edges, so it is neither quantized to whole counts per sample at crawl speed nor to
+ * the sample period at top speed. Captures are one per line, 4 counts apart, uneven spacing of the
+ * channels within a line does not show.
+ * Without a new edge the speed cannot be higher than one capture interval over the time waited since
+ * the last edge, it is clamped to that and drops to zero after ENCODER_EST_STOP_US.
+ * No hardware access, the same code runs on target and against synthetic edges on the host.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_ENCODER_EST_H_
+#define INC_ENCODER_EST_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ENCODER_EST_CAPTURE_COUNTS 4      // Quadrature counts between two captured edges
+#define ENCODER_EST_STOP_US        200000 // No captured edge for this long is standing still
+
+/**
+ * @brief Raw hardware state, the edge fields are latched together on every captured edge
+ */
+typedef struct
+{
+    uint16_t count;      // Quadrature counter
+    uint16_t edge_count; // Counter at the last captured edge
+    uint32_t edge_us;    // Time of the last captured edge
+    uint32_t now_us;     // Time of the sample
+} encoder_sample_t;
+
+typedef struct
+{
+    int32_t  position;      // Counts since the reset
+    float    speed;         // Counts per second, positive when counting up
+    uint32_t edges;         // Samples with a new captured edge
+    uint16_t count;         // Private, counter at the previous sample
+    bool     edge_valid;    // Private, edge_position and edge_us belong to a captured edge
+    int32_t  edge_position; // Private
+    uint32_t edge_us;       // Private
+} encoder_est_t;
+
+void encoder_est_reset(encoder_est_t* est, const encoder_sample_t* sample);
+void encoder_est_update(encoder_est_t* est, const encoder_sample_t* sample);
+
+#endif /* INC_ENCODER_EST_H_ */
@@ -0,0 +1,52 @@
+/**
+ * @file geometry.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Robot geometry tables in flash, generated at compile time from the description in geometry.hpp
+ *
+ * Beam directions, sensor mounts and steering curvature are looked up here instead of computed with
+ * trigonometry at runtime. The tables are built by the C++ compiler in geometry.cpp, C code only reads them.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_GEOMETRY_H_
+#define INC_GEOMETRY_H_
+
+#include <stdint.h>
+
+#include "User/lidar.h"
+
+// Steering table covers -GEOMETRY_STEER_MAX_DEG to GEOMETRY_STEER_MAX_DEG in steps of one degree
+#define GEOMETRY_STEER_MAX_DEG 25
+#define GEOMETRY_STEER_STEPS   (2 * GEOMETRY_STEER_MAX_DEG + 1)
+
+typedef struct
+{
+    float wheelbase_mm;      // Front to rear axle
+    float track_mm;          // Between the centers of the wheels on one axle
+    float wheel_diameter_mm; // Outer diameter of the tyres
+    float steer_max_deg;     // Front wheel angle at full lock
+    float mm_per_count;      // Travel per count of the motor encoder
+} geometry_vehicle_t;
+
+typedef struct
+{
+    lidar_beam_t       beams[LIDAR_ZONES_MAX][LIDAR_BEAMS_MAX]; // [zones - 1][beam], beams past the count are zero
+    float              steer_curvature[GEOMETRY_STEER_STEPS];   // 1/m of the rear axle center, index is degrees + max
+    geometry_vehicle_t vehicle;
+} geometry_tables_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const geometry_tables_t geometry_tables;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_GEOMETRY_H_ */
@@ -0,0 +1,195 @@
+/**
+ * @file geometry.hpp
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Constexpr description of the robot geometry, the one place its dimensions are written down
+ *
+ * Everything is evaluated by the compiler, geometry.cpp places the results in flash as geometry_tables
+ * for the C code. C++ code can use the description and the functions directly.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_GEOMETRY_HPP_
+#define INC_GEOMETRY_HPP_
+
+#include "User/geometry.h"
+#include "User/lidar.h"
+
+namespace geometry {
+
+// ============= Constexpr math ===================
+inline constexpr double pi = 3.14159265358979323846;
+
+constexpr double radians(double deg) {
+    return deg * pi / 180.0;
+}
+
+constexpr double abs(double x) {
+    return x < 0 ? -x : x;
+}
+
+/**
+ * @brief Sine by its Taylor series, the argument is first reduced to [-pi, pi] where 20 terms reach double precision
+ */
+constexpr double sin(double x) {
+    while (x > pi) {
+        x -= 2 * pi;
+    }
+    while (x < -pi) {
+        x += 2 * pi;
+    }
+
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 20; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cos(double x) {
+    return sin(x + pi / 2);
+}
+
+constexpr double tan(double x) {
+    return sin(x) / cos(x);
+}
+
+static_assert(abs(sin(pi / 6) - 0.5) < 1e-12);
+static_assert(abs(cos(radians(-135)) + 0.70710678118654752) < 1e-12);
+
+// ============= Description ===================
+struct lidar_t
+{
+    int    sensors;
+    int    spads;           // Columns of the SPAD array
+    double fov_deg;         // Field of view with all SPADs
+    double spacing_deg;     // Between neighbouring sensors, sensor 0 points furthest to the right
+    double board_x_mm;      // Flex board center ahead of the vehicle origin (rear axle center)
+    double board_radius_mm; // Sensors sit on an arc around the board center, each facing along its own azimuth
+};
+
+struct vehicle_t
+{
+    double wheelbase_mm;
+    double track_mm;
+    double wheel_diameter_mm;
+    double steer_max_deg;
+    int    encoder_lines; // Pulses per channel and turn of the motor
+    double gear_ratio;    // Motor turns per wheel turn
+};
+
+inline constexpr lidar_t lidar = {
+    .sensors = LIDAR_COUNT,
+    .spads = LIDAR_SPADS,
+    .fov_deg = 27.0,
+    .spacing_deg = 45.0,
+    .board_x_mm = 150.0,
+    .board_radius_mm = 20.0,
+};
+
+inline constexpr vehicle_t vehicle = {
+    .wheelbase_mm = 257.0,
+    .track_mm = 160.0,
+    .wheel_diameter_mm = 65.0,
+    .steer_max_deg = GEOMETRY_STEER_MAX_DEG,
+    .encoder_lines = 512,
+    .gear_ratio = 8.0,
+};
+
+// ============= Derived geometry ===================
+/**
+ * @brief Direction of a sensor, counter clockwise from straight ahead
+ */
+constexpr double sensor_azimuth_deg(int sensor) {
+    return (sensor - (lidar.sensors - 1) / 2.0) * lidar.spacing_deg;
+}
+
+/**
+ * @brief Geometry of a beam. Zones are evenly spread over the SPAD array and ordered counter clockwise,
+ * the lens mirrors the scene so the zone looking furthest counter clockwise uses the first columns.
+ *
+ * @param zones Zones per sensor
+ * @param index Beam index, sensor * zones + zone
+ * @return Zeroed beam if index is out of range
+ */
+constexpr lidar_beam_t beam(int zones, int index) {
+    lidar_beam_t beam = {};
+    if (zones < 1 || index >= lidar.sensors * zones) {
+        return beam;
+    }
+
+    int sensor = index / zones;
+    int zone = index % zones;
+    // Rounded up to even, zones then sit symmetric around the center and neighbours overlap by a column at most
+    int width = (lidar.spads / zones + 1) & ~1;
+    int first = zones > 1 ? (zones - 1 - zone) * (lidar.spads - width) / (zones - 1) : 0;
+
+    double spad_deg = lidar.fov_deg / lidar.spads;
+    double sensor_deg = sensor_azimuth_deg(sensor);
+    double azimuth_deg = sensor_deg + (lidar.spads / 2.0 - (first + width / 2.0)) * spad_deg;
+
+    beam.sensor = static_cast<uint8_t>(sensor);
+    beam.zone = static_cast<uint8_t>(zone);
+    beam.roi_center = static_cast<uint8_t>(128 + (first + width / 2) * 8 + 7); // Row 8, the region is full height
+    beam.roi_width = static_cast<uint8_t>(width);
+    beam.azimuth_deg = static_cast<float>(azimuth_deg);
+    beam.width_deg = static_cast<float>(width * spad_deg);
+    beam.cos_azimuth = static_cast<float>(cos(radians(azimuth_deg)));
+    beam.sin_azimuth = static_cast<float>(sin(radians(azimuth_deg)));
+    beam.mount_x_mm = static_cast<float>(lidar.board_x_mm + lidar.board_radius_mm * cos(radians(sensor_deg)));
+    beam.mount_y_mm = static_cast<float>(lidar.board_radius_mm * sin(radians(sensor_deg)));
+    return beam;
+}
+
+/**
+ * @brief Curvature of the path of the rear axle center with the front wheels at an angle, bicycle model
+ *
+ * @param steer_deg Front wheel angle, positive to the left
+ * @return Curvature in 1/m, positive to the left
+ */
+constexpr double steer_curvature(double steer_deg) {
+    return tan(radians(steer_deg)) / vehicle.wheelbase_mm * 1000.0;
+}
+
+/**
+ * @brief Travel of the wheels per count of the quadrature encoder, four counts per line
+ */
+constexpr double mm_per_count() {
+    return pi * vehicle.wheel_diameter_mm / (4 * vehicle.encoder_lines * vehicle.gear_ratio);
+}
+
+constexpr geometry_tables_t tables() {
+    geometry_tables_t tables = {};
+
+    for (int zones = 1; zones <= LIDAR_ZONES_MAX; zones++) {
+        for (int b = 0; b < lidar.sensors * zones; b++) {
+            tables.beams[zones - 1][b] = beam(zones, b);
+        }
+    }
+    for (int step = 0; step < GEOMETRY_STEER_STEPS; step++) {
+        tables.steer_curvature[step] = static_cast<float>(steer_curvature(step - GEOMETRY_STEER_MAX_DEG));
+    }
+    tables.vehicle = {
+        .wheelbase_mm = static_cast<float>(vehicle.wheelbase_mm),
+        .track_mm = static_cast<float>(vehicle.track_mm),
+        .wheel_diameter_mm = static_cast<float>(vehicle.wheel_diameter_mm),
+        .steer_max_deg = static_cast<float>(vehicle.steer_max_deg),
+        .mm_per_count = static_cast<float>(mm_per_count()),
+    };
+    return tables;
+}
+
+// The middle sensor looks straight ahead and every zone count covers the same span symmetrically
+static_assert(lidar.sensors % 2 == 1);
+static_assert(beam(1, LIDAR_COUNT / 2).azimuth_deg == 0.0f && beam(1, LIDAR_COUNT / 2).cos_azimuth == 1.0f);
+static_assert(beam(3, 3 * LIDAR_COUNT - 1).azimuth_deg == -beam(3, 0).azimuth_deg);
+static_assert(beam(LIDAR_ZONES_MAX, 0).roi_width >= 4, "VL53L1X regions of interest are at least 4x4 SPADs");
+
+} // namespace geometry
+
+#endif /* INC_GEOMETRY_HPP_ */
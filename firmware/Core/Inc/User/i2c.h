@@ -0,0 +1,82 @@
+/**
+ * @file i2c.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Interrupt and DMA driven I2C master on I2C1
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_I2C_H_
+#define INC_I2C_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define I2C_SPEED_HZ 400000
+
+// NVIC priority of the I2C and DMA interrupts, done callbacks may use FreeRTOS FromISR functions
+#define I2C_IRQ_PRIORITY 5
+
+// A transfer on the bus without progress for this long is a lockup, the longest transfer takes ~2.5 ms
+#define I2C_STALL_MS 5
+
+// SCL pulses to let a slave finish the byte it is sending and release SDA
+#define I2C_RECOVERY_CLOCKS 9
+
+typedef enum {
+    eI2C_PRIO_HIGH,   // Time critical, results waiting to be read
+    eI2C_PRIO_NORMAL, // Ranging control
+    eI2C_PRIO_LOW,    // Boot, configuration and status polling
+    eI2C_PRIO_COUNT,
+} i2c_priority_e;
+
+typedef struct i2c_xfer i2c_xfer_t;
+
+/**
+ * @brief Called from interrupt context when a transfer has finished
+ * The transfer may be submitted again from within the callback.
+ */
+typedef void (*i2c_done_t)(i2c_xfer_t* xfer, bool ok);
+
+/**
+ * @brief A register read or write, owned by the caller and queued without copying.
+ * data must stay valid until done is called.
+ */
+struct i2c_xfer
+{
+    uint8_t     address;  // 7 bit device address
+    bool        read;     // Read len bytes from reg, otherwise write len bytes to reg
+    uint8_t     priority; // i2c_priority_e, transfers of one priority run in submission order
+    uint16_t    reg;      // 16 bit register index, sent MSB first
+    uint8_t*    data;
+    uint16_t    len;      // Reads need at least one byte
+    i2c_done_t  done;
+    void*       context;  // For the owner of the transfer
+    i2c_xfer_t* next;     // Private, queue link
+    uint32_t    queued;   // Private, cycles_now() at submission
+};
+
+typedef struct
+{
+    uint32_t transfers;  // Finished, including the failed ones
+    uint32_t errors;     // Ended with NACK, a bus error or a lockup
+    uint32_t recoveries; // Lockups cleared
+    uint32_t busy_us;    // Time with a transfer on the bus
+    uint32_t window_us;  // Time the stats cover
+    uint32_t queued[eI2C_PRIO_COUNT];
+    uint32_t wait_mean_us[eI2C_PRIO_COUNT]; // From submission until the transfer is on the bus
+    uint32_t wait_max_us[eI2C_PRIO_COUNT];
+} i2c_stats_t;
+
+void     i2c_init(void);
+void     i2c_submit(i2c_xfer_t* xfer);
+bool     i2c_is_idle(void);
+void     i2c_poll(uint32_t now_ms);
+uint32_t i2c_get_recoveries(void);
+void     i2c_get_stats(i2c_stats_t* stats);
+void     i2c_reset_stats(void);
+
+#endif /* INC_I2C_H_ */
@@ -0,0 +1,200 @@
+/**
+ * @file lidar.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief The five VL53L1X sensors on the lidar flex board
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_LIDAR_H_
+#define INC_LIDAR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/vl53l1x.h"
+
+#define LIDAR_COUNT 5
+
+// Sensor n gets address LIDAR_BASE_ADDRESS + n at boot
+#define LIDAR_BASE_ADDRESS 0x30
+
+// Sensors are ranged in groups of non-adjacent emitters, see s_groups in lidar.c
+#define LIDAR_GROUPS 2
+
+// Speed below the lowest speed of a regime before it is left for a slower one
+#define LIDAR_REGIME_HYSTERESIS_MM_S 100
+
+// Each sensor can range in up to LIDAR_ZONES_MAX narrower beams, one zone of the SPAD array at a time
+#define LIDAR_ZONES_MAX 4
+#define LIDAR_BEAMS_MAX (LIDAR_COUNT * LIDAR_ZONES_MAX)
+
+// SPAD array is LIDAR_SPADS x LIDAR_SPADS, the sensor and beam geometry is described in geometry.hpp
+#define LIDAR_SPADS 16
+
+// Results averaged by a calibration, as in the ULD
+#define LIDAR_CALIB_SAMPLES 50
+
+// Status of a beam in a scan that has no range, the sensor failed or the result could not be read
+#define LIDAR_STATUS_NONE 255
+
+// Health monitoring, see lidar_poll()
+#define LIDAR_POLL_MS             1   // Period lidar_poll() is called with, VL53L1X_POLL_PERIOD_MS
+#define LIDAR_TIMEOUT_MARGIN_MS   10  // On top of the timing budget before a shot without a result times out
+#define LIDAR_HEALTH_LIMIT        32  // Error score at which a sensor is removed from the schedule
+#define LIDAR_HEALTH_TIMEOUT_COST 16  // Added to the score for a timeout, every valid result takes 1 off
+#define LIDAR_HEALTH_READ_COST    8   // Added to the score for a result that could not be read
+#define LIDAR_HEALTH_STUCK        16  // Identical valid results in a row that count as a stuck sensor
+#define LIDAR_REBOOT_DELAY_MS     100 // Reset time before the first reboot attempt, doubles with every attempt
+#define LIDAR_REBOOT_SPACING_MS   500 // Bus rest after a boot attempt before the next reboot of any sensor
+#define LIDAR_REBOOTS             5   // Attempts before a sensor is given up on until lidar_init()
+
+// Distance mode and timing budget of all sensors, picked from the vehicle speed by lidar_set_speed()
+typedef enum {
+    eLIDAR_REGIME_PRECISE, // Crawling or stuck, long range and low noise
+    eLIDAR_REGIME_CRUISE,
+    eLIDAR_REGIME_FAST, // Racing, short range but the fastest updates
+    eLIDAR_REGIMES,
+} lidar_regime_e;
+
+typedef struct
+{
+    const char* name;
+    uint16_t    speed_mm_s; // Lowest speed of the regime
+    uint8_t     mode;       // vl53l1x_mode_e
+    uint16_t    budget_ms;  // A full scan takes zones * LIDAR_GROUPS budgets plus the trigger writes
+} lidar_regime_t;
+
+typedef enum {
+    eLIDAR_CALIB_OFFSET, // White target at ~140 mm, corrects the range offset
+    eLIDAR_CALIB_XTALK,  // Grey target at ~600 mm, compensates the cover glass, after the offset
+} lidar_calib_e;
+
+typedef enum {
+    eLIDAR_CALIB_IDLE,
+    eLIDAR_CALIB_RUNNING,
+    eLIDAR_CALIB_DONE,
+    eLIDAR_CALIB_FAILED, // Too many invalid ranges
+} lidar_calib_state_e;
+
+/**
+ * @brief Calibration of all sensors, kept in flash and written to the sensors at boot.
+ * Sensors without a calibration keep their factory values.
+ */
+typedef struct
+{
+    int16_t  offset_mm[LIDAR_COUNT];
+    uint16_t xtalk_cps[LIDAR_COUNT];
+    uint8_t  offset_valid; // Bit per sensor
+    uint8_t  xtalk_valid;  // Bit per sensor
+} lidar_calib_t;
+
+typedef enum {
+    eLIDAR_HEALTH_OK,
+    eLIDAR_HEALTH_REMOVED, // Out of the schedule and held in reset until the next reboot attempt
+    eLIDAR_HEALTH_REBOOTING,
+    eLIDAR_HEALTH_FAILED, // Given up on after LIDAR_REBOOTS attempts
+} lidar_health_state_e;
+
+/**
+ * @brief Health of a sensor. Timeouts and read errors add to an error score that valid results
+ * take down again, a sensor that reaches LIDAR_HEALTH_LIMIT or gets stuck is removed from the schedule.
+ */
+typedef struct
+{
+    uint8_t  state;       // lidar_health_state_e
+    uint8_t  score;       // Error score
+    uint8_t  reboots;     // Attempts since the sensor last worked
+    uint32_t timeouts;    // Shots without a data ready interrupt
+    uint32_t read_errors; // Data ready but the result could not be read
+    uint32_t stuck;       // Removals for LIDAR_HEALTH_STUCK identical results
+    uint32_t removals;    // From the schedule, for any reason
+    uint32_t recoveries;  // Reboots that brought the sensor back
+} lidar_health_t;
+
+// Consumers of complete scans, the subscribers of the scan topic
+typedef enum {
+    eLIDAR_READER_CONTROL,
+    eLIDAR_READER_CLI,
+    eLIDAR_READERS,
+} lidar_reader_e;
+
+/**
+ * @brief One complete scan, every beam ranged once. Struct of arrays so a consumer only touches the fields it uses.
+ */
+typedef struct
+{
+    uint32_t sequence;                // Increments by one for every published scan
+    uint32_t stamp;                   // cycles_now() when the last beam was read
+    uint8_t  beams;                   // Used entries of the arrays, beams are ordered counter clockwise
+    uint8_t  status[LIDAR_BEAMS_MAX]; // 0 is a valid range, see vl53l1x_result_t
+    uint16_t distance_mm[LIDAR_BEAMS_MAX];
+    uint16_t signal_kcps[LIDAR_BEAMS_MAX];
+    uint32_t capture[LIDAR_BEAMS_MAX];     // cycles_now() at the data ready interrupt of the beam
+    uint32_t valid;                        // Bit per beam, set if filtered_mm holds a range
+    uint16_t filtered_mm[LIDAR_BEAMS_MAX]; // See lidar_filter.h
+} lidar_scan_t;
+
+typedef struct
+{
+    vl53l1x_result_t result;
+    uint32_t         stamp;  // cycles_now() at the data ready interrupt
+    uint32_t         period; // Cycles between the last two results
+    uint32_t         count;  // Results received since the zones were set
+} lidar_range_t;
+
+typedef struct
+{
+    uint8_t sensor;
+    uint8_t zone;
+    uint8_t roi_center;  // SPAD number, see vl53l1x_set_roi()
+    uint8_t roi_width;   // SPAD columns
+    float   azimuth_deg; // Beam center, counter clockwise from straight ahead
+    float   width_deg;   // Horizontal field of view of the beam
+    float   cos_azimuth; // Beam direction as a unit vector in the vehicle frame
+    float   sin_azimuth;
+    float   mount_x_mm;  // Sensor position in the vehicle frame, x forward and y left
+    float   mount_y_mm;
+} lidar_beam_t;
+
+typedef struct
+{
+    bool     running;
+    uint32_t scans;                        // Full scans, every group has ranged once
+    uint32_t scan_period;                  // Cycles of the last full scan
+    uint32_t slot_period[LIDAR_GROUPS];    // Cycles from trigger to the last result of each group
+    uint8_t  zones;                        // Beams per sensor
+    uint32_t published;                    // Scans published to the readers
+    uint32_t dropped;                      // Scans that never got all their results
+    uint8_t  regime;                       // lidar_regime_e of the scan ranging now
+    uint32_t switches;                     // Regime changes
+    uint32_t regime_scans[eLIDAR_REGIMES]; // Full scans in each regime
+    uint64_t regime_us[eLIDAR_REGIMES];    // Time spent ranging full scans in each regime
+} lidar_schedule_t;
+
+void                  lidar_init(void);
+void                  lidar_start(void);
+void                  lidar_stop(void);
+void                  lidar_poll(uint32_t now_ms);
+bool                  lidar_is_booted(void);
+bool                  lidar_set_zones(uint8_t zones);
+void                  lidar_set_speed(int32_t speed_mm_s);
+const lidar_regime_t* lidar_get_regime(lidar_regime_e regime);
+uint8_t               lidar_get_beam_count(void);
+bool                  lidar_get_beam(uint8_t beam, lidar_beam_t* info);
+bool                  lidar_get_range(uint8_t beam, lidar_range_t* range);
+const vl53l1x_t*      lidar_get_sensor(uint8_t index);
+bool                  lidar_get_health(uint8_t index, lidar_health_t* health);
+void                  lidar_get_schedule(lidar_schedule_t* schedule);
+const lidar_scan_t*   lidar_get_scan(lidar_reader_e reader, bool* fresh);
+bool                  lidar_calibrate(uint8_t sensor, lidar_calib_e kind, uint16_t target_mm);
+lidar_calib_state_e   lidar_get_calib_state(void);
+void                  lidar_get_calibration(lidar_calib_t* calib);
+bool                  lidar_save_calibration(void);
+bool                  lidar_clear_calibration(void);
+void                  lidar_exti(uint16_t pin);
+
+#endif /* INC_LIDAR_H_ */
@@ -0,0 +1,38 @@
+/**
+ * @file lidar_deskew.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Lidar scans as points in the vehicle frame, compensated for the motion during the scan
+ * 
+ * The beams of a scan are captured at different times, at speed the vehicle moves several
+ * centimetres and turns a few degrees between the first and the last. Every point is placed with
+ * the odometry pose at its own capture and moved into the vehicle frame at the reference time,
+ * the capture of the newest beam, so the whole scan looks as if it was taken at once.
+ * @version 0.1
+ * @date 2023-11-28
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_LIDAR_DESKEW_H_
+#define INC_LIDAR_DESKEW_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/lidar.h"
+
+typedef struct
+{
+    uint32_t sequence; // Of the scan
+    uint32_t stamp;    // Reference time, cycles_now() of the newest capture
+    uint8_t  beams;
+    float    x_mm[LIDAR_BEAMS_MAX]; // Vehicle frame at the reference time, x forward and y left
+    float    y_mm[LIDAR_BEAMS_MAX];
+    uint32_t valid;    // Bit per beam, set if the beam has a filtered range
+    uint32_t deskewed; // Bit per beam, set if odometry covered its capture, uncompensated otherwise
+} lidar_points_t;
+
+void lidar_deskew(const lidar_scan_t* scan, bool compensate, lidar_points_t* points);
+
+#endif /* INC_LIDAR_DESKEW_H_ */
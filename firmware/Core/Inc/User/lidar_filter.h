@@ -0,0 +1,55 @@
+/**
+ * @file lidar_filter.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Range validation and filtering of lidar scans
+ * 
+ * Every beam goes through the same fixed steps, whatever the data:
+ * 1. Gating on range status, signal rate and distance. Wrap around and sigma failures show up as status.
+ * 2. Median of the last LIDAR_FILTER_MEDIAN accepted ranges, removes single outliers.
+ * 3. First order IIR on the median, in Q4 fixed point.
+ * A rejected range is replaced by the filter output. After LIDAR_FILTER_HOLD rejected ranges in a row
+ * the beam is invalid until a range is accepted again, which restarts the median and IIR. A beam is
+ * valid once LIDAR_FILTER_MEDIAN ranges have been accepted since the restart, so a single outlier
+ * cannot start it.
+ * @version 0.1
+ * @date 2023-11-26
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_LIDAR_FILTER_H_
+#define INC_LIDAR_FILTER_H_
+
+#include <stdint.h>
+
+#include "User/lidar.h"
+
+#define LIDAR_FILTER_MEDIAN 3 // Odd
+#define LIDAR_FILTER_HOLD   3 // Rejected ranges in a row a beam stays valid for
+
+typedef struct
+{
+    uint32_t accept;          // Bit n set accepts range status n
+    uint16_t min_signal_kcps; // Weaker returns are rejected
+    uint16_t max_mm;          // Longer ranges are rejected
+    uint16_t alpha;           // IIR weight of a new range in Q8, 256 disables the IIR
+} lidar_filter_config_t;
+
+typedef struct
+{
+    lidar_filter_config_t config;
+    uint8_t               beams;                     // Beams of the state, reset when a scan has a different number
+    uint8_t               head;                      // Next history entry
+    uint8_t               misses[LIDAR_BEAMS_MAX];   // Rejected ranges in a row, saturates at LIDAR_FILTER_HOLD + 1
+    uint8_t               accepted[LIDAR_BEAMS_MAX]; // Since the restart, saturates at LIDAR_FILTER_MEDIAN
+    uint16_t              history[LIDAR_BEAMS_MAX][LIDAR_FILTER_MEDIAN];
+    int32_t               state[LIDAR_BEAMS_MAX]; // IIR output in Q4 mm
+    uint32_t              rejected;               // Ranges rejected since init
+} lidar_filter_t;
+
+void lidar_filter_init(lidar_filter_t* filter, const lidar_filter_config_t* config);
+void lidar_filter_reset(lidar_filter_t* filter, uint8_t beams);
+void lidar_filter_run(lidar_filter_t* filter, lidar_scan_t* scan);
+
+#endif /* INC_LIDAR_FILTER_H_ */
@@ -0,0 +1,31 @@
+/**
+ * @file lidar_recording.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Recorded lidar scans, input of the lidar_filter benchmark
+ * lidar_recording.c is generated with 'lidar_sim -z 3 -f <permille> -r lidar_recording.c', so the benchmark
+ * filters the same data on target and host, including rejected and outlier ranges.
+ * @version 0.1
+ * @date 2023-11-26
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_LIDAR_RECORDING_H_
+#define INC_LIDAR_RECORDING_H_
+
+#include <stdint.h>
+
+#define LIDAR_RECORDING_SCANS 32
+#define LIDAR_RECORDING_BEAMS 15
+
+typedef struct
+{
+    uint8_t  status[LIDAR_RECORDING_BEAMS];
+    uint16_t distance_mm[LIDAR_RECORDING_BEAMS];
+    uint16_t signal_kcps[LIDAR_RECORDING_BEAMS];
+} lidar_recording_t;
+
+extern const lidar_recording_t lidar_recording[LIDAR_RECORDING_SCANS];
+
+#endif /* INC_LIDAR_RECORDING_H_ */
@@ -0,0 +1,53 @@
+/**
+ * @file motor.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Drive motor on the AUX board, center-aligned PWM into the two inputs of its H-bridge
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_MOTOR_H_
+#define INC_MOTOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOTOR_PWM_HZ     20000 // Above hearing, default at init
+#define MOTOR_PWM_HZ_MIN 1000  // The half period must fit the 16 bit timer
+#define MOTOR_PWM_HZ_MAX 50000 // Keeps at least 960 steps of duty resolution
+
+/**
+ * @brief What the bridge does in the off time of every period
+ */
+typedef enum {
+    eMOTOR_DECAY_COAST, // Both inputs low, the current decays fast through the diodes
+    eMOTOR_DECAY_BRAKE, // Both inputs high, the motor is shorted and the current decays slowly
+} motor_decay_e;
+
+/**
+ * @brief Waveform of the inputs, the same in every period until the next command
+ */
+typedef struct
+{
+    uint16_t period; // Timer counts of half a PWM period, counting up and down
+    uint16_t in1;    // Counts high per half period, 0 is always low and period always high
+    uint16_t in2;
+} motor_pwm_t;
+
+void motor_pwm_drive(motor_pwm_t* pwm, float duty, motor_decay_e decay);
+void motor_pwm_brake(motor_pwm_t* pwm);
+void motor_pwm_coast(motor_pwm_t* pwm);
+
+void     motor_init(void);
+bool     motor_set_frequency(uint32_t hz);
+uint32_t motor_get_frequency(void);
+void     motor_set_decay(motor_decay_e decay);
+void     motor_set(float duty);
+void     motor_brake(void);
+void     motor_coast(void);
+float    motor_get(void);
+
+#endif /* INC_MOTOR_H_ */
@@ -0,0 +1,38 @@
+/**
+ * @file nvm.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Small records kept in the last two flash sectors, e.g. calibration data
+ * 
+ * Records are appended to a sector with a CRC, the latest valid record of an id is the current one.
+ * When the sector is full the latest records are copied to the other one, a reset during the copy keeps
+ * the old records. Writing stalls the CPU while the flash is busy, ~16 us per word and 1-2 s when the
+ * other sector is erased for a copy, so only write from a task and never while driving.
+ * @version 0.1
+ * @date 2023-11-27
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_NVM_H_
+#define INC_NVM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sectors 6 and 7, excluded from the FLASH region in STM32F411CEUX_FLASH.ld
+#define NVM_SIZE       (128 * 1024) // Of one sector
+#define NVM_RECORD_MAX 64 // Data bytes of one record
+
+typedef enum {
+    eNVM_LIDAR_CALIB = 1,
+    eNVM_SERVO_CALIB,
+    eNVM_IDS,
+} nvm_id_e;
+
+bool     nvm_read(nvm_id_e id, void* data, uint16_t size);
+bool     nvm_write(nvm_id_e id, const void* data, uint16_t size);
+bool     nvm_erase(nvm_id_e id);
+uint32_t nvm_get_free(void);
+
+#endif /* INC_NVM_H_ */
@@ -0,0 +1,37 @@
+/**
+ * @file odom.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Recent vehicle poses from odometry, to look up where the vehicle was at a given time
+ * @version 0.1
+ * @date 2023-11-28
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_ODOM_H_
+#define INC_ODOM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Poses kept, at 100 Hz the history covers 1.28 s which is longer than the slowest lidar scan
+#define ODOM_HISTORY 128
+
+/**
+ * @brief Pose of the vehicle origin (rear axle center) in the odometry frame, x forward and y left at start
+ */
+typedef struct
+{
+    uint32_t stamp; // cycles_now() of the pose
+    float    x_mm;
+    float    y_mm;
+    float    yaw_rad; // Counter clockwise, not wrapped
+} odom_pose_t;
+
+void odom_reset(void);
+void odom_update(uint32_t stamp, float x_mm, float y_mm, float yaw_rad);
+bool odom_get_latest(odom_pose_t* pose);
+bool odom_get_pose(uint32_t stamp, odom_pose_t* pose);
+
+#endif /* INC_ODOM_H_ */
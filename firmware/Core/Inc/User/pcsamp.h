@@ -0,0 +1,42 @@
+/**
+ * @file pcsamp.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Statistical PC-sampling profiler
+ * @version 0.1
+ * @date 2023-11-19
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_PCSAMP_H_
+#define INC_PCSAMP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of samples that fit in the ring buffer between two dumps (12 bytes each)
+#define PCSAMP_BUFFER_SIZE 1024
+
+#define PCSAMP_DEFAULT_HZ  2000
+#define PCSAMP_MAX_HZ      20000
+
+// NVIC priority of the sampling timer, above configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+// so PCs inside critical sections and other ISRs are sampled too
+#define PCSAMP_IRQ_PRIORITY 0
+
+typedef struct
+{
+    uint32_t pc;   // Stacked PC of the interrupted code
+    uint32_t lr;   // Stacked LR, approximates the caller
+    void*    task; // Running task handle, NULL if an ISR was interrupted
+} pcsamp_sample_t;
+
+void     pcsamp_start(uint32_t hz);
+void     pcsamp_stop(void);
+bool     pcsamp_is_running(void);
+bool     pcsamp_pop(pcsamp_sample_t* sample);
+uint32_t pcsamp_get_dropped(void);
+uint32_t pcsamp_get_total(void);
+
+#endif /* INC_PCSAMP_H_ */
@@ -0,0 +1,73 @@
+/**
+ * @file pool.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Fixed size block pools, lock-free allocation from tasks and interrupts
+ *
+ * Pools of fixed size blocks replace the heap, for now the lines of the CLI are their only user. Allocation and
+ * free are O(1): a pool keeps its free blocks on a lock-free stack, one compare and swap (LDREX/STREX on the M4)
+ * pops or pushes a block. pool_alloc() takes a block from the pool of the smallest blocks that fit and moves up
+ * to the next size when that pool is empty, a user with another size of its own adds a pool to pool_e.
+ * heap_4 is left to the kernel for the task stacks.
+ * With POOL_DEBUG, the default in the host build, freed blocks are filled with a pattern and every free is
+ * checked against the state of the block:
+ * - double free: the block was not allocated, the free is ignored and counted
+ * - use after free: the pattern was overwritten when the block is allocated again, counted
+ * Freed blocks are the first ones allocated again, a write after free is found by the next allocation.
+ * @code
+ * message_t* message = pool_alloc(sizeof(message_t));
+ * if (message != NULL) {
+ *     ...
+ *     pool_free(message);
+ * }
+ * @endcode
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_POOL_H_
+#define INC_POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef POOL_DEBUG
+#ifdef DONATELLO_HOST
+#define POOL_DEBUG 1
+#else
+#define POOL_DEBUG 0
+#endif
+#endif
+
+#define POOL_MESSAGE_SIZE 256 // A line of the CLI, the longest one printed is ~150 characters
+#define POOL_MESSAGES     4
+
+// From the smallest blocks to the largest
+typedef enum {
+    ePOOL_MESSAGE,
+    ePOOLS,
+} pool_e;
+
+typedef struct
+{
+    const char* name;
+    uint16_t    size;           // Of a block
+    uint16_t    blocks;
+    uint32_t    in_use;
+    uint32_t    high_water;     // Most blocks in use at once
+    uint32_t    allocs;
+    uint32_t    failures;       // Allocations of this size that found no free block in any pool
+    uint32_t    double_frees;   // POOL_DEBUG only
+    uint32_t    use_after_free; // POOL_DEBUG only, blocks written to while free
+} pool_stats_t;
+
+void* pool_alloc(size_t size);
+bool  pool_free(void* block);
+
+void pool_get_stats(pool_e pool, pool_stats_t* stats);
+void pool_reset_stats(void);
+
+#endif /* INC_POOL_H_ */
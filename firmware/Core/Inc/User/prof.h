@@ -0,0 +1,127 @@
+/**
+ * @file prof.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Latency histograms for hot code sections
+ * 
+ * Usage, measures until the end of the enclosing block:
+ * @code
+ * void foo(void) {
+ *     PROF_SCOPE("foo");
+ *     ...
+ * }
+ * @endcode
+ * Scopes are placed in the 'prof_scopes' section so they are all known at link time.
+ * A scope should only be recorded from one context at a time, recording is not atomic.
+ * Build with PROF_ENABLED=0 and the macros compile to nothing.
+ * @version 0.1
+ * @date 2023-11-20
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_PROF_H_
+#define INC_PROF_H_
+
+#include <stdint.h>
+
+#include "User/cycles.h"
+
+#ifndef PROF_ENABLED
+#define PROF_ENABLED 1
+#endif
+
+// Buckets are split on the most significant bit plus PROF_SUB_BITS following bits
+#define PROF_SUB_BITS 2
+#define PROF_BUCKETS  (32 << PROF_SUB_BITS)
+
+typedef struct
+{
+    const char* name;
+    uint32_t    count;
+    uint32_t    max;
+    uint64_t    sum;
+    uint32_t    hist[PROF_BUCKETS];
+} prof_scope_t;
+
+#ifndef DONATELLO_HOST
+// The linker scripts align the prof_scopes section to 8, __start_prof_scopes must be the first scope
+_Static_assert(_Alignof(prof_scope_t) <= 8, "prof_scopes is aligned to 8 in the linker scripts");
+#endif
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t mean;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+} prof_stats_t;
+
+typedef struct
+{
+    prof_scope_t* scope;
+    uint32_t      start;
+} prof_guard_t;
+
+/**
+ * @brief Record one measurement, O(1)
+ * 
+ * @param scope Scope to record into
+ * @param cycles Measured cycles
+ */
+static inline void prof_record(prof_scope_t* scope, uint32_t cycles) {
+    uint32_t bucket = 0;
+    if (cycles >= (2u << PROF_SUB_BITS)) {
+        uint32_t msb = 31 - __builtin_clz(cycles);
+        bucket = ((msb - PROF_SUB_BITS) << PROF_SUB_BITS) + (cycles >> (msb - PROF_SUB_BITS));
+    } else {
+        bucket = cycles;
+    }
+
+    scope->hist[bucket]++;
+    scope->count++;
+    scope->sum += cycles;
+    if (cycles > scope->max) {
+        scope->max = cycles;
+    }
+}
+
+static inline void prof_guard_end(prof_guard_t* guard) {
+    prof_record(guard->scope, cycles_now() - guard->start);
+}
+
+#define PROF_CAT_(a, b) a##b
+#define PROF_CAT(a, b)  PROF_CAT_(a, b)
+
+#if PROF_ENABLED
+/**
+ * @brief Define a scope that can be recorded with prof_record() or PROF_SCOPE_VAR()
+ */
+#define PROF_DEFINE(var, label) \
+    __attribute__((section("prof_scopes"), used, aligned(8))) prof_scope_t var = {.name = label}
+
+/**
+ * @brief Measure from here to the end of the enclosing block into an already defined scope
+ */
+#define PROF_SCOPE_VAR(var)                                                                           \
+    prof_guard_t PROF_CAT(prof_guard_, __LINE__) __attribute__((cleanup(prof_guard_end))) = {&(var), \
+                                                                                            cycles_now()}
+
+/**
+ * @brief Measure from here to the end of the enclosing block
+ */
+#define PROF_SCOPE(label)                                             \
+    static PROF_DEFINE(PROF_CAT(prof_scope_, __LINE__), label);      \
+    PROF_SCOPE_VAR(PROF_CAT(prof_scope_, __LINE__))
+#else
+#define PROF_DEFINE(var, label)
+#define PROF_SCOPE_VAR(var)
+#define PROF_SCOPE(label)
+#endif
+
+prof_scope_t* prof_next(prof_scope_t* scope);
+void          prof_get_stats(const prof_scope_t* scope, prof_stats_t* stats);
+void          prof_reset(void);
+
+#endif /* INC_PROF_H_ */
@@ -0,0 +1,73 @@
+/**
+ * @file ring.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Byte ring buffer between one producer and one consumer, read in place
+ *
+ * The consumer gets the bytes where they are stored instead of a copy: ring_peek() returns the longest
+ * contiguous run of unread bytes, they stay valid and unchanged until ring_consume() hands them back. A USB
+ * transfer can be started on them directly and consumed when it completes.
+ * Lock-free between the producer and the consumer, either may be an interrupt. Several producers must
+ * serialize themselves, e.g. in a critical section.
+ * @code
+ * RING(rx, 256);
+ *
+ * // Producer
+ * ring_put(&rx, c);
+ *
+ * // Consumer
+ * uint16_t       len;
+ * const uint8_t* data = ring_peek(&rx, &len);
+ * ...
+ * ring_consume(&rx, len);
+ * @endcode
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_RING_H_
+#define INC_RING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    uint8_t*         data;
+    uint16_t         size;       // Power of two
+    _Atomic uint32_t head;       // Bytes written, producer only
+    _Atomic uint32_t tail;       // Bytes consumed, consumer only
+    uint32_t         dropped;    // Bytes that did not fit, producer only
+    uint16_t         high_water; // Most bytes stored at once, producer only
+} ring_t;
+
+typedef struct
+{
+    uint16_t size;
+    uint16_t used;
+    uint16_t high_water;
+    uint32_t dropped;
+} ring_stats_t;
+
+/**
+ * Define a ring of bytes, size must be a power of two.
+ * May be preceded by static.
+ */
+#define RING(var, bytes)                                                                                   \
+    ring_t var = {.data = __extension__(uint8_t[bytes]){}, .size = (bytes)};                               \
+    _Static_assert((bytes) > 1 && (bytes) <= 0x8000 && !((bytes) & ((bytes)-1)), "Size of ring " #var)
+
+// Producer
+bool     ring_put(ring_t* ring, uint8_t c);
+uint16_t ring_free(const ring_t* ring);
+
+// Consumer
+const uint8_t* ring_peek(ring_t* ring, uint16_t* len);
+void           ring_consume(ring_t* ring, uint16_t len);
+
+void ring_get_stats(const ring_t* ring, ring_stats_t* stats);
+void ring_reset_stats(ring_t* ring);
+
+#endif /* INC_RING_H_ */
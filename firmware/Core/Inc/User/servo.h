@@ -0,0 +1,56 @@
+/**
+ * @file servo.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Steering servo, pulse width of a timer channel from a calibration kept in flash
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_SERVO_H_
+#define INC_SERVO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SERVO_FRAME_HZ_MIN 50   // Analog servos
+#define SERVO_FRAME_HZ_MAX 333  // Digital servos, the fastest frame rate in use
+#define SERVO_PULSE_MIN_US 500  // Calibrated pulses must stay within
+#define SERVO_PULSE_MAX_US 2500 // Leaves 500 us low time at the fastest frame rate
+
+typedef enum {
+    eSERVO_LEFT,   // Full lock to the left, the steering angle of GEOMETRY_STEER_MAX_DEG
+    eSERVO_CENTER, // Straight
+    eSERVO_RIGHT,  // Full lock to the right
+    eSERVO_POINTS,
+} servo_point_e;
+
+typedef struct
+{
+    float    pulse_us[eSERVO_POINTS]; // Either way around, the center between the others
+    uint16_t frame_hz;                // Fastest frame rate the servo takes
+} servo_calib_t;
+
+extern const servo_calib_t servo_calib_default; // Until one is saved
+
+
+void  servo_init(void);
+void  servo_set(float steer_deg);
+float servo_get(void);
+bool  servo_set_pulse(float pulse_us);
+float servo_get_pulse(void);
+
+bool servo_set_point(servo_point_e point);
+bool servo_set_frame(uint16_t frame_hz);
+void servo_get_calibration(servo_calib_t* calib);
+bool servo_save_calibration(void);
+bool servo_clear_calibration(void);
+
+// Mapping shared by the servo driver and its host mock, see servo_map.c
+bool  servo_map_valid(const servo_calib_t* calib);
+float servo_map_pulse(const servo_calib_t* calib, float steer_deg);
+float servo_map_angle(const servo_calib_t* calib, float pulse_us);
+
+#endif /* INC_SERVO_H_ */
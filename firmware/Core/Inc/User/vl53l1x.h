@@ -0,0 +1,109 @@
+/**
+ * @file vl53l1x.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Non-blocking driver for the ST VL53L1X time-of-flight sensor
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef INC_VL53L1X_H_
+#define INC_VL53L1X_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/i2c.h"
+
+// 7 bit address after reset
+#define VL53L1X_DEFAULT_ADDRESS 0x29
+
+// Boot and the first measurement are polled, one register read per vl53l1x_poll() call until they are done
+#define VL53L1X_POLL_PERIOD_MS  1   // Period vl53l1x_poll() is called with
+#define VL53L1X_POLL_TIMEOUT_MS 200 // Polling before the boot fails
+
+// Failed writes of the timing or the region of interest in a row that are written again before the request is dropped
+#define VL53L1X_RETRIES 3
+
+// Bytes read from RESULT__RANGE_STATUS for one measurement
+#define VL53L1X_RESULT_SIZE 17
+
+typedef enum {
+    eVL53L1X_OFF,     // In reset or not booted yet
+    eVL53L1X_BOOTING, // Address assignment and configuration in progress
+    eVL53L1X_IDLE,    // Configured, not ranging
+    eVL53L1X_RANGING,
+    eVL53L1X_FAILED, // Boot or configuration failed
+} vl53l1x_state_e;
+
+typedef enum {
+    eVL53L1X_SHORT, // Up to ~1.3 m
+    eVL53L1X_LONG,  // Up to ~4 m in the dark, the default
+} vl53l1x_mode_e;
+
+typedef enum {
+    eVL53L1X_EVT_BOOTED,
+    eVL53L1X_EVT_BOOT_FAILED,
+    eVL53L1X_EVT_RESULT,
+    eVL53L1X_EVT_READ_FAILED, // Data ready but the result could not be read, one of the two follows every interrupt
+} vl53l1x_event_e;
+
+typedef struct
+{
+    uint16_t distance_mm;
+    uint16_t signal_kcps;  // Signal rate per SPAD
+    uint16_t ambient_kcps; // Ambient rate
+    uint8_t  spads;        // Number of enabled SPADs
+    uint8_t  status;       // 0 is a valid range, see the ST range status codes
+} vl53l1x_result_t;
+
+typedef struct vl53l1x vl53l1x_t;
+
+/**
+ * @brief Called from interrupt context when an operation has finished or a result is available
+ */
+typedef void (*vl53l1x_callback_t)(vl53l1x_t* dev, vl53l1x_event_e event);
+
+struct vl53l1x
+{
+    uint8_t            address; // Current 7 bit address
+    uint8_t            new_address;
+    volatile uint8_t   state;   // vl53l1x_state_e
+    uint8_t            step;    // Private, position in the running operation
+    volatile uint8_t   pending; // Private, operations waiting for the bus
+    volatile bool      waiting; // Private, the last poll was not ready, vl53l1x_poll() reads again
+    bool               polling; // Private, poll_ms is set
+    uint32_t           poll_ms; // Private, vl53l1x_poll() time of the first poll that was not ready
+    uint8_t            retries; // Private, failed configuration writes in a row
+    uint8_t            mode;       // vl53l1x_mode_e
+    uint16_t           budget_ms;  // Timing budget
+    uint8_t            roi_center; // SPAD in the center of the region of interest
+    uint8_t            roi_size;   // Height - 1 in the high nibble, width - 1 in the low
+    int16_t            offset_mm;  // Last written range offset, the factory value until then
+    uint16_t           xtalk_cps;  // Last written crosstalk compensation, the factory value until then
+    vl53l1x_callback_t callback;
+    void*              context; // For the owner of the sensor
+    i2c_xfer_t         xfer;
+    uint8_t            buffer[VL53L1X_RESULT_SIZE];
+    vl53l1x_result_t   result; // Latest result, valid in the eVL53L1X_EVT_RESULT callback
+    uint32_t           results;
+    uint32_t           errors;
+};
+
+void vl53l1x_init(vl53l1x_t* dev, vl53l1x_callback_t callback, void* context);
+void vl53l1x_boot(vl53l1x_t* dev, uint8_t address);
+bool vl53l1x_reset(vl53l1x_t* dev);
+void vl53l1x_poll(vl53l1x_t* dev, uint32_t now_ms);
+void vl53l1x_start(vl53l1x_t* dev);
+void vl53l1x_trigger(vl53l1x_t* dev);
+bool vl53l1x_set_timing_budget(vl53l1x_t* dev, uint16_t budget_ms);
+bool vl53l1x_set_timing(vl53l1x_t* dev, vl53l1x_mode_e mode, uint16_t budget_ms);
+bool vl53l1x_set_roi(vl53l1x_t* dev, uint8_t center, uint8_t width, uint8_t height);
+bool vl53l1x_set_offset(vl53l1x_t* dev, int16_t offset_mm);
+bool vl53l1x_set_xtalk(vl53l1x_t* dev, uint16_t xtalk_cps);
+void vl53l1x_stop(vl53l1x_t* dev);
+void vl53l1x_data_ready(vl53l1x_t* dev);
+
+#endif /* INC_VL53L1X_H_ */
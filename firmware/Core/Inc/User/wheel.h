@@ -0,0 +1,49 @@
+/**
+ * @file wheel.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Closed loop wheel speed, the controller of wheel_pid.h run with every encoder sample
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_WHEEL_H_
+#define INC_WHEEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/prof.h"
+#include "User/wheel_pid.h"
+
+#define WHEEL_LOG_SAMPLES 500 // Step response, 0.5 s at the encoder rate
+
+typedef struct
+{
+    int16_t target_mm_s; // Slew limited target
+    int16_t speed_mm_s;  // Measured
+    int16_t duty;        // In 1/10000
+} wheel_log_t;
+
+typedef struct
+{
+    bool  on;          // The controller drives the motor
+    float command_mm_s;
+    float target_mm_s; // Slew limited
+    float speed_mm_s;  // Measured
+    float duty;
+} wheel_state_t;
+
+void                wheel_init(void);
+void                wheel_set(float speed_mm_s);
+void                wheel_off(void);
+void                wheel_get(wheel_state_t* state);
+wheel_pid_config_t* wheel_get_config(void);
+void                wheel_start_log(void);
+uint16_t            wheel_get_log(const wheel_log_t** log);
+void                wheel_get_timing(prof_stats_t* exec, prof_stats_t* period);
+void                wheel_reset_timing(void);
+
+#endif /* INC_WHEEL_H_ */
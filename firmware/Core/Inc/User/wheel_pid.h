@@ -0,0 +1,56 @@
+/**
+ * @file wheel_pid.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Wheel speed controller, PID with feedforward, anti-windup and an acceleration limited target
+ *
+ * The target speed moves towards the commanded one at no more than accel_mm_s2, so a step becomes a ramp
+ * the motor can follow without slipping the wheels. Feedforward gives the duty that follows the ramped
+ * target, static friction plus a share per speed and per acceleration, the PID only corrects what the
+ * feedforward misses (battery voltage, load, friction). The derivative acts on the measured speed so a
+ * new target does not kick it. Feedforward and PID give the duty at nominal battery voltage, it is divided by
+ * the actual supply so the loop sees the same plant from a full to an empty pack. The output is clamped to
+ * duty_max or the limit of the low voltage policy. While the output saturates, neither the integral nor the
+ * target move further in its direction, nothing winds up while the motor cannot follow. The integral is
+ * also bounded.
+ * No hardware access, the same code runs on target and against a plant model on the host.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef INC_WHEEL_PID_H_
+#define INC_WHEEL_PID_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    float kp;           // Duty per mm/s of error
+    float ki;           // Duty per mm of integrated error
+    float kd;           // Duty per mm/s2 of measured acceleration
+    float kv;           // Feedforward duty per mm/s of target
+    float ka;           // Feedforward duty per mm/s2 of target, the time constant of the motor times kv
+    float ks;           // Feedforward duty against static friction, in the direction of the target
+    float integral_max; // Largest duty from the integral
+    float duty_max;     // Output clamp, both directions, the limit passed to the update may be lower
+    float accel_mm_s2;  // Slew limit of the target
+} wheel_pid_config_t;
+
+typedef struct
+{
+    const wheel_pid_config_t* config;
+    float                     target_mm_s; // Slew limited target
+    float                     integral;    // Duty
+    float                     speed_mm_s;  // Previous measurement, for the derivative
+    float                     duty;        // Last output
+    bool                      saturated;   // Last output was clamped
+} wheel_pid_t;
+
+void  wheel_pid_init(wheel_pid_t* pid, const wheel_pid_config_t* config);
+void  wheel_pid_reset(wheel_pid_t* pid, float speed_mm_s);
+float wheel_pid_update(wheel_pid_t* pid, float command_mm_s, float speed_mm_s, float supply, float limit, float dt_s);
+
+#endif /* INC_WHEEL_PID_H_ */
@@ -62,6 +62,31 @@ void Error_Handler(void);
 #define BUTTON_Pin GPIO_PIN_3
 #define BUTTON_GPIO_Port GPIOA
 #define BUTTON_EXTI_IRQn EXTI3_IRQn
+#define LIDAR1_INT_Pin GPIO_PIN_0
+#define LIDAR1_INT_GPIO_Port GPIOB
+#define LIDAR1_INT_EXTI_IRQn EXTI0_IRQn
+#define LIDAR2_INT_Pin GPIO_PIN_1
+#define LIDAR2_INT_GPIO_Port GPIOB
+#define LIDAR2_INT_EXTI_IRQn EXTI1_IRQn
+#define LIDAR3_INT_Pin GPIO_PIN_2
+#define LIDAR3_INT_GPIO_Port GPIOB
+#define LIDAR3_INT_EXTI_IRQn EXTI2_IRQn
+#define LIDAR5_INT_Pin GPIO_PIN_10
+#define LIDAR5_INT_GPIO_Port GPIOB
+#define LIDAR5_INT_EXTI_IRQn EXTI15_10_IRQn
+#define LIDAR1_XSHUT_Pin GPIO_PIN_12
+#define LIDAR1_XSHUT_GPIO_Port GPIOB
+#define LIDAR2_XSHUT_Pin GPIO_PIN_13
+#define LIDAR2_XSHUT_GPIO_Port GPIOB
+#define LIDAR3_XSHUT_Pin GPIO_PIN_14
+#define LIDAR3_XSHUT_GPIO_Port GPIOB
+#define LIDAR4_XSHUT_Pin GPIO_PIN_15
+#define LIDAR4_XSHUT_GPIO_Port GPIOB
+#define LIDAR5_XSHUT_Pin GPIO_PIN_15
+#define LIDAR5_XSHUT_GPIO_Port GPIOA
+#define LIDAR4_INT_Pin GPIO_PIN_4
+#define LIDAR4_INT_GPIO_Port GPIOB
+#define LIDAR4_INT_EXTI_IRQn EXTI4_IRQn
 
 /* USER CODE BEGIN Private defines */
 
@@ -0,0 +1,196 @@
+/**
+ * @file battery.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Battery voltage, sampled continuously by ADC and DMA, and the low voltage policy of battery_monitor.h
+ * ADC1 converts the battery divider on PA4 (IN4) and the internal reference (IN17) in continuous scan mode
+ * at the longest sampling time. DMA2 Stream0 moves the pairs into a circular buffer of two blocks, the CPU
+ * only runs at the half and full transfer interrupts, once per BATTERY_BLOCK pairs. The block mean is
+ * ratiometric to the factory calibrated reference, so it does not depend on VDDA.
+ * An overrun, the DMA late to take a conversion, stops the ADC requests, its interrupt restarts the scan.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+#include "User/battery.h"
+#include "User/battery_monitor.h"
+
+#define DMA_STREAM     DMA2_Stream0
+#define DMA_FLAGS      (DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0)
+#define ADC_PRESCALER  8
+#define PAIR_CYCLES    (2 * (480 + 12)) // Two conversions at 480 cycles sampling and 12 bit
+#define VREFINT_CAL    (*(const uint16_t*)0x1FFF7A2A) // Reference at 3.3 V VDDA, 30 degrees C
+#define VREFINT_CAL_MV 3300.0f
+#define FULL_SCALE     4095.0f
+
+// ============= Private variables ===================
+static uint16_t          s_buffer[2][BATTERY_BLOCK][2]; // Blocks of pairs, battery then reference
+static battery_monitor_t s_monitor;
+static float             s_vdda_mv;
+static float             s_block_s;
+
+// ============ Private function declaration =================
+static void s_start(void);
+static void s_block(uint16_t (*pairs)[2]);
+
+//============ Private function implementation ===============
+/**
+ * @brief Start the scan from the beginning of the buffer, with the ADC powered
+ */
+static void s_start(void) {
+    ADC1->CR2 &= ~ADC_CR2_DMA;
+    DMA_STREAM->CR &= ~DMA_SxCR_EN;
+    while (DMA_STREAM->CR & DMA_SxCR_EN) {
+    }
+
+    DMA2->LIFCR = DMA_FLAGS;
+    DMA_STREAM->M0AR = (uint32_t)s_buffer;
+    DMA_STREAM->NDTR = sizeof(s_buffer) / sizeof(s_buffer[0][0][0]);
+    DMA_STREAM->CR |= DMA_SxCR_EN;
+
+    ADC1->SR = 0;
+    ADC1->CR2 |= ADC_CR2_DMA;
+    ADC1->CR2 |= ADC_CR2_SWSTART;
+}
+
+static void s_block(uint16_t (*pairs)[2]) {
+    uint32_t battery = 0;
+    uint32_t reference = 0;
+
+    for (uint16_t i = 0; i < BATTERY_BLOCK; i++) {
+        battery += pairs[i][0];
+        reference += pairs[i][1];
+    }
+    if (reference == 0) {
+        return;
+    }
+
+    s_vdda_mv = VREFINT_CAL_MV * VREFINT_CAL * BATTERY_BLOCK / reference;
+    float mv = s_vdda_mv * battery / BATTERY_BLOCK / FULL_SCALE * BATTERY_DIVIDER;
+    battery_monitor_update(&s_monitor, mv, s_block_s);
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Configure PA4, ADC1 and its DMA stream and start converting
+ */
+void battery_init(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+    __HAL_RCC_ADC1_CLK_ENABLE();
+
+    // Powered first, stable long before the scan starts (tSTAB 3 us)
+    ADC1->CR2 = ADC_CR2_ADON;
+
+    GPIO_InitStruct.Pin = GPIO_PIN_4;
+    GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+    battery_monitor_init(&s_monitor);
+    s_block_s = (float)BATTERY_BLOCK * PAIR_CYCLES * ADC_PRESCALER / HAL_RCC_GetPCLK2Freq();
+
+    // ADCCLK is PCLK2 / 8, the reference is enabled. IN4 then IN17, both sampled 480 cycles.
+    ADC->CCR = ADC_CCR_ADCPRE_0 | ADC_CCR_ADCPRE_1 | ADC_CCR_TSVREFE;
+    ADC1->CR1 = ADC_CR1_SCAN | ADC_CR1_OVRIE;
+    ADC1->CR2 = ADC_CR2_ADON | ADC_CR2_CONT | ADC_CR2_DDS;
+    ADC1->SMPR1 = 7 << ADC_SMPR1_SMP17_Pos;
+    ADC1->SMPR2 = 7 << ADC_SMPR2_SMP4_Pos;
+    ADC1->SQR1 = 1 << ADC_SQR1_L_Pos;
+    ADC1->SQR3 = (4 << ADC_SQR3_SQ1_Pos) | (17 << ADC_SQR3_SQ2_Pos);
+
+    // Channel 0 is ADC1, half words into the circular buffer
+    DMA_STREAM->CR = 0;
+    DMA_STREAM->PAR = (uint32_t)&ADC1->DR;
+    DMA_STREAM->CR = DMA_SxCR_PL_0 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC | DMA_SxCR_CIRC |
+                     DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+
+    HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, BATTERY_IRQ_PRIORITY, 0);
+    HAL_NVIC_SetPriority(ADC_IRQn, BATTERY_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+    HAL_NVIC_EnableIRQ(ADC_IRQn);
+
+    s_start();
+}
+
+/**
+ * @brief Restart the lowest voltage and the counts
+ */
+void battery_reset(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    battery_monitor_reset(&s_monitor);
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Get the filtered voltage and the policy, may be called from tasks and interrupts
+ */
+void battery_get(battery_state_t* state) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *state = (battery_state_t){
+        .mv = s_monitor.mv,
+        .min_mv = s_monitor.min_mv,
+        .vdda_mv = s_vdda_mv,
+        .level = s_monitor.level,
+        .limit = s_monitor.limit,
+        .blocks = s_monitor.blocks,
+        .cutoffs = s_monitor.cutoffs,
+    };
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Battery voltage relative to the nominal one, the motor duty is divided by it
+ */
+float battery_get_supply(void) {
+    return s_monitor.mv / s_monitor.config.nominal_mv;
+}
+
+/**
+ * @brief Largest motor duty the low voltage policy allows now
+ */
+float battery_get_limit(void) {
+    return s_monitor.limit;
+}
+
+/**
+ * @brief Thresholds and filter in use, changes take effect with the next block
+ */
+battery_config_t* battery_get_config(void) {
+    return &s_monitor.config;
+}
+
+/**
+ * @brief A block of conversions is complete, the first half of the buffer on half transfer
+ */
+void DMA2_Stream0_IRQHandler(void) {
+    uint32_t lisr = DMA2->LISR;
+    DMA2->LIFCR = DMA_FLAGS;
+
+    if (lisr & DMA_LISR_HTIF0) {
+        s_block(s_buffer[0]);
+    }
+    if (lisr & DMA_LISR_TCIF0) {
+        s_block(s_buffer[1]);
+    }
+}
+
+/**
+ * @brief Overrun, the scan stopped
+ */
+void ADC_IRQHandler(void) {
+    if (ADC1->SR & ADC_SR_OVR) {
+        s_start();
+    }
+}
@@ -0,0 +1,102 @@
+/**
+ * @file battery_monitor.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Battery voltage filter and low voltage policy
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/battery_monitor.h"
+
+// ============ Private function declaration =================
+static battery_level_e s_level(const battery_monitor_t* monitor);
+
+//============ Private function implementation ===============
+static battery_level_e s_level(const battery_monitor_t* monitor) {
+    return monitor->mv < monitor->config.low_mv ? eBATTERY_LOW : eBATTERY_OK;
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Default configuration for the pack, not started, the first block sets the voltage
+ */
+void battery_monitor_init(battery_monitor_t* monitor) {
+    *monitor = (battery_monitor_t){
+        .config = {
+            .nominal_mv = BATTERY_NOMINAL_MV,
+            .low_mv = BATTERY_LOW_MV,
+            .cutoff_mv = BATTERY_CUTOFF_MV,
+            .recover_mv = BATTERY_RECOVER_MV,
+            .low_limit = 0.3f,
+            .recover_s = 2.0f,
+            .tau_s = 0.01f,
+        },
+        .mv = BATTERY_NOMINAL_MV,
+        .min_mv = BATTERY_NOMINAL_MV,
+        .limit = 1,
+    };
+}
+
+/**
+ * @brief Restart the lowest voltage and the counts, the policy keeps its state
+ */
+void battery_monitor_reset(battery_monitor_t* monitor) {
+    monitor->min_mv = monitor->mv;
+    monitor->blocks = 0;
+    monitor->cutoffs = 0;
+}
+
+/**
+ * @brief Filter the mean of a block of conversions and update the policy
+ *
+ * @param monitor Monitor
+ * @param mv Mean battery voltage of the block
+ * @param dt_s Time of the block
+ */
+void battery_monitor_update(battery_monitor_t* monitor, float mv, float dt_s) {
+    const battery_config_t* config = &monitor->config;
+
+    if (!monitor->started) {
+        monitor->started = true;
+        monitor->mv = mv;
+    } else {
+        monitor->mv += (mv - monitor->mv) * dt_s / (config->tau_s + dt_s);
+    }
+    if (monitor->mv < monitor->min_mv || monitor->blocks == 0) {
+        monitor->min_mv = monitor->mv;
+    }
+    monitor->blocks++;
+
+    if (monitor->level != eBATTERY_CUTOFF) {
+        if (monitor->mv < config->cutoff_mv) {
+            monitor->level = eBATTERY_CUTOFF;
+            monitor->recover_s = config->recover_s;
+            monitor->cutoffs++;
+        } else {
+            monitor->level = s_level(monitor);
+        }
+    } else if (monitor->mv < config->recover_mv) {
+        monitor->recover_s = config->recover_s;
+    } else {
+        monitor->recover_s -= dt_s;
+        if (monitor->recover_s <= 0) {
+            monitor->recover_s = 0;
+            monitor->level = s_level(monitor);
+        }
+    }
+
+    if (monitor->level == eBATTERY_CUTOFF) {
+        monitor->limit = 0;
+    } else if (monitor->level == eBATTERY_LOW) {
+        float share = (monitor->mv - config->cutoff_mv) / (config->low_mv - config->cutoff_mv);
+        monitor->limit = config->low_limit + (1 - config->low_limit) * share;
+    } else {
+        monitor->limit = 1;
+    }
+}
@@ -0,0 +1,139 @@
+/**
+ * @file bench.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Microbenchmark runner, see bench.h
+ * @version 0.1
+ * @date 2023-11-21
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "User/bench.h"
+#include "User/cycles.h"
+
+// Section boundaries, weak so an image without benchmarks still links
+extern const bench_t __start_bench_registry[] __attribute__((weak));
+extern const bench_t __stop_bench_registry[] __attribute__((weak));
+
+// ============ Private function declaration =================
+static uint32_t s_irq_mask(bool mask);
+static void     s_irq_restore(uint32_t state);
+static uint32_t s_measure(void (*run)(void), bool mask_irq);
+static void     s_empty(void);
+
+//============ Private function implementation ===============
+#ifdef DONATELLO_HOST
+static uint32_t s_irq_mask(bool mask) {
+    return 0;
+}
+
+static void s_irq_restore(uint32_t state) {}
+#else
+#include "main.h"
+
+static uint32_t s_irq_mask(bool mask) {
+    uint32_t primask = __get_PRIMASK();
+    if (mask) {
+        __disable_irq();
+    }
+    return primask;
+}
+
+static void s_irq_restore(uint32_t state) {
+    __set_PRIMASK(state);
+}
+#endif
+
+static uint32_t s_measure(void (*run)(void), bool mask_irq) {
+    uint32_t state = s_irq_mask(mask_irq);
+    uint32_t start = cycles_now();
+    run();
+    uint32_t cycles = cycles_now() - start;
+    s_irq_restore(state);
+    return cycles;
+}
+
+// Not static inline-able through the pointer, measures the call and timer read overhead
+__attribute__((noinline)) static void s_empty(void) {
+    __asm volatile("" ::: "memory");
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Iterate over all registered benchmarks
+ * 
+ * @param bench Previous benchmark, NULL to get the first one
+ * @return const bench_t* Next benchmark, NULL when done
+ */
+const bench_t* bench_next(const bench_t* bench) {
+    bench = bench ? bench + 1 : __start_bench_registry;
+    return bench < __stop_bench_registry ? bench : NULL;
+}
+
+/**
+ * @brief Find benchmark by name
+ * 
+ * @param name Name given to BENCH_REGISTER()
+ * @return const bench_t* Benchmark, NULL if not found
+ */
+const bench_t* bench_find(const char* name) {
+    for (const bench_t* bench = bench_next(NULL); bench; bench = bench_next(bench)) {
+        if (!strcmp(bench->name, name)) {
+            return bench;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Run a benchmark
+ * Every repetition is timed separately, the overhead of an empty call is subtracted.
+ * With mask_irq interrupts are disabled during each timed call (not during setup),
+ * without it the spread shows the interference from interrupts and higher priority tasks.
+ * 
+ * @param bench Benchmark to run
+ * @param reps Number of repetitions
+ * @param mask_irq Disable interrupts while timing
+ * @param result Statistics in cycles per operation (ns per operation on host)
+ */
+void bench_run(const bench_t* bench, uint32_t reps, bool mask_irq, bench_result_t* result) {
+    // Overhead, minimum of a few empty runs
+    uint32_t overhead = UINT32_MAX;
+    for (int i = 0; i < 8; i++) {
+        uint32_t cycles = s_measure(s_empty, mask_irq);
+        overhead = cycles < overhead ? cycles : overhead;
+    }
+
+    // Welford's online mean/variance
+    double   mean = 0.0;
+    double   m2 = 0.0;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    for (uint32_t i = 0; i < reps; i++) {
+        if (bench->setup) {
+            bench->setup();
+        }
+
+        uint32_t cycles = s_measure(bench->run, mask_irq);
+        cycles = cycles > overhead ? cycles - overhead : 0;
+
+        double delta = cycles - mean;
+        mean += delta / (i + 1);
+        m2 += delta * (cycles - mean);
+        min = cycles < min ? cycles : min;
+        max = cycles > max ? cycles : max;
+    }
+
+    float ops = bench->ops ? (float)bench->ops : 1.0f;
+    result->reps = reps;
+    result->mean = (float)mean / ops;
+    result->stddev = reps > 1 ? (float)sqrt(m2 / (reps - 1)) / ops : 0.0f;
+    result->min = reps ? min / ops : 0.0f;
+    result->max = max / ops;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file benchmarks.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Benchmarks of the existing hot paths
+ * Compiled both into the firmware and into host/bench_host.
+ * @version 0.1
+ * @date 2023-11-21
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "User/bench.h"
+#include "User/lidar.h"
+#include "User/lidar_filter.h"
+#include "User/lidar_recording.h"
+#include "User/pool.h"
+#include "User/prof.h"
+#include "lwbtn.h"
+
+#define BLOCK_SIZE 1024
+
+// ============= Private variables ===================
+static uint8_t      s_src[BLOCK_SIZE];
+static uint8_t      s_dst[BLOCK_SIZE];
+static char         s_text[64];
+static prof_scope_t s_scope; // Not registered, only used as a target
+static lwbtn_t      s_lwbtn;
+static lwbtn_btn_t  s_btn;
+static uint32_t     s_time;
+static uint8_t      s_state;
+
+static lidar_filter_t s_filter;
+static lidar_scan_t   s_scan;
+static uint8_t        s_recorded; // Next scan of the recording
+
+// ============ Private function declaration =================
+static void    s_prof_record(void);
+static void    s_memcpy(void);
+static void    s_copy_loop(void);
+static void    s_snprintf_int(void);
+static void    s_snprintf_float(void);
+static uint8_t s_btn_get_state(struct lwbtn* lw, struct lwbtn_btn* btn);
+static void    s_btn_event(struct lwbtn* lw, struct lwbtn_btn* btn, lwbtn_evt_t evt);
+static void    s_lwbtn_setup(void);
+static void    s_lwbtn_process(void);
+static void    s_lidar_scan_setup(void);
+static void    s_lidar_rejected_setup(void);
+static void    s_lidar_filter(void);
+
+//============ Private function implementation ===============
+static void s_prof_record(void) {
+    for (uint32_t i = 0; i < 16; i++) {
+        prof_record(&s_scope, 100 + i * 37);
+    }
+}
+
+// Byte-wise copy compared to the library memcpy, e.g. the coms staging copies
+static void s_memcpy(void) {
+    memcpy(s_dst, s_src, sizeof(s_dst));
+    __asm volatile("" ::: "memory");
+}
+
+static void s_copy_loop(void) {
+    volatile uint8_t* dst = s_dst;
+    for (uint32_t i = 0; i < BLOCK_SIZE; i++) {
+        dst[i] = s_src[i];
+    }
+}
+
+// Formatting cost of cli_printf()
+static void s_snprintf_int(void) {
+    snprintf(s_text, sizeof(s_text), "Button state: %u", (unsigned)s_state);
+}
+
+static void s_snprintf_float(void) {
+    snprintf(s_text, sizeof(s_text), "Speed: %.3f m/s", 1.234f + s_state);
+}
+
+static uint8_t s_btn_get_state(struct lwbtn* lw, struct lwbtn_btn* btn) {
+    return s_state;
+}
+
+static void s_btn_event(struct lwbtn* lw, struct lwbtn_btn* btn, lwbtn_evt_t evt) {}
+
+static void s_lwbtn_setup(void) {
+    // Own instance, the default one belongs to the button task
+    if (s_lwbtn.btns == NULL) {
+        lwbtn_init_ex(&s_lwbtn, &s_btn, 1, s_btn_get_state, s_btn_event);
+    }
+}
+
+// 10 ms steps with a press every 250 ms, as seen by the button task
+static void s_lwbtn_process(void) {
+    for (uint32_t i = 0; i < 16; i++) {
+        s_time += 10;
+        s_state = (s_time % 250) < 100;
+        lwbtn_process_ex(&s_lwbtn, s_time);
+    }
+}
+
+/**
+ * @brief Next scan of the recording, the filter state carries over like it does between published scans
+ */
+static void s_lidar_scan_setup(void) {
+    static const lidar_filter_config_t config = {
+        .accept = 1 << 0,
+        .min_signal_kcps = 200,
+        .max_mm = 4000,
+        .alpha = 128,
+    };
+    const lidar_recording_t* recorded = &lidar_recording[s_recorded];
+
+    if (s_filter.config.alpha == 0) {
+        lidar_filter_init(&s_filter, &config);
+    }
+    s_scan.beams = LIDAR_RECORDING_BEAMS;
+    memcpy(s_scan.status, recorded->status, sizeof(recorded->status));
+    memcpy(s_scan.distance_mm, recorded->distance_mm, sizeof(recorded->distance_mm));
+    memcpy(s_scan.signal_kcps, recorded->signal_kcps, sizeof(recorded->signal_kcps));
+    s_recorded = (s_recorded + 1) % LIDAR_RECORDING_SCANS;
+}
+
+// Every range rejected, should cost the same as the recording
+static void s_lidar_rejected_setup(void) {
+    s_lidar_scan_setup();
+    memset(s_scan.status, 4, sizeof(s_scan.status));
+}
+
+static void s_lidar_filter(void) {
+    lidar_filter_run(&s_filter, &s_scan);
+    __asm volatile("" ::: "memory");
+}
+
+// A block for a log message and back, what cli_printf() adds to the formatting
+static void s_pool_alloc_free(void) {
+    pool_free(pool_alloc(POOL_MESSAGE_SIZE));
+}
+
+BENCH_REGISTER(prof_record, NULL, s_prof_record, 16);
+BENCH_REGISTER(memcpy_1k, NULL, s_memcpy, BLOCK_SIZE);
+BENCH_REGISTER(copy_loop_1k, NULL, s_copy_loop, BLOCK_SIZE);
+BENCH_REGISTER(snprintf_int, NULL, s_snprintf_int, 1);
+BENCH_REGISTER(snprintf_float, NULL, s_snprintf_float, 1);
+BENCH_REGISTER(pool_alloc_free, NULL, s_pool_alloc_free, 1);
+BENCH_REGISTER(lwbtn_process, s_lwbtn_setup, s_lwbtn_process, 16);
+BENCH_REGISTER(lidar_filter, s_lidar_scan_setup, s_lidar_filter, LIDAR_RECORDING_BEAMS);
+BENCH_REGISTER(lidar_filter_rejected, s_lidar_rejected_setup, s_lidar_filter, LIDAR_RECORDING_BEAMS);
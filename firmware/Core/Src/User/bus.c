@@ -0,0 +1,214 @@
+/**
+ * @file bus.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Publish/subscribe through statically declared topics, see bus.h
+ * A latest topic is a triple buffer per subscriber that share their slots. Every subscriber owns
+ * two slots, its front and its middle, the publisher hands a new message over by exchanging it into the middle
+ * of every subscriber. It is the same message for all of them, so before the exchange the two slots of a
+ * subscriber are the one published last and the one it held besides that. The exchange returns either, the
+ * other one stays held. The publisher writes into any slot that is neither published last nor held, with
+ * n subscribers there are at most n + 1 of those, n + 2 slots always leave one free.
+ * A queue is a single producer single consumer ring, the counters are free running and only ever written by
+ * one side. All state starts zeroed, no initialization is needed before the first publish.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "User/bus.h"
+#include "User/cycles.h"
+
+#define BUS_INDEX 0x1F
+#define BUS_FRESH 0x80
+
+// Section boundaries, provided by the linker script on target and by the linker on host.
+// Weak so an image without any topic still links, both are then NULL.
+extern bus_topic_t __start_bus_topics[] __attribute__((weak));
+extern bus_topic_t __stop_bus_topics[] __attribute__((weak));
+
+// ============ Private function declaration =================
+static uint8_t s_back(const bus_topic_t* topic);
+
+//============ Private function implementation ===============
+/**
+ * @brief Slot the publisher writes the next latest value into, neither published last nor held by a subscriber
+ */
+static uint8_t s_back(const bus_topic_t* topic) {
+    uint32_t used = 1u << topic->latest;
+
+    for (uint8_t i = 0; i < topic->subscribers; i++) {
+        used |= 1u << topic->subscriber[i].held;
+    }
+    return (uint8_t)__builtin_ctz(~used);
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Get the slot to write the next message into, publisher only
+ * The same slot until it is published. A latest topic always has one, it contains an older message.
+ *
+ * @param topic Topic
+ * @return void* Slot, NULL if the queue is full. The message is then dropped and counted.
+ */
+void* bus_claim(bus_topic_t* topic) {
+    if (topic->kind == eBUS_LATEST) {
+        return topic->data + s_back(topic) * topic->size;
+    }
+
+    uint32_t head = atomic_load_explicit(&topic->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&topic->tail, memory_order_acquire);
+    if (head - tail >= topic->slots) {
+        topic->dropped++;
+        return NULL;
+    }
+    return topic->data + (head & (topic->slots - 1)) * topic->size;
+}
+
+/**
+ * @brief Publish the claimed slot, publisher only
+ * For a queue only after a successful bus_claim().
+ */
+void bus_publish(bus_topic_t* topic) {
+    uint32_t now = cycles_now();
+
+    if (topic->kind == eBUS_LATEST) {
+        uint8_t back = s_back(topic);
+
+        for (uint8_t i = 0; i < topic->subscribers; i++) {
+            bus_subscriber_t* subscriber = &topic->subscriber[i];
+
+            uint8_t old = atomic_exchange_explicit(&subscriber->middle, back | BUS_FRESH, memory_order_acq_rel);
+            if (old & BUS_FRESH) {
+                topic->dropped++; // Never read by this subscriber
+            }
+            if ((old & BUS_INDEX) != topic->latest) {
+                // The subscriber took the last message and gave back the slot it held
+                subscriber->held = topic->latest;
+            }
+        }
+        topic->latest = back;
+    } else {
+        uint32_t head = atomic_load_explicit(&topic->head, memory_order_relaxed);
+        atomic_store_explicit(&topic->head, head + 1, memory_order_release);
+    }
+
+    if (topic->published) {
+        // Low pass with a gain of 1/8, about the mean of the last eight periods
+        int32_t error = (int32_t)(now - topic->stamp - topic->period);
+        topic->period = topic->period ? (uint32_t)((int32_t)topic->period + error / 8) : now - topic->stamp;
+    }
+    topic->stamp = now;
+    topic->published++;
+}
+
+/**
+ * @brief Get the latest message of a topic, wait-free, subscriber only
+ * Stays valid and unchanged until the next call of the subscriber.
+ *
+ * @param topic Latest topic
+ * @param subscriber Number of the subscriber
+ * @param fresh Set if the message was published since the last call, may be NULL
+ * @return const void* Latest message, cleared if nothing has been published yet
+ */
+const void* bus_read(bus_topic_t* topic, uint8_t subscriber, bool* fresh) {
+    bus_subscriber_t* sub = &topic->subscriber[subscriber];
+    bool              newer = atomic_load_explicit(&sub->middle, memory_order_relaxed) & BUS_FRESH;
+
+    if (newer) {
+        // Only the subscriber clears BUS_FRESH, the middle can only have become newer since the load
+        uint8_t old = atomic_exchange_explicit(&sub->middle, sub->front, memory_order_acq_rel);
+        sub->front = old & BUS_INDEX;
+        sub->received++;
+    }
+    if (fresh) {
+        *fresh = newer;
+    }
+    return topic->data + sub->front * topic->size;
+}
+
+/**
+ * @brief Get the oldest message of a queue, subscriber only
+ * Stays valid until released with bus_release().
+ *
+ * @param topic Queue topic
+ * @return const void* Oldest message, NULL if the queue is empty
+ */
+const void* bus_receive(bus_topic_t* topic) {
+    uint32_t tail = atomic_load_explicit(&topic->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&topic->head, memory_order_acquire);
+
+    if (head == tail) {
+        return NULL;
+    }
+    return topic->data + (tail & (topic->slots - 1)) * topic->size;
+}
+
+/**
+ * @brief Give the slot of the message from bus_receive() back to the publisher, subscriber only
+ */
+void bus_release(bus_topic_t* topic) {
+    uint32_t tail = atomic_load_explicit(&topic->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&topic->tail, tail + 1, memory_order_release);
+    topic->received++;
+}
+
+/**
+ * @brief Iterate over all topics in the image
+ *
+ * @param topic Previous topic, NULL to get the first one
+ * @return bus_topic_t* Next topic, NULL when done
+ */
+bus_topic_t* bus_next(bus_topic_t* topic) {
+    topic = topic ? topic + 1 : __start_bus_topics;
+    return topic < __stop_bus_topics ? topic : NULL;
+}
+
+/**
+ * @brief Summarize a topic
+ * The counters are read while they may change, they are not a consistent snapshot.
+ *
+ * @param topic Topic to summarize
+ * @param stats Output
+ */
+void bus_get_stats(const bus_topic_t* topic, bus_stats_t* stats) {
+    uint32_t age = cycles_now() - topic->stamp;
+
+    stats->published = topic->published;
+    stats->dropped = topic->dropped;
+    stats->received = topic->received;
+    stats->pending = 0;
+    if (topic->kind == eBUS_LATEST) {
+        for (uint8_t i = 0; i < topic->subscribers; i++) {
+            stats->received += topic->subscriber[i].received;
+        }
+    } else {
+        stats->pending = atomic_load(&topic->head) - atomic_load(&topic->tail);
+    }
+
+    bool stopped = !topic->period || age / 4 > topic->period;
+    stats->rate_hz = stopped ? 0.0f : cycles_per_us() * 1e6f / topic->period;
+    stats->age_us = topic->published ? age / cycles_per_us() : 0;
+}
+
+/**
+ * @brief Clear the statistics of all topics, the messages are kept
+ */
+void bus_reset_stats(void) {
+    for (bus_topic_t* topic = bus_next(NULL); topic; topic = bus_next(topic)) {
+        topic->published = 0;
+        topic->dropped = 0;
+        topic->received = 0;
+        topic->period = 0;
+        for (uint8_t i = 0; topic->kind == eBUS_LATEST && i < topic->subscribers; i++) {
+            topic->subscriber[i].received = 0;
+        }
+    }
+}
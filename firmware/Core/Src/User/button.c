@@ -16,13 +16,16 @@
 #include "main.h"
 #include "stm32f4xx_hal.h"
 
+#include "User/bus.h"
 #include "User/button.h"
-#include "User/cli.h"
+#include "User/prof.h"
 #include "lwbtn.h"
 
 // ============= Private variables ===================
 static lwbtn_btn_t btns[1] = {0}; // Variable to store all information for lwbtn.
 
+BUS_QUEUE(button_events, "button_events", button_event_t, 8);
+
 // ============ Private function declaration =================
 static uint8_t s_button_get_state(struct lwbtn* lw, struct lwbtn_btn* btn);
 static void    s_button_event(struct lwbtn* lw, struct lwbtn_btn* btn, lwbtn_evt_t evt);
@@ -33,14 +36,26 @@ static uint8_t s_button_get_state(struct lwbtn* lw, struct lwbtn_btn* btn) {
 }
 
 static void s_button_event(struct lwbtn* lw, struct lwbtn_btn* btn, lwbtn_evt_t evt) {
-    // Here all events can be processed
+    // Here all events can be processed, subscribers of button_events act on them
+    button_event_e event;
     if (evt == LWBTN_EVT_ONPRESS) {
-        cli_printf("[LWBTN] OnPress");
+        event = eBUTTON_EVENT_PRESS;
     } else if (evt == LWBTN_EVT_ONRELEASE) {
-        cli_printf("[LWBTN] OnRelease");
+        event = eBUTTON_EVENT_RELEASE;
     } else if (evt == LWBTN_EVT_ONCLICK) {
-        cli_printf("[LWBTN] Click Count: %u", btn->click.cnt);
+        event = eBUTTON_EVENT_CLICK;
+    } else {
+        return;
+    }
+
+    button_event_t* message = bus_claim(&button_events);
+    if (message == NULL) {
+        return; // Queue full, counted as dropped
     }
+    message->tick = HAL_GetTick();
+    message->event = event;
+    message->clicks = btn->click.cnt;
+    bus_publish(&button_events);
 
     // TODO: Change modes by clicking X amount of times?
 }
@@ -61,12 +76,16 @@ void button_init(void) {
 
 /**
  * @brief Button RTOS task
+ * @param argument Unused
  */
-void button_task(void) {
+void button_task(void const* argument) {
     button_init();
 
     for (;;) {
-        lwbtn_process(HAL_GetTick());
+        {
+            PROF_SCOPE("lwbtn_process");
+            lwbtn_process(HAL_GetTick());
+        }
         osDelay(10);
     }
 }
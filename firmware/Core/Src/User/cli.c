@@ -9,17 +9,36 @@
  * 
  */
 
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "cmsis_os.h"
 #include "stm32f4xx_it.h"
+#include "task.h"
 
+#include "User/battery.h"
+#include "User/bench.h"
+#include "User/bus.h"
 #include "User/button.h"
 #include "User/cli.h"
 #include "User/coms.h"
+#include "User/control.h"
+#include "User/cycles.h"
+#include "User/encoder.h"
+#include "User/geometry.h"
+#include "User/i2c.h"
+#include "User/lidar.h"
+#include "User/lidar_deskew.h"
+#include "User/motor.h"
+#include "User/pcsamp.h"
+#include "User/pool.h"
+#include "User/prof.h"
+#include "User/servo.h"
+#include "User/wheel.h"
 #include "main.h"
 
 #define EMBEDDED_CLI_IMPL
@@ -34,11 +53,47 @@ static void s_led_get(EmbeddedCli* cli, char* args, void* context);
 static void s_led_set(EmbeddedCli* cli, char* args, void* context);
 static void s_led_toggle(EmbeddedCli* cli, char* args, void* context);
 static void s_button_get_state(EmbeddedCli* cli, char* args, void* context);
+static void s_pcsamp(EmbeddedCli* cli, char* args, void* context);
+static void s_prof(EmbeddedCli* cli, char* args, void* context);
+static void s_bus(EmbeddedCli* cli, char* args, void* context);
+static void s_pool(EmbeddedCli* cli, char* args, void* context);
+static void s_coms(EmbeddedCli* cli, char* args, void* context);
+static void s_stack(EmbeddedCli* cli, char* args, void* context);
+static void s_button_events(void);
+static void s_bench(EmbeddedCli* cli, char* args, void* context);
+static void s_i2c(EmbeddedCli* cli, char* args, void* context);
+static void s_encoder(EmbeddedCli* cli, char* args, void* context);
+static void s_motor(EmbeddedCli* cli, char* args, void* context);
+static void s_servo(EmbeddedCli* cli, char* args, void* context);
+static void s_servo_calib(char* args);
+static void s_servo_sweep(uint32_t ms);
+static void s_wheel(EmbeddedCli* cli, char* args, void* context);
+static void s_battery(EmbeddedCli* cli, char* args, void* context);
+static void s_control(EmbeddedCli* cli, char* args, void* context);
+static void s_wheel_step(float speed_mm_s);
+static void s_lidar(EmbeddedCli* cli, char* args, void* context);
+static void s_lidar_calib(char* args);
+
+// What embeddedCliRequiredSize() asks for with the sizes of cli.h, plus the internal help binding
+#define CLI_BINDINGS (CLI_MAX_BINDING_COUNT + 1)
+#define CLI_UINTS                                                                                          \
+    (BYTES_TO_CLI_UINTS(sizeof(EmbeddedCli)) + BYTES_TO_CLI_UINTS(sizeof(EmbeddedCliImpl)) +               \
+     BYTES_TO_CLI_UINTS(CLI_RX_BUFFER_SIZE) + BYTES_TO_CLI_UINTS(CLI_CMD_BUFFER_SIZE) +                    \
+     BYTES_TO_CLI_UINTS(CLI_HISTORY_SIZE) + BYTES_TO_CLI_UINTS(CLI_BINDINGS * sizeof(CliCommandBinding)) + \
+     BYTES_TO_CLI_UINTS(CLI_BINDINGS))
 
 // ============= Private variables ===================
 static EmbeddedCli* cli;
-static CLI_UINT     cliBuffer[BYTES_TO_CLI_UINTS(CLI_BUFFER_SIZE)];
+static CLI_UINT     cliBuffer[CLI_UINTS];
 static bool         cli_is_ready = false; // Disable usage if cli isn't initialised
+static uint32_t     s_printf_dropped;     // cli_printf() lines without a block to format them in
+
+static const char* s_lidar_states[] = {"off", "booting", "idle", "ranging", "failed"};
+static const char* s_lidar_health[] = {"ok", "removed", "rebooting", "failed"};
+static const char* s_i2c_priorities[] = {"high", "normal", "low"};
+static const char* s_bus_kinds[] = {"latest", "queue"};
+static const char* s_button_event_names[] = {"press", "release", "click"};
+static const char* s_tasks[] = {"defaultTask", "comsTask", "cliTask", "buttonTask", "controlTask", "IDLE"};
 
 //============ Private function implementation ===============
 void s_cli_clear(EmbeddedCli* cli, char* args, void* context) {
@@ -74,6 +129,845 @@ static void s_button_get_state(EmbeddedCli* cli, char* args, void* context) {
     cli_printf("Button state: %u", button_get_state());
 }
 
+static void s_pcsamp(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+
+    if (arg1 == NULL || !strcmp(arg1, "status")) {
+        cli_printf(
+            "pcsamp %s total: %" PRIu32 " dropped: %" PRIu32,
+            pcsamp_is_running() ? "running" : "stopped",
+            pcsamp_get_total(),
+            pcsamp_get_dropped()
+        );
+    } else if (!strcmp(arg1, "start")) {
+        const char* arg2 = embeddedCliGetToken(args, 2);
+        pcsamp_start(arg2 ? strtoul(arg2, NULL, 10) : PCSAMP_DEFAULT_HZ);
+    } else if (!strcmp(arg1, "stop")) {
+        pcsamp_stop();
+    } else if (!strcmp(arg1, "dump")) {
+        // Only drain what is there now, sampling may still be running
+        pcsamp_sample_t sample;
+        uint32_t        n = 0;
+        cli_printf("pcsamp begin");
+        while (n < PCSAMP_BUFFER_SIZE && pcsamp_pop(&sample)) {
+            const char* name = sample.task ? pcTaskGetName((TaskHandle_t)sample.task) : "ISR";
+            cli_printf("S %08" PRIx32 " %08" PRIx32 " %s", sample.pc, sample.lr, name);
+            n++;
+        }
+        cli_printf("pcsamp end %" PRIu32 " dropped %" PRIu32, n, pcsamp_get_dropped());
+    } else {
+        cli_printf("Usage: pcsamp [start [hz]/stop/dump/status]");
+    }
+}
+
+static void s_prof(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+
+    if (arg1 != NULL && !strcmp(arg1, "reset")) {
+        prof_reset();
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: prof [reset]");
+        return;
+    }
+
+    uint32_t per_us = cycles_per_us();
+    cli_printf("%-24s %10s %10s %10s %10s %10s", "scope [" CYCLES_UNIT "]", "count", "mean", "p50", "p99", "max");
+    for (prof_scope_t* scope = prof_next(NULL); scope; scope = prof_next(scope)) {
+        prof_stats_t stats;
+        prof_get_stats(scope, &stats);
+        cli_printf(
+            "%-24s %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32 "  (max %" PRIu32 " us)",
+            scope->name,
+            stats.count,
+            stats.mean,
+            stats.p50,
+            stats.p99,
+            stats.max,
+            stats.max / per_us
+        );
+    }
+}
+
+static void s_bus(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+
+    if (arg1 != NULL && !strcmp(arg1, "reset")) {
+        bus_reset_stats();
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: bus [reset]");
+        return;
+    }
+
+    cli_printf(
+        "%-16s %-6s %5s %6s %10s %10s %10s %7s %9s %10s",
+        "topic",
+        "kind",
+        "slots",
+        "size",
+        "published",
+        "received",
+        "dropped",
+        "pending",
+        "rate [Hz]",
+        "age [ms]"
+    );
+    for (bus_topic_t* topic = bus_next(NULL); topic; topic = bus_next(topic)) {
+        bus_stats_t stats;
+        bus_get_stats(topic, &stats);
+        cli_printf(
+            "%-16s %-6s %5u %6u %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %7" PRIu32 " %9.1f %10" PRIu32,
+            topic->name,
+            s_bus_kinds[topic->kind],
+            topic->slots,
+            topic->size,
+            stats.published,
+            stats.received,
+            stats.dropped,
+            stats.pending,
+            stats.rate_hz,
+            stats.age_us / 1000
+        );
+    }
+}
+
+static void s_pool(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+
+    if (arg1 != NULL && !strcmp(arg1, "reset")) {
+        pool_reset_stats();
+        s_printf_dropped = 0;
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: pool [reset]");
+        return;
+    }
+
+    cli_printf(
+        "%-8s %5s %6s %6s %6s %10s %8s %11s %14s",
+        "pool",
+        "size",
+        "blocks",
+        "in use",
+        "high",
+        "allocs",
+        "failures",
+        "double free",
+        "use after free"
+    );
+    for (pool_e p = 0; p < ePOOLS; p++) {
+        pool_stats_t stats;
+        pool_get_stats(p, &stats);
+        cli_printf(
+            "%-8s %5u %6u %6" PRIu32 " %6" PRIu32 " %10" PRIu32 " %8" PRIu32 " %11" PRIu32 " %14" PRIu32,
+            stats.name,
+            stats.size,
+            stats.blocks,
+            stats.in_use,
+            stats.high_water,
+            stats.allocs,
+            stats.failures,
+            stats.double_frees,
+            stats.use_after_free
+        );
+    }
+    cli_printf("%" PRIu32 " CLI lines dropped for lack of a block", s_printf_dropped);
+}
+
+static void s_coms(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+
+    if (arg1 != NULL && !strcmp(arg1, "reset")) {
+        coms_reset_stats();
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: coms [reset]");
+        return;
+    }
+
+    ring_stats_t rings[2];
+    const char*  names[2] = {"rx", "tx"};
+    coms_get_stats(&rings[0], &rings[1]);
+
+    cli_printf("%-4s %5s %5s %5s %8s", "ring", "size", "used", "high", "dropped");
+    for (uint8_t r = 0; r < 2; r++) {
+        cli_printf(
+            "%-4s %5u %5u %5u %8" PRIu32,
+            names[r],
+            rings[r].size,
+            rings[r].used,
+            rings[r].high_water,
+            rings[r].dropped
+        );
+    }
+}
+
+static void s_stack(EmbeddedCli* cli, char* args, void* context) {
+    cli_printf("%-12s %12s", "task", "free [words]");
+    for (uint8_t t = 0; t < sizeof(s_tasks) / sizeof(s_tasks[0]); t++) {
+        TaskHandle_t task = xTaskGetHandle(s_tasks[t]);
+        if (task != NULL) {
+            cli_printf("%-12s %12lu", s_tasks[t], (unsigned long)uxTaskGetStackHighWaterMark(task));
+        }
+    }
+}
+
+/**
+ * @brief Print the button events published since the last call
+ */
+static void s_button_events(void) {
+    const button_event_t* event;
+
+    while ((event = bus_receive(&button_events)) != NULL) {
+        if (event->event == eBUTTON_EVENT_CLICK) {
+            cli_printf("[button] %s x%u", s_button_event_names[event->event], event->clicks);
+        } else {
+            cli_printf("[button] %s", s_button_event_names[event->event]);
+        }
+        bus_release(&button_events);
+    }
+}
+
+static void s_bench(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+
+    if (arg1 == NULL || !strcmp(arg1, "list")) {
+        for (const bench_t* bench = bench_next(NULL); bench; bench = bench_next(bench)) {
+            cli_printf("%s (%" PRIu32 " ops)", bench->name, bench->ops);
+        }
+        return;
+    }
+
+    const char* name = embeddedCliGetToken(args, 2);
+    const char* reps_arg = embeddedCliGetToken(args, 3);
+    uint32_t    reps = (reps_arg && strcmp(reps_arg, "masked")) ? strtoul(reps_arg, NULL, 10) : BENCH_DEFAULT_REPS;
+    bool        masked = embeddedCliFindToken(args, "masked") != 0;
+
+    if (strcmp(arg1, "run") || name == NULL) {
+        cli_printf("Usage: bench [list] | bench run <name/all> [reps] [masked]");
+        return;
+    }
+
+    cli_printf(
+        "%-20s %6s %10s %10s %10s %10s  irq %s",
+        "benchmark [cyc/op]",
+        "reps",
+        "mean",
+        "stddev",
+        "min",
+        "max",
+        masked ? "masked" : "on"
+    );
+    for (const bench_t* bench = bench_next(NULL); bench; bench = bench_next(bench)) {
+        if (strcmp(name, "all") && strcmp(name, bench->name)) {
+            continue;
+        }
+
+        bench_result_t result;
+        bench_run(bench, reps, masked, &result);
+        cli_printf(
+            "%-20s %6" PRIu32 " %10.2f %10.2f %10.2f %10.2f",
+            bench->name,
+            result.reps,
+            result.mean,
+            result.stddev,
+            result.min,
+            result.max
+        );
+    }
+}
+
+static void s_i2c(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+
+    if (arg1 != NULL && !strcmp(arg1, "reset")) {
+        i2c_reset_stats();
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: i2c [reset]");
+        return;
+    }
+
+    i2c_stats_t stats;
+    i2c_get_stats(&stats);
+    cli_printf(
+        "busy %" PRIu32 " ms of %" PRIu32 " ms (%.2f %%), %" PRIu32 " transfers",
+        stats.busy_us / 1000,
+        stats.window_us / 1000,
+        stats.window_us ? 100.0f * stats.busy_us / stats.window_us : 0.0f,
+        stats.transfers
+    );
+    cli_printf("%" PRIu32 " errors, %" PRIu32 " lockups recovered", stats.errors, stats.recoveries);
+    cli_printf("%-8s %10s %10s %10s", "priority", "queued", "wait us", "max us");
+    for (uint8_t p = 0; p < eI2C_PRIO_COUNT; p++) {
+        cli_printf(
+            "%-8s %10" PRIu32 " %10" PRIu32 " %10" PRIu32,
+            s_i2c_priorities[p],
+            stats.queued[p],
+            stats.wait_mean_us[p],
+            stats.wait_max_us[p]
+        );
+    }
+}
+
+static void s_encoder(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+
+    if (arg1 != NULL && !strcmp(arg1, "reset")) {
+        encoder_reset();
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: encoder [reset]");
+        return;
+    }
+
+    encoder_state_t state;
+    encoder_get(&state);
+    cli_printf(
+        "%" PRId32 " counts, %.1f mm, %.1f mm/s, %" PRIu32 " samples",
+        state.counts,
+        state.distance_mm,
+        state.speed_mm_s,
+        state.samples
+    );
+}
+
+static void s_motor(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+    const char* arg2 = embeddedCliGetToken(args, 2);
+
+    if (arg1 != NULL && !strcmp(arg1, "brake")) {
+        motor_brake();
+    } else if (arg1 != NULL && !strcmp(arg1, "coast")) {
+        motor_coast();
+    } else if (arg1 != NULL && !strcmp(arg1, "freq") && arg2 != NULL) {
+        if (!motor_set_frequency(strtol(arg2, NULL, 10))) {
+            cli_printf("Frequency must be %u to %u Hz", MOTOR_PWM_HZ_MIN, MOTOR_PWM_HZ_MAX);
+            return;
+        }
+    } else if (arg1 != NULL && !strcmp(arg1, "decay") && arg2 != NULL && !strcmp(arg2, "coast")) {
+        motor_set_decay(eMOTOR_DECAY_COAST);
+    } else if (arg1 != NULL && !strcmp(arg1, "decay") && arg2 != NULL && !strcmp(arg2, "brake")) {
+        motor_set_decay(eMOTOR_DECAY_BRAKE);
+    } else if (arg1 != NULL && !strcmp(arg1, "set") && arg2 != NULL) {
+        float duty = strtof(arg2, NULL);
+        if (duty < -1 || duty > 1) {
+            cli_printf("Duty must be -1 to 1");
+            return;
+        }
+        motor_set(duty);
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: motor [set <-1 to 1>/brake/coast/freq <hz>/decay <coast/brake>]");
+        return;
+    }
+
+    cli_printf("duty %.3f at %" PRIu32 " Hz", motor_get(), motor_get_frequency());
+}
+
+static void s_servo(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+    const char* arg2 = embeddedCliGetToken(args, 2);
+
+    if (arg1 != NULL && !strcmp(arg1, "set") && arg2 != NULL) {
+        servo_set(strtof(arg2, NULL));
+    } else if (arg1 != NULL && !strcmp(arg1, "pulse") && arg2 != NULL) {
+        if (!servo_set_pulse(strtof(arg2, NULL))) {
+            cli_printf("Pulse must be %u to %u us", SERVO_PULSE_MIN_US, SERVO_PULSE_MAX_US);
+            return;
+        }
+    } else if (arg1 != NULL && !strcmp(arg1, "frame") && arg2 != NULL) {
+        if (!servo_set_frame(strtol(arg2, NULL, 10))) {
+            cli_printf("Frame rate must be %u to %u Hz", SERVO_FRAME_HZ_MIN, SERVO_FRAME_HZ_MAX);
+            return;
+        }
+    } else if (arg1 != NULL && !strcmp(arg1, "sweep")) {
+        s_servo_sweep(arg2 != NULL ? strtoul(arg2, NULL, 10) : 2000);
+    } else if (arg1 != NULL && !strcmp(arg1, "calib")) {
+        s_servo_calib(args);
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: servo [set <deg>/pulse <us>/frame <hz>/sweep [ms]/calib]");
+        return;
+    }
+
+    servo_calib_t calib;
+    servo_get_calibration(&calib);
+    cli_printf("pulse %.2f us at %u Hz", servo_get_pulse(), calib.frame_hz);
+}
+
+static void s_servo_calib(char* args) {
+    static const char* points[eSERVO_POINTS] = {"left", "center", "right"};
+    const char*        arg2 = embeddedCliGetToken(args, 2);
+
+    for (uint8_t p = 0; arg2 != NULL && p < eSERVO_POINTS; p++) {
+        if (!strcmp(arg2, points[p])) {
+            if (!servo_set_point(p)) {
+                cli_printf("The center must be between left and right");
+                return;
+            }
+            arg2 = NULL;
+        }
+    }
+    if (arg2 != NULL && !strcmp(arg2, "save")) {
+        if (!servo_save_calibration()) {
+            cli_printf("Flash error, calibration not saved");
+            return;
+        }
+    } else if (arg2 != NULL && !strcmp(arg2, "clear")) {
+        if (!servo_clear_calibration()) {
+            cli_printf("Flash error, calibration not cleared");
+            return;
+        }
+    } else if (arg2 != NULL) {
+        cli_printf("Usage: servo calib [left/center/right/save/clear]");
+        return;
+    }
+
+    servo_calib_t calib;
+    servo_get_calibration(&calib);
+    cli_printf("%-8s %10s", "point", "pulse us");
+    for (uint8_t p = 0; p < eSERVO_POINTS; p++) {
+        cli_printf("%-8s %10.2f", points[p], calib.pulse_us[p]);
+    }
+    cli_printf("%-8s %10u", "frame hz", calib.frame_hz);
+}
+
+/**
+ * @brief Steer from full lock left to full lock right and back to straight, one step per frame
+ */
+static void s_servo_sweep(uint32_t ms) {
+    servo_calib_t calib;
+    servo_get_calibration(&calib);
+
+    uint32_t frame_ms = 1000 / calib.frame_hz + 1;
+    uint32_t steps = ms / frame_ms / 2 + 1;
+    float    max = geometry_tables.vehicle.steer_max_deg;
+    for (uint32_t i = 0; i <= 2 * steps; i++) {
+        // Left to right, then right to straight
+        float share = i <= steps ? 1 - 2.0f * i / steps : (float)(i - steps) / steps - 1;
+        servo_set(max * share);
+        osDelay(frame_ms);
+    }
+    servo_set(0);
+}
+
+static void s_wheel(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+    const char* arg2 = embeddedCliGetToken(args, 2);
+
+    if (arg1 != NULL && !strcmp(arg1, "set") && arg2 != NULL) {
+        wheel_set(strtof(arg2, NULL));
+    } else if (arg1 != NULL && !strcmp(arg1, "off")) {
+        wheel_off();
+    } else if (arg1 != NULL && !strcmp(arg1, "step") && arg2 != NULL) {
+        s_wheel_step(strtof(arg2, NULL));
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "reset")) {
+        wheel_reset_timing();
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: wheel [set <mm/s>/off/step <mm/s>/reset]");
+        return;
+    }
+
+    wheel_state_t state;
+    wheel_get(&state);
+    cli_printf(
+        "%s, command %.0f mm/s, target %.0f mm/s, speed %.1f mm/s, duty %.3f",
+        state.on ? "on" : "off",
+        state.command_mm_s,
+        state.target_mm_s,
+        state.speed_mm_s,
+        state.duty
+    );
+
+    prof_stats_t exec, period;
+    wheel_get_timing(&exec, &period);
+    uint32_t per_us = cycles_per_us();
+    cli_printf("%-8s %10s %10s %10s %10s", "[us]", "mean", "p99", "max", "count");
+    cli_printf(
+        "%-8s %10.2f %10.2f %10.2f %10" PRIu32,
+        "exec",
+        (float)exec.mean / per_us,
+        (float)exec.p99 / per_us,
+        (float)exec.max / per_us,
+        exec.count
+    );
+    cli_printf(
+        "%-8s %10.2f %10.2f %10.2f %10" PRIu32,
+        "period",
+        (float)period.mean / per_us,
+        (float)period.p99 / per_us,
+        (float)period.max / per_us,
+        period.count
+    );
+}
+
+static void s_battery(EmbeddedCli* cli, char* args, void* context) {
+    static const char* levels[] = {"ok", "low", "cutoff"};
+    const char*        arg1 = embeddedCliGetToken(args, 1);
+
+    if (arg1 != NULL && !strcmp(arg1, "reset")) {
+        battery_reset();
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: battery [reset]");
+        return;
+    }
+
+    battery_state_t state;
+    battery_get(&state);
+    cli_printf(
+        "%.0f mV (min %.0f mV), VDDA %.0f mV, %s, duty limit %.2f, %" PRIu32 " blocks, %" PRIu32 " cutoffs",
+        state.mv,
+        state.min_mv,
+        state.vdda_mv,
+        levels[state.level],
+        state.limit,
+        state.blocks,
+        state.cutoffs
+    );
+}
+
+static void s_control(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+    const char* arg2 = embeddedCliGetToken(args, 2);
+    const char* arg3 = embeddedCliGetToken(args, 3);
+
+    if (arg1 != NULL && !strcmp(arg1, "start") && arg2 != NULL) {
+        control_start(strtof(arg2, NULL));
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "stop")) {
+        control_stop();
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "budget") && arg2 != NULL && arg3 != NULL) {
+        control_stats_t stats;
+        control_get_stats(&stats);
+        for (uint8_t i = 0; i < eCONTROL_STAGES; i++) {
+            if (!strcmp(arg2, stats.stage[i].name)) {
+                control_set_budget(i, strtoul(arg3, NULL, 10));
+                return;
+            }
+        }
+        cli_printf("No stage %s", arg2);
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "reset")) {
+        control_reset_stats();
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: control [start <mm/s>/stop/budget <stage> <us>/reset]");
+        return;
+    }
+
+    control_stats_t stats;
+    control_get_stats(&stats);
+    cli_printf(
+        "%s, command %.0f mm/s %.1f deg, %" PRIu32 " cycles, %" PRIu32 " late, %" PRIu32 " holds, %" PRIu32 " stops",
+        stats.driving ? "driving" : "stopped",
+        stats.command.speed_mm_s,
+        stats.command.steer_deg,
+        stats.cycles,
+        stats.late,
+        stats.holds,
+        stats.stops
+    );
+
+    uint32_t per_us = cycles_per_us();
+    cli_printf("%-9s %8s %10s %10s %10s %8s %8s", "[us]", "budget", "mean", "p99", "max", "overruns", "skips");
+    for (uint8_t i = 0; i < eCONTROL_STAGES; i++) {
+        const control_stage_stats_t* stage = &stats.stage[i];
+        cli_printf(
+            "%-9s %8" PRIu32 " %10.2f %10.2f %10.2f %8" PRIu32 " %8" PRIu32,
+            stage->name,
+            stage->budget_us,
+            (float)stage->exec.mean / per_us,
+            (float)stage->exec.p99 / per_us,
+            (float)stage->exec.max / per_us,
+            stage->overruns,
+            stage->skips
+        );
+    }
+    cli_printf(
+        "%-9s %8u %10.2f %10.2f %10.2f",
+        "cycle",
+        CONTROL_PERIOD_US,
+        (float)stats.exec.mean / per_us,
+        (float)stats.exec.p99 / per_us,
+        (float)stats.exec.max / per_us
+    );
+    cli_printf(
+        "%-9s %8s %10.2f %10.2f %10.2f",
+        "latency",
+        "",
+        (float)stats.latency.mean / per_us,
+        (float)stats.latency.p99 / per_us,
+        (float)stats.latency.max / per_us
+    );
+}
+
+/**
+ * @brief Step to a speed, log the response for WHEEL_LOG_SAMPLES encoder samples and stop again
+ */
+static void s_wheel_step(float speed_mm_s) {
+    const wheel_log_t* log;
+
+    wheel_start_log();
+    wheel_set(speed_mm_s);
+    while (wheel_get_log(&log) < WHEEL_LOG_SAMPLES) {
+        osDelay(10);
+    }
+    wheel_set(0);
+
+    cli_printf("%6s %8s %8s %8s", "ms", "target", "speed", "duty");
+    for (uint16_t i = 0; i < WHEEL_LOG_SAMPLES; i++) {
+        cli_printf(
+            "%6u %8d %8d %8.4f",
+            i * 1000 / ENCODER_RATE_HZ,
+            log[i].target_mm_s,
+            log[i].speed_mm_s,
+            log[i].duty / 10000.0f
+        );
+    }
+}
+
+/**
+ * @brief lidar calib [<sensor> offset/xtalk <target mm>/save/clear], blocks while a calibration runs
+ */
+static void s_lidar_calib(char* args) {
+    const char* arg2 = embeddedCliGetToken(args, 2);
+    const char* arg3 = embeddedCliGetToken(args, 3);
+    const char* arg4 = embeddedCliGetToken(args, 4);
+
+    if (arg2 != NULL && !strcmp(arg2, "clear")) {
+        bool cleared = lidar_clear_calibration();
+        cli_printf(cleared ? "Calibration cleared, factory values after the next boot" : "Flash error");
+        return;
+    } else if (arg2 != NULL && arg3 != NULL && arg4 != NULL) {
+        lidar_calib_e kind = !strcmp(arg3, "xtalk") ? eLIDAR_CALIB_XTALK : eLIDAR_CALIB_OFFSET;
+        if (strcmp(arg3, "offset") && strcmp(arg3, "xtalk")) {
+            cli_printf("Calibrate offset or xtalk");
+            return;
+        }
+        if (!lidar_calibrate(strtoul(arg2, NULL, 10), kind, strtoul(arg4, NULL, 10))) {
+            cli_printf("Calibration not started, stop the lidar first");
+            return;
+        }
+        cli_printf("Calibrating, %u measurements", LIDAR_CALIB_SAMPLES);
+        while (lidar_get_calib_state() == eLIDAR_CALIB_RUNNING) {
+            osDelay(10);
+        }
+        if (lidar_get_calib_state() != eLIDAR_CALIB_DONE) {
+            cli_printf("Calibration failed, too many invalid ranges");
+            return;
+        }
+        // Stalls the CPU while the flash is written, the lidar is stopped anyway
+        if (!lidar_save_calibration()) {
+            cli_printf("Flash error, calibration not saved");
+            return;
+        }
+    } else if (arg2 != NULL) {
+        cli_printf("Usage: lidar calib [<sensor> offset/xtalk <target mm>/clear]");
+        return;
+    }
+
+    lidar_calib_t calib;
+    lidar_get_calibration(&calib);
+    cli_printf("%-3s %10s %10s", "#", "offset mm", "xtalk cps");
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        char offset[8] = "factory";
+        char xtalk[8] = "factory";
+        if ((calib.offset_valid >> i) & 1) {
+            snprintf(offset, sizeof(offset), "%d", calib.offset_mm[i]);
+        }
+        if ((calib.xtalk_valid >> i) & 1) {
+            snprintf(xtalk, sizeof(xtalk), "%u", calib.xtalk_cps[i]);
+        }
+        cli_printf("%-3u %10s %10s", i, offset, xtalk);
+    }
+}
+
+static void s_lidar(EmbeddedCli* cli, char* args, void* context) {
+    const char* arg1 = embeddedCliGetToken(args, 1);
+    const char* arg2 = embeddedCliGetToken(args, 2);
+
+    if (arg1 != NULL && !strcmp(arg1, "start")) {
+        lidar_start();
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "stop")) {
+        lidar_stop();
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "scan")) {
+        bool                fresh;
+        const lidar_scan_t* scan = lidar_get_scan(eLIDAR_READER_CLI, &fresh);
+        uint32_t            now = cycles_now();
+
+        cli_printf(
+            "Scan %" PRIu32 "%s, %u beams, %" PRIu32 " ms old",
+            scan->sequence,
+            fresh ? "" : " (not new)",
+            scan->beams,
+            (now - scan->stamp) / cycles_per_us() / 1000
+        );
+        cli_printf("%-5s %6s %6s %8s %9s %10s", "beam", "mm", "status", "kcps", "filtered", "age [ms]");
+        for (uint8_t b = 0; b < scan->beams; b++) {
+            char filtered[8] = "-";
+            if ((scan->valid >> b) & 1) {
+                snprintf(filtered, sizeof(filtered), "%u", scan->filtered_mm[b]);
+            }
+            cli_printf(
+                "%-5u %6u %6u %8u %9s %10" PRIu32,
+                b,
+                scan->distance_mm[b],
+                scan->status[b],
+                scan->signal_kcps[b],
+                filtered,
+                (now - scan->capture[b]) / cycles_per_us() / 1000
+            );
+        }
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "points")) {
+        static lidar_points_t points; // Too large for the stack of the CLI task
+        lidar_deskew(lidar_get_scan(eLIDAR_READER_CLI, NULL), true, &points);
+
+        cli_printf("Scan %" PRIu32 ", %u beams, vehicle frame", points.sequence, points.beams);
+        cli_printf("%-5s %8s %8s %9s", "beam", "x [mm]", "y [mm]", "deskewed");
+        for (uint8_t b = 0; b < points.beams; b++) {
+            if (!((points.valid >> b) & 1)) {
+                cli_printf("%-5u %8s %8s %9s", b, "-", "-", "-");
+                continue;
+            }
+            cli_printf(
+                "%-5u %8.0f %8.0f %9s",
+                b,
+                points.x_mm[b],
+                points.y_mm[b],
+                ((points.deskewed >> b) & 1) ? "yes" : "no"
+            );
+        }
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "zones") && arg2 != NULL) {
+        if (!lidar_set_zones(strtoul(arg2, NULL, 10))) {
+            cli_printf("Zones must be 1 to %u", LIDAR_ZONES_MAX);
+        }
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "speed") && arg2 != NULL) {
+        lidar_set_speed(strtol(arg2, NULL, 10));
+        return;
+    } else if (arg1 != NULL && !strcmp(arg1, "calib")) {
+        s_lidar_calib(args);
+        return;
+    } else if (arg1 != NULL) {
+        cli_printf("Usage: lidar [start/stop/scan/points/zones <1-%u>/speed <mm/s>/calib]", LIDAR_ZONES_MAX);
+        return;
+    }
+
+    float per_s = cycles_per_us() * 1e6f;
+    float aggregate_hz = 0;
+
+    cli_printf(
+        "%-3s %-5s %-8s %8s %8s %-9s %5s %8s %6s %5s %8s %7s",
+        "#",
+        "addr",
+        "state",
+        "results",
+        "errors",
+        "health",
+        "score",
+        "timeouts",
+        "reads",
+        "stuck",
+        "removals",
+        "reboots"
+    );
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        const vl53l1x_t* sensor = lidar_get_sensor(i);
+        lidar_health_t   health;
+        lidar_get_health(i, &health);
+        cli_printf(
+            "%-3u 0x%02x  %-8s %8" PRIu32 " %8" PRIu32 " %-9s %5u %8" PRIu32 " %6" PRIu32 " %5" PRIu32 " %8" PRIu32
+            " %7u",
+            i,
+            sensor->address,
+            s_lidar_states[sensor->state],
+            sensor->results,
+            sensor->errors,
+            s_lidar_health[health.state],
+            health.score,
+            health.timeouts,
+            health.read_errors,
+            health.stuck,
+            health.removals,
+            health.reboots
+        );
+    }
+
+    cli_printf(
+        "%-5s %-6s %8s %8s %6s %6s %10s %8s",
+        "beam",
+        "sensor",
+        "az [deg]",
+        "fov",
+        "mm",
+        "status",
+        "age [ms]",
+        "Hz"
+    );
+    for (uint8_t b = 0; b < lidar_get_beam_count(); b++) {
+        lidar_beam_t  beam;
+        lidar_range_t range;
+        lidar_get_beam(b, &beam);
+        bool     valid = lidar_get_range(b, &range);
+        uint32_t age_ms = (cycles_now() - range.stamp) / cycles_per_us() / 1000;
+        float    hz = valid && range.period ? per_s / range.period : 0;
+
+        aggregate_hz += hz;
+        cli_printf(
+            "%-5u %-6u %8.1f %8.1f %6u %6u %10" PRIu32 " %8.2f",
+            b,
+            beam.sensor,
+            beam.azimuth_deg,
+            beam.width_deg,
+            valid ? range.result.distance_mm : 0,
+            valid ? range.result.status : 255,
+            valid ? age_ms : 0,
+            hz
+        );
+    }
+
+    lidar_schedule_t schedule;
+    lidar_get_schedule(&schedule);
+    cli_printf(
+        "Schedule %s, %u zones, %s regime, %" PRIu32 " scans (%" PRIu32 " published, %" PRIu32
+        " dropped), scan %.2f Hz (budget allows %.2f Hz), aggregate %.2f Hz",
+        schedule.running ? "running" : "stopped",
+        schedule.zones,
+        lidar_get_regime(schedule.regime)->name,
+        schedule.scans,
+        schedule.published,
+        schedule.dropped,
+        schedule.scan_period ? per_s / schedule.scan_period : 0,
+        1000.0f / (schedule.zones * LIDAR_GROUPS * lidar_get_regime(schedule.regime)->budget_ms),
+        aggregate_hz
+    );
+    cli_printf("%-8s %6s %6s %10s %8s %8s", "regime", "mode", "budget", "scans", "scan Hz", "allows");
+    for (uint8_t r = 0; r < eLIDAR_REGIMES; r++) {
+        const lidar_regime_t* regime = lidar_get_regime(r);
+        cli_printf(
+            "%-8s %6s %6u %10" PRIu32 " %8.2f %8.2f",
+            regime->name,
+            regime->mode == eVL53L1X_SHORT ? "short" : "long",
+            regime->budget_ms,
+            schedule.regime_scans[r],
+            schedule.regime_us[r] ? schedule.regime_scans[r] * 1e6f / schedule.regime_us[r] : 0,
+            1000.0f / (schedule.zones * LIDAR_GROUPS * regime->budget_ms)
+        );
+    }
+    for (uint8_t g = 0; g < LIDAR_GROUPS; g++) {
+        cli_printf("Slot %u: %" PRIu32 " us", g, schedule.slot_period[g] / cycles_per_us());
+    }
+}
+
 // ==================== Global function implementation ==========================
 /**
  * @brief Initialize CLI
@@ -83,7 +977,7 @@ static void s_button_get_state(EmbeddedCli* cli, char* args, void* context) {
 void cli_init(void) {
     EmbeddedCliConfig* config = embeddedCliDefaultConfig();
     config->cliBuffer = cliBuffer;
-    config->cliBufferSize = CLI_BUFFER_SIZE;
+    config->cliBufferSize = sizeof(cliBuffer);
     config->rxBufferSize = CLI_RX_BUFFER_SIZE;
     config->cmdBufferSize = CLI_CMD_BUFFER_SIZE;
     config->historyBufferSize = CLI_HISTORY_SIZE;
@@ -94,18 +988,13 @@ void cli_init(void) {
     cli = embeddedCliNew(config);
     if (cli == NULL) {
         // CLI init failed. Is there not enough memory allocated to the CLI?
-        // Please increase the 'CLI_BUFFER_SIZE' in header file or decrease max binding / history size.
-        // You can get required buffer size by calling
-        // uint16_t requiredSize = embeddedCliRequiredSize(config);
-        // Then check it's value in debugger
+        // The buffer is sized like embeddedCliRequiredSize() does, see CLI_UINTS. Did the library change?
 
         char     error_buffer[100] = {0};
         uint16_t size = embeddedCliRequiredSize(config);
         uint16_t len = sprintf(error_buffer, "CLI could not be created, required size: %ud", size);
 
-        for (int i = 0; i < len; i++) {
-            coms_add_tx((uint8_t)error_buffer[i]); // TODO: Use coms_trannsmit() once implemented
-        }
+        coms_transmit((const uint8_t*)error_buffer, len);
     }
 
     // Assign character write function
@@ -138,11 +1027,131 @@ void cli_init(void) {
         .context = NULL,
         .binding = s_button_get_state
     };
+    CliCommandBinding pcsamp_binding = {
+        .name = "pcsamp",
+        .help = "PC-sampling profiler: pcsamp [start [hz]/stop/dump/status]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_pcsamp
+    };
+    CliCommandBinding prof_binding = {
+        .name = "prof",
+        .help = "List latency histograms of profiled scopes: prof [reset]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_prof
+    };
+    CliCommandBinding bus_binding = {
+        .name = "bus",
+        .help = "Message bus topics, rates and drops: bus [reset]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_bus
+    };
+    CliCommandBinding pool_binding = {
+        .name = "pool",
+        .help = "Block pools, blocks in use and the most used at once: pool [reset]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_pool
+    };
+    CliCommandBinding coms_binding = {
+        .name = "coms",
+        .help = "Virtual COM port rings, bytes stored, the most at once and dropped: coms [reset]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_coms
+    };
+    CliCommandBinding stack_binding = {
+        .name = "stack",
+        .help = "Least free stack of every task since it started",
+        .tokenizeArgs = false,
+        .context = NULL,
+        .binding = s_stack
+    };
+    CliCommandBinding bench_binding = {
+        .name = "bench",
+        .help = "Microbenchmarks: bench [list] | bench run <name/all> [reps] [masked]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_bench
+    };
+    CliCommandBinding i2c_binding = {
+        .name = "i2c",
+        .help = "I2C bus utilization and queue latency per priority: i2c [reset]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_i2c
+    };
+    CliCommandBinding encoder_binding = {
+        .name = "encoder",
+        .help = "Wheel travel and speed since the reset: encoder [reset]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_encoder
+    };
+    CliCommandBinding motor_binding = {
+        .name = "motor",
+        .help = "Drive motor PWM: motor [set <-1 to 1>/brake/coast/freq <hz>/decay <coast/brake>]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_motor
+    };
+    CliCommandBinding servo_binding = {
+        .name = "servo",
+        .help = "Steering: servo [set <deg>/pulse <us>/frame <hz>/sweep [ms]/calib [left/center/right/save/clear]]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_servo
+    };
+    CliCommandBinding wheel_binding = {
+        .name = "wheel",
+        .help = "Wheel speed control and its timing: wheel [set <mm/s>/off/step <mm/s>/reset]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_wheel
+    };
+    CliCommandBinding battery_binding = {
+        .name = "battery",
+        .help = "Battery voltage and low voltage policy: battery [reset]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_battery
+    };
+    CliCommandBinding control_binding = {
+        .name = "control",
+        .help = "Control executive and its stage timing: control [start <mm/s>/stop/budget <stage> <us>/reset]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_control
+    };
+    CliCommandBinding lidar_binding = {
+        .name = "lidar",
+        .help = "Lidar sensor status and latest ranges: lidar [start/stop/scan/points/zones <1-4>/speed <mm/s>/calib]",
+        .tokenizeArgs = true,
+        .context = NULL,
+        .binding = s_lidar
+    };
     embeddedCliAddBinding(cli, clear_binding);
     embeddedCliAddBinding(cli, led_get_binding);
     embeddedCliAddBinding(cli, led_set_binding);
     embeddedCliAddBinding(cli, led_toggle_binding);
     embeddedCliAddBinding(cli, button_get_binding);
+    embeddedCliAddBinding(cli, pcsamp_binding);
+    embeddedCliAddBinding(cli, prof_binding);
+    embeddedCliAddBinding(cli, bus_binding);
+    embeddedCliAddBinding(cli, pool_binding);
+    embeddedCliAddBinding(cli, coms_binding);
+    embeddedCliAddBinding(cli, stack_binding);
+    embeddedCliAddBinding(cli, bench_binding);
+    embeddedCliAddBinding(cli, i2c_binding);
+    embeddedCliAddBinding(cli, encoder_binding);
+    embeddedCliAddBinding(cli, motor_binding);
+    embeddedCliAddBinding(cli, servo_binding);
+    embeddedCliAddBinding(cli, wheel_binding);
+    embeddedCliAddBinding(cli, battery_binding);
+    embeddedCliAddBinding(cli, control_binding);
+    embeddedCliAddBinding(cli, lidar_binding);
 
     // Init the CLI with blank screen
     cli_clear();
@@ -172,21 +1181,34 @@ void cli_receive_byte(uint8_t c) {
  * @param ... 
  */
 void cli_printf(const char* format, ...) {
-    char buffer[CLI_PRINTF_BUFFER_SIZE];
+    // None free is counted as a failure of the pool, the line is replaced by a constant one so it does not go
+    // missing unnoticed
+    char* buffer = pool_alloc(CLI_PRINTF_BUFFER_SIZE);
+    if (buffer == NULL) {
+        s_printf_dropped++;
+        embeddedCliPrint(cli, "[line dropped, no free message block]");
+        return;
+    }
 
     // Format the string using snprintf
     va_list args;
     va_start(args, format);
-    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    int length = vsnprintf(buffer, CLI_PRINTF_BUFFER_SIZE, format, args);
     va_end(args);
 
-    // Check if string fitted in buffer else print error to stderr
+    // Cut, the end shows it
+    if (length >= CLI_PRINTF_BUFFER_SIZE) {
+        memcpy(buffer + CLI_PRINTF_BUFFER_SIZE - 4, "...", 4);
+    }
+
+    // Check if string could be formatted else print error
     if (length < 0) {
-        cli_printf("printf needs more buffer size!");
+        cli_printf("printf could not format the string!");
     }
 
     // Call embeddedCliPrint with the formatted string
     embeddedCliPrint(cli, buffer);
+    pool_free(buffer);
 }
 
 /**
@@ -204,6 +1226,7 @@ EmbeddedCli* cli_get_pointer() {
  * 
  */
 void cli_process(void) {
+    PROF_SCOPE("embeddedCliProcess");
     embeddedCliProcess(cli);
 }
 
@@ -224,6 +1247,7 @@ void cli_task(void const* argument) {
 
     for (;;) {
         cli_process();
+        s_button_events();
         osDelay(50);
     }
 }
@@ -2,6 +2,10 @@
  * @file coms.c
  * @author Isak Åslund (aslundisak@gmail.com)
  * @brief Communication Interface, layer between application and Virtual Com Port (CDC USB)
+ * Received bytes are put in the RX ring by the USB interrupt and handed to the CLI by the coms task.
+ * Bytes to send are put in the TX ring and transmitted by USB where they are, a transfer covers the bytes up
+ * to the end of the ring and they are consumed once it completes. The completion starts the next transfer,
+ * the coms task only starts one when USB is idle.
  * @version 0.1
  * @date 2023-11-11
  * 
@@ -10,66 +14,71 @@
  */
 
 #include <stdint.h>
-#include <string.h>
 
 #include "FreeRTOS.h"
 #include "cmsis_os.h"
+#include "task.h"
 #include "usbd_cdc_if.h"
 
 #include "User/cli.h"
 #include "User/coms.h"
+#include "User/ring.h"
 
-#define TX_SIZE 1048
-#define RX_SIZE 50
+// ============= Private variables ===================
+static RING(s_rx, COMS_RX_SIZE);
+static RING(s_tx, COMS_TX_SIZE);
+static volatile uint16_t s_tx_sending; // Bytes of s_tx handed to USB, 0 while idle
 
-static uint8_t s_rx_buffer[RX_SIZE];
-static uint8_t s_i_rx;
-static uint8_t s_tx_buffer[TX_SIZE];
-static uint8_t s_i_tx;
+// ============ Private function declaration =================
+static void s_handle_rx(void);
+static void s_tx_start(void);
 
+//============ Private function implementation ===============
 static void s_handle_rx(void) {
-    if (!s_i_rx) {
-        return;
-    }
+    const uint8_t* data;
+    uint16_t       len;
 
-    for (int i = 0; i < s_i_rx; i++) {
-        cli_receive_byte(s_rx_buffer[i]);
+    while ((data = ring_peek(&s_rx, &len)) != NULL) {
+        for (uint16_t i = 0; i < len; i++) {
+            cli_receive_byte(data[i]);
+        }
+        ring_consume(&s_rx, len);
     }
-    memset(s_rx_buffer, 0, sizeof(s_rx_buffer));
-    s_i_rx = 0;
 }
 
-static void s_handle_tx(void) {
-    if (!s_i_tx) {
+/**
+ * @brief Transmit the oldest bytes of the TX ring unless a transfer is ongoing
+ * From the USB interrupt or with it masked.
+ */
+static void s_tx_start(void) {
+    uint16_t len;
+    uint8_t* data = (uint8_t*)ring_peek(&s_tx, &len);
+
+    if (s_tx_sending || data == NULL) {
         return;
     }
-
-    uint8_t res = CDC_Transmit_FS(s_tx_buffer, s_i_tx);
-    if (res == USBD_OK) {
-        memset(s_tx_buffer, 0, sizeof(s_tx_buffer));
-        s_i_tx = 0;
+    // Set before the transfer starts, it may complete right away
+    s_tx_sending = len;
+    if (CDC_Transmit_FS(data, len) != USBD_OK) {
+        s_tx_sending = 0;
     }
 }
 
+// ==================== Global function implementation ==========================
 /**
  * @brief Communication RTOS task
  * 
  * @param argument Unused
  */
 void coms_task(void const* argument) {
-    // Task should handle the following:
-    // 1. Handle received characters that have been placed in Que by CDC_Receive interrupt
-    // 2. Handle outgoing characters that have been placed in a Que
     for (;;) {
         // Handle all received characters
-        if (s_i_rx) {
-            s_handle_rx();
-        }
+        s_handle_rx();
 
-        // Handle outgoing characters
-        if (s_i_tx) {
-            s_handle_tx();
-        }
+        // Start sending what was added while USB was idle
+        UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+        s_tx_start();
+        taskEXIT_CRITICAL_FROM_ISR(mask);
 
         osDelay(50);
     }
@@ -77,18 +86,77 @@ void coms_task(void const* argument) {
 
 /**
  * @brief Add received character via Virtual COM port
- * Only CDC receive should be calling this function
+ * Only CDC receive should be calling this function. Dropped and counted if the coms task fell behind.
  * @param c 
  */
 void coms_add_rx(uint8_t c) {
-    s_rx_buffer[s_i_rx++] = c;
+    ring_put(&s_rx, c);
 }
 
 /**
  * @brief Add character to send via Virtual COM port
+ * If the buffer is full and the caller is a task, it waits for USB to drain it,
+ * so long outputs (e.g. profiler dumps) arrive intact. From an ISR the character is dropped.
  * 
  * @param c Character to add
  */
 void coms_add_tx(uint8_t c) {
-    s_tx_buffer[s_i_tx++] = c;
+    while (!ring_free(&s_tx)) {
+        if (__get_IPSR() != 0 || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+            break;
+        }
+        UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+        s_tx_start();
+        taskEXIT_CRITICAL_FROM_ISR(mask);
+        osDelay(1);
+    }
+
+    // Tasks and ISRs all add to the same ring, one at a time
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    ring_put(&s_tx, c);
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+/**
+ * @brief Add characters to send via Virtual COM port, like coms_add_tx() for each of them
+ * 
+ * @param buffer Characters
+ * @param len Number of characters
+ */
+void coms_transmit(const uint8_t* buffer, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        coms_add_tx(buffer[i]);
+    }
+}
+
+/**
+ * @brief Release the bytes of the finished transfer and start the next one
+ * Only CDC transmit complete should be calling this function.
+ */
+void coms_tx_done(void) {
+    ring_consume(&s_tx, s_tx_sending);
+    s_tx_sending = 0;
+    s_tx_start();
+}
+
+/**
+ * @brief Get the fill level and statistics of both rings
+ * 
+ * @param rx Received bytes
+ * @param tx Bytes to send
+ */
+void coms_get_stats(ring_stats_t* rx, ring_stats_t* tx) {
+    ring_get_stats(&s_rx, rx);
+    ring_get_stats(&s_tx, tx);
+}
+
+/**
+ * @brief Clear the statistics of both rings
+ */
+void coms_reset_stats(void) {
+    ring_reset_stats(&s_rx);
+
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    ring_reset_stats(&s_tx);
+    taskEXIT_CRITICAL_FROM_ISR(mask);
 }
@@ -0,0 +1,98 @@
+/**
+ * @file control.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Trigger of the control executive, TIM4 wakes the control task at CONTROL_RATE_HZ
+ * TIM4 counts at 1 MHz and updates every CONTROL_PERIOD_US. Its interrupt stamps the trigger and signals
+ * the task, which runs one cycle of control_exec.c per signal. The task has the highest priority of the
+ * application, only interrupts delay a cycle, the delay is recorded as latency. A cycle that takes longer than
+ * the period merges the triggers in between into one, the next cycle then starts late.
+ * In the host build there is no timer, the host I/O task calls control_trigger() instead.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cmsis_os.h"
+#include "main.h"
+
+#include "User/control.h"
+#include "User/cycles.h"
+
+#define SIGNAL_TRIGGER 0x01
+
+// ============= Private variables ===================
+static osThreadId        s_task;
+static volatile uint32_t s_trigger; // cycles_now() of the last trigger
+
+// ============ Private function declaration =================
+static void s_start(void);
+
+//============ Private function implementation ===============
+#ifdef DONATELLO_HOST
+static void s_start(void) {}
+#else
+static uint32_t s_timer_clock(void) {
+    // Timers on APB1 run at twice PCLK1 when the APB1 prescaler is not 1
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    return ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1) ? pclk1 : 2 * pclk1;
+}
+
+static void s_start(void) {
+    __HAL_RCC_TIM4_CLK_ENABLE();
+
+    TIM4->CR1 = 0;
+    TIM4->PSC = s_timer_clock() / 1000000 - 1;
+    TIM4->ARR = CONTROL_PERIOD_US - 1;
+    TIM4->EGR = TIM_EGR_UG;
+    TIM4->SR = 0;
+    TIM4->DIER = TIM_DIER_UIE;
+
+    HAL_NVIC_SetPriority(TIM4_IRQn, CONTROL_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+    TIM4->CR1 = TIM_CR1_CEN;
+}
+#endif
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Start triggering cycles, call after the modules the cycle uses are initialized
+ */
+void control_init(void) {
+    s_start();
+}
+
+/**
+ * @brief Run a cycle as soon as the control task gets to it, from the timer interrupt or a task
+ */
+void control_trigger(void) {
+    s_trigger = cycles_now();
+    if (s_task != NULL) {
+        osSignalSet(s_task, SIGNAL_TRIGGER);
+    }
+}
+
+/**
+ * @brief Runs a cycle for every trigger
+ */
+void control_task(void const* argument) {
+    s_task = osThreadGetId();
+
+    for (;;) {
+        osEvent event = osSignalWait(SIGNAL_TRIGGER, osWaitForever);
+        if (event.status == osEventSignal) {
+            control_cycle(s_trigger);
+        }
+    }
+}
+
+#ifndef DONATELLO_HOST
+void TIM4_IRQHandler(void) {
+    TIM4->SR = ~TIM_SR_UIF;
+    control_trigger();
+}
+#endif
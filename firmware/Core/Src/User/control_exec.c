@@ -0,0 +1,364 @@
+/**
+ * @file control_exec.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief The cycle of the control executive, sense, estimate, plan and act in a fixed order
+ * Every stage is timed against its budget. Planning is the only stage that may be skipped, it is the one
+ * whose run time grows with what the car sees. It is skipped when the time since the trigger plus its budget
+ * and the budget of act would not fit in the period, or when it overran in the cycle before, so a slow plan
+ * runs at most every other cycle and the actuators are always written on time. Skipped cycles act on the last
+ * plan, after CONTROL_HOLD_CYCLES the speed is set to zero.
+ * The planner is reactive: pure pursuit of the farthest point of the scan, at a speed that can still stop
+ * CONTROL_STOP_MM short of what is in the path. It keeps the car off the walls of a track, no more.
+ * No RTOS calls, the host simulation runs the same cycle in simulated time.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+#include "User/control.h"
+#include "User/cycles.h"
+#include "User/encoder.h"
+#include "User/geometry.h"
+#include "User/lidar.h"
+#include "User/lidar_deskew.h"
+#include "User/odom.h"
+#include "User/prof.h"
+#include "User/servo.h"
+#include "User/wheel.h"
+
+#define DEG_PER_RAD 57.29578f
+
+typedef struct
+{
+    const char*  name;
+    void         (*run)(void);
+    uint32_t     budget_us;
+    uint32_t     runs;
+    uint32_t     overruns;
+    uint32_t     skips;
+    bool         overran; // In its last run
+    prof_scope_t exec;
+} stage_t;
+
+// ============ Private function declaration =================
+static void  s_sense(void);
+static void  s_estimate(void);
+static void  s_plan(void);
+static void  s_act(void);
+static void  s_run(stage_t* stage);
+static float s_curvature(float steer_deg);
+
+// ============= Private variables ===================
+// Budgets on target, estimate and plan grow with the beams and are sized for LIDAR_BEAMS_MAX
+static stage_t s_stages[eCONTROL_STAGES] = {
+    [eCONTROL_SENSE] = {"sense", s_sense, 50},
+    [eCONTROL_ESTIMATE] = {"estimate", s_estimate, 400},
+    [eCONTROL_PLAN] = {"plan", s_plan, 400},
+    [eCONTROL_ACT] = {"act", s_act, 100},
+};
+
+static prof_scope_t s_latency = {.name = "control latency"};
+static prof_scope_t s_exec = {.name = "control cycle"};
+static uint32_t     s_cycles;
+static uint32_t     s_late;
+static uint32_t     s_holds;
+static uint32_t     s_stops;
+
+static bool              s_driving;
+static float             s_cruise_mm_s;
+static control_command_t s_command; // Of the last plan
+static control_command_t s_acted;   // Written to the actuators
+static uint8_t           s_held;    // Cycles since the last plan
+
+// Sensed
+static encoder_state_t     s_encoder;
+static const lidar_scan_t* s_scan;
+static bool                s_fresh;
+static uint8_t             s_since_scan = CONTROL_STALE_CYCLES; // Cycles since a new scan
+
+// Estimated
+static uint32_t       s_samples; // Of the encoder at the last pose
+static float          s_distance_mm;
+static float          s_x_mm;
+static float          s_y_mm;
+static float          s_yaw_rad;
+static lidar_points_t s_points;
+
+//============ Private function implementation ===============
+static void s_sense(void) {
+    encoder_get(&s_encoder);
+    s_scan = lidar_get_scan(eLIDAR_READER_CONTROL, &s_fresh);
+    if (s_fresh) {
+        s_since_scan = 0;
+    } else if (s_since_scan < CONTROL_STALE_CYCLES) {
+        s_since_scan++;
+    }
+}
+
+/**
+ * @brief Dead reckoning of the rear axle on the bicycle model, then the new scan moved onto its latest pose
+ */
+static void s_estimate(void) {
+    if (s_encoder.samples != s_samples) {
+        // The encoder was reset when it has fewer samples, travel counts from there
+        float travel = s_encoder.samples > s_samples ? s_encoder.distance_mm - s_distance_mm : 0;
+        float turn = travel * s_curvature(servo_get());
+        float heading = s_yaw_rad + turn / 2;
+
+        s_x_mm += travel * cosf(heading);
+        s_y_mm += travel * sinf(heading);
+        s_yaw_rad += turn;
+        s_samples = s_encoder.samples;
+        s_distance_mm = s_encoder.distance_mm;
+        odom_update(s_encoder.stamp, s_x_mm, s_y_mm, s_yaw_rad);
+    }
+
+    if (s_fresh) {
+        lidar_deskew(s_scan, true, &s_points);
+    }
+}
+
+/**
+ * @brief Steer for the farthest point and slow down for the closest one on the arc steered
+ * A beam without a target is open out to CONTROL_OPEN_MM. A beam without a range at all, its sensor failed,
+ * may hide anything and counts as blocked at the sensor.
+ */
+static void s_plan(void) {
+    const geometry_vehicle_t* vehicle = &geometry_tables.vehicle;
+    float                     x[LIDAR_BEAMS_MAX], y[LIDAR_BEAMS_MAX];
+    float                     goal_x = 0, goal_y = 0, goal_mm = 0;
+
+    if (s_since_scan >= CONTROL_STALE_CYCLES) {
+        s_command.speed_mm_s = 0;
+        return;
+    }
+
+    for (uint8_t b = 0; b < s_points.beams; b++) {
+        lidar_beam_t beam;
+        float        range;
+
+        if (!lidar_get_beam(b, &beam)) {
+            x[b] = y[b] = 0;
+            continue;
+        }
+        if ((s_points.valid >> b) & 1) {
+            x[b] = s_points.x_mm[b];
+            y[b] = s_points.y_mm[b];
+            range = s_scan->filtered_mm[b];
+        } else {
+            range = s_scan->status[b] == LIDAR_STATUS_NONE ? 0 : CONTROL_OPEN_MM;
+            x[b] = beam.mount_x_mm + range * beam.cos_azimuth;
+            y[b] = beam.mount_y_mm + range * beam.sin_azimuth;
+        }
+
+        // Aim at the lookahead along the beam, farther goals give too wide an arc to follow a corridor
+        if (range > goal_mm) {
+            float share = range > CONTROL_LOOKAHEAD_MM ? CONTROL_LOOKAHEAD_MM / range : 1;
+            goal_mm = range;
+            goal_x = beam.mount_x_mm + (x[b] - beam.mount_x_mm) * share;
+            goal_y = beam.mount_y_mm + (y[b] - beam.mount_y_mm) * share;
+        }
+    }
+
+    // Pure pursuit, the arc through the rear axle and the goal, full lock when the goal is beside or behind
+    float steer_deg = 0;
+    if (goal_mm > 0) {
+        float curvature = 2 * goal_y / (goal_x * goal_x + goal_y * goal_y);
+        steer_deg = goal_x > 0 ? atanf(curvature * vehicle->wheelbase_mm) * DEG_PER_RAD
+                               : copysignf(vehicle->steer_max_deg, goal_y);
+    }
+    steer_deg = fmaxf(fminf(steer_deg, vehicle->steer_max_deg), -vehicle->steer_max_deg);
+    s_command.steer_deg = steer_deg;
+
+    // Travel along the arc to every point beside the path swept by the car, the closest limits the speed
+    float curvature = s_curvature(steer_deg);
+    float half_width = vehicle->track_mm / 2 + CONTROL_MARGIN_MM;
+    float clearance = CONTROL_OPEN_MM;
+    for (uint8_t b = 0; b < s_points.beams; b++) {
+        float along = x[b];
+        float beside = y[b];
+
+        if (fabsf(curvature) > 1e-6f) {
+            // Arc around the center (0, radius), the angle is swept from the rear axle
+            float radius = 1 / curvature;
+            float angle = atan2f(x[b], (radius - y[b]) * (radius > 0 ? 1 : -1));
+            along = fabsf(radius) * angle;
+            beside = fabsf(radius) - hypotf(x[b], y[b] - radius);
+        }
+        if (along > 0 && fabsf(beside) < half_width) {
+            clearance = fminf(clearance, along - vehicle->wheelbase_mm);
+        }
+    }
+
+    float room = clearance - CONTROL_STOP_MM;
+    float speed = room > 0 ? sqrtf(2 * CONTROL_DECEL_MM_S2 * room) : 0;
+    s_command.speed_mm_s = fminf(speed, s_cruise_mm_s);
+}
+
+static void s_act(void) {
+    lidar_set_speed((int32_t)s_encoder.speed_mm_s);
+
+    s_acted = s_command;
+    if (s_held >= CONTROL_HOLD_CYCLES) {
+        s_acted.speed_mm_s = 0;
+    }
+
+    // Not after control_stop() has braked the wheel
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (s_driving) {
+        wheel_set(s_acted.speed_mm_s);
+        servo_set(s_acted.steer_deg);
+    }
+    __set_PRIMASK(primask);
+}
+
+static void s_run(stage_t* stage) {
+    uint32_t start = cycles_now();
+
+    stage->run();
+
+    uint32_t cycles = cycles_now() - start;
+    prof_record(&stage->exec, cycles);
+    stage->runs++;
+    stage->overran = cycles > stage->budget_us * cycles_per_us();
+    stage->overruns += stage->overran;
+}
+
+/**
+ * @brief Curvature of the rear axle center in 1/mm, interpolated in the steering table
+ */
+static float s_curvature(float steer_deg) {
+    float index = fmaxf(fminf(steer_deg + GEOMETRY_STEER_MAX_DEG, GEOMETRY_STEER_STEPS - 1), 0);
+    uint8_t low = (uint8_t)index;
+    uint8_t high = low + 1 < GEOMETRY_STEER_STEPS ? low + 1 : low;
+    float   share = index - low;
+    const float* table = geometry_tables.steer_curvature;
+
+    return (table[low] + (table[high] - table[low]) * share) / 1000;
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Run one cycle, every stage in order unless planning is skipped
+ *
+ * @param trigger cycles_now() of the trigger, the latency to the start is recorded
+ */
+void control_cycle(uint32_t trigger) {
+    uint32_t start = cycles_now();
+    uint32_t period = CONTROL_PERIOD_US * cycles_per_us();
+
+    prof_record(&s_latency, start - trigger);
+    s_cycles++;
+    s_late += start - trigger > period / 2;
+
+    s_run(&s_stages[eCONTROL_SENSE]);
+    s_run(&s_stages[eCONTROL_ESTIMATE]);
+
+    stage_t* plan = &s_stages[eCONTROL_PLAN];
+    uint32_t needed = (plan->budget_us + s_stages[eCONTROL_ACT].budget_us) * cycles_per_us();
+    if (plan->overran || cycles_now() - trigger + needed > period) {
+        plan->overran = false;
+        plan->skips++;
+        s_held += s_held < CONTROL_HOLD_CYCLES;
+    } else {
+        s_run(plan);
+        s_held = 0;
+    }
+    if (s_driving) {
+        s_holds += s_held > 0 && s_held < CONTROL_HOLD_CYCLES;
+        s_stops += s_held >= CONTROL_HOLD_CYCLES || s_since_scan >= CONTROL_STALE_CYCLES;
+    }
+
+    s_run(&s_stages[eCONTROL_ACT]);
+    prof_record(&s_exec, cycles_now() - start);
+}
+
+/**
+ * @brief Drive, from the next plan on the plan sets the wheel speed and the steering
+ *
+ * @param cruise_mm_s Speed where the path is clear
+ */
+void control_start(float cruise_mm_s) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_cruise_mm_s = cruise_mm_s;
+    s_command.speed_mm_s = 0; // Standing until the first plan, not acting on one from before the stop
+    s_held = CONTROL_HOLD_CYCLES;
+    s_driving = true;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Stop driving, the wheel is braked to standstill and the steering left where it is
+ * The cycle keeps running, sensing and estimating.
+ */
+void control_stop(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_driving = false;
+    wheel_set(0);
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Change the budget of a stage, from the next cycle
+ *
+ * @return false if the stage does not exist
+ */
+bool control_set_budget(control_stage_e stage, uint32_t budget_us) {
+    if (stage >= eCONTROL_STAGES) {
+        return false;
+    }
+    s_stages[stage].budget_us = budget_us;
+    return true;
+}
+
+void control_get_stats(control_stats_t* stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    stats->driving = s_driving;
+    stats->cycles = s_cycles;
+    stats->late = s_late;
+    stats->holds = s_holds;
+    stats->stops = s_stops;
+    stats->command = s_acted;
+    for (uint8_t i = 0; i < eCONTROL_STAGES; i++) {
+        stats->stage[i] = (control_stage_stats_t){
+            .name = s_stages[i].name,
+            .budget_us = s_stages[i].budget_us,
+            .runs = s_stages[i].runs,
+            .overruns = s_stages[i].overruns,
+            .skips = s_stages[i].skips,
+        };
+    }
+    __set_PRIMASK(primask);
+
+    prof_get_stats(&s_latency, &stats->latency);
+    prof_get_stats(&s_exec, &stats->exec);
+    for (uint8_t i = 0; i < eCONTROL_STAGES; i++) {
+        prof_get_stats(&s_stages[i].exec, &stats->stage[i].exec);
+    }
+}
+
+void control_reset_stats(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_cycles = s_late = s_holds = s_stops = 0;
+    s_latency = (prof_scope_t){.name = s_latency.name};
+    s_exec = (prof_scope_t){.name = s_exec.name};
+    for (uint8_t i = 0; i < eCONTROL_STAGES; i++) {
+        stage_t* stage = &s_stages[i];
+        stage->runs = stage->overruns = stage->skips = 0;
+        stage->exec = (prof_scope_t){.name = stage->name};
+    }
+    __set_PRIMASK(primask);
+}
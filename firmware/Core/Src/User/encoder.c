@@ -0,0 +1,169 @@
+/**
+ * @file encoder.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Motor encoder, travel and speed of the wheels sampled at a fixed rate
+ * TIM3 counts the quadrature edges of channel A on PA6 and B on PA7 in encoder mode. Its capture on the
+ * rising edges of A is sent as TRGO pulse to TIM2, a free running 1 MHz 32 bit timer that captures the time
+ * on it. The counter and time of the last edge are so latched in hardware, no interrupt per edge.
+ * A TIM2 compare interrupt samples them at ENCODER_RATE_HZ and runs the M/T estimator of encoder_est.c.
+ * A listener runs in the same interrupt right after, with the sample fresh.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+#include "User/cycles.h"
+#include "User/encoder.h"
+#include "User/encoder_est.h"
+#include "User/geometry.h"
+
+#define TIMER_HZ  1000000
+#define PERIOD_US (TIMER_HZ / ENCODER_RATE_HZ)
+
+// ============= Private variables ===================
+static encoder_est_t      s_est;
+static uint32_t           s_stamp;
+static uint32_t           s_samples;
+static encoder_listener_t s_listener;
+
+// ============ Private function declaration =================
+static uint32_t s_timer_clock(void);
+static void     s_sample(encoder_sample_t* sample);
+
+//============ Private function implementation ===============
+static uint32_t s_timer_clock(void) {
+    // Timers on APB1 run at twice PCLK1 when the APB1 prescaler is not 1
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    return ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1) ? pclk1 : 2 * pclk1;
+}
+
+/**
+ * @brief Read the hardware state, an edge captured while reading is read again with its counter
+ */
+static void s_sample(encoder_sample_t* sample) {
+    uint32_t edge_us;
+
+    do {
+        edge_us = TIM2->CCR1;
+        sample->edge_count = TIM3->CCR1;
+        sample->count = TIM3->CNT;
+        sample->now_us = TIM2->CNT;
+    } while (TIM2->CCR1 != edge_us);
+    sample->edge_us = edge_us;
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Configure the pins and timers and start sampling
+ */
+void encoder_init(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_TIM2_CLK_ENABLE();
+    __HAL_RCC_TIM3_CLK_ENABLE();
+
+    GPIO_InitStruct.Pin = GPIO_PIN_6 | GPIO_PIN_7;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    GPIO_InitStruct.Alternate = GPIO_AF2_TIM3;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+    // TI1 and TI2 filtered over 8 samples at 96 MHz, counting on both edges of both channels.
+    // CC1 captures on rising TI1 and pulses TRGO.
+    TIM3->CR1 = 0;
+    TIM3->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0 | (3 << TIM_CCMR1_IC1F_Pos) | (3 << TIM_CCMR1_IC2F_Pos);
+    TIM3->CCER = TIM_CCER_CC1E;
+    TIM3->SMCR = TIM_SMCR_SMS_0 | TIM_SMCR_SMS_1;
+    TIM3->CR2 = TIM_CR2_MMS_0 | TIM_CR2_MMS_1;
+    TIM3->ARR = 0xFFFF;
+
+    // Captures TRC, ITR2 is TIM3 TRGO. CC2 compares for the sample interrupt.
+    TIM2->CR1 = 0;
+    TIM2->PSC = s_timer_clock() / TIMER_HZ - 1;
+    TIM2->ARR = 0xFFFFFFFF;
+    TIM2->SMCR = TIM_SMCR_TS_1;
+    TIM2->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC1S_1;
+    TIM2->CCER = TIM_CCER_CC1E;
+    TIM2->CCR2 = PERIOD_US;
+    TIM2->EGR = TIM_EGR_UG;
+    TIM2->SR = 0;
+    TIM2->DIER = TIM_DIER_CC2IE;
+
+    TIM3->CR1 = TIM_CR1_CEN;
+    TIM2->CR1 = TIM_CR1_CEN;
+    encoder_reset();
+
+    HAL_NVIC_SetPriority(TIM2_IRQn, ENCODER_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+}
+
+/**
+ * @brief Start counting the travel from 0 again
+ */
+void encoder_reset(void) {
+    encoder_sample_t sample;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_sample(&sample);
+    encoder_est_reset(&s_est, &sample);
+    s_samples = 0;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Get the latest sample, may be called from tasks and interrupts
+ *
+ * @param state Filled with the travel and speed
+ */
+void encoder_get(encoder_state_t* state) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    state->stamp = s_stamp;
+    state->samples = s_samples;
+    state->counts = s_est.position;
+    state->speed_mm_s = s_est.speed;
+    __set_PRIMASK(primask);
+
+    state->distance_mm = state->counts * geometry_tables.vehicle.mm_per_count;
+    state->speed_mm_s *= geometry_tables.vehicle.mm_per_count;
+}
+
+/**
+ * @brief Run a function with every sample, e.g. a control loop at the sample rate
+ *
+ * @param listener Called from the sample interrupt, NULL for none
+ */
+void encoder_set_listener(encoder_listener_t listener) {
+    s_listener = listener;
+}
+
+/**
+ * @brief Sample interrupt, the next compare is one period after the previous so the rate does not drift
+ */
+void TIM2_IRQHandler(void) {
+    encoder_sample_t sample;
+
+    TIM2->SR = ~TIM_SR_CC2IF;
+    TIM2->CCR2 += PERIOD_US;
+
+    s_sample(&sample);
+    encoder_est_update(&s_est, &sample);
+    s_stamp = cycles_now();
+    s_samples++;
+
+    if (s_listener != NULL) {
+        encoder_state_t state;
+        encoder_get(&state);
+        s_listener(&state);
+    }
+}
@@ -0,0 +1,68 @@
+/**
+ * @file encoder_est.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Position and speed of a quadrature encoder from periodic samples of its counter, M/T method
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/encoder_est.h"
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Start over at position 0 and standing still
+ *
+ * @param est Estimator
+ * @param sample Current hardware state, its edge is older than the reset and not used
+ */
+void encoder_est_reset(encoder_est_t* est, const encoder_sample_t* sample) {
+    *est = (encoder_est_t){0};
+    est->count = sample->count;
+    est->edge_us = sample->edge_us;
+}
+
+/**
+ * @brief Advance the estimate by one sample, call at a steady rate
+ * The counter may not move more than 32767 counts between two samples.
+ *
+ * @param est Estimator
+ * @param sample Hardware state, the edge must not be newer than the counter
+ */
+void encoder_est_update(encoder_est_t* est, const encoder_sample_t* sample) {
+    est->position += (int16_t)(sample->count - est->count);
+    est->count = sample->count;
+
+    if (sample->edge_us != est->edge_us) {
+        // Counts and time between the last captured edges of this and the previous sample with one
+        int32_t edge_position = est->position + (int16_t)(sample->edge_count - sample->count);
+        if (est->edge_valid) {
+            est->speed = (edge_position - est->edge_position) * 1e6f / (sample->edge_us - est->edge_us);
+        }
+        est->edge_valid = true;
+        est->edge_position = edge_position;
+        est->edge_us = sample->edge_us;
+        est->edges++;
+        return;
+    }
+
+    uint32_t wait_us = sample->now_us - est->edge_us;
+    if (!est->edge_valid || wait_us >= ENCODER_EST_STOP_US) {
+        // The next edge starts over, its time since a long gone edge says nothing
+        est->edge_valid = false;
+        est->speed = 0;
+        return;
+    }
+
+    float bound = ENCODER_EST_CAPTURE_COUNTS * 1e6f / wait_us;
+    if (est->speed > bound) {
+        est->speed = bound;
+    } else if (est->speed < -bound) {
+        est->speed = -bound;
+    }
+}
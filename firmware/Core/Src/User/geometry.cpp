@@ -0,0 +1,17 @@
+/**
+ * @file geometry.cpp
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Places the geometry tables generated from geometry.hpp in flash
+ * constinit makes the compiler evaluate the tables, a geometry that cannot be computed is a build error
+ * and never runs as a static constructor.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "User/geometry.h"
+#include "User/geometry.hpp"
+
+constinit const geometry_tables_t geometry_tables = geometry::tables();
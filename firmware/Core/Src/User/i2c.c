@@ -0,0 +1,547 @@
+/**
+ * @file i2c.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Interrupt and DMA driven I2C master on I2C1
+ * Transfers are queued and run back to back from the interrupts, the register index is sent from the
+ * event interrupt and the payload is moved by DMA1 (Stream6 TX, Stream0 RX, channel 1).
+ * The CPU is only involved a handful of times per transfer regardless of its length.
+ * There is a queue per priority, the next transfer is taken from the highest one with anything queued.
+ * i2c_poll() watches for transfers that never finish, clocks a stuck slave free and resets the peripheral.
+ * The HAL I2C module is not used, SCL on PB8 and SDA on PB9 are configured here.
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "main.h"
+
+#include "User/cycles.h"
+#include "User/i2c.h"
+
+#define DMA_RX DMA1_Stream0
+#define DMA_TX DMA1_Stream6
+
+#define DMA_RX_FLAGS                                                                                                   \
+    (DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0)
+#define DMA_TX_FLAGS                                                                                                   \
+    (DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6)
+
+#define I2C_SR1_ERRORS (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_AF | I2C_SR1_OVR | I2C_SR1_TIMEOUT)
+
+#define SCL_PIN          GPIO_PIN_8
+#define SDA_PIN          GPIO_PIN_9
+#define RECOVERY_HALF_US 5 // 100 kHz while clocking a slave free
+
+typedef enum {
+    eI2C_IDLE,
+    eI2C_START,    // Waiting for start condition
+    eI2C_ADDR,     // Waiting for address ACK, write direction
+    eI2C_REG,      // Register MSB sent, waiting to send LSB
+    eI2C_TX,       // Payload written by DMA, waiting for the last byte to leave
+    eI2C_RESTART,  // Register sent, waiting before the repeated start
+    eI2C_RX_START, // Waiting for repeated start condition
+    eI2C_RX_ADDR,  // Waiting for address ACK, read direction
+    eI2C_RX,       // Payload read by DMA
+} i2c_state_e;
+
+typedef struct
+{
+    i2c_xfer_t* head;
+    i2c_xfer_t* tail;
+} queue_t;
+
+// ============= Private variables ===================
+static queue_t              s_queues[eI2C_PRIO_COUNT];
+static i2c_xfer_t* volatile s_active; // Transfer on the bus
+static volatile i2c_state_e s_state = eI2C_IDLE;
+static volatile uint32_t    s_starts; // Transfers started on the bus
+static volatile bool        s_abort;  // The transfer on the bus hung, finish it from the error interrupt
+static uint32_t             s_watch_starts;
+static uint32_t             s_watch_ms; // s_starts was seen first
+static volatile uint32_t    s_recoveries;
+
+// Stats, cycle sums are converted when read
+static i2c_stats_t s_stats;
+static uint32_t    s_started; // cycles_now() when the transfer on the bus started
+static uint64_t    s_busy;
+static uint64_t    s_wait[eI2C_PRIO_COUNT];
+static uint32_t    s_wait_max[eI2C_PRIO_COUNT];
+static uint32_t    s_waited[eI2C_PRIO_COUNT];
+static uint32_t    s_since_ms;
+
+// ============ Private function declaration =================
+static void s_pins(uint32_t mode);
+static void s_configure(void);
+static void s_delay_us(uint32_t us);
+static void s_recover(void);
+static void s_dma_start(DMA_Stream_TypeDef* stream, uint8_t* data, uint16_t len);
+static void s_waited_for(const i2c_xfer_t* xfer, uint32_t now);
+static void s_start(void);
+static void s_finish(bool ok);
+
+//============ Private function implementation ===============
+static void s_pins(uint32_t mode) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    GPIO_InitStruct.Pin = SCL_PIN | SDA_PIN;
+    GPIO_InitStruct.Mode = mode;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Alternate = GPIO_AF4_I2C1;
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+}
+
+/**
+ * @brief Fast mode, duty 2:1, Thigh + Tlow = 3 * CCR * Tpclk1
+ */
+static void s_configure(void) {
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    I2C1->CR2 = (pclk1 / 1000000) | I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+    I2C1->CCR = I2C_CCR_FS | (pclk1 / (3 * I2C_SPEED_HZ));
+    I2C1->TRISE = (pclk1 / 1000000) * 300 / 1000 + 1; // 300 ns max rise time
+    I2C1->CR1 = I2C_CR1_PE;
+}
+
+static void s_delay_us(uint32_t us) {
+    uint32_t start = cycles_now();
+    uint32_t cycles = us * cycles_per_us();
+    while (cycles_now() - start < cycles) {
+    }
+}
+
+/**
+ * @brief Free the bus from a slave holding SDA low and reset I2C1
+ * A slave interrupted in the middle of a byte keeps driving it until it has been clocked out, then a stop
+ * condition ends whatever it thinks is going on. The reset clears a BUSY flag stuck after a glitch.
+ * Takes ~100 us with the I2C and DMA interrupts disabled.
+ */
+static void s_recover(void) {
+    DMA_RX->CR &= ~DMA_SxCR_EN;
+    DMA_TX->CR &= ~DMA_SxCR_EN;
+    I2C1->CR1 = 0;
+
+    HAL_GPIO_WritePin(GPIOB, SCL_PIN | SDA_PIN, GPIO_PIN_SET);
+    s_pins(GPIO_MODE_OUTPUT_OD);
+    for (uint8_t i = 0; i < I2C_RECOVERY_CLOCKS && HAL_GPIO_ReadPin(GPIOB, SDA_PIN) == GPIO_PIN_RESET; i++) {
+        HAL_GPIO_WritePin(GPIOB, SCL_PIN, GPIO_PIN_RESET);
+        s_delay_us(RECOVERY_HALF_US);
+        HAL_GPIO_WritePin(GPIOB, SCL_PIN, GPIO_PIN_SET);
+        s_delay_us(RECOVERY_HALF_US);
+    }
+
+    // Stop condition, SDA rises while SCL is high
+    HAL_GPIO_WritePin(GPIOB, SCL_PIN, GPIO_PIN_RESET);
+    s_delay_us(RECOVERY_HALF_US);
+    HAL_GPIO_WritePin(GPIOB, SDA_PIN, GPIO_PIN_RESET);
+    s_delay_us(RECOVERY_HALF_US);
+    HAL_GPIO_WritePin(GPIOB, SCL_PIN, GPIO_PIN_SET);
+    s_delay_us(RECOVERY_HALF_US);
+    HAL_GPIO_WritePin(GPIOB, SDA_PIN, GPIO_PIN_SET);
+    s_delay_us(RECOVERY_HALF_US);
+
+    s_pins(GPIO_MODE_AF_OD);
+    I2C1->CR1 = I2C_CR1_SWRST;
+    I2C1->CR1 = 0;
+    s_configure();
+}
+
+static void s_dma_start(DMA_Stream_TypeDef* stream, uint8_t* data, uint16_t len) {
+    stream->CR &= ~DMA_SxCR_EN;
+    while (stream->CR & DMA_SxCR_EN) {
+    }
+
+    if (stream == DMA_RX) {
+        DMA1->LIFCR = DMA_RX_FLAGS;
+    } else {
+        DMA1->HIFCR = DMA_TX_FLAGS;
+    }
+    stream->M0AR = (uint32_t)data;
+    stream->NDTR = len;
+    stream->CR |= DMA_SxCR_EN;
+}
+
+static void s_waited_for(const i2c_xfer_t* xfer, uint32_t now) {
+    uint32_t wait = now - xfer->queued;
+
+    s_wait[xfer->priority] += wait;
+    s_waited[xfer->priority]++;
+    if (wait > s_wait_max[xfer->priority]) {
+        s_wait_max[xfer->priority] = wait;
+    }
+}
+
+/**
+ * @brief Take the next transfer off the queues and start it, does nothing if they are empty
+ * The transfer is the head of the highest priority queue.
+ */
+static void s_start(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint8_t p = 0;
+    while (p < eI2C_PRIO_COUNT && s_queues[p].head == NULL) {
+        p++;
+    }
+    if (p == eI2C_PRIO_COUNT) {
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    queue_t*    queue = &s_queues[p];
+    i2c_xfer_t* xfer = queue->head;
+    uint32_t    now = cycles_now();
+    s_waited_for(xfer, now);
+
+    s_active = xfer;
+    queue->head = xfer->next;
+    if (queue->head == NULL) {
+        queue->tail = NULL;
+    }
+    xfer->next = NULL;
+    s_started = now;
+    s_starts++;
+    s_state = eI2C_START;
+    __set_PRIMASK(primask);
+
+    I2C1->CR1 |= I2C_CR1_START;
+}
+
+/**
+ * @brief Complete the transfer on the bus and start the next one
+ * 
+ * @param ok False if the transfer was aborted
+ */
+static void s_finish(bool ok) {
+    i2c_xfer_t* xfer = s_active;
+
+    I2C1->CR2 &= ~(I2C_CR2_DMAEN | I2C_CR2_LAST | I2C_CR2_ITBUFEN);
+    s_busy += cycles_now() - s_started;
+    s_active = NULL;
+    s_state = eI2C_IDLE;
+
+    // The callback may submit again, that starts the bus if the queues were empty
+    s_stats.transfers++;
+    s_stats.errors += !ok;
+    xfer->done(xfer, ok);
+
+    if (s_state == eI2C_IDLE) {
+        s_start();
+    }
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Configure I2C1 in fast mode, its pins and DMA streams
+ */
+void i2c_init(void) {
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    __HAL_RCC_I2C1_CLK_ENABLE();
+
+    s_pins(GPIO_MODE_AF_OD);
+    __HAL_RCC_I2C1_FORCE_RESET();
+    __HAL_RCC_I2C1_RELEASE_RESET();
+    s_configure();
+
+    DMA_RX->CR = 0;
+    DMA_RX->PAR = (uint32_t)&I2C1->DR;
+    DMA_RX->CR = DMA_SxCR_CHSEL_0 | DMA_SxCR_PL_1 | DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+
+    DMA_TX->CR = 0;
+    DMA_TX->PAR = (uint32_t)&I2C1->DR;
+    DMA_TX->CR = DMA_SxCR_CHSEL_0 | DMA_SxCR_PL_1 | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TEIE;
+
+    HAL_NVIC_SetPriority(I2C1_EV_IRQn, I2C_IRQ_PRIORITY, 0);
+    HAL_NVIC_SetPriority(I2C1_ER_IRQn, I2C_IRQ_PRIORITY, 0);
+    HAL_NVIC_SetPriority(DMA1_Stream0_IRQn, I2C_IRQ_PRIORITY, 0);
+    HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, I2C_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
+    HAL_NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+    HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+    i2c_reset_stats();
+}
+
+/**
+ * @brief Queue a transfer, may be called from tasks and interrupts
+ * The transfer must not be submitted again before its done callback.
+ * 
+ * @param xfer Transfer to queue
+ */
+void i2c_submit(i2c_xfer_t* xfer) {
+    queue_t* queue = &s_queues[xfer->priority];
+    xfer->next = NULL;
+    xfer->queued = cycles_now();
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (queue->tail) {
+        queue->tail->next = xfer;
+    } else {
+        queue->head = xfer;
+    }
+    queue->tail = xfer;
+    s_stats.queued[xfer->priority]++;
+    if (s_state == eI2C_IDLE) {
+        s_start();
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Check if the queues are empty
+ * 
+ * @return true if no transfer is queued or running
+ */
+bool i2c_is_idle(void) {
+    return s_active == NULL;
+}
+
+/**
+ * @brief Recover from a lockup, call periodically from a task
+ * A transfer seen on the bus by two calls at least I2C_STALL_MS apart has hung. The bus is freed and the
+ * transfer aborted, its done callback is called from the error interrupt and the queues carry on.
+ * 
+ * @param now_ms Monotonic time in milliseconds
+ */
+void i2c_poll(uint32_t now_ms) {
+    if (s_active == NULL || s_starts != s_watch_starts) {
+        s_watch_starts = s_starts;
+        s_watch_ms = now_ms;
+        return;
+    }
+    if (now_ms - s_watch_ms < I2C_STALL_MS) {
+        return;
+    }
+
+    HAL_NVIC_DisableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_DisableIRQ(I2C1_ER_IRQn);
+    HAL_NVIC_DisableIRQ(DMA1_Stream0_IRQn);
+    HAL_NVIC_DisableIRQ(DMA1_Stream6_IRQn);
+    if (s_active != NULL && s_starts == s_watch_starts) {
+        s_recover();
+        s_stats.recoveries++;
+        s_recoveries++;
+        s_abort = true;
+        HAL_NVIC_SetPendingIRQ(I2C1_ER_IRQn);
+    }
+    HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
+    HAL_NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+    HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+    s_watch_ms = now_ms;
+}
+
+/**
+ * @brief Get number of lockups recovered since boot, not cleared by i2c_reset_stats()
+ * Callers can tell a failed transfer from the victim of a lockup by comparing it before and after.
+ * 
+ * @return uint32_t Recoveries by i2c_poll()
+ */
+uint32_t i2c_get_recoveries(void) {
+    return s_recoveries;
+}
+
+/**
+ * @brief Get the bus statistics since i2c_reset_stats()
+ * The microsecond times wrap after 71 minutes.
+ * 
+ * @param stats Filled with a consistent snapshot
+ */
+void i2c_get_stats(i2c_stats_t* stats) {
+    uint64_t busy;
+    uint64_t wait[eI2C_PRIO_COUNT];
+    uint32_t waited[eI2C_PRIO_COUNT];
+    uint32_t per_us = cycles_per_us();
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = s_stats;
+    busy = s_busy;
+    for (uint8_t p = 0; p < eI2C_PRIO_COUNT; p++) {
+        wait[p] = s_wait[p];
+        waited[p] = s_waited[p];
+        stats->wait_max_us[p] = s_wait_max[p] / per_us;
+    }
+    __set_PRIMASK(primask);
+
+    stats->busy_us = busy / per_us;
+    stats->window_us = (HAL_GetTick() - s_since_ms) * 1000;
+    for (uint8_t p = 0; p < eI2C_PRIO_COUNT; p++) {
+        stats->wait_mean_us[p] = waited[p] ? wait[p] / waited[p] / per_us : 0;
+    }
+}
+
+void i2c_reset_stats(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(s_wait, 0, sizeof(s_wait));
+    memset(s_wait_max, 0, sizeof(s_wait_max));
+    memset(s_waited, 0, sizeof(s_waited));
+    s_busy = 0;
+    s_since_ms = HAL_GetTick();
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Event interrupt, walks a transfer through start, address and register phases
+ */
+void I2C1_EV_IRQHandler(void) {
+    uint32_t    sr1 = I2C1->SR1;
+    i2c_xfer_t* xfer = s_active;
+
+    if (xfer == NULL) {
+        // Stale flag after a stop, BTF is cleared by the stop condition
+        return;
+    }
+
+    switch (s_state) {
+        case eI2C_START:
+            if (sr1 & I2C_SR1_SB) {
+                I2C1->DR = xfer->address << 1;
+                s_state = eI2C_ADDR;
+            }
+            break;
+
+        case eI2C_ADDR:
+            if (sr1 & I2C_SR1_ADDR) {
+                (void)I2C1->SR2;
+                I2C1->DR = xfer->reg >> 8;
+                I2C1->CR2 |= I2C_CR2_ITBUFEN;
+                s_state = eI2C_REG;
+            }
+            break;
+
+        case eI2C_REG:
+            if (sr1 & I2C_SR1_TXE) {
+                I2C1->DR = xfer->reg & 0xFF;
+                I2C1->CR2 &= ~I2C_CR2_ITBUFEN;
+                if (xfer->read) {
+                    s_state = eI2C_RESTART;
+                } else {
+                    if (xfer->len) {
+                        s_dma_start(DMA_TX, xfer->data, xfer->len);
+                        I2C1->CR2 |= I2C_CR2_DMAEN;
+                    }
+                    s_state = eI2C_TX;
+                }
+            }
+            break;
+
+        case eI2C_TX:
+            // BTF with an empty DMA means the last byte is on the wire
+            if ((sr1 & I2C_SR1_BTF) && DMA_TX->NDTR == 0) {
+                I2C1->CR1 |= I2C_CR1_STOP;
+                s_finish(true);
+            }
+            break;
+
+        case eI2C_RESTART:
+            if (sr1 & I2C_SR1_BTF) {
+                I2C1->CR1 |= I2C_CR1_START;
+                s_state = eI2C_RX_START;
+            }
+            break;
+
+        case eI2C_RX_START:
+            if (sr1 & I2C_SR1_SB) {
+                s_dma_start(DMA_RX, xfer->data, xfer->len);
+                if (xfer->len > 1) {
+                    // DMA NACKs the last byte by itself
+                    I2C1->CR1 |= I2C_CR1_ACK;
+                    I2C1->CR2 |= I2C_CR2_DMAEN | I2C_CR2_LAST;
+                } else {
+                    I2C1->CR1 &= ~I2C_CR1_ACK;
+                    I2C1->CR2 |= I2C_CR2_DMAEN;
+                }
+                I2C1->DR = (xfer->address << 1) | 1;
+                s_state = eI2C_RX_ADDR;
+            }
+            break;
+
+        case eI2C_RX_ADDR:
+            if (sr1 & I2C_SR1_ADDR) {
+                (void)I2C1->SR2;
+                if (xfer->len == 1) {
+                    I2C1->CR1 |= I2C_CR1_STOP;
+                }
+                s_state = eI2C_RX;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Error interrupt, NACK, lost arbitration and bus errors abort the transfer
+ */
+void I2C1_ER_IRQHandler(void) {
+    uint32_t errors = I2C1->SR1 & I2C_SR1_ERRORS;
+    I2C1->SR1 = ~errors & 0xFFFF; // Error flags are cleared by writing 0
+
+    if (s_abort) {
+        // Pended by i2c_poll() after the bus was recovered, the transfer that hung is over
+        s_abort = false;
+        if (s_active != NULL) {
+            s_finish(false);
+        }
+        return;
+    }
+    if (s_active == NULL || s_state == eI2C_IDLE) {
+        return;
+    }
+
+    DMA_RX->CR &= ~DMA_SxCR_EN;
+    DMA_TX->CR &= ~DMA_SxCR_EN;
+    if (!(errors & I2C_SR1_ARLO)) {
+        // The bus is released by hardware when arbitration is lost
+        I2C1->CR1 |= I2C_CR1_STOP;
+    }
+    s_finish(false);
+}
+
+/**
+ * @brief DMA RX complete, all bytes of a read are in memory
+ */
+void DMA1_Stream0_IRQHandler(void) {
+    uint32_t lisr = DMA1->LISR;
+    DMA1->LIFCR = DMA_RX_FLAGS;
+
+    if (s_active == NULL || s_state != eI2C_RX) {
+        return;
+    }
+
+    if (lisr & DMA_LISR_TEIF0) {
+        I2C1->CR1 |= I2C_CR1_STOP;
+        s_finish(false);
+    } else if (lisr & DMA_LISR_TCIF0) {
+        if (s_active->len > 1) {
+            I2C1->CR1 |= I2C_CR1_STOP;
+        }
+        s_finish(true);
+    }
+}
+
+/**
+ * @brief DMA TX error, completion is handled on BTF in the event interrupt
+ */
+void DMA1_Stream6_IRQHandler(void) {
+    uint32_t hisr = DMA1->HISR;
+    DMA1->HIFCR = DMA_TX_FLAGS;
+
+    if (s_active != NULL && s_state == eI2C_TX && (hisr & DMA_HISR_TEIF6)) {
+        I2C1->CR1 |= I2C_CR1_STOP;
+        s_finish(false);
+    }
+}
@@ -0,0 +1,924 @@
+/**
+ * @file lidar.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief The five VL53L1X sensors on the lidar flex board
+ * All sensors share I2C1 and start at the same address. They are held in reset with XSHUT and
+ * released one at a time, each one gets a unique address before the next is released.
+ * Everything after lidar_init() runs from the I2C and GPIO1 (EXTI) interrupts, only the polls of a sensor
+ * waiting for its boot or first measurement are paced by lidar_poll().
+ * 
+ * Ranging is scheduled in slots. Neighbouring sensors see each other's emitter, so only sensors
+ * that are not adjacent range in the same slot, each with a single shot. When the last result of
+ * a group arrives the next group is triggered first and the result is read while it ranges, the bus
+ * work of one slot is hidden in the next. The order of emitters is the same every scan.
+ * 
+ * With more than one zone each sensor ranges once per zone and scan, with the region of interest
+ * moved across the SPAD array. Every zone is a narrower beam, more zones give a finer scan at a
+ * lower rate. A full scan takes zones * LIDAR_GROUPS timing budgets plus the bus writes.
+ * 
+ * The distance mode and timing budget follow the vehicle speed, see lidar_regime_e. A new regime is
+ * taken at the start of a scan and written to each sensor before its first shot of that scan, the
+ * sensor is idle then so no measurement or frame is lost. Only that slot gets longer by the writes.
+ * 
+ * Results are assembled into a scan frame. The last slot of a scan is still being read when the next
+ * scan starts ranging, so there are two frames and every shot remembers which one it belongs to.
+ * A frame is copied once into the scan topic when all of its shots have been read, after the ranges
+ * have been validated and filtered, see lidar_filter.h. Every reader is a subscriber, see bus.h.
+ * 
+ * The offset and crosstalk calibration of each sensor is kept in flash, see nvm.h, and written to
+ * the sensor when it boots. A calibration ranges one sensor against a target at a known distance
+ * while the schedule is stopped, with the same averaging and formulas as the ULD.
+ * 
+ * A sensor can drop off the bus or go bad mid-race. lidar_poll() times out a slot that a sensor never
+ * finishes so the others keep ranging, see lidar_health_t. A sensor with too many errors or stuck results
+ * is taken out of the schedule and held in reset, groups without a working sensor are skipped so the rest
+ * keep their rate. It is rebooted alone at the default address after a delay that doubles with every attempt,
+ * and never sooner than LIDAR_REBOOT_SPACING_MS after the last attempt of any sensor.
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "main.h"
+
+#include "User/bus.h"
+#include "User/cycles.h"
+#include "User/geometry.h"
+#include "User/i2c.h"
+#include "User/lidar.h"
+#include "User/lidar_filter.h"
+#include "User/nvm.h"
+#include "User/prof.h"
+#include "User/vl53l1x.h"
+
+#define SPADS_CENTER   199                       // Region of interest center of a calibration
+#define CALIB_ATTEMPTS (2 * LIDAR_CALIB_SAMPLES) // Measurements before a calibration gives up
+
+typedef struct
+{
+    GPIO_TypeDef* xshut_port;
+    uint16_t      xshut_pin;
+    uint16_t      int_pin; // GPIO1, EXTI line
+} lidar_pins_t;
+
+typedef struct
+{
+    lidar_scan_t scan;
+    uint8_t      expected; // Shots fired for the scan, 0 once published
+    uint8_t      received; // Shots read or failed
+    bool         closed;   // All slots of the scan have been fired
+} lidar_frame_t;
+
+typedef struct
+{
+    volatile uint8_t state; // lidar_calib_state_e
+    uint8_t          sensor;
+    uint8_t          kind; // lidar_calib_e
+    uint16_t         target_mm;
+    uint8_t          samples;  // Valid ranges
+    uint8_t          attempts; // Measurements
+    uint32_t         distance_sum;
+    uint32_t         signal_sum;
+    uint32_t         spads_sum;
+} calibration_t;
+
+typedef struct
+{
+    uint8_t  same;         // Identical valid results in a row
+    uint8_t  results;      // Valid results since the last boot, up to LIDAR_HEALTH_STUCK
+    uint16_t distance_mm;  // Of the last valid result
+    uint16_t signal_kcps;
+    uint16_t ambient_kcps;
+    bool     armed;        // Reboot time set
+    uint32_t reboot_ms;    // lidar_poll() time of the next reboot attempt
+} monitor_t;
+
+// ============= Private variables ===================
+// Sensors are mounted in a fan in index order, neighbours never range at the same time
+static const uint8_t s_groups[LIDAR_GROUPS] = {
+    (1 << 0) | (1 << 2) | (1 << 4),
+    (1 << 1) | (1 << 3),
+};
+
+static const lidar_pins_t s_pins[LIDAR_COUNT] = {
+    {LIDAR1_XSHUT_GPIO_Port, LIDAR1_XSHUT_Pin, LIDAR1_INT_Pin},
+    {LIDAR2_XSHUT_GPIO_Port, LIDAR2_XSHUT_Pin, LIDAR2_INT_Pin},
+    {LIDAR3_XSHUT_GPIO_Port, LIDAR3_XSHUT_Pin, LIDAR3_INT_Pin},
+    {LIDAR4_XSHUT_GPIO_Port, LIDAR4_XSHUT_Pin, LIDAR4_INT_Pin},
+    {LIDAR5_XSHUT_GPIO_Port, LIDAR5_XSHUT_Pin, LIDAR5_INT_Pin},
+};
+
+static vl53l1x_t         s_sensors[LIDAR_COUNT];
+static lidar_range_t     s_ranges[LIDAR_BEAMS_MAX];
+static volatile uint32_t s_stamps[LIDAR_COUNT]; // Time of the last data ready interrupt
+static uint8_t           s_beams[LIDAR_COUNT];  // Beam of the measurement in progress
+static uint8_t           s_shots[LIDAR_COUNT];  // Frame of the measurement in progress
+static volatile bool     s_booted;
+
+static volatile bool    s_running;
+static uint8_t          s_slot;           // Slot ranging now, zone * LIDAR_GROUPS + group
+static volatile uint8_t s_waiting;        // Sensors of the slot without a result yet
+static volatile uint8_t s_zones = 1;      // Beams per sensor
+static volatile uint8_t s_zones_next = 1; // Applied when the scan wraps
+static volatile uint8_t s_regime;         // lidar_regime_e of the scan ranging now
+static volatile uint8_t s_regime_next;    // Applied when the scan wraps
+static uint32_t         s_slot_stamp;     // Slot was triggered
+static uint32_t         s_scan_stamp;     // Scan started
+static lidar_schedule_t s_schedule;
+
+static volatile bool     s_enabled; // Schedule wanted, lidar_poll() restarts it when a sensor comes back
+static volatile uint8_t  s_open;    // Sensors with a shot that has not been read or timed out
+static volatile uint32_t s_fired;   // Slots fired, a slot that stays the same too long times out
+static uint32_t          s_poll_fired;
+static uint32_t          s_poll_ms;         // lidar_poll() time s_fired last changed
+static uint32_t          s_bus_recoveries;  // i2c_get_recoveries() seen by lidar_poll()
+static volatile uint32_t s_slot_recoveries; // i2c_get_recoveries() when the slot was fired
+static lidar_health_t    s_health[LIDAR_COUNT];
+static monitor_t         s_monitors[LIDAR_COUNT];
+static bool              s_rebooting;   // A sensor was booting at the last lidar_poll()
+static uint32_t          s_rebooted_ms; // lidar_poll() time the last boot attempt of any sensor ended
+
+static lidar_frame_t  s_frames[2];
+static uint8_t        s_frame; // Frame of the scan ranging now
+static uint32_t       s_sequence;
+static lidar_filter_t s_filter;
+static BUS_LATEST(s_scans, "lidar_scans", lidar_scan_t, eLIDAR_READERS);
+
+static lidar_calib_t s_calib; // Written to the sensors at boot
+static calibration_t s_calibration;
+
+static const lidar_regime_t s_regimes[eLIDAR_REGIMES] = {
+    [eLIDAR_REGIME_PRECISE] = {"precise", 0, eVL53L1X_LONG, 100},
+    [eLIDAR_REGIME_CRUISE] = {"cruise", 300, eVL53L1X_LONG, 33},
+    [eLIDAR_REGIME_FAST] = {"fast", 1500, eVL53L1X_SHORT, 20},
+};
+
+static const lidar_filter_config_t s_filter_config = {
+    .accept = 1 << 0, // Range valid only
+    .min_signal_kcps = 200,
+    .max_mm = 4000,
+    .alpha = 128,
+};
+
+// ============ Private function declaration =================
+static void    s_boot(uint8_t index);
+static void    s_event(vl53l1x_t* dev, vl53l1x_event_e event);
+static void    s_calibrate(vl53l1x_t* dev, vl53l1x_event_e event);
+static void    s_remove(uint8_t index);
+static void    s_penalize(uint8_t index, uint8_t cost);
+static void    s_check_result(uint8_t index, const vl53l1x_result_t* result);
+static void    s_timeout(void);
+static void    s_apply_zones(void);
+static void    s_begin_frame(void);
+static void    s_publish(lidar_frame_t* frame);
+static void    s_fire(uint8_t slot);
+static void    s_slot_done(uint32_t now);
+
+//============ Private function implementation ===============
+/**
+ * @brief Release the sensor from reset and boot it, the rest follow from the boot event
+ */
+static void s_boot(uint8_t index) {
+    HAL_GPIO_WritePin(s_pins[index].xshut_port, s_pins[index].xshut_pin, GPIO_PIN_SET);
+    vl53l1x_boot(&s_sensors[index], LIDAR_BASE_ADDRESS + index);
+}
+
+static void s_event(vl53l1x_t* dev, vl53l1x_event_e event) {
+    uint8_t index = (uint8_t)(uintptr_t)dev->context;
+
+    switch (event) {
+        case eVL53L1X_EVT_BOOT_FAILED:
+            // Still at the default address, the reset keeps it from answering for the next sensor
+            s_remove(index);
+            // fall through
+        case eVL53L1X_EVT_BOOTED:
+            if (event == eVL53L1X_EVT_BOOTED) {
+                vl53l1x_set_timing(dev, s_regimes[s_regime].mode, s_regimes[s_regime].budget_ms);
+                if (s_calib.offset_valid & (1 << index)) {
+                    vl53l1x_set_offset(dev, s_calib.offset_mm[index]);
+                }
+                if (s_calib.xtalk_valid & (1 << index)) {
+                    vl53l1x_set_xtalk(dev, s_calib.xtalk_cps[index]);
+                }
+                if (s_health[index].state == eLIDAR_HEALTH_REBOOTING) {
+                    s_health[index].recoveries++;
+                }
+                s_health[index].state = eLIDAR_HEALTH_OK;
+                s_health[index].score = 0;
+                memset(&s_monitors[index], 0, sizeof(monitor_t));
+            }
+            if (s_booted) {
+                break; // Rebooted by lidar_poll(), joins the schedule with the next slot of its group
+            }
+            if (index + 1 < LIDAR_COUNT) {
+                s_boot(index + 1);
+            } else {
+                s_booted = true;
+                lidar_start();
+            }
+            break;
+
+        case eVL53L1X_EVT_RESULT:
+        case eVL53L1X_EVT_READ_FAILED: {
+            if (s_calibration.state == eLIDAR_CALIB_RUNNING && s_calibration.sensor == index) {
+                s_calibrate(dev, event);
+                break;
+            }
+
+            if (!(s_open & (1 << index))) {
+                break; // Late result of a shot that timed out
+            }
+            s_open &= ~(1 << index);
+
+            lidar_frame_t* frame = &s_frames[s_shots[index]];
+            uint8_t        beam = s_beams[index];
+
+            if (event == eVL53L1X_EVT_READ_FAILED) {
+                s_health[index].read_errors++;
+                // Aborted by a bus recovery, not the fault of the sensor
+                if (i2c_get_recoveries() == s_slot_recoveries) {
+                    s_penalize(index, LIDAR_HEALTH_READ_COST);
+                }
+            } else {
+                s_check_result(index, &dev->result);
+                frame->scan.status[beam] = dev->result.status;
+                frame->scan.distance_mm[beam] = dev->result.distance_mm;
+                frame->scan.signal_kcps[beam] = dev->result.signal_kcps;
+                frame->scan.capture[beam] = s_stamps[index];
+
+                // The beam means something else if the zones changed after the shot
+                if (frame->scan.beams == lidar_get_beam_count()) {
+                    lidar_range_t* range = &s_ranges[beam];
+                    range->result = dev->result;
+                    range->period = range->count ? s_stamps[index] - range->stamp : 0;
+                    range->stamp = s_stamps[index];
+                    range->count++;
+                }
+            }
+            frame->received++;
+            s_publish(frame);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Add a measurement of the sensor being calibrated, trigger the next until there are enough
+ * Offset as VL53L1X_CalibrateOffset() and crosstalk as VL53L1X_CalibrateXtalk() in the ULD.
+ */
+static void s_calibrate(vl53l1x_t* dev, vl53l1x_event_e event) {
+    calibration_t* cal = &s_calibration;
+    uint8_t        sensor = cal->sensor;
+
+    cal->attempts++;
+    if (event == eVL53L1X_EVT_RESULT && dev->result.status == 0) {
+        cal->samples++;
+        cal->distance_sum += dev->result.distance_mm;
+        cal->signal_sum += dev->result.signal_kcps;
+        cal->spads_sum += dev->result.spads;
+    }
+
+    if (cal->samples < LIDAR_CALIB_SAMPLES) {
+        if (cal->attempts < CALIB_ATTEMPTS) {
+            vl53l1x_trigger(dev);
+        } else {
+            cal->state = eLIDAR_CALIB_FAILED;
+        }
+        return;
+    }
+
+    float distance = (float)cal->distance_sum / cal->samples;
+    if (cal->kind == eLIDAR_CALIB_OFFSET) {
+        s_calib.offset_mm[sensor] = (int16_t)(cal->target_mm - distance + 0.5f);
+        s_calib.offset_valid |= 1 << sensor;
+        vl53l1x_set_offset(dev, s_calib.offset_mm[sensor]);
+    } else {
+        // Share of the signal coming from the cover glass, per SPAD
+        float xtalk = (float)cal->signal_sum / cal->spads_sum * (1.0f - distance / cal->target_mm) * 1000.0f;
+        xtalk = xtalk < 0 ? 0 : xtalk > UINT16_MAX ? UINT16_MAX : xtalk;
+        s_calib.xtalk_cps[sensor] = (uint16_t)xtalk;
+        s_calib.xtalk_valid |= 1 << sensor;
+        vl53l1x_set_xtalk(dev, s_calib.xtalk_cps[sensor]);
+    }
+    cal->state = eLIDAR_CALIB_DONE;
+}
+
+/**
+ * @brief Take a sensor out of the schedule and hold it in reset, lidar_poll() reboots it later
+ * Gives up on it once it has used all its reboots without working in between.
+ */
+static void s_remove(uint8_t index) {
+    lidar_health_t* health = &s_health[index];
+
+    if (health->state == eLIDAR_HEALTH_OK) {
+        health->removals++;
+    }
+    health->state = health->reboots < LIDAR_REBOOTS ? eLIDAR_HEALTH_REMOVED : eLIDAR_HEALTH_FAILED;
+    s_monitors[index].armed = false;
+    HAL_GPIO_WritePin(s_pins[index].xshut_port, s_pins[index].xshut_pin, GPIO_PIN_RESET);
+}
+
+static void s_penalize(uint8_t index, uint8_t cost) {
+    lidar_health_t* health = &s_health[index];
+
+    if (health->state == eLIDAR_HEALTH_OK) {
+        health->score += cost;
+        if (health->score >= LIDAR_HEALTH_LIMIT) {
+            s_remove(index);
+        }
+    }
+}
+
+/**
+ * @brief A valid result takes the error score down, the same result over and over means the sensor is stuck
+ * Noise changes the range or the rates of a working sensor between two measurements.
+ */
+static void s_check_result(uint8_t index, const vl53l1x_result_t* result) {
+    lidar_health_t* health = &s_health[index];
+    monitor_t*      monitor = &s_monitors[index];
+
+    if (result->status != 0) {
+        return;
+    }
+
+    bool same = monitor->results && result->distance_mm == monitor->distance_mm &&
+                result->signal_kcps == monitor->signal_kcps && result->ambient_kcps == monitor->ambient_kcps;
+    monitor->same = same ? monitor->same + 1 : 1;
+    if (monitor->same >= LIDAR_HEALTH_STUCK) {
+        health->stuck++;
+        s_remove(index);
+        return;
+    }
+
+    monitor->distance_mm = result->distance_mm;
+    monitor->signal_kcps = result->signal_kcps;
+    monitor->ambient_kcps = result->ambient_kcps;
+    if (health->score) {
+        health->score--;
+    }
+    if (monitor->results < LIDAR_HEALTH_STUCK && ++monitor->results == LIDAR_HEALTH_STUCK) {
+        health->reboots = 0; // Works again, a later failure gets the full number of reboots
+    }
+}
+
+/**
+ * @brief Some sensors of the slot never signalled a result, count their shots as failed and move on
+ */
+static void s_timeout(void) {
+    uint8_t late = s_waiting;
+
+    s_waiting = 0;
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        if (!(late & (1 << i))) {
+            continue;
+        }
+        s_health[i].timeouts++;
+        if (i2c_get_recoveries() == s_slot_recoveries) {
+            s_penalize(i, LIDAR_HEALTH_TIMEOUT_COST); // A lockup during the slot may have lost the shot
+        }
+        if (s_open & (1 << i)) {
+            s_open &= ~(1 << i);
+            s_frames[s_shots[i]].received++;
+            s_publish(&s_frames[s_shots[i]]);
+        }
+    }
+    s_slot_done(cycles_now());
+}
+
+/**
+ * @brief Beams change meaning with the number of zones, drop the old ranges
+ */
+static void s_apply_zones(void) {
+    s_zones = s_zones_next;
+    memset(s_ranges, 0, sizeof(s_ranges));
+}
+
+/**
+ * @brief Switch to the other frame for the shots of the next scan
+ * It was published long ago unless a sensor stopped answering.
+ */
+static void s_begin_frame(void) {
+    s_frame ^= 1;
+    lidar_frame_t* frame = &s_frames[s_frame];
+
+    if (frame->expected) {
+        s_schedule.dropped++;
+    }
+    frame->expected = 0;
+    frame->received = 0;
+    frame->closed = false;
+    frame->scan.beams = LIDAR_COUNT * s_zones;
+    memset(frame->scan.status, LIDAR_STATUS_NONE, sizeof(frame->scan.status));
+}
+
+/**
+ * @brief Copy the frame to every reader once all shots of its scan have been read
+ */
+static void s_publish(lidar_frame_t* frame) {
+    if (!frame->closed || frame->received < frame->expected) {
+        return;
+    }
+
+    frame->scan.sequence = ++s_sequence;
+    frame->scan.stamp = cycles_now();
+    {
+        PROF_SCOPE("lidar_filter");
+        lidar_filter_run(&s_filter, &frame->scan);
+    }
+    memcpy(bus_claim(&s_scans), &frame->scan, sizeof(lidar_scan_t));
+    bus_publish(&s_scans);
+    frame->expected = 0;
+    frame->closed = false;
+    s_schedule.published++;
+}
+
+/**
+ * @brief Move the region of interest to the zone of the slot and trigger a single shot on every working
+ * sensor of its group. Groups without a working sensor are skipped, the schedule stops if no sensor works.
+ */
+static void s_fire(uint8_t slot) {
+    uint8_t slots = s_zones * LIDAR_GROUPS;
+
+    for (uint8_t tries = 0; tries < slots; tries++) {
+        uint8_t group = slot % LIDAR_GROUPS;
+        uint8_t zone = slot / LIDAR_GROUPS;
+        uint8_t mask = 0;
+        for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+            uint8_t state = s_sensors[i].state;
+            bool    working = (state == eVL53L1X_IDLE || state == eVL53L1X_RANGING) &&
+                              s_health[i].state == eLIDAR_HEALTH_OK;
+            if ((s_groups[group] & (1 << i)) && working) {
+                mask |= 1 << i;
+            }
+        }
+
+        if (mask) {
+            const lidar_regime_t* regime = &s_regimes[s_regime];
+            const lidar_beam_t*   beam = &geometry_tables.beams[s_zones - 1][zone]; // Same region on every sensor
+
+            s_slot = slot;
+            s_waiting = mask;
+            s_open |= mask;
+            s_fired++;
+            s_slot_stamp = cycles_now();
+            s_slot_recoveries = i2c_get_recoveries();
+            for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+                if (mask & (1 << i)) {
+                    vl53l1x_set_timing(&s_sensors[i], regime->mode, regime->budget_ms);
+                    vl53l1x_set_roi(&s_sensors[i], beam->roi_center, beam->roi_width, LIDAR_SPADS);
+                    s_beams[i] = i * s_zones + zone;
+                    s_shots[i] = s_frame;
+                    s_frames[s_frame].expected++;
+                    vl53l1x_trigger(&s_sensors[i]);
+                }
+            }
+            return;
+        }
+        slot = (slot + 1) % slots;
+    }
+    s_running = false;
+}
+
+/**
+ * @brief All sensors of the slot have finished their measurement, start the next slot
+ */
+static void s_slot_done(uint32_t now) {
+    uint8_t next = s_slot + 1;
+
+    s_schedule.slot_period[s_slot % LIDAR_GROUPS] = now - s_slot_stamp;
+    if (next == s_zones * LIDAR_GROUPS) {
+        next = 0;
+        s_schedule.scans++;
+        s_schedule.scan_period = now - s_scan_stamp;
+        s_schedule.regime_scans[s_regime]++;
+        s_schedule.regime_us[s_regime] += s_schedule.scan_period / cycles_per_us();
+        s_scan_stamp = now;
+
+        s_frames[s_frame].closed = true;
+        s_publish(&s_frames[s_frame]);
+        if (s_zones_next != s_zones) {
+            s_apply_zones();
+        }
+        if (s_regime_next != s_regime) {
+            s_regime = s_regime_next;
+            s_schedule.switches++;
+        }
+        s_begin_frame();
+    }
+    s_fire(next);
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Start the boot sequence, returns right away
+ * Ranging starts on all sensors that booted once the last sensor is done.
+ */
+void lidar_init(void) {
+    i2c_init();
+
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        HAL_GPIO_WritePin(s_pins[i].xshut_port, s_pins[i].xshut_pin, GPIO_PIN_RESET);
+        vl53l1x_init(&s_sensors[i], s_event, (void*)(uintptr_t)i);
+    }
+    lidar_filter_init(&s_filter, &s_filter_config);
+    if (!nvm_read(eNVM_LIDAR_CALIB, &s_calib, sizeof(s_calib))) {
+        memset(&s_calib, 0, sizeof(s_calib));
+    }
+    s_calibration.state = eLIDAR_CALIB_IDLE;
+    memset(s_health, 0, sizeof(s_health));
+    memset(s_monitors, 0, sizeof(s_monitors));
+    s_enabled = false;
+
+    s_booted = false;
+    s_rebooting = true; // The boot sequence counts as an attempt, reboots rest after it
+    s_boot(0);
+}
+
+/**
+ * @brief Start the ranging schedule on all booted sensors
+ */
+void lidar_start(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_enabled = true;
+    if (!s_running) {
+        s_running = true;
+        s_scan_stamp = cycles_now();
+        // A scan cut short by lidar_stop() is never completed, it is not a dropped scan
+        s_frames[0].expected = 0;
+        s_frames[1].expected = 0;
+        s_open = 0;
+        s_begin_frame();
+        s_fire(0);
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Stop the schedule and abort the measurements in progress
+ */
+void lidar_stop(void) {
+    s_enabled = false;
+    s_running = false;
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        vl53l1x_stop(&s_sensors[i]);
+    }
+}
+
+/**
+ * @brief Health monitoring, call every LIDAR_POLL_MS from a task
+ * Recovers the I2C bus from lockups, polls booting sensors, times out a slot that a sensor never finishes,
+ * reboots removed sensors one at a time and restarts the schedule if it stopped for lack of working sensors.
+ * 
+ * @param now_ms Monotonic time in milliseconds, e.g. HAL_GetTick()
+ */
+void lidar_poll(uint32_t now_ms) {
+    // The lidar owns the bus. A lockup delays every sensor waiting on it, the slot gets its time again.
+    i2c_poll(now_ms);
+    uint32_t recoveries = i2c_get_recoveries();
+    bool     recovered = recoveries != s_bus_recoveries;
+    s_bus_recoveries = recoveries;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t timeout_ms = s_regimes[s_regime].budget_ms + LIDAR_TIMEOUT_MARGIN_MS;
+    if (recovered || s_fired != s_poll_fired || !s_running || !s_waiting) {
+        s_poll_fired = s_fired;
+        s_poll_ms = now_ms;
+    } else if (now_ms - s_poll_ms > timeout_ms) {
+        s_timeout();
+    }
+    __set_PRIMASK(primask);
+
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        vl53l1x_poll(&s_sensors[i], now_ms);
+    }
+
+    if (!s_booted) {
+        return; // Sensors that fail to boot are retried once the boot sequence is done
+    }
+
+    // Only one sensor may be out of reset at the default address. A missing sensor fails every read of its
+    // boot, the bus rests for LIDAR_REBOOT_SPACING_MS after each attempt so they do not follow back to back.
+    bool rebooting = false;
+    bool working = false;
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        rebooting |= s_health[i].state == eLIDAR_HEALTH_REBOOTING;
+    }
+    if (s_rebooting && !rebooting) {
+        s_rebooted_ms = now_ms;
+    }
+    s_rebooting = rebooting;
+    bool rested = now_ms - s_rebooted_ms >= LIDAR_REBOOT_SPACING_MS;
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        lidar_health_t* health = &s_health[i];
+        monitor_t*      monitor = &s_monitors[i];
+
+        if (health->state == eLIDAR_HEALTH_REMOVED && !monitor->armed) {
+            monitor->reboot_ms = now_ms + (LIDAR_REBOOT_DELAY_MS << health->reboots);
+            monitor->armed = true;
+        } else if (health->state == eLIDAR_HEALTH_REMOVED && !rebooting && rested &&
+                   (int32_t)(now_ms - monitor->reboot_ms) >= 0 && vl53l1x_reset(&s_sensors[i])) {
+            health->reboots++;
+            health->state = eLIDAR_HEALTH_REBOOTING;
+            rebooting = true;
+            s_rebooting = true;
+            s_boot(i); // Low I2C priority until it ranges, see vl53l1x.c
+        }
+        working |= health->state == eLIDAR_HEALTH_OK;
+    }
+
+    if (s_enabled && !s_running && working) {
+        lidar_start();
+    }
+}
+
+/**
+ * @brief Check if the boot sequence has finished, sensors that failed are left in reset
+ * 
+ * @return true when all sensors have been booted or given up on
+ */
+bool lidar_is_booted(void) {
+    return s_booted;
+}
+
+/**
+ * @brief Set the number of beams per sensor, trades scan rate for angular resolution
+ * Takes effect at the start of the next scan, the ranges of all beams are cleared.
+ * 
+ * @param zones 1 to LIDAR_ZONES_MAX
+ * @return false if zones is out of range
+ */
+bool lidar_set_zones(uint8_t zones) {
+    if (zones < 1 || zones > LIDAR_ZONES_MAX) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_zones_next = zones;
+    if (!s_running) {
+        s_apply_zones();
+    }
+    __set_PRIMASK(primask);
+    return true;
+}
+
+/**
+ * @brief Pick the regime for the vehicle speed, commanded or measured
+ * Faster regimes are entered at their speed and left LIDAR_REGIME_HYSTERESIS_MM_S below it, the
+ * change takes effect at the start of the next scan. Call it whenever the speed changes.
+ * 
+ * @param speed_mm_s Speed in either direction
+ */
+void lidar_set_speed(int32_t speed_mm_s) {
+    int32_t speed = speed_mm_s < 0 ? -speed_mm_s : speed_mm_s;
+    uint8_t regime = s_regime_next;
+
+    while (regime + 1 < eLIDAR_REGIMES && speed >= s_regimes[regime + 1].speed_mm_s) {
+        regime++;
+    }
+    while (regime > 0 && speed + LIDAR_REGIME_HYSTERESIS_MM_S < s_regimes[regime].speed_mm_s) {
+        regime--;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_regime_next = regime;
+    if (!s_running) {
+        s_regime = regime;
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Get the distance mode and timing budget of a regime
+ * 
+ * @param regime Regime
+ * @return const lidar_regime_t* Regime, NULL if out of range
+ */
+const lidar_regime_t* lidar_get_regime(lidar_regime_e regime) {
+    return regime < eLIDAR_REGIMES ? &s_regimes[regime] : NULL;
+}
+
+/**
+ * @brief Get the number of beams in a scan, beams are ordered counter clockwise
+ */
+uint8_t lidar_get_beam_count(void) {
+    return LIDAR_COUNT * s_zones;
+}
+
+/**
+ * @brief Get the geometry of a beam, looked up in the tables generated from geometry.hpp
+ * 
+ * @param beam Beam index
+ * @param info Sensor, zone, region of interest, direction and mount of the beam
+ * @return false if beam is out of range
+ */
+bool lidar_get_beam(uint8_t beam, lidar_beam_t* info) {
+    uint8_t zones = s_zones;
+    if (beam >= LIDAR_COUNT * zones) {
+        return false;
+    }
+
+    *info = geometry_tables.beams[zones - 1][beam];
+    return true;
+}
+
+/**
+ * @brief Get the latest range of a beam
+ * 
+ * @param beam Beam index, equal to the sensor index with one zone
+ * @param range Copy of the latest range
+ * @return true if the beam has produced a range
+ */
+bool lidar_get_range(uint8_t beam, lidar_range_t* range) {
+    if (beam >= lidar_get_beam_count()) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *range = s_ranges[beam];
+    __set_PRIMASK(primask);
+
+    return range->count > 0;
+}
+
+/**
+ * @brief Get a sensor for its state and counters
+ * 
+ * @param index Sensor index
+ * @return const vl53l1x_t* Sensor, NULL if index is out of range
+ */
+const vl53l1x_t* lidar_get_sensor(uint8_t index) {
+    return index < LIDAR_COUNT ? &s_sensors[index] : NULL;
+}
+
+/**
+ * @brief Get the health of a sensor
+ * 
+ * @param index Sensor index
+ * @param health Copy of the health counters
+ * @return false if index is out of range
+ */
+bool lidar_get_health(uint8_t index, lidar_health_t* health) {
+    if (index >= LIDAR_COUNT) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *health = s_health[index];
+    __set_PRIMASK(primask);
+    return true;
+}
+
+/**
+ * @brief Get the state of the ranging schedule
+ * 
+ * @param schedule Copy of the schedule counters
+ */
+void lidar_get_schedule(lidar_schedule_t* schedule) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *schedule = s_schedule;
+    schedule->running = s_running;
+    schedule->zones = s_zones;
+    schedule->regime = s_regime;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Get the latest complete scan, wait-free
+ * Each reader must only be used from one task.
+ * 
+ * @param reader Consumer
+ * @param fresh Set if the scan is newer than the one of the previous call, may be NULL
+ * @return const lidar_scan_t* Latest scan, unchanged until the next call of the reader. No beams before the first scan.
+ */
+const lidar_scan_t* lidar_get_scan(lidar_reader_e reader, bool* fresh) {
+    return bus_read(&s_scans, reader, fresh);
+}
+
+/**
+ * @brief Start calibrating a sensor against a target filling its field of view, returns right away
+ * The schedule must be stopped. The sensor ranges LIDAR_CALIB_SAMPLES times with the full region of
+ * interest, poll lidar_get_calib_state() for the end. The result is used right away, it is kept over
+ * a reboot once saved with lidar_save_calibration().
+ * 
+ * @param sensor Sensor index
+ * @param kind Offset first, then crosstalk
+ * @param target_mm Distance from the sensor to the target
+ * @return false if the schedule runs, the sensor does not work or a calibration is running
+ */
+bool lidar_calibrate(uint8_t sensor, lidar_calib_e kind, uint16_t target_mm) {
+    if (sensor >= LIDAR_COUNT || kind > eLIDAR_CALIB_XTALK || target_mm == 0 || !s_booted || s_running ||
+        s_calibration.state == eLIDAR_CALIB_RUNNING) {
+        return false;
+    }
+
+    vl53l1x_t* dev = &s_sensors[sensor];
+    if ((dev->state != eVL53L1X_IDLE && dev->state != eVL53L1X_RANGING) || s_health[sensor].state != eLIDAR_HEALTH_OK) {
+        return false;
+    }
+
+    s_calibration = (calibration_t){
+        .state = eLIDAR_CALIB_RUNNING,
+        .sensor = sensor,
+        .kind = kind,
+        .target_mm = target_mm,
+    };
+
+    // Measured without the compensation being calibrated, as the ULD does
+    if (kind == eLIDAR_CALIB_OFFSET) {
+        vl53l1x_set_offset(dev, 0);
+    } else {
+        vl53l1x_set_xtalk(dev, 0);
+    }
+    vl53l1x_set_roi(dev, SPADS_CENTER, LIDAR_SPADS, LIDAR_SPADS);
+    vl53l1x_trigger(dev);
+    return true;
+}
+
+/**
+ * @brief Get the state of the latest calibration
+ */
+lidar_calib_state_e lidar_get_calib_state(void) {
+    return s_calibration.state;
+}
+
+/**
+ * @brief Get the calibration of all sensors
+ * 
+ * @param calib Copy of the calibration in use
+ */
+void lidar_get_calibration(lidar_calib_t* calib) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *calib = s_calib;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Write the calibration to flash, it is loaded by lidar_init()
+ * Blocks while the flash is written, see nvm.h. Only call it with the schedule stopped.
+ * 
+ * @return false if the flash could not be written
+ */
+bool lidar_save_calibration(void) {
+    lidar_calib_t calib;
+    lidar_get_calibration(&calib);
+    return nvm_write(eNVM_LIDAR_CALIB, &calib, sizeof(calib));
+}
+
+/**
+ * @brief Remove the calibration from flash, the sensors get their factory values back when they boot
+ * 
+ * @return false if the flash could not be written
+ */
+bool lidar_clear_calibration(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&s_calib, 0, sizeof(s_calib));
+    __set_PRIMASK(primask);
+    return nvm_erase(eNVM_LIDAR_CALIB);
+}
+
+/**
+ * @brief GPIO1 falling edge, a new result is ready
+ * 
+ * @param pin EXTI pin
+ */
+void lidar_exti(uint16_t pin) {
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        if (s_pins[i].int_pin == pin) {
+            uint32_t now = cycles_now();
+            s_stamps[i] = now;
+
+            // The emitter is off once the result is ready, the next group can range while this one is read
+            if (s_running && (s_waiting & (1 << i))) {
+                s_waiting &= ~(1 << i);
+                if (s_waiting == 0) {
+                    s_slot_done(now);
+                }
+            }
+            vl53l1x_data_ready(&s_sensors[i]);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Shared EXTI callback of the HAL, the button is polled so all lines belong to the lidar
+ */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+    lidar_exti(GPIO_Pin);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file lidar_deskew.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Lidar scans as points in the vehicle frame, compensated for the motion during the scan
+ * Runs in the task of the consumer, not in the interrupt publishing the scan. Each point is moved
+ * by the motion between its capture and the reference time, computed from the two odometry poses
+ * relative to each other so the float precision does not depend on the distance travelled.
+ * @version 0.1
+ * @date 2023-11-28
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/lidar.h"
+#include "User/lidar_deskew.h"
+#include "User/odom.h"
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Turn the filtered ranges of a scan into points in the vehicle frame
+ * 
+ * @param scan Scan, with the beam geometry in use. Points of an older geometry are all invalid.
+ * @param compensate Move the points with the odometry, otherwise they are placed as if the vehicle stood still
+ * @param points Points of the scan
+ */
+void lidar_deskew(const lidar_scan_t* scan, bool compensate, lidar_points_t* points) {
+    odom_pose_t reference = {0};
+
+    points->sequence = scan->sequence;
+    points->beams = scan->beams;
+    points->valid = scan->beams == lidar_get_beam_count() ? scan->valid : 0;
+    points->deskewed = 0;
+
+    // The newest capture of a valid beam, captures of beams without a range are stale
+    points->stamp = scan->stamp;
+    bool first = true;
+    for (uint8_t b = 0; b < scan->beams; b++) {
+        if ((points->valid >> b) & 1) {
+            if (first || (int32_t)(scan->capture[b] - points->stamp) > 0) {
+                points->stamp = scan->capture[b];
+            }
+            first = false;
+        }
+    }
+    compensate = compensate && odom_get_pose(points->stamp, &reference);
+
+    float cos_ref = cosf(reference.yaw_rad);
+    float sin_ref = sinf(reference.yaw_rad);
+
+    for (uint8_t b = 0; b < scan->beams; b++) {
+        lidar_beam_t beam;
+        odom_pose_t  pose;
+
+        if (!((points->valid >> b) & 1) || !lidar_get_beam(b, &beam)) {
+            points->x_mm[b] = 0;
+            points->y_mm[b] = 0;
+            continue;
+        }
+
+        float x = beam.mount_x_mm + scan->filtered_mm[b] * beam.cos_azimuth;
+        float y = beam.mount_y_mm + scan->filtered_mm[b] * beam.sin_azimuth;
+
+        if (compensate && odom_get_pose(scan->capture[b], &pose)) {
+            // Pose at the capture in the vehicle frame at the reference time
+            float dx = pose.x_mm - reference.x_mm;
+            float dy = pose.y_mm - reference.y_mm;
+            float tx = cos_ref * dx + sin_ref * dy;
+            float ty = cos_ref * dy - sin_ref * dx;
+            float yaw = pose.yaw_rad - reference.yaw_rad;
+            float c = cosf(yaw);
+            float s = sinf(yaw);
+
+            float moved_x = tx + c * x - s * y;
+            y = ty + s * x + c * y;
+            x = moved_x;
+            points->deskewed |= 1 << b;
+        }
+        points->x_mm[b] = x;
+        points->y_mm[b] = y;
+    }
+}
@@ -0,0 +1,124 @@
+/**
+ * @file lidar_filter.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Range validation and filtering of lidar scans
+ * Runs in the I2C interrupt when a scan is published, so the cost has to be the same for every scan.
+ * All steps run for every beam and decisions are selects instead of branches, the only data
+ * dependent branch is the reset when the number of beams changes.
+ * @version 0.1
+ * @date 2023-11-26
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "User/lidar.h"
+#include "User/lidar_filter.h"
+
+// ============ Private function declaration =================
+static uint16_t s_median(const uint16_t* values);
+
+//============ Private function implementation ===============
+/**
+ * @brief Median by rank, fixed LIDAR_FILTER_MEDIAN^2 compares without branches
+ * Equal values are ranked by position so exactly one value has the middle rank.
+ */
+static uint16_t s_median(const uint16_t* values) {
+    uint16_t median = 0;
+
+    for (uint8_t i = 0; i < LIDAR_FILTER_MEDIAN; i++) {
+        uint8_t rank = 0;
+        for (uint8_t j = 0; j < LIDAR_FILTER_MEDIAN; j++) {
+            rank += (values[j] < values[i]) | ((values[j] == values[i]) & (j < i));
+        }
+        median = rank == LIDAR_FILTER_MEDIAN / 2 ? values[i] : median;
+    }
+    return median;
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Initialize a filter, all beams start invalid
+ * 
+ * @param filter Filter
+ * @param config Gating and IIR settings, copied
+ */
+void lidar_filter_init(lidar_filter_t* filter, const lidar_filter_config_t* config) {
+    filter->config = *config;
+    filter->rejected = 0;
+    lidar_filter_reset(filter, 0);
+}
+
+/**
+ * @brief Forget all beams, e.g. when their directions change
+ * 
+ * @param filter Filter
+ * @param beams Number of beams of the following scans
+ */
+void lidar_filter_reset(lidar_filter_t* filter, uint8_t beams) {
+    filter->beams = beams;
+    filter->head = 0;
+    memset(filter->misses, LIDAR_FILTER_HOLD + 1, sizeof(filter->misses));
+    memset(filter->accepted, 0, sizeof(filter->accepted));
+    memset(filter->history, 0, sizeof(filter->history));
+    memset(filter->state, 0, sizeof(filter->state));
+}
+
+/**
+ * @brief Filter a scan, sets filtered_mm and valid from the raw ranges
+ * 
+ * @param filter Filter, state of the previous scans
+ * @param scan Scan to filter in place
+ */
+void lidar_filter_run(lidar_filter_t* filter, lidar_scan_t* scan) {
+    const lidar_filter_config_t* config = &filter->config;
+    uint8_t                      head = filter->head;
+    uint32_t                     valid = 0;
+    uint32_t                     rejected = 0;
+
+    if (scan->beams != filter->beams) {
+        lidar_filter_reset(filter, scan->beams);
+    }
+
+    for (uint8_t b = 0; b < scan->beams; b++) {
+        uint16_t* history = filter->history[b];
+        uint16_t  range = scan->distance_mm[b];
+        uint8_t   status = scan->status[b];
+        uint8_t   misses = filter->misses[b];
+        uint8_t   accepted = filter->accepted[b];
+
+        bool ok = (status < 32) & ((config->accept >> (status & 31)) & 1) &
+                  (scan->signal_kcps[b] >= config->min_signal_kcps) & (range <= config->max_mm);
+        bool restart = ok & (misses > LIDAR_FILTER_HOLD);
+        accepted = restart ? 0 : accepted;
+
+        // Median, a restart fills the history with the new range
+        for (uint8_t i = 0; i < LIDAR_FILTER_MEDIAN; i++) {
+            history[i] = restart ? range : history[i];
+        }
+        int32_t state = filter->state[b];
+        history[head] = ok ? range : (uint16_t)((state + 8) >> 4);
+        int32_t median = (int32_t)s_median(history) << 4;
+
+        // IIR, follows the median until the history only holds ranges accepted after the restart
+        state += ((median - state) * config->alpha) >> 8;
+        state = accepted < LIDAR_FILTER_MEDIAN ? median : state;
+        filter->state[b] = state;
+
+        misses = ok ? 0 : misses + (misses <= LIDAR_FILTER_HOLD);
+        accepted += ok & (accepted < LIDAR_FILTER_MEDIAN);
+        filter->misses[b] = misses;
+        filter->accepted[b] = accepted;
+        scan->filtered_mm[b] = (uint16_t)((state + 8) >> 4);
+        valid |= (uint32_t)((misses <= LIDAR_FILTER_HOLD) & (accepted == LIDAR_FILTER_MEDIAN)) << b;
+        rejected += !ok;
+    }
+
+    filter->head = head + 1 < LIDAR_FILTER_MEDIAN ? head + 1 : 0;
+    filter->rejected += rejected;
+    scan->valid = valid;
+}
@@ -0,0 +1,169 @@
+/**
+ * @file lidar_recording.c
+ * @brief Lidar scans recorded with 'lidar_sim -z 3 -f 100 -r <file>', do not edit
+ */
+
+#include "User/lidar_recording.h"
+
+const lidar_recording_t lidar_recording[LIDAR_RECORDING_SCANS] = {
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {301, 248, 199, 552, 499, 452, 800, 749, 698, 1049, 1213, 953, 1302, 1252, 1197},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {302, 249, 201, 551, 502, 450, 799, 753, 699, 1051, 997, 948, 1297, 1250, 1201},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0},
+        .distance_mm = {303, 252, 203, 547, 502, 451, 797, 751, 697, 1048, 1001, 805, 1300, 1252, 1200},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 40, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {298, 248, 201, 552, 499, 449, 799, 748, 698, 1049, 997, 950, 1300, 1251, 1199},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {298, 250, 0, 551, 503, 450, 797, 752, 701, 1052, 998, 948, 1299, 1495, 1200},
+        .signal_kcps = {2000, 2000, 40, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {299, 252, 197, 547, 497, 448, 797, 751, 701, 1051, 997, 949, 1297, 1248, 1198},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {297, 253, 201, 552, 499, 450, 800, 748, 701, 1052, 1000, 1179, 1298, 1248, 1202},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {298, 251, 200, 548, 499, 448, 803, 748, 702, 1051, 999, 950, 1303, 1247, 1198},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {303, 247, 202, 552, 497, 452, 802, 747, 697, 1049, 1001, 949, 1301, 1247, 1200},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {300, 251, 199, 549, 499, 447, 799, 750, 697, 1052, 998, 948, 1301, 1253, 1199},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {299, 250, 203, 551, 498, 447, 802, 753, 703, 1048, 997, 953, 1298, 1251, 1197},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {1, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 1, 0, 0, 0},
+        .distance_mm = {320, 253, 202, 549, 499, 857, 798, 751, 551, 1051, 701, 1246, 1297, 1252, 1197},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 40, 2000, 120, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0},
+        .distance_mm = {301, 253, 197, 550, 906, 453, 798, 749, 796, 1052, 997, 952, 1550, 1249, 1203},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 120, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0},
+        .distance_mm = {303, 249, 203, 639, 499, 450, 800, 749, 513, 1051, 999, 1191, 1297, 1247, 1200},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 120, 2000, 2000, 40, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0},
+        .distance_mm = {301, 248, 202, 552, 500, 450, 802, 751, 702, 1051, 1003, 950, 1434, 1248, 1197},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 7, 0},
+        .distance_mm = {303, 252, 198, 552, 500, 452, 801, 750, 701, 1048, 1002, 947, 99, 51, 1201},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {297, 250, 198, 553, 503, 450, 801, 751, 700, 1047, 1003, 949, 1297, 1248, 1202},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0},
+        .distance_mm = {298, 250, 197, 547, 694, 448, 803, 752, 702, 1051, 997, 1100, 1301, 1250, 1600},
+        .signal_kcps = {2000, 2000, 2000, 2000, 120, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {301, 247, 197, 551, 499, 449, 800, 753, 699, 1051, 1002, 953, 1303, 1252, 1201},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {300, 253, 197, 553, 501, 451, 799, 595, 703, 1051, 998, 949, 1297, 1252, 1199},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 40, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 7, 0, 0, 0},
+        .distance_mm = {298, 252, 199, 550, 500, 453, 798, 729, 697, 1052, 998, 149, 1302, 1250, 1200},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 40, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {302, 251, 393, 152, 501, 452, 801, 753, 699, 1053, 1000, 949, 1298, 1250, 1198},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {298, 252, 197, 552, 497, 451, 800, 751, 701, 1051, 1002, 947, 1298, 1251, 1202},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 1, 0, 0, 0, 7, 1, 0, 0, 0, 0, 0},
+        .distance_mm = {302, 450, 203, 547, 358, 448, 801, 752, 97, 961, 1002, 950, 1297, 1251, 1198},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 7, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {298, 48, 203, 487, 500, 448, 802, 753, 700, 1053, 1000, 953, 1301, 1253, 1199},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {297, 251, 200, 549, 502, 453, 802, 747, 1074, 1049, 997, 949, 1299, 1251, 1197},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0},
+        .distance_mm = {301, 248, 199, 547, 499, 452, 797, 748, 702, 1047, 999, 950, 1302, 1193, 1201},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 40, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {467, 249, 200, 549, 502, 453, 803, 747, 698, 1395, 1003, 949, 1297, 1252, 1202},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {303, 247, 201, 549, 501, 620, 801, 748, 697, 1053, 997, 953, 1299, 1247, 1198},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {300, 251, 199, 549, 501, 447, 797, 747, 879, 1051, 1002, 953, 1301, 1249, 1202},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 40, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {303, 252, 198, 547, 503, 447, 797, 748, 698, 1053, 1003, 949, 1303, 1251, 1199},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+    {
+        .status = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        .distance_mm = {302, 250, 201, 551, 497, 453, 800, 748, 702, 1053, 1003, 953, 1302, 1250, 1202},
+        .signal_kcps = {2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000, 2000},
+    },
+};
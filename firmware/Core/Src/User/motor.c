@@ -0,0 +1,182 @@
+/**
+ * @file motor.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Drive motor on the AUX board, center-aligned PWM into the two inputs of its H-bridge
+ * TIM1 counts up and down, CH1 on PA8 drives IN1 and CH2 on PA9 drives IN2. Both pulses are centered on the
+ * top of the count, the update event comes once per period at the bottom where both inputs are low (high
+ * when braking). Compare and period registers are preloaded and only take effect at the update, which is
+ * held off while they are written, so every period runs with one consistent set and a new duty never cuts
+ * into a running pulse.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+#include "User/motor.h"
+
+#define CR1_RUN (TIM_CR1_CEN | TIM_CR1_ARPE | TIM_CR1_CMS_0)
+
+typedef enum {
+    eCOMMAND_DRIVE,
+    eCOMMAND_BRAKE,
+    eCOMMAND_COAST,
+} command_e;
+
+// ============= Private variables ===================
+static motor_pwm_t   s_pwm;
+static motor_decay_e s_decay = eMOTOR_DECAY_COAST;
+static command_e     s_command = eCOMMAND_COAST;
+static float         s_duty;
+static uint32_t      s_hz = MOTOR_PWM_HZ;
+
+// ============ Private function declaration =================
+static uint32_t s_timer_clock(void);
+static void     s_apply(void);
+
+//============ Private function implementation ===============
+static uint32_t s_timer_clock(void) {
+    // Timers on APB2 run at twice PCLK2 when the APB2 prescaler is not 1
+    uint32_t pclk2 = HAL_RCC_GetPCLK2Freq();
+    return ((RCC->CFGR & RCC_CFGR_PPRE2) == RCC_CFGR_PPRE2_DIV1) ? pclk2 : 2 * pclk2;
+}
+
+/**
+ * @brief Compute the compare values of the command and write them to the preload registers
+ */
+static void s_apply(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    switch (s_command) {
+    case eCOMMAND_DRIVE:
+        motor_pwm_drive(&s_pwm, s_duty, s_decay);
+        break;
+    case eCOMMAND_BRAKE:
+        motor_pwm_brake(&s_pwm);
+        break;
+    case eCOMMAND_COAST:
+        motor_pwm_coast(&s_pwm);
+        break;
+    }
+
+    // No update while the set is half written, the running period keeps the previous one
+    TIM1->CR1 = CR1_RUN | TIM_CR1_UDIS;
+    TIM1->ARR = s_pwm.period;
+    TIM1->CCR1 = s_pwm.period - s_pwm.in1;
+    TIM1->CCR2 = s_pwm.period - s_pwm.in2;
+    TIM1->CR1 = CR1_RUN;
+
+    __set_PRIMASK(primask);
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Start the PWM at MOTOR_PWM_HZ with the motor coasting
+ */
+void motor_init(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_TIM1_CLK_ENABLE();
+
+    s_pwm.period = s_timer_clock() / (2 * s_hz);
+    motor_pwm_coast(&s_pwm);
+
+    // PWM mode 2 with preload, high from the compare value up to the top and back
+    TIM1->CR1 = TIM_CR1_ARPE | TIM_CR1_CMS_0;
+    TIM1->PSC = 0;
+    TIM1->ARR = s_pwm.period;
+    TIM1->CCMR1 = TIM_CCMR1_OC1M | TIM_CCMR1_OC1PE | TIM_CCMR1_OC2M | TIM_CCMR1_OC2PE;
+    TIM1->CCR1 = s_pwm.period - s_pwm.in1;
+    TIM1->CCR2 = s_pwm.period - s_pwm.in2;
+    TIM1->CCER = TIM_CCER_CC1E | TIM_CCER_CC2E;
+    TIM1->BDTR = TIM_BDTR_MOE;
+    TIM1->EGR = TIM_EGR_UG;
+    TIM1->SR = 0;
+    TIM1->CR1 = CR1_RUN;
+
+    // The repetition counter puts the update on every second event. With an odd count it is the underflow,
+    // the bottom, only if RCR is written after the counter was started, written before it is the overflow at
+    // the top (reference manual, repetition counter). Still coasting, the extra update at the first top
+    // before RCR is loaded changes nothing.
+    TIM1->RCR = 1;
+
+    // Pins last, the bridge sees low inputs until the timer drives them
+    GPIO_InitStruct.Pin = GPIO_PIN_8 | GPIO_PIN_9;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_PULLDOWN;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_MEDIUM;
+    GPIO_InitStruct.Alternate = GPIO_AF1_TIM1;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+}
+
+/**
+ * @brief Change the PWM frequency, the command is kept, from the next period
+ *
+ * @param hz MOTOR_PWM_HZ_MIN to MOTOR_PWM_HZ_MAX
+ * @return true if in range
+ */
+bool motor_set_frequency(uint32_t hz) {
+    if (hz < MOTOR_PWM_HZ_MIN || hz > MOTOR_PWM_HZ_MAX) {
+        return false;
+    }
+    s_hz = hz;
+    s_pwm.period = s_timer_clock() / (2 * hz);
+    s_apply();
+    return true;
+}
+
+uint32_t motor_get_frequency(void) {
+    return s_hz;
+}
+
+/**
+ * @brief Coast or brake in the off time of every period, from the next period
+ */
+void motor_set_decay(motor_decay_e decay) {
+    s_decay = decay;
+    s_apply();
+}
+
+/**
+ * @brief Drive the motor from the next period, a few register writes, callable from interrupts
+ *
+ * @param duty -1 full backwards to 1 full forward
+ */
+void motor_set(float duty) {
+    s_duty = duty;
+    s_command = eCOMMAND_DRIVE;
+    s_apply();
+}
+
+/**
+ * @brief Short the motor from the next period
+ */
+void motor_brake(void) {
+    s_command = eCOMMAND_BRAKE;
+    s_apply();
+}
+
+/**
+ * @brief Let the motor run free from the next period
+ */
+void motor_coast(void) {
+    s_command = eCOMMAND_COAST;
+    s_apply();
+}
+
+/**
+ * @brief Get the commanded duty
+ *
+ * @return float -1 to 1, 0 while braking or coasting
+ */
+float motor_get(void) {
+    return s_command == eCOMMAND_DRIVE ? s_duty : 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file motor_pwm.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Waveform of the H-bridge inputs for a duty cycle, shared by the motor driver and its host mock
+ * Forward drives IN1 high and IN2 low, backwards the other way around. The bridge drives for the duty share
+ * of the period and coasts or brakes for the rest, so the average voltage is the duty in both decay modes.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdint.h>
+
+#include "User/motor.h"
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Set the high time of both inputs for a duty cycle
+ *
+ * @param pwm period must be set, in1 and in2 are set
+ * @param duty -1 full backwards to 1 full forward, clamped
+ * @param decay Off time coasting or braking
+ */
+void motor_pwm_drive(motor_pwm_t* pwm, float duty, motor_decay_e decay) {
+    float    magnitude = duty < 0 ? -duty : duty;
+    uint16_t on = 0;
+    uint16_t high, low;
+
+    if (magnitude >= 1) {
+        on = pwm->period;
+    } else if (magnitude > 0) {
+        on = (uint16_t)(magnitude * pwm->period + 0.5f);
+    }
+
+    if (decay == eMOTOR_DECAY_COAST) {
+        // Driving input pulses, the other one stays low
+        high = on;
+        low = 0;
+    } else {
+        // Driving input stays high, the other one pulses to brake
+        high = pwm->period;
+        low = pwm->period - on;
+    }
+
+    pwm->in1 = duty < 0 ? low : high;
+    pwm->in2 = duty < 0 ? high : low;
+}
+
+/**
+ * @brief Both inputs high, the motor is shorted
+ */
+void motor_pwm_brake(motor_pwm_t* pwm) {
+    pwm->in1 = pwm->period;
+    pwm->in2 = pwm->period;
+}
+
+/**
+ * @brief Both inputs low, the motor runs free
+ */
+void motor_pwm_coast(motor_pwm_t* pwm) {
+    pwm->in1 = 0;
+    pwm->in2 = 0;
+}
@@ -0,0 +1,305 @@
+/**
+ * @file nvm.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Small records kept in the last two flash sectors, e.g. calibration data
+ * A record is a header word, the data padded to words and a CRC-32 of both. The header also holds
+ * the inverted length so a header torn by a reset is seen as the end of the records. A record with
+ * a bad CRC is skipped. The header is programmed last, a record only exists once it is complete.
+ * An erased record (tombstone) has no data.
+ * Records are appended to one sector. When it is full the latest records are copied to the other one,
+ * which is erased first, and a copy record with the number of the copy closes them. The sector with the
+ * highest copy number is in use, so a reset at any point of the copy leaves the old records in use. The
+ * old sector is only erased by the next copy. Without any copy record, e.g. records of a firmware that
+ * only used sector 7, sector 7 is in use.
+ * @version 0.1
+ * @date 2023-11-27
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "main.h"
+
+#include "User/nvm.h"
+
+#ifdef DONATELLO_HOST
+#define NVM_START ((uintptr_t)host_flash)
+#else
+#define NVM_START 0x08040000 // Sector 6, sector 7 follows
+#endif
+
+#define NVM_SECTORS 2
+#define NVM_LEGACY  1 // Sector 7, in use before the first copy
+
+#define NVM_ERASED 0xFFFFFFFF
+
+#define NVM_MARK    0xA5
+#define NVM_COPY_ID 0xFF // Closes a copy, the data is the number of the copy
+
+// Header word: id, data bytes, inverted data bytes, mark
+#define HEADER(id, size) \
+    ((uint32_t)(id) | ((uint32_t)(size) << 8) | ((uint32_t)(uint8_t)~(size) << 16) | ((uint32_t)NVM_MARK << 24))
+#define HEADER_ID(header)    ((header) & 0xFF)
+#define HEADER_SIZE(header)  (((header) >> 8) & 0xFF)
+#define HEADER_VALID(header) (((((header) >> 8) ^ ((header) >> 16)) & 0xFF) == 0xFF && ((header) >> 24) == NVM_MARK)
+#define WORDS(size)          (((size) + 3) / 4)
+#define SECTOR(sector)       ((const uint32_t*)(NVM_START + (sector) * NVM_SIZE))
+
+typedef struct
+{
+    const uint32_t* header; // NULL if there is none
+    uint8_t         size;
+} record_t;
+
+// ============= Private variables ===================
+static uint8_t s_compact[eNVM_IDS][NVM_RECORD_MAX]; // Records on their way to the other sector
+
+// ============ Private function declaration =================
+static uint32_t s_crc32(uint32_t crc, const void* data, uint32_t len);
+static bool     s_is_intact(const uint32_t* header);
+static record_t s_find(uint8_t sector, uint8_t id, const uint32_t** end);
+static uint8_t  s_current(uint32_t* copy);
+static bool     s_program(uintptr_t address, const uint32_t* words, uint32_t count);
+static bool     s_append(uint8_t sector, const uint32_t** end, uint8_t id, const void* data, uint8_t size);
+static bool     s_copy_sector(uint8_t* sector, uint32_t copy, const uint32_t** end);
+
+//============ Private function implementation ===============
+/**
+ * @brief CRC-32 (IEEE), bitwise, only used when a record is read or written
+ */
+static uint32_t s_crc32(uint32_t crc, const void* data, uint32_t len) {
+    const uint8_t* bytes = data;
+
+    crc = ~crc;
+    while (len--) {
+        crc ^= *bytes++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static bool s_is_intact(const uint32_t* header) {
+    uint8_t size = HEADER_SIZE(*header);
+    return s_crc32(0, header, 4 + size) == header[1 + WORDS(size)];
+}
+
+/**
+ * @brief Walk the records of a sector, find the latest intact one of an id
+ * 
+ * @param sector 0 for sector 6, 1 for sector 7
+ * @param id Record id, 0 to only walk
+ * @param end Set to the first word after the last record
+ */
+static record_t s_find(uint8_t sector, uint8_t id, const uint32_t** end) {
+    const uint32_t* word = SECTOR(sector);
+    const uint32_t* last = SECTOR(sector + 1);
+    record_t        found = {NULL, 0};
+
+    while (word < last && *word != NVM_ERASED && HEADER_VALID(*word)) {
+        uint8_t size = HEADER_SIZE(*word);
+        if (word + 2 + WORDS(size) > last) {
+            break;
+        }
+        if (HEADER_ID(*word) == id && s_is_intact(word)) {
+            found.header = size ? word : NULL; // No data is an erased record
+            found.size = size;
+        }
+        word += 2 + WORDS(size);
+    }
+    *end = word;
+    return found;
+}
+
+/**
+ * @brief Find the sector in use, the one closed by the latest copy
+ * 
+ * @param copy Set to the number of its copy, 0 before the first
+ * @return uint8_t Sector in use
+ */
+static uint8_t s_current(uint32_t* copy) {
+    uint8_t current = NVM_LEGACY;
+
+    *copy = 0;
+    for (uint8_t sector = 0; sector < NVM_SECTORS; sector++) {
+        const uint32_t* end;
+        record_t        record = s_find(sector, NVM_COPY_ID, &end);
+        uint32_t        number;
+
+        if (record.header && record.size == sizeof(number)) {
+            memcpy(&number, &record.header[1], sizeof(number));
+            if (number > *copy) {
+                *copy = number;
+                current = sector;
+            }
+        }
+    }
+    return current;
+}
+
+static bool s_program(uintptr_t address, const uint32_t* words, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + 4 * i, words[i]) != HAL_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Write a record after the last one, data and CRC first and the header last
+ * 
+ * @param sector Sector of the records
+ * @param end First free word, moved past the record
+ * @return false if the sector is full or programming failed
+ */
+static bool s_append(uint8_t sector, const uint32_t** end, uint8_t id, const void* data, uint8_t size) {
+    uint32_t words[2 + WORDS(NVM_RECORD_MAX)] = {0};
+    uint32_t count = 2 + WORDS(size);
+
+    if (*end + count > SECTOR(sector + 1)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if ((*end)[i] != NVM_ERASED) {
+            return false; // Left over from a torn write
+        }
+    }
+
+    words[0] = HEADER(id, size);
+    if (size) {
+        memcpy(&words[1], data, size);
+    }
+    words[count - 1] = s_crc32(0, words, 4 + size);
+
+    uintptr_t address = (uintptr_t)*end;
+    bool      ok = s_program(address + 4, &words[1], count - 1) && s_program(address, words, 1);
+    *end += count;
+    return ok;
+}
+
+/**
+ * @brief Copy the latest record of every id to the other sector and close the copy
+ * The other sector is erased first, the records in use are not touched.
+ * 
+ * @param sector Sector in use, set to the other one once the copy is closed
+ * @param copy Number of the copy in use
+ * @param end Set to the first free word of the sector in use
+ */
+static bool s_copy_sector(uint8_t* sector, uint32_t copy, const uint32_t** end) {
+    uint8_t sizes[eNVM_IDS] = {0};
+    uint8_t to = *sector ^ 1;
+
+    for (uint8_t id = 1; id < eNVM_IDS; id++) {
+        record_t record = s_find(*sector, id, end);
+        if (record.header) {
+            memcpy(s_compact[id], &record.header[1], record.size);
+            sizes[id] = record.size;
+        }
+    }
+
+    // Left over from a copy that was cut short or from the copy before the one in use
+    const uint32_t* word = SECTOR(to);
+    while (word < SECTOR(to + 1) && *word == NVM_ERASED) {
+        word++;
+    }
+    if (word < SECTOR(to + 1)) {
+        FLASH_EraseInitTypeDef erase = {
+            .TypeErase = FLASH_TYPEERASE_SECTORS,
+            .Sector = FLASH_SECTOR_6 + to,
+            .NbSectors = 1,
+            .VoltageRange = FLASH_VOLTAGE_RANGE_3,
+        };
+        uint32_t error;
+        if (HAL_FLASHEx_Erase(&erase, &error) != HAL_OK) {
+            return false;
+        }
+    }
+
+    const uint32_t* copy_end = SECTOR(to);
+    for (uint8_t id = 1; id < eNVM_IDS; id++) {
+        if (sizes[id] && !s_append(to, &copy_end, id, s_compact[id], sizes[id])) {
+            return false;
+        }
+    }
+    copy++;
+    if (!s_append(to, &copy_end, NVM_COPY_ID, &copy, sizeof(copy))) {
+        return false;
+    }
+    *sector = to;
+    *end = copy_end;
+    return true;
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Read the current record of an id
+ * 
+ * @param id Record id
+ * @param data Copy of the record
+ * @param size Expected size, a record of another size (e.g. an older layout) is not read
+ * @return true if there is a record of that size
+ */
+bool nvm_read(nvm_id_e id, void* data, uint16_t size) {
+    const uint32_t* end;
+    uint32_t        copy;
+    record_t        record = s_find(s_current(&copy), id, &end);
+
+    if (record.header == NULL || record.size != size) {
+        return false;
+    }
+    memcpy(data, &record.header[1], size);
+    return true;
+}
+
+/**
+ * @brief Replace the record of an id, blocks while the flash is programmed
+ * 
+ * @param id Record id
+ * @param data Record
+ * @param size 1 to NVM_RECORD_MAX bytes
+ * @return false if the size is out of range or the flash could not be written
+ */
+bool nvm_write(nvm_id_e id, const void* data, uint16_t size) {
+    if (id == 0 || id >= eNVM_IDS || size > NVM_RECORD_MAX) {
+        return false;
+    }
+
+    const uint32_t* end;
+    uint32_t        copy;
+    uint8_t         sector = s_current(&copy);
+    s_find(sector, 0, &end);
+
+    HAL_FLASH_Unlock();
+    bool ok = s_append(sector, &end, id, data, size);
+    if (!ok) {
+        ok = s_copy_sector(&sector, copy, &end) && s_append(sector, &end, id, data, size);
+    }
+    HAL_FLASH_Lock();
+    return ok;
+}
+
+/**
+ * @brief Remove the record of an id
+ */
+bool nvm_erase(nvm_id_e id) {
+    return nvm_write(id, NULL, 0);
+}
+
+/**
+ * @brief Get the bytes left before the records are copied to the other sector
+ */
+uint32_t nvm_get_free(void) {
+    const uint32_t* end;
+    uint32_t        copy;
+    uint8_t         sector = s_current(&copy);
+
+    s_find(sector, 0, &end);
+    return (uintptr_t)SECTOR(sector + 1) - (uintptr_t)end;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file odom.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Recent vehicle poses from odometry, to look up where the vehicle was at a given time
+ * The poses are a ring written by the odometry update, from a task or an interrupt. A lookup
+ * interpolates linearly between the two poses around the time, the ring is only touched with
+ * interrupts disabled and for at most log2(ODOM_HISTORY) + 2 reads.
+ * @version 0.1
+ * @date 2023-11-28
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+#include "User/odom.h"
+
+// ============= Private variables ===================
+static odom_pose_t s_poses[ODOM_HISTORY];
+static uint32_t    s_count; // Poses written since the reset
+
+// ============ Private function declaration =================
+static inline odom_pose_t* s_pose(uint32_t n);
+
+//============ Private function implementation ===============
+/**
+ * @brief Pose number n since the reset, must be one of the last ODOM_HISTORY
+ */
+static inline odom_pose_t* s_pose(uint32_t n) {
+    return &s_poses[n % ODOM_HISTORY];
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Forget all poses, e.g. when the odometry frame is reset
+ */
+void odom_reset(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_count = 0;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Add the latest pose, call at a steady rate of at least 100 Hz while moving
+ * 
+ * @param stamp cycles_now() when the pose was valid, later than the previous one
+ * @param x_mm Position
+ * @param y_mm Position
+ * @param yaw_rad Heading, keep it continuous rather than wrapped
+ */
+void odom_update(uint32_t stamp, float x_mm, float y_mm, float yaw_rad) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *s_pose(s_count) = (odom_pose_t){stamp, x_mm, y_mm, yaw_rad};
+    s_count++;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Get the latest pose
+ * 
+ * @return false if there is none
+ */
+bool odom_get_latest(odom_pose_t* pose) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool found = s_count > 0;
+    if (found) {
+        *pose = *s_pose(s_count - 1);
+    }
+    __set_PRIMASK(primask);
+    return found;
+}
+
+/**
+ * @brief Get the pose at a time, interpolated between the two poses around it
+ * 
+ * @param stamp cycles_now() of the pose wanted
+ * @param pose Pose at stamp
+ * @return false if stamp is not covered by the history, too old or newer than the latest pose
+ */
+bool odom_get_pose(uint32_t stamp, odom_pose_t* pose) {
+    odom_pose_t before, after;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t count = s_count;
+    uint32_t oldest = count > ODOM_HISTORY ? count - ODOM_HISTORY : 0;
+    if (count < 2 || (int32_t)(stamp - s_pose(oldest)->stamp) < 0 || (int32_t)(stamp - s_pose(count - 1)->stamp) > 0) {
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    // Last pose at or before stamp, stamps are relative to it so they may wrap
+    uint32_t low = oldest;
+    uint32_t high = count - 1;
+    while (high - low > 1) {
+        uint32_t middle = low + (high - low) / 2;
+        if ((int32_t)(stamp - s_pose(middle)->stamp) >= 0) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    before = *s_pose(low);
+    after = *s_pose(high);
+    __set_PRIMASK(primask);
+
+    uint32_t span = after.stamp - before.stamp;
+    float    t = span ? (float)(stamp - before.stamp) / span : 0.0f;
+    t = t > 1.0f ? 1.0f : t;
+
+    pose->stamp = stamp;
+    pose->x_mm = before.x_mm + (after.x_mm - before.x_mm) * t;
+    pose->y_mm = before.y_mm + (after.y_mm - before.y_mm) * t;
+    pose->yaw_rad = before.yaw_rad + (after.yaw_rad - before.yaw_rad) * t;
+    return true;
+}
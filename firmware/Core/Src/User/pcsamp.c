@@ -0,0 +1,192 @@
+/**
+ * @file pcsamp.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Statistical PC-sampling profiler
+ * TIM11 interrupts at a few kHz and records the PC/LR stacked by the exception entry together with the running task.
+ * Samples are kept in a single producer/single consumer ring and drained by the 'pcsamp dump' CLI command,
+ * tools/pcprof.py symbolizes them against the ELF. The FreeRTOS kernel and port are not modified.
+ * @version 0.1
+ * @date 2023-11-19
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "main.h"
+#include "task.h"
+
+#include "User/pcsamp.h"
+
+// Offsets (in words) in the exception stack frame
+#define FRAME_LR 5
+#define FRAME_PC 6
+
+// EXC_RETURN bit set when returning to thread mode
+#define EXC_RETURN_THREAD (1UL << 3)
+
+// ============= Private variables ===================
+static pcsamp_sample_t   s_samples[PCSAMP_BUFFER_SIZE];
+static volatile uint32_t s_head;    // Written by ISR only
+static volatile uint32_t s_tail;    // Written by consumer only
+static volatile uint32_t s_dropped; // Samples lost because the ring was full
+static volatile uint32_t s_total;   // Samples taken since start
+static volatile bool     s_running;
+static uint32_t          s_reload;  // Nominal auto reload value
+static uint32_t          s_rng = 0x2545F491;
+
+// ============ Private function declaration =================
+static uint32_t s_timer_clock(void);
+static uint32_t s_jitter(void);
+
+//============ Private function implementation ===============
+static uint32_t s_timer_clock(void) {
+    // Timers on APB2 run at twice PCLK2 when the APB2 prescaler is not 1
+    uint32_t pclk2 = HAL_RCC_GetPCLK2Freq();
+    return ((RCC->CFGR & RCC_CFGR_PPRE2) == RCC_CFGR_PPRE2_DIV1) ? pclk2 : 2 * pclk2;
+}
+
+/**
+ * @brief Pseudo random reload, +-1/8 of the period
+ * Prevents the sampling from locking onto periodic activity such as the 1 kHz tick
+ */
+static uint32_t s_jitter(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+
+    uint32_t span = s_reload / 4;
+    return s_reload - span / 2 + (span ? s_rng % span : 0);
+}
+
+/**
+ * @brief C part of the sampling interrupt
+ * Kept global and used so the naked handler can branch to it by name, also with LTO.
+ * 
+ * @param frame Exception stack frame of the interrupted context
+ * @param exc_return EXC_RETURN value of the exception
+ */
+__attribute__((used)) void pcsamp_isr(const uint32_t* frame, uint32_t exc_return) {
+    TIM11->SR = ~TIM_SR_UIF;
+    TIM11->ARR = s_jitter();
+
+    s_total++;
+    uint32_t head = s_head;
+    uint32_t next = (head + 1) % PCSAMP_BUFFER_SIZE;
+    if (next == s_tail) {
+        s_dropped++;
+        return;
+    }
+
+    s_samples[head].pc = frame[FRAME_PC];
+    s_samples[head].lr = frame[FRAME_LR];
+    s_samples[head].task = (exc_return & EXC_RETURN_THREAD) ? (void*)xTaskGetCurrentTaskHandle() : NULL;
+    __DMB(); // Sample must be visible before the consumer sees the new head
+    s_head = next;
+}
+
+/**
+ * @brief TIM11 interrupt, fetches the active stack pointer before any C prologue touches the stack
+ */
+__attribute__((naked)) void TIM1_TRG_COM_TIM11_IRQHandler(void) {
+    __asm volatile("tst   lr, #4      \n"
+                   "ite   eq          \n"
+                   "mrseq r0, msp     \n"
+                   "mrsne r0, psp     \n"
+                   "mov   r1, lr      \n"
+                   "b     pcsamp_isr  \n");
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Start sampling, previous samples that have not been dumped are discarded
+ * 
+ * @param hz Sample rate, clamped to PCSAMP_MAX_HZ
+ */
+void pcsamp_start(uint32_t hz) {
+    if (hz == 0) {
+        hz = PCSAMP_DEFAULT_HZ;
+    } else if (hz > PCSAMP_MAX_HZ) {
+        hz = PCSAMP_MAX_HZ;
+    }
+
+    pcsamp_stop();
+    s_tail = s_head;
+    s_dropped = 0;
+    s_total = 0;
+
+    // 1 MHz timer tick, period set by auto reload
+    __HAL_RCC_TIM11_CLK_ENABLE();
+    s_reload = 1000000 / hz - 1;
+    TIM11->CR1 = 0;
+    TIM11->PSC = s_timer_clock() / 1000000 - 1;
+    TIM11->ARR = s_reload;
+    TIM11->EGR = TIM_EGR_UG;
+    TIM11->SR = 0;
+    TIM11->DIER = TIM_DIER_UIE;
+
+    HAL_NVIC_SetPriority(TIM1_TRG_COM_TIM11_IRQn, PCSAMP_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(TIM1_TRG_COM_TIM11_IRQn);
+
+    s_running = true;
+    TIM11->CR1 = TIM_CR1_CEN;
+}
+
+/**
+ * @brief Stop sampling, samples in the ring can still be popped
+ */
+void pcsamp_stop(void) {
+    TIM11->CR1 = 0;
+    HAL_NVIC_DisableIRQ(TIM1_TRG_COM_TIM11_IRQn);
+    s_running = false;
+}
+
+/**
+ * @brief Check if the profiler is sampling
+ * 
+ * @return true Sampling
+ * @return false Stopped
+ */
+bool pcsamp_is_running(void) {
+    return s_running;
+}
+
+/**
+ * @brief Pop the oldest sample, may be called while sampling is running
+ * 
+ * @param sample Where to store the sample
+ * @return true A sample was popped
+ * @return false Ring is empty
+ */
+bool pcsamp_pop(pcsamp_sample_t* sample) {
+    uint32_t tail = s_tail;
+    if (tail == s_head) {
+        return false;
+    }
+
+    __DMB();
+    *sample = s_samples[tail];
+    s_tail = (tail + 1) % PCSAMP_BUFFER_SIZE;
+    return true;
+}
+
+/**
+ * @brief Get number of samples lost because the ring was full
+ * 
+ * @return uint32_t Dropped samples since start
+ */
+uint32_t pcsamp_get_dropped(void) {
+    return s_dropped;
+}
+
+/**
+ * @brief Get number of sample interrupts since start
+ * 
+ * @return uint32_t Total samples since start
+ */
+uint32_t pcsamp_get_total(void) {
+    return s_total;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file pool.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Fixed size block pools, see pool.h
+ * The free blocks of a pool form a stack linked through an array of indices beside the blocks, the blocks
+ * themselves are never touched by the pool outside of POOL_DEBUG. The head holds the index of the top block
+ * plus one, 0 for an empty stack, and a tag in the upper half that changes with every push and pop. A compare
+ * and swap on the head fails if anything was pushed or popped in between, even if the same block is on top
+ * again. The tag wraps after 65536 operations, a context would have to be preempted for that many before its
+ * compare and swap to pop a wrong block.
+ * Blocks that were never allocated are not on the stack, they are handed out in order once it is empty. All
+ * state starts zeroed, no initialization is needed before the first allocation.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "User/pool.h"
+
+#define POOL_LINK 0x0000FFFF // Index of the top block plus one
+#define POOL_TAG  0x00010000
+
+#define POOL_FREE      0
+#define POOL_ALLOCATED 1
+#define POOL_POISON    0xDD // Fills free blocks
+#define POOL_FILL      0xCD // Fills allocated blocks, neither zero nor what was freed
+
+typedef struct
+{
+    const char*       name;
+    uint16_t          size;
+    uint16_t          blocks;
+    uint8_t*          data;
+    _Atomic uint16_t* next; // Link of every block while it is free
+#if POOL_DEBUG
+    _Atomic uint8_t* state;
+#endif
+    _Atomic uint32_t head;
+    _Atomic uint16_t fresh; // Blocks handed out that were never allocated before
+    _Atomic uint32_t in_use;
+    _Atomic uint32_t high_water;
+    _Atomic uint32_t allocs;
+    _Atomic uint32_t failures;
+    _Atomic uint32_t double_frees;
+    _Atomic uint32_t use_after_free;
+} pool_t;
+
+// ============= Private variables ===================
+static uint8_t          s_message_data[POOL_MESSAGES][POOL_MESSAGE_SIZE] __attribute__((aligned(8)));
+static _Atomic uint16_t s_message_next[POOL_MESSAGES];
+#if POOL_DEBUG
+static _Atomic uint8_t s_message_state[POOL_MESSAGES];
+#define POOL_STATE(states) .state = states,
+#else
+#define POOL_STATE(states)
+#endif
+
+static pool_t s_pools[ePOOLS] = {
+    [ePOOL_MESSAGE] = {.name = "message", .size = POOL_MESSAGE_SIZE, .blocks = POOL_MESSAGES,
+                       .data = &s_message_data[0][0], .next = s_message_next, POOL_STATE(s_message_state)},
+};
+
+// ============ Private function declaration =================
+static void* s_alloc(pool_t* pool);
+static void  s_free(pool_t* pool, uint16_t index);
+
+//============ Private function implementation ===============
+static void* s_alloc(pool_t* pool) {
+    uint32_t head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    uint16_t index;
+    bool     reused = true;
+
+    for (;;) {
+        if (!(head & POOL_LINK)) {
+            // Stack empty, take a block that was never allocated. Blocks freed meanwhile are left for the next one.
+            uint16_t fresh = atomic_load_explicit(&pool->fresh, memory_order_relaxed);
+            do {
+                if (fresh >= pool->blocks) {
+                    return NULL;
+                }
+            } while (!atomic_compare_exchange_weak_explicit(
+                &pool->fresh, &fresh, fresh + 1, memory_order_relaxed, memory_order_relaxed
+            ));
+            index = fresh;
+            reused = false;
+            break;
+        }
+
+        index = (head & POOL_LINK) - 1;
+        uint16_t next = atomic_load_explicit(&pool->next[index], memory_order_relaxed);
+        uint32_t top = ((head + POOL_TAG) & ~POOL_LINK) | next;
+        if (atomic_compare_exchange_weak_explicit(
+                &pool->head, &head, top, memory_order_acq_rel, memory_order_acquire
+            )) {
+            break;
+        }
+    }
+
+    uint8_t* block = pool->data + index * pool->size;
+#if POOL_DEBUG
+    atomic_store_explicit(&pool->state[index], POOL_ALLOCATED, memory_order_relaxed);
+    for (uint16_t i = 0; reused && i < pool->size; i++) {
+        if (block[i] != POOL_POISON) {
+            atomic_fetch_add_explicit(&pool->use_after_free, 1, memory_order_relaxed);
+            break;
+        }
+    }
+    memset(block, POOL_FILL, pool->size);
+#else
+    (void)reused;
+#endif
+
+    uint32_t in_use = atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed) + 1;
+    uint32_t high_water = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+    while (in_use > high_water) {
+        if (atomic_compare_exchange_weak_explicit(
+                &pool->high_water, &high_water, in_use, memory_order_relaxed, memory_order_relaxed
+            )) {
+            break;
+        }
+    }
+    atomic_fetch_add_explicit(&pool->allocs, 1, memory_order_relaxed);
+    return block;
+}
+
+static void s_free(pool_t* pool, uint16_t index) {
+    uint32_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    uint32_t top;
+
+    // Before the block is back, in_use never counts more blocks than there are
+    atomic_fetch_sub_explicit(&pool->in_use, 1, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&pool->next[index], head & POOL_LINK, memory_order_relaxed);
+        top = ((head + POOL_TAG) & ~POOL_LINK) | (index + 1u);
+    } while (!atomic_compare_exchange_weak_explicit(
+        &pool->head, &head, top, memory_order_release, memory_order_relaxed
+    ));
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Allocate a block, from tasks and interrupts
+ * From the pool of the smallest blocks of at least size bytes, or a larger one if that is empty.
+ *
+ * @param size Bytes needed
+ * @return void* Block aligned to 8 bytes, NULL if there is none. Filled with garbage.
+ */
+void* pool_alloc(size_t size) {
+    pool_t* fit = NULL;
+
+    for (pool_t* pool = s_pools; pool < s_pools + ePOOLS; pool++) {
+        if (pool->size < size) {
+            continue;
+        }
+        fit = fit ? fit : pool;
+        void* block = s_alloc(pool);
+        if (block != NULL) {
+            return block;
+        }
+    }
+    if (fit != NULL) {
+        atomic_fetch_add_explicit(&fit->failures, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Return a block from pool_alloc(), from tasks and interrupts
+ *
+ * @param block Block, NULL is ignored
+ * @return true Freed
+ * @return false Not a block of a pool, or with POOL_DEBUG a block that is not allocated. Nothing is freed.
+ */
+bool pool_free(void* block) {
+    if (block == NULL) {
+        return true;
+    }
+
+    for (pool_t* pool = s_pools; pool < s_pools + ePOOLS; pool++) {
+        uintptr_t offset = (uintptr_t)block - (uintptr_t)pool->data;
+        if (offset >= (uintptr_t)pool->size * pool->blocks) {
+            continue;
+        }
+        if (offset % pool->size) {
+            return false; // Inside a block
+        }
+
+        uint16_t index = offset / pool->size;
+#if POOL_DEBUG
+        if (atomic_exchange_explicit(&pool->state[index], POOL_FREE, memory_order_relaxed) != POOL_ALLOCATED) {
+            atomic_fetch_add_explicit(&pool->double_frees, 1, memory_order_relaxed);
+            return false;
+        }
+        memset(block, POOL_POISON, pool->size);
+#endif
+        s_free(pool, index);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Get the statistics of a pool
+ * Read while they may change, they are not a consistent snapshot.
+ */
+void pool_get_stats(pool_e pool, pool_stats_t* stats) {
+    pool_t* p = &s_pools[pool];
+
+    stats->name = p->name;
+    stats->size = p->size;
+    stats->blocks = p->blocks;
+    stats->in_use = atomic_load(&p->in_use);
+    stats->high_water = atomic_load(&p->high_water);
+    stats->allocs = atomic_load(&p->allocs);
+    stats->failures = atomic_load(&p->failures);
+    stats->double_frees = atomic_load(&p->double_frees);
+    stats->use_after_free = atomic_load(&p->use_after_free);
+}
+
+/**
+ * @brief Clear the counters of all pools, the high water mark starts over from the blocks in use
+ */
+void pool_reset_stats(void) {
+    for (pool_t* pool = s_pools; pool < s_pools + ePOOLS; pool++) {
+        atomic_store(&pool->high_water, atomic_load(&pool->in_use));
+        atomic_store(&pool->allocs, 0);
+        atomic_store(&pool->failures, 0);
+        atomic_store(&pool->double_frees, 0);
+        atomic_store(&pool->use_after_free, 0);
+    }
+}
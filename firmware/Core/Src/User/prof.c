@@ -0,0 +1,94 @@
+/**
+ * @file prof.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Latency histograms for hot code sections, see prof.h
+ * @version 0.1
+ * @date 2023-11-20
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "User/prof.h"
+
+// Section boundaries, provided by the linker script on target and by the linker on host.
+// Weak so an image without any scope still links, both are then NULL.
+extern prof_scope_t __start_prof_scopes[] __attribute__((weak));
+extern prof_scope_t __stop_prof_scopes[] __attribute__((weak));
+
+// ============ Private function declaration =================
+static uint32_t s_bucket_value(uint32_t bucket);
+static uint32_t s_percentile(const prof_scope_t* scope, uint32_t permille);
+
+//============ Private function implementation ===============
+/**
+ * @brief Middle of the range covered by a bucket, inverse of the mapping in prof_record()
+ */
+static uint32_t s_bucket_value(uint32_t bucket) {
+    if (bucket < (2u << PROF_SUB_BITS)) {
+        return bucket;
+    }
+
+    uint32_t shift = (bucket >> PROF_SUB_BITS) - 1;
+    uint32_t mantissa = bucket - (shift << PROF_SUB_BITS);
+    return (mantissa << shift) + ((1u << shift) >> 1);
+}
+
+static uint32_t s_percentile(const prof_scope_t* scope, uint32_t permille) {
+    // Rank of the wanted sample, rounded up
+    uint64_t rank = ((uint64_t)scope->count * permille + 999) / 1000;
+    uint32_t seen = 0;
+
+    for (uint32_t i = 0; i < PROF_BUCKETS; i++) {
+        seen += scope->hist[i];
+        if (seen >= rank && seen) {
+            uint32_t value = s_bucket_value(i);
+            return value > scope->max ? scope->max : value;
+        }
+    }
+
+    return scope->max;
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Iterate over all scopes in the image
+ * 
+ * @param scope Previous scope, NULL to get the first one
+ * @return prof_scope_t* Next scope, NULL when done
+ */
+prof_scope_t* prof_next(prof_scope_t* scope) {
+    scope = scope ? scope + 1 : __start_prof_scopes;
+    return scope < __stop_prof_scopes ? scope : NULL;
+}
+
+/**
+ * @brief Summarize a scope
+ * Percentiles are resolved to the histogram bucket, i.e. within 1/2^PROF_SUB_BITS of the value.
+ * 
+ * @param scope Scope to summarize
+ * @param stats Output
+ */
+void prof_get_stats(const prof_scope_t* scope, prof_stats_t* stats) {
+    stats->count = scope->count;
+    stats->max = scope->max;
+    stats->mean = scope->count ? (uint32_t)(scope->sum / scope->count) : 0;
+    stats->p50 = s_percentile(scope, 500);
+    stats->p99 = s_percentile(scope, 990);
+}
+
+/**
+ * @brief Clear all scopes
+ */
+void prof_reset(void) {
+    for (prof_scope_t* scope = prof_next(NULL); scope; scope = prof_next(scope)) {
+        scope->count = 0;
+        scope->max = 0;
+        scope->sum = 0;
+        memset(scope->hist, 0, sizeof(scope->hist));
+    }
+}
@@ -0,0 +1,108 @@
+/**
+ * @file ring.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Byte ring buffer, see ring.h
+ * The counters are free running and only ever written by one side, the difference is the number of stored
+ * bytes. The size is a power of two so the 32 bit counters wrap together with the position in the data.
+ * All state starts zeroed, no initialization is needed.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "User/ring.h"
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Store a byte, producer only
+ *
+ * @param ring Ring
+ * @param c Byte
+ * @return true Stored
+ * @return false Full, the byte is dropped and counted
+ */
+bool ring_put(ring_t* ring, uint8_t c) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t used = head - atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (used >= ring->size) {
+        ring->dropped++;
+        return false;
+    }
+    ring->data[head & (ring->size - 1)] = c;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    if (used + 1 > ring->high_water) {
+        ring->high_water = used + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Number of bytes that can be stored, producer only
+ * Only grows until the next ring_put().
+ */
+uint16_t ring_free(const ring_t* ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    return ring->size - (head - tail);
+}
+
+/**
+ * @brief Get the oldest unread bytes in place, consumer only
+ * Only the bytes up to the end of the data, the ones after the wrap are returned once these are consumed.
+ * Peeking again without consuming returns the same bytes, possibly more of them.
+ *
+ * @param ring Ring
+ * @param len Number of contiguous bytes returned
+ * @return const uint8_t* First byte, NULL if the ring is empty
+ */
+const uint8_t* ring_peek(ring_t* ring, uint16_t* len) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t start = tail & (ring->size - 1);
+    uint32_t used = head - tail;
+    uint32_t end = ring->size - start;
+
+    *len = used < end ? used : end;
+    return used ? ring->data + start : NULL;
+}
+
+/**
+ * @brief Give peeked bytes back to the producer, consumer only
+ *
+ * @param ring Ring
+ * @param len Number of bytes, at most what ring_peek() returned
+ */
+void ring_consume(ring_t* ring, uint16_t len) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+}
+
+/**
+ * @brief Get the fill level and statistics of a ring
+ * Read while they may change, they are not a consistent snapshot.
+ */
+void ring_get_stats(const ring_t* ring, ring_stats_t* stats) {
+    stats->size = ring->size;
+    stats->used = atomic_load(&ring->head) - atomic_load(&ring->tail);
+    stats->high_water = ring->high_water;
+    stats->dropped = ring->dropped;
+}
+
+/**
+ * @brief Clear the statistics, the high water mark starts over from the bytes stored
+ */
+void ring_reset_stats(ring_t* ring) {
+    ring->high_water = atomic_load(&ring->head) - atomic_load(&ring->tail);
+    ring->dropped = 0;
+}
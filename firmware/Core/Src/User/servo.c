@@ -0,0 +1,215 @@
+/**
+ * @file servo.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Steering servo, pulse width of a timer channel from a calibration kept in flash
+ * TIM5 is a 32 bit timer running at 96 MHz without prescaler, CH2 on PA1 gives the pulse with ~10 ns
+ * resolution at any frame rate. Pulse and frame are preloaded and start with the next frame, a new pulse
+ * never cuts into the running one. A faster frame rate gets a new steering angle to the servo sooner,
+ * it is part of the calibration since it depends on the servo fitted.
+ * The steering angle is mapped to the pulse by servo_map.c, the host build has a mock instead of this driver.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+#include "User/nvm.h"
+#include "User/servo.h"
+
+// ============= Private variables ===================
+static servo_calib_t s_calib;
+static float         s_pulse_us;
+
+// ============ Private function declaration =================
+static uint32_t s_timer_clock(void);
+static void     s_start(void);
+static void     s_output(void);
+
+//============ Private function implementation ===============
+static uint32_t s_timer_clock(void) {
+    // Timers on APB1 run at twice PCLK1 when the APB1 prescaler is not 1
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    return ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1) ? pclk1 : 2 * pclk1;
+}
+
+static void s_start(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_TIM5_CLK_ENABLE();
+
+    // PWM mode 1 with preload, high from the update to the compare
+    TIM5->CR1 = TIM_CR1_ARPE;
+    TIM5->PSC = 0;
+    TIM5->CCMR1 = TIM_CCMR1_OC2M_1 | TIM_CCMR1_OC2M_2 | TIM_CCMR1_OC2PE;
+    TIM5->CCER = TIM_CCER_CC2E;
+    s_output();
+    TIM5->EGR = TIM_EGR_UG;
+    TIM5->SR = 0;
+    TIM5->CR1 = TIM_CR1_ARPE | TIM_CR1_CEN;
+
+    GPIO_InitStruct.Pin = GPIO_PIN_1;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    GPIO_InitStruct.Alternate = GPIO_AF2_TIM5;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+}
+
+/**
+ * @brief Write frame and pulse to the preload registers, taken together at the next update
+ * Called with interrupts disabled, CR1 is read and written back.
+ */
+static void s_output(void) {
+    uint32_t clock = s_timer_clock();
+
+    TIM5->CR1 |= TIM_CR1_UDIS;
+    TIM5->ARR = clock / s_calib.frame_hz - 1;
+    TIM5->CCR2 = (uint32_t)(s_pulse_us * (clock / 1000000) + 0.5f);
+    TIM5->CR1 &= ~TIM_CR1_UDIS;
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Load the calibration and start the pulses, straight ahead
+ */
+void servo_init(void) {
+    if (!nvm_read(eNVM_SERVO_CALIB, &s_calib, sizeof(s_calib)) || !servo_map_valid(&s_calib)) {
+        s_calib = servo_calib_default;
+    }
+    s_pulse_us = s_calib.pulse_us[eSERVO_CENTER];
+    s_start();
+}
+
+/**
+ * @brief Steer from the next frame, callable from interrupts
+ *
+ * @param steer_deg Front wheel angle, positive to the left, clamped to full lock
+ */
+void servo_set(float steer_deg) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_pulse_us = servo_map_pulse(&s_calib, steer_deg);
+    s_output();
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Output a raw pulse from the next frame, to find the points of the calibration
+ *
+ * @param pulse_us SERVO_PULSE_MIN_US to SERVO_PULSE_MAX_US
+ * @return false if out of range
+ */
+bool servo_set_pulse(float pulse_us) {
+    if (!(pulse_us >= SERVO_PULSE_MIN_US && pulse_us <= SERVO_PULSE_MAX_US)) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_pulse_us = pulse_us;
+    s_output();
+    __set_PRIMASK(primask);
+    return true;
+}
+
+float servo_get_pulse(void) {
+    return s_pulse_us;
+}
+
+/**
+ * @brief Steering angle of the pulse output now, interpolated back through the calibration
+ *
+ * @return float Front wheel angle, positive to the left
+ */
+float servo_get(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    float angle = servo_map_angle(&s_calib, s_pulse_us);
+    __set_PRIMASK(primask);
+    return angle;
+}
+
+/**
+ * @brief Make the pulse output now a point of the calibration, in use right away but not saved
+ *
+ * @param point Full lock left, center or full lock right
+ * @return false if the center would not be between the others
+ */
+bool servo_set_point(servo_point_e point) {
+    servo_calib_t calib;
+
+    servo_get_calibration(&calib);
+    calib.pulse_us[point] = s_pulse_us;
+    if (!servo_map_valid(&calib)) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_calib = calib;
+    __set_PRIMASK(primask);
+    return true;
+}
+
+/**
+ * @brief Set the frame rate, in use from the next frame but not saved
+ *
+ * @param frame_hz SERVO_FRAME_HZ_MIN to SERVO_FRAME_HZ_MAX, the fastest the servo takes
+ * @return false if out of range
+ */
+bool servo_set_frame(uint16_t frame_hz) {
+    if (frame_hz < SERVO_FRAME_HZ_MIN || frame_hz > SERVO_FRAME_HZ_MAX) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_calib.frame_hz = frame_hz;
+    s_output();
+    __set_PRIMASK(primask);
+    return true;
+}
+
+/**
+ * @param calib Copy of the calibration in use
+ */
+void servo_get_calibration(servo_calib_t* calib) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *calib = s_calib;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Write the calibration to flash, it is loaded by servo_init()
+ * Blocks while the flash is written, see nvm.h. Only call it standing still.
+ *
+ * @return false if the flash could not be written
+ */
+bool servo_save_calibration(void) {
+    servo_calib_t calib;
+    servo_get_calibration(&calib);
+    return nvm_write(eNVM_SERVO_CALIB, &calib, sizeof(calib));
+}
+
+/**
+ * @brief Remove the calibration from flash and go back to the defaults, straight ahead
+ *
+ * @return false if the flash could not be written
+ */
+bool servo_clear_calibration(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_calib = servo_calib_default;
+    s_pulse_us = s_calib.pulse_us[eSERVO_CENTER];
+    s_output();
+    __set_PRIMASK(primask);
+    return nvm_erase(eNVM_SERVO_CALIB);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file servo_map.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Steering angle to pulse through the calibration, shared by the servo driver and its host mock
+ * The angle is interpolated from the center to the pulse at full lock on either side, so the center may be
+ * off the middle of the ends. Positive angles steer to the left, whichever way around the servo is fitted.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/geometry.h"
+#include "User/servo.h"
+
+// ==================== Global function implementation ==========================
+const servo_calib_t servo_calib_default = {
+    .pulse_us = {1900, 1500, 1100},
+    .frame_hz = SERVO_FRAME_HZ_MIN,
+};
+
+/**
+ * @brief Check a calibration before it is used
+ *
+ * @return false if a pulse is out of range, the center is not between the others or the frame is out of range
+ */
+bool servo_map_valid(const servo_calib_t* calib) {
+    const float* pulse = calib->pulse_us;
+
+    for (uint8_t p = 0; p < eSERVO_POINTS; p++) {
+        if (!(pulse[p] >= SERVO_PULSE_MIN_US && pulse[p] <= SERVO_PULSE_MAX_US)) {
+            return false;
+        }
+    }
+    bool between = (pulse[eSERVO_LEFT] < pulse[eSERVO_CENTER] && pulse[eSERVO_CENTER] < pulse[eSERVO_RIGHT]) ||
+                   (pulse[eSERVO_LEFT] > pulse[eSERVO_CENTER] && pulse[eSERVO_CENTER] > pulse[eSERVO_RIGHT]);
+    return between && calib->frame_hz >= SERVO_FRAME_HZ_MIN && calib->frame_hz <= SERVO_FRAME_HZ_MAX;
+}
+
+/**
+ * @brief Pulse for a steering angle
+ *
+ * @param calib Valid calibration
+ * @param steer_deg Front wheel angle, positive to the left, clamped to full lock
+ * @return float Pulse in us
+ */
+float servo_map_pulse(const servo_calib_t* calib, float steer_deg) {
+    float share = steer_deg / geometry_tables.vehicle.steer_max_deg;
+
+    if (share > 1) {
+        share = 1;
+    } else if (share < -1) {
+        share = -1;
+    }
+
+    float center = calib->pulse_us[eSERVO_CENTER];
+    float end = calib->pulse_us[share >= 0 ? eSERVO_LEFT : eSERVO_RIGHT];
+    return center + (end - center) * (share >= 0 ? share : -share);
+}
+
+/**
+ * @brief Steering angle of a pulse, the inverse of servo_map_pulse()
+ *
+ * @param calib Valid calibration
+ * @param pulse_us Pulse in us, beyond the ends gives angles beyond full lock
+ * @return float Front wheel angle, positive to the left
+ */
+float servo_map_angle(const servo_calib_t* calib, float pulse_us) {
+    float center = calib->pulse_us[eSERVO_CENTER];
+    float left = calib->pulse_us[eSERVO_LEFT];
+    float right = calib->pulse_us[eSERVO_RIGHT];
+
+    // The left point is on the same side of the center as the pulse when steering left
+    bool  to_left = (pulse_us - center) * (left - center) >= 0;
+    float end = to_left ? left : right;
+    float share = (pulse_us - center) / (end - center);
+    return geometry_tables.vehicle.steer_max_deg * (to_left ? share : -share);
+}
@@ -0,0 +1,780 @@
+/**
+ * @file vl53l1x.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Non-blocking driver for the ST VL53L1X time-of-flight sensor
+ * Same register sequences as the ST ultra lite driver (ULD), but every access is an asynchronous
+ * transfer queued on the I2C bus and the next step is taken from its done callback.
+ * A measurement costs two transfers started from the GPIO1 data ready interrupt, the CPU is never
+ * waiting on the bus.
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "main.h"
+
+#include "User/i2c.h"
+#include "User/vl53l1x.h"
+
+#define REG_I2C_SLAVE_DEVICE_ADDRESS             0x0001
+#define REG_VHV_CONFIG_TIMEOUT_MACROP_LOOP_BOUND 0x0008
+#define REG_VHV_CONFIG_INIT                      0x000B
+#define REG_ALGO_CROSSTALK_PLANE_OFFSET_KCPS     0x0016
+#define REG_ALGO_PART_TO_PART_RANGE_OFFSET_MM    0x001E
+#define REG_DEFAULT_CONFIG                       0x002D
+#define REG_GPIO_TIO_HV_STATUS                   0x0031
+#define REG_PHASECAL_CONFIG_TIMEOUT_MACROP       0x004B
+#define REG_RANGE_CONFIG_TIMEOUT_MACROP_A        0x005E
+#define REG_RANGE_CONFIG_VALID_PHASE_HIGH        0x0069
+#define REG_SD_CONFIG_WOI_SD0                    0x0078
+#define REG_ROI_CONFIG_USER_ROI_CENTRE_SPAD      0x007F
+#define REG_SYSTEM_INTERRUPT_CLEAR               0x0086
+#define REG_SYSTEM_MODE_START                    0x0087
+#define REG_RESULT_RANGE_STATUS                  0x0089
+#define REG_FIRMWARE_SYSTEM_STATUS               0x00E5
+#define REG_IDENTIFICATION_MODEL_ID              0x010F
+
+#define MODEL_ID         0xEACC
+#define MODE_START_RANGE  0x40 // Timed, continuous
+#define MODE_START_SINGLE 0x10 // One measurement, then idle
+#define MODE_START_STOP   0x00
+
+// Timing and region of interest after the default configuration
+#define DEFAULT_MODE             eVL53L1X_LONG
+#define DEFAULT_TIMING_BUDGET_MS 100
+#define DEFAULT_ROI_CENTER       199
+#define DEFAULT_ROI_SIZE         0xFF
+
+// Operations requested while the sensor is busy
+#define PENDING_START  (1 << 0)
+#define PENDING_STOP   (1 << 1)
+#define PENDING_READ   (1 << 2)
+#define PENDING_TIMING (1 << 3)
+#define PENDING_SINGLE (1 << 4)
+#define PENDING_ROI    (1 << 5)
+#define PENDING_OFFSET (1 << 6)
+#define PENDING_XTALK  (1 << 7)
+
+typedef enum {
+    eSTEP_NONE,
+    eSTEP_BOOT_POLL,   // Waiting for FIRMWARE__SYSTEM_STATUS
+    eSTEP_SET_ADDRESS, // New address written at the default address
+    eSTEP_MODEL_ID,    // First read at the new address
+    eSTEP_CONFIG,      // Default configuration written
+    eSTEP_VHV_START,   // First measurement started, it runs the VHV calibration
+    eSTEP_VHV_POLL,    // Waiting for the first measurement
+    eSTEP_VHV_CLEAR,
+    eSTEP_VHV_STOP,
+    eSTEP_VHV_BOUND,
+    eSTEP_VHV_INIT,
+    eSTEP_START,
+    eSTEP_STOP,
+    eSTEP_READ,         // Result registers read
+    eSTEP_CLEAR,        // Interrupt cleared, sensor continues with the next measurement
+    eSTEP_CLEAR_FAILED, // Interrupt cleared after a failed read, busy until the write is done
+    eSTEP_TIMING_PHASECAL, // Distance mode and timing budget, three writes
+    eSTEP_TIMING_RANGE,
+    eSTEP_TIMING_SD,
+    eSTEP_SINGLE,
+    eSTEP_ROI,
+    eSTEP_CALIBRATION, // Offset or crosstalk compensation written
+} step_e;
+
+typedef struct
+{
+    uint16_t budget_ms;
+    uint16_t macrop_a;
+    uint16_t macrop_b;
+} budget_t;
+
+typedef struct
+{
+    uint8_t         phasecal_timeout;  // PHASECAL_CONFIG__TIMEOUT_MACROP
+    uint8_t         vcsel_period_a;    // RANGE_CONFIG__VCSEL_PERIOD_A
+    uint8_t         vcsel_period_b;    // RANGE_CONFIG__VCSEL_PERIOD_B
+    uint8_t         valid_phase_high;  // RANGE_CONFIG__VALID_PHASE_HIGH
+    uint16_t        woi_sd0;           // SD_CONFIG__WOI_SD0
+    uint16_t        initial_phase_sd0; // SD_CONFIG__INITIAL_PHASE_SD0
+    const budget_t* budgets;           // Timeouts of the mode
+    uint8_t         budget_count;
+} distance_mode_t;
+
+// ============= Private variables ===================
+// Register 0x2D to 0x87, from VL51L1X_DEFAULT_CONFIGURATION in the ULD
+// with an active low GPIO1 so it can be open drain with a pull up
+static const uint8_t s_default_config[] = {
+    0x00, 0x00, 0x00, 0x11, 0x02, 0x00, 0x02, 0x08, 0x00, 0x08, 0x10, 0x01, 0x01, 0x00, 0x00, 0x00, // 0x2D
+    0x00, 0xFF, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x0B, 0x00, 0x00, 0x02, 0x0A, 0x21, // 0x3D
+    0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0xC8, 0x00, 0x00, 0x38, 0xFF, 0x01, 0x00, 0x08, 0x00, // 0x4D
+    0x00, 0x01, 0xCC, 0x0F, 0x01, 0xF1, 0x0D, 0x01, 0x68, 0x00, 0x80, 0x08, 0xB8, 0x00, 0x00, 0x00, // 0x5D
+    0x00, 0x0F, 0x89, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x0F, 0x0D, 0x0E, 0x0E, 0x00, // 0x6D
+    0x00, 0x02, 0xC7, 0xFF, 0x9B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00,                               // 0x7D
+};
+
+// RESULT__RANGE_STATUS to ULD range status
+static const uint8_t s_range_status[24] = {
+    255, 255, 255, 5, 2, 4, 1, 7, 3, 0, 255, 255, 9, 13, 255, 255, 255, 255, 10, 6, 255, 255, 11, 12,
+};
+
+// Timeouts for each timing budget, from VL53L1X_SetTimingBudgetInMs() in the ULD
+static const budget_t s_short_budgets[] = {
+    {15, 0x001D, 0x0027},
+    {20, 0x0051, 0x006E},
+    {33, 0x00D6, 0x006E},
+    {50, 0x01AE, 0x01E8},
+    {100, 0x02E1, 0x0388},
+    {200, 0x03E1, 0x0496},
+    {500, 0x0591, 0x05C1},
+};
+static const budget_t s_long_budgets[] = {
+    {20, 0x001E, 0x0022},
+    {33, 0x0060, 0x006E},
+    {50, 0x00AD, 0x00C6},
+    {100, 0x01CC, 0x01EA},
+    {200, 0x02D9, 0x02F8},
+    {500, 0x048F, 0x04A4},
+};
+
+// From VL53L1X_SetDistanceMode() in the ULD, indexed by vl53l1x_mode_e
+static const distance_mode_t s_modes[] = {
+    {0x14, 0x07, 0x05, 0x38, 0x0705, 0x0606, s_short_budgets, sizeof(s_short_budgets) / sizeof(budget_t)},
+    {0x0A, 0x0F, 0x0D, 0xB8, 0x0F0D, 0x0E0E, s_long_budgets, sizeof(s_long_budgets) / sizeof(budget_t)},
+};
+
+// ============ Private function declaration =================
+static uint8_t s_priority(const vl53l1x_t* dev);
+static void s_read(vl53l1x_t* dev, uint16_t reg, uint16_t len);
+static void s_write(vl53l1x_t* dev, uint16_t reg, const uint8_t* data, uint16_t len);
+static void s_write_byte(vl53l1x_t* dev, uint16_t reg, uint8_t value);
+static const budget_t* s_find_budget(uint8_t mode, uint16_t budget_ms);
+static void s_write_range_config(vl53l1x_t* dev);
+static void s_parse_result(vl53l1x_t* dev);
+static void s_boot_failed(vl53l1x_t* dev);
+static void s_retry(vl53l1x_t* dev, uint8_t op);
+static void s_request(vl53l1x_t* dev, uint8_t op);
+static void s_next(vl53l1x_t* dev);
+static void s_xfer_done(i2c_xfer_t* xfer, bool ok);
+
+//============ Private function implementation ===============
+/**
+ * @brief Results waiting in the sensors go first, boot and configuration give way to ranging
+ */
+static uint8_t s_priority(const vl53l1x_t* dev) {
+    if (dev->step == eSTEP_READ) {
+        return eI2C_PRIO_HIGH;
+    }
+    return dev->state == eVL53L1X_RANGING ? eI2C_PRIO_NORMAL : eI2C_PRIO_LOW;
+}
+
+static void s_read(vl53l1x_t* dev, uint16_t reg, uint16_t len) {
+    dev->xfer.address = dev->address;
+    dev->xfer.priority = s_priority(dev);
+    dev->xfer.read = true;
+    dev->xfer.reg = reg;
+    dev->xfer.data = dev->buffer;
+    dev->xfer.len = len;
+    i2c_submit(&dev->xfer);
+}
+
+static void s_write(vl53l1x_t* dev, uint16_t reg, const uint8_t* data, uint16_t len) {
+    dev->xfer.address = dev->address;
+    dev->xfer.priority = s_priority(dev);
+    dev->xfer.read = false;
+    dev->xfer.reg = reg;
+    dev->xfer.data = (uint8_t*)data; // Only read by the DMA
+    dev->xfer.len = len;
+    i2c_submit(&dev->xfer);
+}
+
+static void s_write_byte(vl53l1x_t* dev, uint16_t reg, uint8_t value) {
+    dev->buffer[0] = value;
+    s_write(dev, reg, dev->buffer, 1);
+}
+
+static const budget_t* s_find_budget(uint8_t mode, uint16_t budget_ms) {
+    if (mode >= sizeof(s_modes) / sizeof(s_modes[0])) {
+        return NULL;
+    }
+    for (uint8_t i = 0; i < s_modes[mode].budget_count; i++) {
+        if (s_modes[mode].budgets[i].budget_ms == budget_ms) {
+            return &s_modes[mode].budgets[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Timeouts and VCSEL periods of the mode and budget in one write, RANGE_CONFIG__TIMEOUT_MACROP_A
+ * to RANGE_CONFIG__VALID_PHASE_HIGH. The registers in between keep their default configuration.
+ */
+static void s_write_range_config(vl53l1x_t* dev) {
+    const distance_mode_t* mode = &s_modes[dev->mode];
+    const budget_t*        budget = s_find_budget(dev->mode, dev->budget_ms);
+    uint8_t                len = REG_RANGE_CONFIG_VALID_PHASE_HIGH - REG_RANGE_CONFIG_TIMEOUT_MACROP_A + 1;
+
+    memcpy(dev->buffer, &s_default_config[REG_RANGE_CONFIG_TIMEOUT_MACROP_A - REG_DEFAULT_CONFIG], len);
+    dev->buffer[0] = budget->macrop_a >> 8;
+    dev->buffer[1] = budget->macrop_a & 0xFF;
+    dev->buffer[2] = mode->vcsel_period_a;
+    dev->buffer[3] = budget->macrop_b >> 8;
+    dev->buffer[4] = budget->macrop_b & 0xFF;
+    dev->buffer[5] = mode->vcsel_period_b;
+    dev->buffer[len - 1] = mode->valid_phase_high;
+    dev->step = eSTEP_TIMING_RANGE;
+    s_write(dev, REG_RANGE_CONFIG_TIMEOUT_MACROP_A, dev->buffer, len);
+}
+
+/**
+ * @brief Decode the result registers, same as VL53L1X_GetResult() in the ULD
+ */
+static void s_parse_result(vl53l1x_t* dev) {
+    const uint8_t* b = dev->buffer;
+    uint8_t        status = b[0] & 0x1F;
+
+    dev->result.status = status < sizeof(s_range_status) ? s_range_status[status] : status;
+    dev->result.spads = b[3];
+    dev->result.ambient_kcps = ((b[7] << 8) | b[8]) * 8;
+    dev->result.distance_mm = (b[13] << 8) | b[14];
+    dev->result.signal_kcps = ((b[15] << 8) | b[16]) * 8;
+}
+
+static void s_boot_failed(vl53l1x_t* dev) {
+    dev->step = eSTEP_NONE;
+    dev->state = eVL53L1X_FAILED;
+    dev->errors++;
+    dev->callback(dev, eVL53L1X_EVT_BOOT_FAILED);
+}
+
+/**
+ * @brief Write the timing or the region of interest again after a failed write, up to VL53L1X_RETRIES in a row
+ * The owner already computes timeouts from the new values, dropping the request would leave the sensor behind.
+ */
+static void s_retry(vl53l1x_t* dev, uint8_t op) {
+    dev->step = eSTEP_NONE;
+    dev->errors++;
+    if (dev->retries >= VL53L1X_RETRIES) {
+        dev->retries = 0;
+        return;
+    }
+    dev->retries++;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    dev->pending |= op;
+    __set_PRIMASK(primask);
+}
+
+static void s_request(vl53l1x_t* dev, uint8_t op) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    dev->pending |= op;
+    __set_PRIMASK(primask);
+
+    s_next(dev);
+}
+
+/**
+ * @brief Start the next pending operation if the sensor is not busy
+ * Requests come from tasks, the data ready interrupt and done callbacks.
+ */
+static void s_next(vl53l1x_t* dev) {
+    uint8_t op = 0;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (dev->step == eSTEP_NONE && dev->pending) {
+        if (dev->pending & PENDING_STOP) {
+            op = PENDING_STOP;
+            dev->step = eSTEP_STOP;
+        } else if (dev->pending & PENDING_TIMING) {
+            op = PENDING_TIMING;
+            dev->step = eSTEP_TIMING_PHASECAL;
+        } else if (dev->pending & (PENDING_OFFSET | PENDING_XTALK)) {
+            op = (dev->pending & PENDING_OFFSET) ? PENDING_OFFSET : PENDING_XTALK;
+            dev->step = eSTEP_CALIBRATION;
+        } else if (dev->pending & PENDING_ROI) {
+            op = PENDING_ROI;
+            dev->step = eSTEP_ROI;
+        } else if (dev->pending & PENDING_START) {
+            op = PENDING_START;
+            dev->step = eSTEP_START;
+        } else if (dev->pending & PENDING_READ) {
+            // Before a new single shot, it clears the interrupt and the result would be lost
+            op = PENDING_READ;
+            dev->step = eSTEP_READ;
+        } else {
+            op = PENDING_SINGLE;
+            dev->step = eSTEP_SINGLE;
+        }
+        dev->pending &= ~op;
+    }
+    __set_PRIMASK(primask);
+
+    if (op == PENDING_STOP) {
+        s_write_byte(dev, REG_SYSTEM_MODE_START, MODE_START_STOP);
+    } else if (op == PENDING_START) {
+        // Clear a result left from before the stop together with the start, GPIO1 would stay asserted otherwise
+        dev->buffer[0] = 0x01;
+        dev->buffer[1] = MODE_START_RANGE;
+        s_write(dev, REG_SYSTEM_INTERRUPT_CLEAR, dev->buffer, 2);
+    } else if (op == PENDING_READ) {
+        s_read(dev, REG_RESULT_RANGE_STATUS, VL53L1X_RESULT_SIZE);
+    } else if (op == PENDING_TIMING) {
+        s_write_byte(dev, REG_PHASECAL_CONFIG_TIMEOUT_MACROP, s_modes[dev->mode].phasecal_timeout);
+    } else if (op == PENDING_OFFSET) {
+        // ALGO__PART_TO_PART_RANGE_OFFSET_MM in 1/4 mm, MM_CONFIG__INNER_OFFSET_MM and OUTER_OFFSET_MM cleared
+        uint16_t offset = (uint16_t)(dev->offset_mm * 4);
+        memset(dev->buffer, 0, 6);
+        dev->buffer[0] = offset >> 8;
+        dev->buffer[1] = offset & 0xFF;
+        s_write(dev, REG_ALGO_PART_TO_PART_RANGE_OFFSET_MM, dev->buffer, 6);
+    } else if (op == PENDING_XTALK) {
+        // ALGO__CROSSTALK_COMPENSATION_PLANE_OFFSET_KCPS in kcps per SPAD with 9 fraction bits, no X and Y gradient
+        uint16_t plane = (uint16_t)(((uint32_t)dev->xtalk_cps << 9) / 1000);
+        memset(dev->buffer, 0, 6);
+        dev->buffer[0] = plane >> 8;
+        dev->buffer[1] = plane & 0xFF;
+        s_write(dev, REG_ALGO_CROSSTALK_PLANE_OFFSET_KCPS, dev->buffer, 6);
+    } else if (op == PENDING_ROI) {
+        // ROI_CONFIG__USER_ROI_CENTRE_SPAD and ROI_CONFIG__USER_ROI_REQUESTED_GLOBAL_XY_SIZE
+        dev->buffer[0] = dev->roi_center;
+        dev->buffer[1] = dev->roi_size;
+        s_write(dev, REG_ROI_CONFIG_USER_ROI_CENTRE_SPAD, dev->buffer, 2);
+    } else if (op == PENDING_SINGLE) {
+        dev->buffer[0] = 0x01;
+        dev->buffer[1] = MODE_START_SINGLE;
+        s_write(dev, REG_SYSTEM_INTERRUPT_CLEAR, dev->buffer, 2);
+    }
+}
+
+/**
+ * @brief The sensor state machine, runs in I2C interrupt context
+ */
+static void s_xfer_done(i2c_xfer_t* xfer, bool ok) {
+    vl53l1x_t* dev = xfer->context;
+
+    switch (dev->step) {
+        case eSTEP_BOOT_POLL:
+            // The sensor NACKs until its firmware has booted
+            if (ok && (dev->buffer[0] & 0x01)) {
+                dev->step = eSTEP_SET_ADDRESS;
+                s_write_byte(dev, REG_I2C_SLAVE_DEVICE_ADDRESS, dev->new_address);
+            } else {
+                dev->waiting = true; // Read again from vl53l1x_poll(), not back to back
+            }
+            return;
+
+        case eSTEP_SET_ADDRESS:
+            if (!ok) {
+                s_boot_failed(dev);
+                return;
+            }
+            dev->address = dev->new_address;
+            dev->step = eSTEP_MODEL_ID;
+            s_read(dev, REG_IDENTIFICATION_MODEL_ID, 2);
+            return;
+
+        case eSTEP_MODEL_ID:
+            if (!ok || ((dev->buffer[0] << 8) | dev->buffer[1]) != MODEL_ID) {
+                s_boot_failed(dev);
+                return;
+            }
+            dev->step = eSTEP_CONFIG;
+            s_write(dev, REG_DEFAULT_CONFIG, s_default_config, sizeof(s_default_config));
+            return;
+
+        case eSTEP_CONFIG:
+            if (!ok) {
+                s_boot_failed(dev);
+                return;
+            }
+            dev->step = eSTEP_VHV_START;
+            s_write_byte(dev, REG_SYSTEM_MODE_START, MODE_START_RANGE);
+            return;
+
+        case eSTEP_VHV_START:
+            if (!ok) {
+                s_boot_failed(dev);
+                return;
+            }
+            dev->step = eSTEP_VHV_POLL;
+            dev->polling = false;
+            s_read(dev, REG_GPIO_TIO_HV_STATUS, 1);
+            return;
+
+        case eSTEP_VHV_POLL:
+            // GPIO1 is active low, bit 0 follows the pin
+            if (ok && !(dev->buffer[0] & 0x01)) {
+                dev->step = eSTEP_VHV_CLEAR;
+                s_write_byte(dev, REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
+            } else {
+                dev->waiting = true;
+            }
+            return;
+
+        case eSTEP_VHV_CLEAR:
+            dev->step = eSTEP_VHV_STOP;
+            s_write_byte(dev, REG_SYSTEM_MODE_START, MODE_START_STOP);
+            return;
+
+        case eSTEP_VHV_STOP:
+            dev->step = eSTEP_VHV_BOUND;
+            s_write_byte(dev, REG_VHV_CONFIG_TIMEOUT_MACROP_LOOP_BOUND, 0x09); // Two bounds VHV
+            return;
+
+        case eSTEP_VHV_BOUND:
+            dev->step = eSTEP_VHV_INIT;
+            s_write_byte(dev, REG_VHV_CONFIG_INIT, 0x00); // Start VHV from the previous temperature
+            return;
+
+        case eSTEP_VHV_INIT:
+            dev->step = eSTEP_NONE;
+            if (!ok) {
+                s_boot_failed(dev);
+                return;
+            }
+            dev->state = eVL53L1X_IDLE;
+            dev->callback(dev, eVL53L1X_EVT_BOOTED);
+            break;
+
+        case eSTEP_TIMING_PHASECAL:
+        case eSTEP_TIMING_RANGE:
+            if (!ok) {
+                s_retry(dev, PENDING_TIMING);
+                break;
+            }
+            if (dev->step == eSTEP_TIMING_PHASECAL) {
+                s_write_range_config(dev);
+            } else {
+                const distance_mode_t* mode = &s_modes[dev->mode];
+                dev->step = eSTEP_TIMING_SD;
+                dev->buffer[0] = mode->woi_sd0 >> 8;
+                dev->buffer[1] = mode->woi_sd0 & 0xFF;
+                dev->buffer[2] = mode->initial_phase_sd0 >> 8;
+                dev->buffer[3] = mode->initial_phase_sd0 & 0xFF;
+                s_write(dev, REG_SD_CONFIG_WOI_SD0, dev->buffer, 4);
+            }
+            return;
+
+        case eSTEP_TIMING_SD:
+        case eSTEP_ROI:
+            if (!ok) {
+                s_retry(dev, dev->step == eSTEP_ROI ? PENDING_ROI : PENDING_TIMING);
+                break;
+            }
+            dev->step = eSTEP_NONE;
+            dev->retries = 0;
+            break;
+
+        case eSTEP_CALIBRATION:
+            dev->step = eSTEP_NONE;
+            if (!ok) {
+                dev->errors++;
+            }
+            break;
+
+        case eSTEP_START:
+        case eSTEP_SINGLE:
+            dev->step = eSTEP_NONE;
+            if (ok) {
+                dev->state = eVL53L1X_RANGING;
+            } else {
+                dev->errors++;
+            }
+            break;
+
+        case eSTEP_STOP:
+            dev->step = eSTEP_NONE;
+            if (ok) {
+                dev->state = eVL53L1X_IDLE;
+            } else {
+                dev->errors++;
+            }
+            break;
+
+        case eSTEP_READ:
+            if (ok) {
+                s_parse_result(dev);
+            } else {
+                dev->errors++;
+                dev->callback(dev, eVL53L1X_EVT_READ_FAILED);
+            }
+            // Clear even if the read failed, otherwise GPIO1 stays asserted and no more interrupts arrive
+            dev->step = ok ? eSTEP_CLEAR : eSTEP_CLEAR_FAILED;
+            s_write_byte(dev, REG_SYSTEM_INTERRUPT_CLEAR, 0x01);
+            return;
+
+        case eSTEP_CLEAR:
+            dev->step = eSTEP_NONE;
+            if (ok) {
+                dev->results++;
+                dev->callback(dev, eVL53L1X_EVT_RESULT);
+            } else {
+                dev->errors++;
+                dev->callback(dev, eVL53L1X_EVT_READ_FAILED);
+            }
+            break;
+
+        case eSTEP_CLEAR_FAILED:
+            // The failed read is already reported
+            dev->step = eSTEP_NONE;
+            if (!ok) {
+                dev->errors++;
+            }
+            break;
+
+        case eSTEP_NONE:
+            // No transfer of this sensor on the bus
+            break;
+    }
+
+    s_next(dev);
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Initialize a sensor instance, does not touch the bus
+ * 
+ * @param dev Sensor
+ * @param callback Called on boot completion and for every result
+ * @param context For the owner of the sensor
+ */
+void vl53l1x_init(vl53l1x_t* dev, vl53l1x_callback_t callback, void* context) {
+    *dev = (vl53l1x_t){
+        .address = VL53L1X_DEFAULT_ADDRESS,
+        .state = eVL53L1X_OFF,
+        .callback = callback,
+        .context = context,
+    };
+    dev->xfer.done = s_xfer_done;
+    dev->xfer.context = dev;
+}
+
+/**
+ * @brief Boot a sensor that just left reset, assign its address and configure it
+ * Only the sensor being booted may be out of reset (XSHUT high) while it still has the default address.
+ * Finishes with eVL53L1X_EVT_BOOTED or eVL53L1X_EVT_BOOT_FAILED.
+ * 
+ * @param dev Sensor
+ * @param address New 7 bit address
+ */
+void vl53l1x_boot(vl53l1x_t* dev, uint8_t address) {
+    dev->address = VL53L1X_DEFAULT_ADDRESS;
+    dev->new_address = address;
+    dev->state = eVL53L1X_BOOTING;
+    dev->pending = 0;
+    dev->waiting = false;
+    dev->polling = false;
+    dev->retries = 0;
+    dev->mode = DEFAULT_MODE;
+    dev->budget_ms = DEFAULT_TIMING_BUDGET_MS;
+    dev->roi_center = DEFAULT_ROI_CENTER;
+    dev->roi_size = DEFAULT_ROI_SIZE;
+    dev->offset_mm = 0;
+    dev->xtalk_cps = 0;
+    dev->step = eSTEP_BOOT_POLL;
+    s_read(dev, REG_FIRMWARE_SYSTEM_STATUS, 1);
+}
+
+/**
+ * @brief Forget the state of a sensor its owner has put in reset (XSHUT low), boot it again afterwards
+ * Transfers to a sensor in reset fail, the one in flight must finish before the transfer is reused.
+ * 
+ * @param dev Sensor
+ * @return false while a transfer is still in flight, try again later
+ */
+bool vl53l1x_reset(vl53l1x_t* dev) {
+    bool idle;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    idle = dev->step == eSTEP_NONE;
+    if (idle) {
+        dev->state = eVL53L1X_OFF;
+        dev->pending = 0;
+        dev->address = VL53L1X_DEFAULT_ADDRESS;
+    }
+    __set_PRIMASK(primask);
+    return idle;
+}
+
+/**
+ * @brief Poll a sensor waiting for its boot or first measurement, call every VL53L1X_POLL_PERIOD_MS from a task
+ * A poll that is not ready waits for the next call instead of reading again at once, a sensor that is
+ * missing or stuck costs one failed read per period. The boot fails after VL53L1X_POLL_TIMEOUT_MS.
+ *
+ * @param dev Sensor
+ * @param now_ms Monotonic time in milliseconds, e.g. HAL_GetTick()
+ */
+void vl53l1x_poll(vl53l1x_t* dev, uint32_t now_ms) {
+    if (!dev->waiting) {
+        return;
+    }
+
+    // Nothing is in flight while waiting, the failure callback runs with interrupts disabled as from the I2C
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    dev->waiting = false;
+    if (!dev->polling) {
+        dev->polling = true;
+        dev->poll_ms = now_ms;
+    }
+    if (now_ms - dev->poll_ms >= VL53L1X_POLL_TIMEOUT_MS) {
+        s_boot_failed(dev);
+    } else if (dev->step == eSTEP_BOOT_POLL) {
+        s_read(dev, REG_FIRMWARE_SYSTEM_STATUS, 1);
+    } else {
+        s_read(dev, REG_GPIO_TIO_HV_STATUS, 1);
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Start continuous ranging, every result is signalled on GPIO1
+ * 
+ * @param dev Sensor
+ */
+void vl53l1x_start(vl53l1x_t* dev) {
+    if (dev->state == eVL53L1X_IDLE || dev->state == eVL53L1X_RANGING) {
+        s_request(dev, PENDING_START);
+    }
+}
+
+/**
+ * @brief Start a single measurement, the result is signalled on GPIO1 and the sensor goes idle
+ * Used to decide exactly when each sensor emits.
+ * 
+ * @param dev Sensor
+ */
+void vl53l1x_trigger(vl53l1x_t* dev) {
+    if (dev->state == eVL53L1X_IDLE || dev->state == eVL53L1X_RANGING) {
+        s_request(dev, PENDING_SINGLE);
+    }
+}
+
+/**
+ * @brief Set the timing budget, the time one measurement takes, in the current distance mode
+ * A longer budget gives less noise and more range. Applied before the next start or trigger.
+ * 
+ * @param dev Sensor
+ * @param budget_ms 20, 33, 50, 100, 200 or 500, 15 in short mode
+ * @return false if the sensor is not booted or the budget is not supported
+ */
+bool vl53l1x_set_timing_budget(vl53l1x_t* dev, uint16_t budget_ms) {
+    return vl53l1x_set_timing(dev, dev->mode, budget_ms);
+}
+
+/**
+ * @brief Set the distance mode and timing budget together, the budget registers depend on the mode
+ * Short mode ranges up to ~1.3 m and is less sensitive to ambient light, long mode up to ~4 m.
+ * Applied before the next start or trigger, nothing is written if both are unchanged.
+ * 
+ * @param dev Sensor
+ * @param mode Distance mode
+ * @param budget_ms See vl53l1x_set_timing_budget()
+ * @return false if the sensor is not booted or the budget is not supported in the mode
+ */
+bool vl53l1x_set_timing(vl53l1x_t* dev, vl53l1x_mode_e mode, uint16_t budget_ms) {
+    if (s_find_budget(mode, budget_ms) == NULL || (dev->state != eVL53L1X_IDLE && dev->state != eVL53L1X_RANGING)) {
+        return false;
+    }
+
+    if (mode != dev->mode || budget_ms != dev->budget_ms) {
+        dev->mode = mode;
+        dev->budget_ms = budget_ms;
+        s_request(dev, PENDING_TIMING);
+    }
+    return true;
+}
+
+/**
+ * @brief Select the SPADs used for ranging, a smaller region narrows the field of view
+ * The region is centered on a SPAD, numbered as in VL53L1X_SetROICenter() of the ULD.
+ * Applied before the next start or trigger, nothing is written if the region is unchanged.
+ * 
+ * @param dev Sensor
+ * @param center SPAD number of the center
+ * @param width 4 to 16 SPADs
+ * @param height 4 to 16 SPADs
+ * @return false if the sensor is not booted or the size is out of range
+ */
+bool vl53l1x_set_roi(vl53l1x_t* dev, uint8_t center, uint8_t width, uint8_t height) {
+    if (width < 4 || width > 16 || height < 4 || height > 16 ||
+        (dev->state != eVL53L1X_IDLE && dev->state != eVL53L1X_RANGING)) {
+        return false;
+    }
+
+    uint8_t size = ((height - 1) << 4) | (width - 1);
+    if (center != dev->roi_center || size != dev->roi_size) {
+        dev->roi_center = center;
+        dev->roi_size = size;
+        s_request(dev, PENDING_ROI);
+    }
+    return true;
+}
+
+/**
+ * @brief Set the range offset, added to every range. Same as VL53L1X_SetOffset() in the ULD.
+ * Replaces the factory offset until the next boot, applied before the next start or trigger.
+ * 
+ * @param dev Sensor
+ * @param offset_mm Offset, e.g. from a calibration against a target at a known distance
+ * @return false if the sensor is not booted
+ */
+bool vl53l1x_set_offset(vl53l1x_t* dev, int16_t offset_mm) {
+    if (dev->state != eVL53L1X_IDLE && dev->state != eVL53L1X_RANGING) {
+        return false;
+    }
+
+    dev->offset_mm = offset_mm;
+    s_request(dev, PENDING_OFFSET);
+    return true;
+}
+
+/**
+ * @brief Set the crosstalk compensation, the signal returned by a cover glass. Same as VL53L1X_SetXtalk() in the ULD.
+ * Replaces the factory value until the next boot, applied before the next start or trigger.
+ * 
+ * @param dev Sensor
+ * @param xtalk_cps Crosstalk per SPAD in counts per second, 0 disables the compensation
+ * @return false if the sensor is not booted
+ */
+bool vl53l1x_set_xtalk(vl53l1x_t* dev, uint16_t xtalk_cps) {
+    if (dev->state != eVL53L1X_IDLE && dev->state != eVL53L1X_RANGING) {
+        return false;
+    }
+
+    dev->xtalk_cps = xtalk_cps;
+    s_request(dev, PENDING_XTALK);
+    return true;
+}
+
+/**
+ * @brief Stop ranging
+ * 
+ * @param dev Sensor
+ */
+void vl53l1x_stop(vl53l1x_t* dev) {
+    if (dev->state == eVL53L1X_RANGING) {
+        s_request(dev, PENDING_STOP);
+    }
+}
+
+/**
+ * @brief Call from the GPIO1 falling edge interrupt, reads the result and clears the interrupt
+ * 
+ * @param dev Sensor
+ */
+void vl53l1x_data_ready(vl53l1x_t* dev) {
+    // The interrupt also fires for the calibration measurement during boot, that one is polled
+    if (dev->state == eVL53L1X_RANGING) {
+        s_request(dev, PENDING_READ);
+    }
+}
@@ -0,0 +1,180 @@
+/**
+ * @file wheel.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Closed loop wheel speed, the controller of wheel_pid.h run with every encoder sample
+ * The controller runs as listener of the encoder, in the TIM2 sample interrupt at ENCODER_RATE_HZ, right
+ * after the speed is estimated, and sets the motor duty for the next PWM period. The duty is compensated for
+ * the battery voltage and limited by the low voltage policy of battery.h, while it cuts the motor the wheel
+ * coasts and the controller starts over from the speed then. Execution time and the period between two runs
+ * are recorded in histograms, the period shows the jitter of the interrupt.
+ * While on, every run can be logged for a step response.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+#include "User/battery.h"
+#include "User/cycles.h"
+#include "User/encoder.h"
+#include "User/motor.h"
+#include "User/prof.h"
+#include "User/wheel.h"
+#include "User/wheel_pid.h"
+
+#define DT_S (1.0f / ENCODER_RATE_HZ)
+
+// ============= Private variables ===================
+// Tuned on the plant model of wheel_sim.c, top speed 5000 mm/s at full duty and 150 ms time constant
+static wheel_pid_config_t s_config = {
+    .kp = 0.0009f,
+    .ki = 0.006f,
+    .kd = 0,
+    .kv = 1.0f / 5000,
+    .ka = 0.15f / 5000,
+    .ks = 0.05f,
+    .integral_max = 0.5f,
+    .duty_max = 1.0f,
+    .accel_mm_s2 = 8000,
+};
+
+static wheel_pid_t  s_pid;
+static bool         s_on;
+static float        s_command_mm_s;
+static float        s_speed_mm_s;
+static wheel_log_t  s_log[WHEEL_LOG_SAMPLES];
+static uint16_t     s_logged = WHEEL_LOG_SAMPLES; // Full, not logging
+static uint32_t     s_last;                       // cycles_now() of the previous run
+static prof_scope_t s_exec = {.name = "wheel control"};
+static prof_scope_t s_period = {.name = "wheel period"};
+
+// ============ Private function declaration =================
+static void s_control(const encoder_state_t* state);
+
+//============ Private function implementation ===============
+static void s_control(const encoder_state_t* state) {
+    uint32_t start = cycles_now();
+
+    if (s_last != 0) {
+        prof_record(&s_period, start - s_last);
+    }
+    s_last = start;
+    s_speed_mm_s = state->speed_mm_s;
+
+    float limit = battery_get_limit();
+    if (s_on && limit <= 0) {
+        wheel_pid_reset(&s_pid, state->speed_mm_s);
+        motor_coast();
+    } else if (s_on) {
+        float duty = wheel_pid_update(&s_pid, s_command_mm_s, state->speed_mm_s, battery_get_supply(), limit, DT_S);
+        motor_set(duty);
+
+        if (s_logged < WHEEL_LOG_SAMPLES) {
+            s_log[s_logged++] = (wheel_log_t){
+                .target_mm_s = (int16_t)s_pid.target_mm_s,
+                .speed_mm_s = (int16_t)state->speed_mm_s,
+                .duty = (int16_t)(duty * 10000),
+            };
+        }
+    }
+
+    prof_record(&s_exec, cycles_now() - start);
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Run with the encoder samples, off until a speed is set. Call after encoder_init() and motor_init().
+ */
+void wheel_init(void) {
+    wheel_pid_init(&s_pid, &s_config);
+    encoder_set_listener(s_control);
+}
+
+/**
+ * @brief Drive at a speed, reached at the configured acceleration. Takes over the motor from the speed now.
+ *
+ * @param speed_mm_s Positive forward
+ */
+void wheel_set(float speed_mm_s) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!s_on) {
+        wheel_pid_reset(&s_pid, s_speed_mm_s);
+        s_on = true;
+    }
+    s_command_mm_s = speed_mm_s;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Stop controlling and let the motor coast
+ */
+void wheel_off(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_on = false;
+    s_command_mm_s = 0;
+    motor_coast();
+    __set_PRIMASK(primask);
+}
+
+void wheel_get(wheel_state_t* state) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *state = (wheel_state_t){
+        .on = s_on,
+        .command_mm_s = s_command_mm_s,
+        .target_mm_s = s_pid.target_mm_s,
+        .speed_mm_s = s_speed_mm_s,
+        .duty = s_on ? s_pid.duty : 0,
+    };
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Gains and limits in use, changes take effect with the next run
+ */
+wheel_pid_config_t* wheel_get_config(void) {
+    return &s_config;
+}
+
+/**
+ * @brief Log the next WHEEL_LOG_SAMPLES runs, only while on
+ */
+void wheel_start_log(void) {
+    s_logged = 0;
+}
+
+/**
+ * @brief Get the log
+ *
+ * @param log Set to the samples, oldest first
+ * @return uint16_t Samples logged so far, WHEEL_LOG_SAMPLES when done
+ */
+uint16_t wheel_get_log(const wheel_log_t** log) {
+    *log = s_log;
+    return s_logged;
+}
+
+/**
+ * @brief Execution time of the controller and period between its runs, in cycles
+ */
+void wheel_get_timing(prof_stats_t* exec, prof_stats_t* period) {
+    prof_get_stats(&s_exec, exec);
+    prof_get_stats(&s_period, period);
+}
+
+void wheel_reset_timing(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_exec = (prof_scope_t){.name = s_exec.name};
+    s_period = (prof_scope_t){.name = s_period.name};
+    s_last = 0;
+    __set_PRIMASK(primask);
+}
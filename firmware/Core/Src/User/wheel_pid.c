@@ -0,0 +1,96 @@
+/**
+ * @file wheel_pid.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Wheel speed controller, PID with feedforward, anti-windup and an acceleration limited target
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/wheel_pid.h"
+
+// ============ Private function declaration =================
+static float s_clamp(float value, float limit);
+
+//============ Private function implementation ===============
+static float s_clamp(float value, float limit) {
+    if (value > limit) {
+        return limit;
+    }
+    if (value < -limit) {
+        return -limit;
+    }
+    return value;
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Start standing still
+ *
+ * @param pid Controller
+ * @param config Gains and limits, kept by reference so they can be tuned while running
+ */
+void wheel_pid_init(wheel_pid_t* pid, const wheel_pid_config_t* config) {
+    *pid = (wheel_pid_t){.config = config};
+}
+
+/**
+ * @brief Forget the integral and start the target from the current speed, before taking over the motor
+ *
+ * @param pid Controller
+ * @param speed_mm_s Measured speed
+ */
+void wheel_pid_reset(wheel_pid_t* pid, float speed_mm_s) {
+    pid->target_mm_s = speed_mm_s;
+    pid->integral = 0;
+    pid->speed_mm_s = speed_mm_s;
+    pid->duty = 0;
+    pid->saturated = false;
+}
+
+/**
+ * @brief Run one step of the controller
+ *
+ * @param pid Controller
+ * @param command_mm_s Commanded speed, reached at the configured acceleration
+ * @param speed_mm_s Measured speed
+ * @param supply Battery voltage relative to the nominal one
+ * @param limit Largest duty allowed now, the output is also clamped to duty_max
+ * @param dt_s Time since the previous step
+ * @return float Duty for the motor
+ */
+float wheel_pid_update(wheel_pid_t* pid, float command_mm_s, float speed_mm_s, float supply, float limit, float dt_s) {
+    const wheel_pid_config_t* config = pid->config;
+
+    // The acceleration asked for stays in the feedforward while the target waits for the motor
+    float ramp = s_clamp(command_mm_s - pid->target_mm_s, config->accel_mm_s2 * dt_s);
+    if (!pid->saturated || (ramp > 0) != (pid->duty > 0)) {
+        pid->target_mm_s += ramp;
+    }
+
+    float feedforward = config->kv * pid->target_mm_s + config->ka * ramp / dt_s;
+    if (pid->target_mm_s > 0) {
+        feedforward += config->ks;
+    } else if (pid->target_mm_s < 0) {
+        feedforward -= config->ks;
+    }
+
+    // No integration further into a saturated output
+    float error = pid->target_mm_s - speed_mm_s;
+    if (!pid->saturated || (error > 0) != (pid->duty > 0)) {
+        pid->integral = s_clamp(pid->integral + config->ki * error * dt_s, config->integral_max);
+    }
+
+    float derivative = -config->kd * (speed_mm_s - pid->speed_mm_s) / dt_s;
+    pid->speed_mm_s = speed_mm_s;
+
+    float duty = (feedforward + config->kp * error + pid->integral + derivative) / supply;
+    pid->duty = s_clamp(duty, limit < config->duty_max ? limit : config->duty_max);
+    pid->saturated = pid->duty != duty;
+    return pid->duty;
+}
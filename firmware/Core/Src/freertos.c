@@ -25,9 +25,16 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "User/battery.h"
 #include "User/button.h"
 #include "User/cli.h"
 #include "User/coms.h"
+#include "User/control.h"
+#include "User/encoder.h"
+#include "User/lidar.h"
+#include "User/motor.h"
+#include "User/servo.h"
+#include "User/wheel.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -47,9 +54,11 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN Variables */
+static const char* volatile s_overflow_task; // Task whose stack overflowed, for the debugger
 osThreadId comsTaskHandle;
 osThreadId cliTaskHandle;
 osThreadId buttonTaskHandle;
+osThreadId controlTaskHandle;
 /* USER CODE END Variables */
 osThreadId defaultTaskHandle;
 
@@ -63,6 +72,21 @@ void StartDefaultTask(void const* argument);
 extern void MX_USB_DEVICE_Init(void);
 void        MX_FREERTOS_Init(void); /* (MISRA C 2004 rule 8.1) */
 
+/* Hook prototypes */
+void vApplicationStackOverflowHook(xTaskHandle xTask, signed char* pcTaskName);
+
+/* USER CODE BEGIN 4 */
+/**
+ * @brief Called by the kernel when a task switched out with its stack past the end or its last words written
+ * The memory after the stack is corrupt, stop with the motor coasting instead of running on with it.
+ */
+void vApplicationStackOverflowHook(xTaskHandle xTask, signed char* pcTaskName) {
+    s_overflow_task = (const char*)pcTaskName;
+    motor_coast();
+    Error_Handler();
+}
+/* USER CODE END 4 */
+
 /**
   * @brief  FreeRTOS initialization
   * @param  None
@@ -91,7 +115,7 @@ void MX_FREERTOS_Init(void) {
 
     /* Create the thread(s) */
     /* definition and creation of defaultTask */
-    osThreadDef(defaultTask, StartDefaultTask, osPriorityHigh, 0, 128);
+    osThreadDef(defaultTask, StartDefaultTask, osPriorityHigh, 0, 512);
     defaultTaskHandle = osThreadCreate(osThread(defaultTask), NULL);
 
     /* USER CODE BEGIN RTOS_THREADS */
@@ -103,6 +127,9 @@ void MX_FREERTOS_Init(void) {
 
     osThreadDef(buttonTask, button_task, osPriorityNormal, 0, 512);
     buttonTaskHandle = osThreadCreate(osThread(buttonTask), NULL);
+
+    osThreadDef(controlTask, control_task, osPriorityRealtime, 0, 256); // Above all, woken by TIM4 only
+    controlTaskHandle = osThreadCreate(osThread(controlTask), NULL);
     /* USER CODE END RTOS_THREADS */
 }
 
@@ -117,9 +144,18 @@ void StartDefaultTask(void const* argument) {
     /* init code for USB_DEVICE */
     MX_USB_DEVICE_Init();
     /* USER CODE BEGIN StartDefaultTask */
+    motor_init();   // Coasting until commanded
+    servo_init();   // Straight ahead, calibration from flash
+    encoder_init(); // Samples from its own timer interrupt
+    battery_init(); // Converts continuously by DMA, the low voltage policy of the wheel
+    wheel_init();   // Speed control with every encoder sample, off until commanded
+    lidar_init();   // Boots the sensors from interrupts, does not block
+    control_init(); // Control cycles from now on, not driving until started
+
     /* Infinite loop */
     for (;;) {
-        osDelay(500);
+        lidar_poll(HAL_GetTick()); // Lidar health, times out and reboots sensors that stopped working
+        osDelay(LIDAR_POLL_MS);
     }
     /* USER CODE END StartDefaultTask */
 }
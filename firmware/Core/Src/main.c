@@ -26,6 +26,7 @@
 /* USER CODE BEGIN Includes */
 #include <string.h>
 
+#include "User/cycles.h"
 #include "stm32f4xx_it.h"
 #include "usbd_cdc_if.h"
 /* USER CODE END Includes */
@@ -90,6 +91,7 @@ int main(void) {
     /* Initialize all configured peripherals */
     MX_GPIO_Init();
     /* USER CODE BEGIN 2 */
+    cycles_init();
     /* USER CODE END 2 */
 
     /* Call init function for freertos objects (in freertos.c) */
@@ -234,7 +234,7 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length) {
   */
 static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t* Len) {
     /* USER CODE BEGIN 6 */
-    // Received characters should individually be sent to the CLI
+    // Received characters are copied into the coms RX ring, the packet buffer is reused right away
     for (uint32_t i = 0; i < *Len; i++) {
         coms_add_rx(Buf[i]);
     }
@@ -288,6 +288,8 @@ static int8_t CDC_TransmitCplt_FS(uint8_t* Buf, uint32_t* Len, uint8_t epnum) {
     UNUSED(Buf);
     UNUSED(Len);
     UNUSED(epnum);
+    // The bytes were sent straight out of the coms TX ring, release them
+    coms_tx_done();
     /* USER CODE END 13 */
     return result;
 }
@@ -0,0 +1,57 @@
+/**
+ * @file FreeRTOSConfig.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief FreeRTOS configuration for the host build on the POSIX/GCC port
+ * Mirrors Core/Inc/FreeRTOSConfig.h where it matters to the application (priorities, tick rate, APIs).
+ * Task stacks below PTHREAD_STACK_MIN fall back to the default pthread stack.
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include <assert.h>
+
+#define configUSE_PREEMPTION                    1
+#define configSUPPORT_STATIC_ALLOCATION         0
+#define configSUPPORT_DYNAMIC_ALLOCATION        1
+#define configUSE_IDLE_HOOK                     0
+#define configUSE_TICK_HOOK                     0
+#define configUSE_MALLOC_FAILED_HOOK            0
+#define configCHECK_FOR_STACK_OVERFLOW          0
+#define configTICK_RATE_HZ                      ((TickType_t)1000)
+#define configMAX_PRIORITIES                    (7)
+#define configMINIMAL_STACK_SIZE                ((unsigned short)128)
+#define configTOTAL_HEAP_SIZE                   ((size_t)(1024 * 1024))
+#define configMAX_TASK_NAME_LEN                 (16)
+#define configUSE_16_BIT_TICKS                  0
+#define configUSE_MUTEXES                       1
+#define configUSE_RECURSIVE_MUTEXES             1
+#define configUSE_COUNTING_SEMAPHORES           1
+#define configQUEUE_REGISTRY_SIZE               8
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+#define configUSE_TRACE_FACILITY                1
+#define configMESSAGE_BUFFER_LENGTH_TYPE        size_t
+
+#define configUSE_CO_ROUTINES                   0
+#define configMAX_CO_ROUTINE_PRIORITIES         (2)
+
+#define INCLUDE_vTaskPrioritySet                1
+#define INCLUDE_uxTaskPriorityGet               1
+#define INCLUDE_vTaskDelete                     1
+#define INCLUDE_vTaskCleanUpResources           0
+#define INCLUDE_vTaskSuspend                    1
+#define INCLUDE_vTaskDelayUntil                 0
+#define INCLUDE_vTaskDelay                      1
+#define INCLUDE_xTaskGetSchedulerState          1
+#define INCLUDE_xTaskGetCurrentTaskHandle       1
+#define INCLUDE_uxTaskGetStackHighWaterMark     1
+#define INCLUDE_xTaskGetHandle                  1
+
+#define configASSERT(x)                         assert(x)
+
+#endif /* FREERTOS_CONFIG_H */
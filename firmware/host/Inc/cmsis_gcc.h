@@ -0,0 +1,49 @@
+/**
+ * @file cmsis_gcc.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host stand-in for the CMSIS core intrinsics used by the application and cmsis_os.c
+ * Code never runs in handler mode on the host and there are no interrupts to mask,
+ * FreeRTOS critical sections are provided by the POSIX port.
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef HOST_CMSIS_GCC_H_
+#define HOST_CMSIS_GCC_H_
+
+#include <stdint.h>
+
+#ifndef __ASM
+#define __ASM __asm
+#endif
+#ifndef __INLINE
+#define __INLINE inline
+#endif
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE static inline
+#endif
+
+static inline uint32_t __get_IPSR(void) {
+    return 0;
+}
+
+static inline uint32_t __get_PRIMASK(void) {
+    return 0;
+}
+
+static inline void __set_PRIMASK(uint32_t primask) {
+    (void)primask;
+}
+
+static inline void __disable_irq(void) {}
+
+static inline void __enable_irq(void) {}
+
+static inline void __DMB(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif /* HOST_CMSIS_GCC_H_ */
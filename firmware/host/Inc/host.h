@@ -0,0 +1,20 @@
+/**
+ * @file host.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host stand-ins polled by the host I/O task
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef HOST_HOST_H_
+#define HOST_HOST_H_
+
+void host_keys_init(void);
+void host_keys_poll(void);
+void host_cdc_init(void);
+void host_cdc_poll(void);
+
+#endif /* HOST_HOST_H_ */
@@ -0,0 +1,45 @@
+/**
+ * @file main.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host stand-in for Core/Inc/main.h, same pin names on the in-memory GPIO ports
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef __MAIN_H
+#define __MAIN_H
+
+#include "stm32f4xx_hal.h"
+
+void Error_Handler(void);
+
+#define LED_Pin          GPIO_PIN_0
+#define LED_GPIO_Port    GPIOA
+#define BUTTON_Pin       GPIO_PIN_3
+#define BUTTON_GPIO_Port GPIOA
+
+#define LIDAR1_INT_Pin         GPIO_PIN_0
+#define LIDAR1_INT_GPIO_Port   GPIOB
+#define LIDAR2_INT_Pin         GPIO_PIN_1
+#define LIDAR2_INT_GPIO_Port   GPIOB
+#define LIDAR3_INT_Pin         GPIO_PIN_2
+#define LIDAR3_INT_GPIO_Port   GPIOB
+#define LIDAR4_INT_Pin         GPIO_PIN_4
+#define LIDAR4_INT_GPIO_Port   GPIOB
+#define LIDAR5_INT_Pin         GPIO_PIN_10
+#define LIDAR5_INT_GPIO_Port   GPIOB
+#define LIDAR1_XSHUT_Pin       GPIO_PIN_12
+#define LIDAR1_XSHUT_GPIO_Port GPIOB
+#define LIDAR2_XSHUT_Pin       GPIO_PIN_13
+#define LIDAR2_XSHUT_GPIO_Port GPIOB
+#define LIDAR3_XSHUT_Pin       GPIO_PIN_14
+#define LIDAR3_XSHUT_GPIO_Port GPIOB
+#define LIDAR4_XSHUT_Pin       GPIO_PIN_15
+#define LIDAR4_XSHUT_GPIO_Port GPIOB
+#define LIDAR5_XSHUT_Pin       GPIO_PIN_15
+#define LIDAR5_XSHUT_GPIO_Port GPIOA
+
+#endif /* __MAIN_H */
@@ -0,0 +1,77 @@
+/**
+ * @file sim.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Simulated peripherals of the host build
+ * The I2C bus implements User/i2c.h and routes transfers to simulated VL53L1X sensors.
+ * The encoder implements User/encoder.h on a simulated quadrature encoder turning at a set speed.
+ * The motor implements User/motor.h and records the waveform of the H-bridge inputs.
+ * The servo implements User/servo.h and keeps the pulse and frame rate the timer would output.
+ * All advance in simulated time, call the step functions with a monotonic microsecond time.
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef HOST_SIM_H_
+#define HOST_SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "main.h"
+
+#include "User/i2c.h"
+#include "User/motor.h"
+
+#define SIM_LIDAR_MAX       8
+#define SIM_LIDAR_BOOT_US   1200  // tBOOT after XSHUT is released
+#define SIM_LIDAR_PERIOD_US 50000 // Time between two measurements when ranging continuously
+#define SIM_LIDAR_NOISE_MM  3     // Peak range noise
+#define SIM_LIDAR_SHORT_MM  1300  // Range in short distance mode
+
+#define SIM_MOTOR_RECORDS 256
+
+typedef struct
+{
+    uint32_t    at_us; // Start of the first period with the waveform
+    motor_pwm_t pwm;
+} sim_motor_record_t;
+
+void sim_lidar_attach(
+    uint8_t index, GPIO_TypeDef* xshut_port, uint16_t xshut_pin, GPIO_TypeDef* int_port, uint16_t int_pin
+);
+void     sim_lidar_set_distance(uint8_t index, uint16_t distance_mm);
+void     sim_lidar_set_gradient(uint8_t index, int16_t mm_per_column);
+void     sim_lidar_set_dead(uint8_t index, bool dead);
+void     sim_lidar_set_stuck(uint8_t index, bool stuck);
+void     sim_lidar_set_nacks(uint8_t index, uint16_t permille);
+void     sim_lidar_set_faults(uint8_t index, uint16_t permille);
+void     sim_lidar_set_glass(uint8_t index, int16_t offset_mm, uint16_t xtalk_cps);
+void     sim_lidar_step(uint32_t now_us);
+bool     sim_lidar_read(uint8_t address, uint16_t reg, uint8_t* data, uint16_t len);
+bool     sim_lidar_write(uint8_t address, uint16_t reg, const uint8_t* data, uint16_t len);
+uint32_t sim_lidar_get_measurements(uint8_t index);
+uint32_t sim_lidar_get_collisions(void);
+uint32_t sim_lidar_get_crosstalk(void);
+
+void     sim_i2c_step(uint32_t now_us);
+void     sim_i2c_lockup(void);
+bool     sim_i2c_is_pending(const i2c_xfer_t* xfer);
+uint32_t sim_i2c_get_resubmits(void);
+
+void    sim_encoder_set_speed(float speed_mm_s);
+void    sim_encoder_step(uint32_t now_us);
+int32_t sim_encoder_get_counts(void);
+
+void     sim_motor_step(uint32_t now_us);
+uint32_t sim_motor_read(sim_motor_record_t* records, uint32_t max);
+void     sim_motor_get_active(motor_pwm_t* pwm);
+
+void sim_servo_get_output(float* pulse_us, uint16_t* frame_hz);
+
+void sim_battery_set_mv(float mv);
+void sim_battery_step(uint32_t now_us);
+
+#endif /* HOST_SIM_H_ */
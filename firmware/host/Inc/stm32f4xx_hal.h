@@ -0,0 +1,88 @@
+/**
+ * @file stm32f4xx_hal.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host stand-in for the subset of the STM32 HAL used by the application
+ * GPIO pins and the flash sectors used by nvm.c are kept in memory, see host/Src/hal_host.c.
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef HOST_STM32F4XX_HAL_H_
+#define HOST_STM32F4XX_HAL_H_
+
+#include <stdint.h>
+
+#include "cmsis_gcc.h"
+
+#define UNUSED(X) (void)X
+
+typedef enum { HAL_OK = 0x00U, HAL_ERROR = 0x01U, HAL_BUSY = 0x02U, HAL_TIMEOUT = 0x03U } HAL_StatusTypeDef;
+
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+
+typedef struct
+{
+    uint16_t odr; // Output data
+    uint16_t idr; // Input data
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef host_gpioa;
+extern GPIO_TypeDef host_gpiob;
+
+#define GPIOA (&host_gpioa)
+#define GPIOB (&host_gpiob)
+
+#define GPIO_PIN_0  ((uint16_t)0x0001)
+#define GPIO_PIN_1  ((uint16_t)0x0002)
+#define GPIO_PIN_2  ((uint16_t)0x0004)
+#define GPIO_PIN_3  ((uint16_t)0x0008)
+#define GPIO_PIN_4  ((uint16_t)0x0010)
+#define GPIO_PIN_5  ((uint16_t)0x0020)
+#define GPIO_PIN_6  ((uint16_t)0x0040)
+#define GPIO_PIN_7  ((uint16_t)0x0080)
+#define GPIO_PIN_8  ((uint16_t)0x0100)
+#define GPIO_PIN_9  ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void          HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void          HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+uint32_t      HAL_GetTick(void);
+void          HAL_Delay(uint32_t Delay);
+void          HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+#define FLASH_TYPEPROGRAM_WORD  0x02U
+#define FLASH_TYPEERASE_SECTORS 0x00U
+#define FLASH_SECTOR_6          6U
+#define FLASH_SECTOR_7          7U
+#define FLASH_VOLTAGE_RANGE_3   0x02U
+
+typedef struct
+{
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t Sector;
+    uint32_t NbSectors;
+    uint32_t VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+// Only sectors 6 and 7, addresses are in host_flash
+extern uint32_t host_flash[2 * 128 * 1024 / 4];
+
+void host_flash_cut(uint32_t ops);
+void host_flash_restore(void);
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* SectorError);
+
+#endif /* HOST_STM32F4XX_HAL_H_ */
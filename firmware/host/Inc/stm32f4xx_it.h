@@ -0,0 +1,15 @@
+/**
+ * @file stm32f4xx_it.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host stand-in for Core/Inc/stm32f4xx_it.h, there are no interrupt handlers on the host
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef __STM32F4xx_IT_H
+#define __STM32F4xx_IT_H
+
+#endif /* __STM32F4xx_IT_H */
@@ -0,0 +1,25 @@
+/**
+ * @file usbd_cdc_if.h
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host stand-in for the USB CDC interface, the virtual COM port is a pseudo terminal
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#ifndef __USBD_CDC_IF_H__
+#define __USBD_CDC_IF_H__
+
+#include <stdint.h>
+
+#include "stm32f4xx_hal.h"
+
+#define USBD_OK   0U
+#define USBD_BUSY 1U
+#define USBD_FAIL 3U
+
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
+
+#endif /* __USBD_CDC_IF_H__ */
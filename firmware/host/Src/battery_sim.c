@@ -0,0 +1,100 @@
+/**
+ * @file battery_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host implementation of User/battery.h on a simulated battery voltage
+ * sim_battery_step() averages the set voltage over blocks as long as the DMA fills them on target and runs
+ * every block mean through the same monitor, like the DMA interrupt does.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+#include "User/battery.h"
+#include "User/battery_monitor.h"
+
+#define BLOCK_US 2624 // BATTERY_BLOCK pairs of 984 cycles at 12 MHz ADC clock, as on target
+
+// ============= Private variables ===================
+static battery_monitor_t s_monitor;
+static bool              s_initialized;
+static float             s_mv = BATTERY_NOMINAL_MV;
+static float             s_sum;      // mV times us in the block so far
+static uint32_t          s_now_us;   // Simulated up to
+static uint32_t          s_block_us; // End of the block
+static bool              s_started;
+
+// ==================== Global function implementation ==========================
+void battery_init(void) {
+    battery_monitor_init(&s_monitor);
+    s_initialized = true;
+}
+
+void battery_reset(void) {
+    battery_monitor_reset(&s_monitor);
+}
+
+void battery_get(battery_state_t* state) {
+    *state = (battery_state_t){
+        .mv = s_monitor.mv,
+        .min_mv = s_monitor.min_mv,
+        .vdda_mv = 3300,
+        .level = s_monitor.level,
+        .limit = s_monitor.limit,
+        .blocks = s_monitor.blocks,
+        .cutoffs = s_monitor.cutoffs,
+    };
+}
+
+float battery_get_supply(void) {
+    return s_monitor.mv / s_monitor.config.nominal_mv;
+}
+
+float battery_get_limit(void) {
+    return s_monitor.limit;
+}
+
+battery_config_t* battery_get_config(void) {
+    return &s_monitor.config;
+}
+
+/**
+ * @brief Set the battery voltage from now on
+ */
+void sim_battery_set_mv(float mv) {
+    s_mv = mv;
+}
+
+/**
+ * @brief Average the voltage up to now and update the monitor with every block that is complete
+ *
+ * @param now_us Monotonic time in microseconds
+ */
+void sim_battery_step(uint32_t now_us) {
+    if (!s_initialized) {
+        return;
+    }
+    if (!s_started) {
+        s_started = true;
+        s_now_us = now_us;
+        s_block_us = now_us + BLOCK_US;
+    }
+
+    while ((int32_t)(now_us - s_now_us) > 0) {
+        uint32_t until = (int32_t)(now_us - s_block_us) < 0 ? now_us : s_block_us;
+        s_sum += s_mv * (until - s_now_us);
+        s_now_us = until;
+
+        if (s_now_us == s_block_us) {
+            battery_monitor_update(&s_monitor, s_sum / BLOCK_US, BLOCK_US * 1e-6f);
+            s_sum = 0;
+            s_block_us += BLOCK_US;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/**
+ * @file bench_main.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host runner for the benchmarks registered with BENCH_REGISTER()
+ * Usage: bench_host [name] [-n reps]
+ * @version 0.1
+ * @date 2023-11-21
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "User/bench.h"
+
+int main(int argc, char** argv) {
+    const char* filter = NULL;
+    uint32_t    reps = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            reps = strtoul(argv[++i], NULL, 10);
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    printf("%-20s %8s %12s %12s %12s %12s\n", "benchmark [ns/op]", "reps", "mean", "stddev", "min", "max");
+    for (const bench_t* bench = bench_next(NULL); bench; bench = bench_next(bench)) {
+        if (filter && strcmp(filter, bench->name)) {
+            continue;
+        }
+
+        bench_result_t result;
+        bench_run(bench, reps, false, &result);
+        printf(
+            "%-20s %8u %12.3f %12.3f %12.3f %12.3f\n",
+            bench->name,
+            (unsigned)result.reps,
+            result.mean,
+            result.stddev,
+            result.min,
+            result.max
+        );
+    }
+
+    return 0;
+}
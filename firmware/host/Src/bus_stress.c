@@ -0,0 +1,259 @@
+/**
+ * @file bus_stress.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Concurrent publishers and subscribers of bus topics on threads, checks messages and statistics
+ * A latest topic of lidar scans with a subscriber thread per lidar reader, like lidar.c publishes them.
+ * Every field of a scan is derived from its sequence number, a subscriber that sees a mix of two scans or
+ * a sequence going backwards counts an error. Every scan published is read or counted as dropped by every
+ * subscriber, except the one each of them has not gotten to yet.
+ * A queue topic of sequence numbers between two threads. The consumer must see them in order, with a gap
+ * for exactly every message the bus counted as dropped. Exits with 1 on any error.
+ *
+ * Usage: bus_stress [-t ms]
+ *   -t  Run time, default 1000 ms
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "User/bus.h"
+#include "User/lidar.h"
+
+typedef struct
+{
+    uint8_t  index;
+    uint64_t reads;
+    uint64_t fresh;
+    uint64_t torn;
+    uint64_t backwards;
+} reader_t;
+
+typedef struct
+{
+    uint64_t received;
+    uint64_t gaps;     // Messages missing between two received ones
+    uint64_t disorder; // Received out of order
+} consumer_t;
+
+// ============= Private variables ===================
+static BUS_LATEST(s_scans, "scans", lidar_scan_t, eLIDAR_READERS);
+static BUS_QUEUE(s_events, "events", uint32_t, 16);
+
+static atomic_bool s_stop;
+static atomic_bool s_queue_done;
+static uint64_t    s_queue_sent;
+
+// ============ Private function declaration =================
+static void  s_fill(lidar_scan_t* scan, uint32_t sequence);
+static bool  s_is_whole(const lidar_scan_t* scan);
+static void* s_scan_writer(void* arg);
+static void* s_scan_reader(void* arg);
+static void* s_queue_writer(void* arg);
+static void* s_queue_reader(void* arg);
+
+//============ Private function implementation ===============
+/**
+ * @brief Write a scan field by field like the frame assembly does
+ */
+static void s_fill(lidar_scan_t* scan, uint32_t sequence) {
+    scan->sequence = sequence;
+    for (uint8_t b = 0; b < LIDAR_BEAMS_MAX; b++) {
+        scan->status[b] = (sequence + b) & 0x7F;
+        scan->distance_mm[b] = (uint16_t)(sequence * 31 + b);
+        scan->signal_kcps[b] = (uint16_t)~(sequence * 31 + b);
+        scan->capture[b] = sequence ^ (b << 24);
+    }
+    scan->beams = LIDAR_BEAMS_MAX;
+    scan->stamp = ~sequence;
+}
+
+static bool s_is_whole(const lidar_scan_t* scan) {
+    uint32_t sequence = scan->sequence;
+
+    if (sequence == 0) {
+        return scan->beams == 0; // Nothing published yet
+    }
+    bool whole = scan->beams == LIDAR_BEAMS_MAX && scan->stamp == ~sequence;
+    for (uint8_t b = 0; b < LIDAR_BEAMS_MAX; b++) {
+        whole &= scan->status[b] == ((sequence + b) & 0x7F);
+        whole &= scan->distance_mm[b] == (uint16_t)(sequence * 31 + b);
+        whole &= scan->signal_kcps[b] == (uint16_t)~(sequence * 31 + b);
+        whole &= scan->capture[b] == (sequence ^ (b << 24));
+    }
+    return whole;
+}
+
+static void* s_scan_writer(void* arg) {
+    uint32_t sequence = 0;
+
+    while (!atomic_load(&s_stop)) {
+        s_fill(bus_claim(&s_scans), ++sequence);
+        bus_publish(&s_scans);
+    }
+    return NULL;
+}
+
+static void* s_scan_reader(void* arg) {
+    reader_t* reader = arg;
+    uint32_t  last = 0;
+
+    while (!atomic_load(&s_stop)) {
+        bool                fresh;
+        const lidar_scan_t* scan = bus_read(&s_scans, reader->index, &fresh);
+
+        reader->reads++;
+        reader->fresh += fresh;
+        if (!s_is_whole(scan)) {
+            reader->torn++;
+        }
+        if (scan->sequence < last) {
+            reader->backwards++;
+        }
+        last = scan->sequence;
+    }
+    return NULL;
+}
+
+static void* s_queue_writer(void* arg) {
+    uint32_t sequence = 0;
+
+    while (!atomic_load(&s_stop)) {
+        sequence++;
+        uint32_t* message = bus_claim(&s_events);
+        if (message != NULL) {
+            *message = sequence;
+            bus_publish(&s_events);
+        }
+    }
+    s_queue_sent = sequence;
+    atomic_store(&s_queue_done, true);
+    return NULL;
+}
+
+static void* s_queue_reader(void* arg) {
+    consumer_t* consumer = arg;
+    uint32_t    last = 0;
+
+    for (;;) {
+        // Done is loaded before the queue, nothing is left once it is set and the queue is empty
+        bool            done = atomic_load(&s_queue_done);
+        const uint32_t* message = bus_receive(&s_events);
+
+        if (message == NULL) {
+            if (done) {
+                break;
+            }
+            continue;
+        }
+        if (*message <= last) {
+            consumer->disorder++;
+        } else {
+            consumer->gaps += *message - last - 1;
+        }
+        last = *message;
+        consumer->received++;
+        bus_release(&s_events);
+    }
+    // Dropped at the end of the run
+    consumer->gaps += s_queue_sent - last;
+    return NULL;
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    uint32_t run_ms = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            run_ms = strtoul(argv[++i], NULL, 0);
+        } else {
+            printf("Usage: bus_stress [-t ms]\n");
+            return 2;
+        }
+    }
+
+    pthread_t  scan_writer;
+    pthread_t  scan_readers[eLIDAR_READERS];
+    pthread_t  queue_writer;
+    pthread_t  queue_reader;
+    reader_t   readers[eLIDAR_READERS] = {0};
+    consumer_t consumer = {0};
+
+    atomic_store(&s_stop, false);
+    pthread_create(&scan_writer, NULL, s_scan_writer, NULL);
+    for (uint8_t r = 0; r < eLIDAR_READERS; r++) {
+        readers[r].index = r;
+        pthread_create(&scan_readers[r], NULL, s_scan_reader, &readers[r]);
+    }
+    pthread_create(&queue_writer, NULL, s_queue_writer, NULL);
+    pthread_create(&queue_reader, NULL, s_queue_reader, &consumer);
+
+    struct timespec sleep = {.tv_sec = run_ms / 1000, .tv_nsec = (run_ms % 1000) * 1000000L};
+    nanosleep(&sleep, NULL);
+    atomic_store(&s_stop, true);
+
+    pthread_join(scan_writer, NULL);
+    pthread_join(queue_writer, NULL);
+    pthread_join(queue_reader, NULL);
+    for (uint8_t r = 0; r < eLIDAR_READERS; r++) {
+        pthread_join(scan_readers[r], NULL);
+    }
+
+    uint64_t    errors = 0;
+    bus_stats_t scans;
+    bus_get_stats(&s_scans, &scans);
+    printf("Latest topic, %" PRIu32 " scans published, %u slots\n", scans.published, s_scans.slots);
+    printf("%-10s %12s %12s %8s %10s\n", "subscriber", "reads", "fresh", "torn", "backwards");
+    for (uint8_t r = 0; r < eLIDAR_READERS; r++) {
+        printf(
+            "%-10u %12" PRIu64 " %12" PRIu64 " %8" PRIu64 " %10" PRIu64 "\n",
+            r,
+            readers[r].reads,
+            readers[r].fresh,
+            readers[r].torn,
+            readers[r].backwards
+        );
+        errors += readers[r].torn + readers[r].backwards;
+    }
+    // Every subscriber may have one scan it has neither read nor had overwritten
+    uint64_t unaccounted = (uint64_t)scans.published * eLIDAR_READERS - scans.received - scans.dropped;
+    printf(
+        "received %" PRIu32 ", dropped %" PRIu32 ", unaccounted %" PRIu64 " (at most %u)\n",
+        scans.received,
+        scans.dropped,
+        unaccounted,
+        eLIDAR_READERS
+    );
+    errors += unaccounted > eLIDAR_READERS;
+
+    bus_stats_t events;
+    bus_get_stats(&s_events, &events);
+    printf("Queue topic, %" PRIu64 " messages sent, %u slots\n", s_queue_sent, s_events.slots);
+    printf(
+        "published %" PRIu32 ", received %" PRIu64 ", dropped %" PRIu32 ", gaps %" PRIu64 ", out of order %" PRIu64
+        "\n",
+        events.published,
+        consumer.received,
+        events.dropped,
+        consumer.gaps,
+        consumer.disorder
+    );
+    errors += consumer.disorder;
+    errors += consumer.gaps != events.dropped;
+    errors += consumer.received != events.published || events.published + events.dropped != s_queue_sent;
+
+    printf(errors ? "FAILED\n" : "OK\n");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,385 @@
+/**
+ * @file control_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief The control executive driving a simulated car around a closed track, in simulated time
+ * The cycle of control_exec.c runs at CONTROL_RATE_HZ against the same lidar, encoder, motor, wheel and servo
+ * code as the application, with the host mocks of the peripherals. The car follows the bicycle model on the
+ * steering angle of the servo, its speed is the motor plant of wheel_sim.c. The simulated sensors range the
+ * walls of a rectangular track around a block, one corridor wide, from the true pose of the car.
+ * Every scenario starts the car at the same place and drives for DRIVE_MS:
+ * - nominal: every stage runs every cycle, the car laps without touching a wall
+ * - slow plan: a plan budget of 0, every plan overruns. Planning runs every other cycle, the car still laps.
+ * - no time: a plan budget longer than the period, planning never fits. The car must not move.
+ * - blind: every sensor dies after BLIND_MS. Without new scans the car must stop within STOPPED_MS.
+ * The execution time of every stage against its budget is printed for the nominal scenario, host timings.
+ * Exits with 1 if a check fails.
+ *
+ * Usage: control_sim
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "main.h"
+#include "sim.h"
+
+#include "User/battery.h"
+#include "User/control.h"
+#include "User/cycles.h"
+#include "User/encoder.h"
+#include "User/geometry.h"
+#include "User/lidar.h"
+#include "User/motor.h"
+#include "User/servo.h"
+#include "User/wheel.h"
+
+#define STEP_US        10     // Lidar and I2C
+#define PLANT_STEP_US  50     // One PWM period
+#define PLANT_TOP_MM_S 5000.0f
+#define PLANT_TAU_S    0.15f
+#define PLANT_STATIC   0.05f
+#define BOOT_LIMIT     1000000
+#define DRIVE_MS       20000
+#define BLIND_MS       3000
+#define STOPPED_MS     1000 // After BLIND_MS, to stand still
+#define CRUISE_MM_S    1500
+#define LAP_MIN_MM     12000 // Travel in the scenarios that lap, most of a lap of the center line
+#define BODY_REAR_MM   -60   // Footprint around the rear axle center, x forward
+#define BODY_FRONT_MM  340
+#define BODY_HALF_MM   100
+#define RAD_PER_DEG    0.017453293f
+#define PI             3.14159265f
+
+// Walls of the track, a block inside a room, the corridor between them
+#define OUTER_X_MM 3000
+#define OUTER_Y_MM 2000
+#define INNER_X_MM 2000
+#define INNER_Y_MM 1000
+
+typedef struct
+{
+    const char* name;
+    uint32_t    plan_us; // Budget of the plan stage
+    bool        blind;
+    bool        laps;    // Must go around the track, else must stand still at the end
+} scenario_t;
+
+typedef struct
+{
+    float x_mm;
+    float y_mm;
+    float yaw_rad;
+} pose_t;
+
+// ============= Private variables ===================
+static const scenario_t s_scenarios[] = {
+    {"nominal", 400, false, true},
+    {"slow plan", 0, false, true},
+    {"no time", CONTROL_PERIOD_US, false, false},
+    {"blind", 400, true, false},
+};
+
+static uint32_t s_now_us;
+static pose_t   s_pose;
+static float    s_speed_mm_s;
+static float    s_travel_mm;
+static float    s_clearance_mm; // Least between the footprint and a wall
+static int      s_failed;
+
+// ============ Private function declaration =================
+static void  s_step(uint32_t end_us, bool cycles);
+static void  s_plant(void);
+static void  s_range(void);
+static float s_ray(float x, float y, float heading);
+static float s_wall(float x, float y);
+static void  s_check(bool ok, const char* scenario, const char* what);
+
+//============ Private function implementation ===============
+/**
+ * @brief Advance the simulation, with control cycles at the control rate if cycles is set
+ */
+static void s_step(uint32_t end_us, bool cycles) {
+    while ((int32_t)(end_us - s_now_us) > 0) {
+        s_now_us += STEP_US;
+        if (s_now_us % PLANT_STEP_US == 0) {
+            s_plant();
+            s_range();
+            sim_battery_step(s_now_us);
+            sim_encoder_step(s_now_us);
+            sim_motor_step(s_now_us);
+        }
+        sim_lidar_step(s_now_us);
+        sim_i2c_step(s_now_us);
+        if (s_now_us % (LIDAR_POLL_MS * 1000) == 0) {
+            lidar_poll(s_now_us / 1000);
+        }
+        if (cycles && s_now_us % CONTROL_PERIOD_US == 0) {
+            control_cycle(cycles_now());
+        }
+    }
+}
+
+/**
+ * @brief Car speed from the motor waveform as in wheel_sim.c, the pose on the bicycle model
+ */
+static void s_plant(void) {
+    const geometry_vehicle_t* vehicle = &geometry_tables.vehicle;
+    motor_pwm_t               pwm;
+    float                     dt = PLANT_STEP_US * 1e-6f;
+
+    sim_motor_get_active(&pwm);
+    float force = pwm.period ? ((float)pwm.in1 - pwm.in2) / pwm.period : 0; // No waveform before the first period
+    float friction = s_speed_mm_s != 0 ? copysignf(PLANT_STATIC, s_speed_mm_s)
+                                       : copysignf(fminf(fabsf(force), PLANT_STATIC), force);
+    float speed = s_speed_mm_s + ((force - friction) * PLANT_TOP_MM_S - s_speed_mm_s) * dt / PLANT_TAU_S;
+    if (s_speed_mm_s != 0 && (speed > 0) != (s_speed_mm_s > 0)) {
+        speed = 0;
+    }
+    s_speed_mm_s = speed;
+    sim_encoder_set_speed(speed);
+
+    float curvature = tanf(servo_get() * RAD_PER_DEG) / vehicle->wheelbase_mm;
+    s_pose.x_mm += speed * dt * cosf(s_pose.yaw_rad);
+    s_pose.y_mm += speed * dt * sinf(s_pose.yaw_rad);
+    s_pose.yaw_rad += speed * dt * curvature;
+    s_travel_mm += fabsf(speed) * dt;
+
+    // Corners and the middle of the long sides of the footprint
+    static const float body[][2] = {
+        {BODY_REAR_MM, BODY_HALF_MM},
+        {BODY_FRONT_MM, BODY_HALF_MM},
+        {BODY_FRONT_MM, -BODY_HALF_MM},
+        {BODY_REAR_MM, -BODY_HALF_MM},
+        {(BODY_REAR_MM + BODY_FRONT_MM) / 2, BODY_HALF_MM},
+        {(BODY_REAR_MM + BODY_FRONT_MM) / 2, -BODY_HALF_MM},
+    };
+    float c = cosf(s_pose.yaw_rad);
+    float s = sinf(s_pose.yaw_rad);
+    for (uint8_t i = 0; i < sizeof(body) / sizeof(body[0]); i++) {
+        float x = s_pose.x_mm + c * body[i][0] - s * body[i][1];
+        float y = s_pose.y_mm + s * body[i][0] + c * body[i][1];
+        s_clearance_mm = fminf(s_clearance_mm, s_wall(x, y));
+    }
+}
+
+/**
+ * @brief Distance to the walls along every beam, from where its sensor is now
+ */
+static void s_range(void) {
+    float c = cosf(s_pose.yaw_rad);
+    float s = sinf(s_pose.yaw_rad);
+
+    for (uint8_t b = 0; b < lidar_get_beam_count(); b++) {
+        lidar_beam_t beam;
+        lidar_get_beam(b, &beam);
+
+        float x = s_pose.x_mm + c * beam.mount_x_mm - s * beam.mount_y_mm;
+        float y = s_pose.y_mm + s * beam.mount_x_mm + c * beam.mount_y_mm;
+        float range = s_ray(x, y, s_pose.yaw_rad + beam.azimuth_deg * RAD_PER_DEG);
+        sim_lidar_set_distance(beam.sensor, (uint16_t)fminf(fmaxf(range, 0), UINT16_MAX));
+    }
+}
+
+/**
+ * @brief Distance from a point in the corridor to the first wall in a direction
+ */
+static float s_ray(float x, float y, float heading) {
+    static const float walls[][4] = {
+        // x0, y0, x1, y1
+        {-OUTER_X_MM, -OUTER_Y_MM, OUTER_X_MM, -OUTER_Y_MM},
+        {OUTER_X_MM, -OUTER_Y_MM, OUTER_X_MM, OUTER_Y_MM},
+        {OUTER_X_MM, OUTER_Y_MM, -OUTER_X_MM, OUTER_Y_MM},
+        {-OUTER_X_MM, OUTER_Y_MM, -OUTER_X_MM, -OUTER_Y_MM},
+        {-INNER_X_MM, -INNER_Y_MM, INNER_X_MM, -INNER_Y_MM},
+        {INNER_X_MM, -INNER_Y_MM, INNER_X_MM, INNER_Y_MM},
+        {INNER_X_MM, INNER_Y_MM, -INNER_X_MM, INNER_Y_MM},
+        {-INNER_X_MM, INNER_Y_MM, -INNER_X_MM, -INNER_Y_MM},
+    };
+    float dx = cosf(heading);
+    float dy = sinf(heading);
+    float nearest = INFINITY;
+
+    for (uint8_t i = 0; i < sizeof(walls) / sizeof(walls[0]); i++) {
+        // Point + t * direction = wall start + u * (wall end - wall start)
+        float ex = walls[i][2] - walls[i][0];
+        float ey = walls[i][3] - walls[i][1];
+        float denominator = dx * ey - dy * ex;
+        if (fabsf(denominator) < 1e-9f) {
+            continue;
+        }
+        float wx = walls[i][0] - x;
+        float wy = walls[i][1] - y;
+        float t = (wx * ey - wy * ex) / denominator;
+        float u = (wx * dy - wy * dx) / denominator;
+        if (t > 0 && u >= 0 && u <= 1) {
+            nearest = fminf(nearest, t);
+        }
+    }
+    return nearest;
+}
+
+/**
+ * @brief Distance from a point to the nearest wall, negative if it is inside one
+ */
+static float s_wall(float x, float y) {
+    float outer = fminf(OUTER_X_MM - fabsf(x), OUTER_Y_MM - fabsf(y));
+    float out_x = fabsf(x) - INNER_X_MM;
+    float out_y = fabsf(y) - INNER_Y_MM;
+    float inner = out_x > 0 && out_y > 0 ? hypotf(out_x, out_y) : fmaxf(out_x, out_y);
+    return fminf(outer, inner);
+}
+
+static void s_check(bool ok, const char* scenario, const char* what) {
+    if (!ok) {
+        printf("FAIL %s: %s\n", scenario, what);
+        s_failed++;
+    }
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        printf("Usage: control_sim\n");
+        return 2;
+    }
+
+    sim_lidar_attach(0, LIDAR1_XSHUT_GPIO_Port, LIDAR1_XSHUT_Pin, LIDAR1_INT_GPIO_Port, LIDAR1_INT_Pin);
+    sim_lidar_attach(1, LIDAR2_XSHUT_GPIO_Port, LIDAR2_XSHUT_Pin, LIDAR2_INT_GPIO_Port, LIDAR2_INT_Pin);
+    sim_lidar_attach(2, LIDAR3_XSHUT_GPIO_Port, LIDAR3_XSHUT_Pin, LIDAR3_INT_GPIO_Port, LIDAR3_INT_Pin);
+    sim_lidar_attach(3, LIDAR4_XSHUT_GPIO_Port, LIDAR4_XSHUT_Pin, LIDAR4_INT_GPIO_Port, LIDAR4_INT_Pin);
+    sim_lidar_attach(4, LIDAR5_XSHUT_GPIO_Port, LIDAR5_XSHUT_Pin, LIDAR5_INT_GPIO_Port, LIDAR5_INT_Pin);
+
+    sim_motor_step(s_now_us);
+    sim_encoder_step(s_now_us);
+    sim_battery_step(s_now_us);
+    motor_init();
+    servo_init();
+    encoder_init();
+    battery_init();
+    wheel_init();
+    lidar_init();
+    while (!lidar_is_booted() && s_now_us < BOOT_LIMIT) {
+        s_step(s_now_us + 1000, false);
+    }
+    s_check(lidar_is_booted(), "boot", "lidar did not boot");
+
+    printf(
+        "%-9s %6s %6s %6s %6s %6s %6s %5s %7s %8s\n",
+        "scenario",
+        "cycles",
+        "plans",
+        "skips",
+        "holds",
+        "stops",
+        "late",
+        "laps",
+        "m",
+        "wall mm"
+    );
+    control_stats_t nominal = {0};
+    for (uint8_t i = 0; i < sizeof(s_scenarios) / sizeof(s_scenarios[0]); i++) {
+        const scenario_t* scenario = &s_scenarios[i];
+
+        // Standing at the start in the middle of the corridor, facing along it
+        s_pose = (pose_t){0, -(OUTER_Y_MM + INNER_Y_MM) / 2.0f, 0};
+        s_speed_mm_s = 0;
+        s_travel_mm = 0;
+        s_clearance_mm = INFINITY;
+        s_step(s_now_us + 500000, true);
+
+        control_set_budget(eCONTROL_PLAN, scenario->plan_us);
+        control_reset_stats();
+        control_start(CRUISE_MM_S);
+
+        uint32_t start_us = s_now_us;
+        float    yaw_start = s_pose.yaw_rad;
+        float    blind_mm_s = 0; // STOPPED_MS after the sensors died
+        for (uint32_t ms = 0; ms < DRIVE_MS; ms++) {
+            if (scenario->blind && ms == BLIND_MS) {
+                for (uint8_t s = 0; s < LIDAR_COUNT; s++) {
+                    sim_lidar_set_dead(s, true);
+                }
+            }
+            s_step(start_us + (ms + 1) * 1000, true);
+            if (ms == BLIND_MS + STOPPED_MS) {
+                blind_mm_s = s_speed_mm_s;
+            }
+        }
+
+        control_stats_t stats;
+        control_get_stats(&stats);
+        control_stop();
+        const control_stage_stats_t* plan = &stats.stage[eCONTROL_PLAN];
+        float laps = (s_pose.yaw_rad - yaw_start) / (2 * PI);
+        printf(
+            "%-9s %6" PRIu32 " %6" PRIu32 " %6" PRIu32 " %6" PRIu32 " %6" PRIu32 " %6" PRIu32 " %5.2f %7.1f %8.0f\n",
+            scenario->name,
+            stats.cycles,
+            plan->runs,
+            plan->skips,
+            stats.holds,
+            stats.stops,
+            stats.late,
+            laps,
+            s_travel_mm / 1000,
+            s_clearance_mm
+        );
+
+        // Every other stage runs every cycle, whatever happens to planning
+        for (uint8_t s = 0; s < eCONTROL_STAGES; s++) {
+            uint32_t expected = s == eCONTROL_PLAN ? stats.cycles - plan->skips : stats.cycles;
+            s_check(stats.stage[s].runs == expected, scenario->name, "stage did not run every cycle");
+        }
+        s_check(stats.cycles == DRIVE_MS * 1000 / CONTROL_PERIOD_US, scenario->name, "cycles missing");
+        s_check(s_clearance_mm > 0, scenario->name, "hit a wall");
+
+        if (scenario->plan_us == 0) {
+            s_check(plan->runs - plan->skips <= 1, scenario->name, "plan not skipped after every overrun");
+            s_check(stats.holds == plan->skips && stats.stops == 0, scenario->name, "held plan not acted on");
+        } else if (scenario->plan_us >= CONTROL_PERIOD_US) {
+            s_check(plan->runs == 0, scenario->name, "plan ran without time for it");
+            s_check(stats.stops == stats.cycles, scenario->name, "did not stop");
+        }
+        if (scenario->laps) {
+            s_check(s_travel_mm > LAP_MIN_MM, scenario->name, "did not get around the track");
+        } else if (scenario->blind) {
+            s_check(fabsf(blind_mm_s) < 1, scenario->name, "still moving without scans");
+        } else {
+            s_check(s_travel_mm < 1, scenario->name, "moved without a plan");
+        }
+        if (i == 0) {
+            nominal = stats;
+        }
+
+        for (uint8_t s = 0; s < LIDAR_COUNT; s++) {
+            sim_lidar_set_dead(s, false);
+        }
+        s_step(s_now_us + 2000000, true);
+    }
+
+    printf("\n%-9s %7s %6s %6s %6s %9s\n", "stage", "budget", "mean", "p99", "max", "overruns");
+    for (uint8_t s = 0; s < eCONTROL_STAGES; s++) {
+        const control_stage_stats_t* stage = &nominal.stage[s];
+        printf(
+            "%-9s %7" PRIu32 " %6.1f %6.1f %6.1f %9" PRIu32 "\n",
+            stage->name,
+            stage->budget_us,
+            stage->exec.mean / (float)cycles_per_us(),
+            stage->exec.p99 / (float)cycles_per_us(),
+            stage->exec.max / (float)cycles_per_us(),
+            stage->overruns
+        );
+    }
+    printf("Times in us on the host, the budgets are for the target\n");
+
+    printf(s_failed ? "FAILED\n" : "OK\n");
+    return s_failed ? 1 : 0;
+}
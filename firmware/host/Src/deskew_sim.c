@@ -0,0 +1,242 @@
+/**
+ * @file deskew_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Position error of lidar points with and without motion compensation, at several speeds
+ * The vehicle drives through a walled room at a constant speed and turn rate. A scan is built with the
+ * beam geometry and slot timing of the lidar schedule, every beam ranged from the true pose at its own
+ * capture. Odometry poses are fed to odom.c at 100 Hz. The points of lidar_deskew() are compared to where
+ * the beams really hit, seen from the vehicle at the reference time of the scan.
+ * The compensated error must stay within DESKEW_ERROR at every speed, exits with 1 otherwise.
+ * 
+ * Usage: deskew_sim [-z zones] [-r mm]
+ *   -z  Beams per sensor, default 3
+ *   -r  Turn radius, 0 drives straight, default 1000 mm
+ * @version 0.1
+ * @date 2023-11-28
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "User/cycles.h"
+#include "User/lidar.h"
+#include "User/lidar_deskew.h"
+#include "User/odom.h"
+
+#define ODOM_PERIOD_US 10000 // 100 Hz
+#define ODOM_BEFORE_S  0.5f  // Odometry running before the scan starts
+#define DESKEW_ERROR   3.0f  // Largest compensated error in mm, ranges are whole mm
+#define ROOM_FRONT_MM  3000  // Walls around the start pose
+#define ROOM_BACK_MM   -2000
+#define ROOM_SIDE_MM   1500
+#define RAD_PER_DEG    0.017453293f
+
+typedef struct
+{
+    float x_mm;
+    float y_mm;
+    float yaw_rad;
+} pose_t;
+
+typedef struct
+{
+    float mean;
+    float max;
+} stats_t;
+
+// ============= Private variables ===================
+static const int32_t s_speeds[] = {0, 500, 1000, 2000, 3000};
+
+// ============ Private function declaration =================
+static pose_t   s_pose_at(float speed_mm_s, float radius_mm, float t_s);
+static void     s_transform(const pose_t* pose, float x, float y, float* out_x, float* out_y);
+static void     s_inverse(const pose_t* pose, float x, float y, float* out_x, float* out_y);
+static float    s_ray(float x, float y, float heading);
+static uint32_t s_stamp(float t_s);
+
+//============ Private function implementation ===============
+/**
+ * @brief True pose after t_s seconds on a circle of the radius, a straight line if it is 0
+ */
+static pose_t s_pose_at(float speed_mm_s, float radius_mm, float t_s) {
+    float distance = speed_mm_s * t_s;
+
+    if (radius_mm == 0) {
+        return (pose_t){distance, 0, 0};
+    }
+    float yaw = distance / radius_mm;
+    return (pose_t){radius_mm * sinf(yaw), radius_mm * (1 - cosf(yaw)), yaw};
+}
+
+static void s_transform(const pose_t* pose, float x, float y, float* out_x, float* out_y) {
+    *out_x = pose->x_mm + cosf(pose->yaw_rad) * x - sinf(pose->yaw_rad) * y;
+    *out_y = pose->y_mm + sinf(pose->yaw_rad) * x + cosf(pose->yaw_rad) * y;
+}
+
+static void s_inverse(const pose_t* pose, float x, float y, float* out_x, float* out_y) {
+    float dx = x - pose->x_mm;
+    float dy = y - pose->y_mm;
+    *out_x = cosf(pose->yaw_rad) * dx + sinf(pose->yaw_rad) * dy;
+    *out_y = cosf(pose->yaw_rad) * dy - sinf(pose->yaw_rad) * dx;
+}
+
+/**
+ * @brief Distance from a point inside the room to the first wall in a direction
+ */
+static float s_ray(float x, float y, float heading) {
+    float dx = cosf(heading);
+    float dy = sinf(heading);
+    float nearest = INFINITY;
+
+    if (dx > 1e-6f) {
+        nearest = fminf(nearest, (ROOM_FRONT_MM - x) / dx);
+    } else if (dx < -1e-6f) {
+        nearest = fminf(nearest, (ROOM_BACK_MM - x) / dx);
+    }
+    if (dy > 1e-6f) {
+        nearest = fminf(nearest, (ROOM_SIDE_MM - y) / dy);
+    } else if (dy < -1e-6f) {
+        nearest = fminf(nearest, (-ROOM_SIDE_MM - y) / dy);
+    }
+    return nearest;
+}
+
+/**
+ * @brief cycles_now() at a time relative to the scan start, never before the first pose
+ */
+static uint32_t s_stamp(float t_s) {
+    return (uint32_t)(int64_t)((t_s + ODOM_BEFORE_S) * 1e6 * cycles_per_us());
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    uint8_t zones = 3;
+    float   radius_mm = 1000;
+    int     failed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-z") && i + 1 < argc) {
+            zones = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            radius_mm = strtof(argv[++i], NULL);
+        } else {
+            printf("Usage: deskew_sim [-z zones] [-r mm]\n");
+            return 2;
+        }
+    }
+    if (!lidar_set_zones(zones)) {
+        printf("Zones must be 1 to %u\n", LIDAR_ZONES_MAX);
+        return 2;
+    }
+
+    printf("%u beams, turn radius %.0f mm\n", lidar_get_beam_count(), radius_mm);
+    printf(
+        "%-8s %-8s %8s %8s %10s %10s %10s %10s\n",
+        "mm/s",
+        "regime",
+        "scan ms",
+        "yaw deg",
+        "raw mean",
+        "raw max",
+        "comp mean",
+        "comp max"
+    );
+
+    for (uint8_t i = 0; i < sizeof(s_speeds) / sizeof(s_speeds[0]); i++) {
+        float speed = s_speeds[i];
+
+        // Slot timing of the regime the lidar picks for the speed, one timing budget per slot
+        lidar_schedule_t schedule;
+        lidar_set_speed(s_speeds[i]);
+        lidar_get_schedule(&schedule);
+        float slot_s = lidar_get_regime(schedule.regime)->budget_ms / 1000.0f;
+        float scan_s = slot_s * zones * LIDAR_GROUPS;
+
+        // Odometry from before the scan until after its last capture, the scan starts at the origin at 0 s
+        odom_reset();
+        for (float t = -ODOM_BEFORE_S; t < scan_s + 0.05f; t += ODOM_PERIOD_US / 1e6f) {
+            pose_t pose = s_pose_at(speed, radius_mm, t);
+            odom_update(s_stamp(t), pose.x_mm, pose.y_mm, pose.yaw_rad);
+        }
+
+        lidar_scan_t scan = {.sequence = i + 1, .beams = lidar_get_beam_count()};
+        float        truth_x[LIDAR_BEAMS_MAX], truth_y[LIDAR_BEAMS_MAX];
+        float        newest_s = 0;
+        for (uint8_t b = 0; b < scan.beams; b++) {
+            lidar_beam_t beam;
+            lidar_get_beam(b, &beam);
+
+            // Group 0 holds the even sensors, see s_groups in lidar.c
+            uint8_t slot = beam.zone * LIDAR_GROUPS + (beam.sensor & 1);
+            float   capture_s = (slot + 1) * slot_s;
+            pose_t  pose = s_pose_at(speed, radius_mm, capture_s);
+            float   sensor_x, sensor_y;
+            s_transform(&pose, beam.mount_x_mm, beam.mount_y_mm, &sensor_x, &sensor_y);
+
+            float heading = pose.yaw_rad + beam.azimuth_deg * RAD_PER_DEG;
+            float range = s_ray(sensor_x, sensor_y, heading);
+            truth_x[b] = sensor_x + range * cosf(heading);
+            truth_y[b] = sensor_y + range * sinf(heading);
+
+            scan.status[b] = 0;
+            scan.distance_mm[b] = (uint16_t)lroundf(range);
+            scan.filtered_mm[b] = scan.distance_mm[b];
+            scan.capture[b] = s_stamp(capture_s);
+            scan.valid |= 1u << b;
+            newest_s = fmaxf(newest_s, capture_s);
+        }
+        scan.stamp = s_stamp(newest_s);
+
+        // The hit points seen from the vehicle at the reference time
+        pose_t reference = s_pose_at(speed, radius_mm, newest_s);
+        for (uint8_t b = 0; b < scan.beams; b++) {
+            s_inverse(&reference, truth_x[b], truth_y[b], &truth_x[b], &truth_y[b]);
+        }
+
+        lidar_points_t raw, compensated;
+        lidar_deskew(&scan, false, &raw);
+        lidar_deskew(&scan, true, &compensated);
+
+        stats_t raw_error = {0}, compensated_error = {0};
+        for (uint8_t b = 0; b < scan.beams; b++) {
+            float e_raw = hypotf(raw.x_mm[b] - truth_x[b], raw.y_mm[b] - truth_y[b]);
+            float e_comp = hypotf(compensated.x_mm[b] - truth_x[b], compensated.y_mm[b] - truth_y[b]);
+            raw_error.mean += e_raw / scan.beams;
+            raw_error.max = fmaxf(raw_error.max, e_raw);
+            compensated_error.mean += e_comp / scan.beams;
+            compensated_error.max = fmaxf(compensated_error.max, e_comp);
+        }
+
+        float yaw_deg = reference.yaw_rad / RAD_PER_DEG;
+        printf(
+            "%-8.0f %-8s %8.0f %8.1f %10.1f %10.1f %10.2f %10.2f\n",
+            speed,
+            lidar_get_regime(schedule.regime)->name,
+            scan_s * 1000,
+            yaw_deg,
+            raw_error.mean,
+            raw_error.max,
+            compensated_error.mean,
+            compensated_error.max
+        );
+
+        if (compensated.deskewed != compensated.valid || compensated.valid != scan.valid) {
+            printf("FAIL %.0f mm/s: beams not compensated\n", speed);
+            failed++;
+        }
+        if (compensated_error.max > DESKEW_ERROR) {
+            printf("FAIL %.0f mm/s: compensated error above %.1f mm\n", speed, DESKEW_ERROR);
+            failed++;
+        }
+    }
+
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file encoder_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host implementation of User/encoder.h on a simulated quadrature encoder
+ * The wheel turns at the set speed and generates the quadrature edges one by one, the counter and the
+ * capture of the rising edges of channel A behave like TIM3 and TIM2 on target. The samples are taken
+ * every 1000000 / ENCODER_RATE_HZ us by sim_encoder_step() and run through the same estimator, the listener
+ * is called right after like from the sample interrupt.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+#include "User/cycles.h"
+#include "User/encoder.h"
+#include "User/encoder_est.h"
+#include "User/geometry.h"
+
+#define PERIOD_US (1000000 / ENCODER_RATE_HZ)
+
+// ============= Private variables ===================
+static double             s_position;  // Counts, the counter follows its integer part
+static double             s_speed;     // Counts per us
+static int32_t            s_counter;   // Quadrature counter, extended
+static encoder_sample_t   s_hardware;  // Counter and latched edge as the timers hold them
+static uint32_t           s_now_us;    // Simulated up to
+static uint32_t           s_sample_us; // Next sample
+static bool               s_started;
+static encoder_est_t      s_est;
+static uint32_t           s_stamp;
+static uint32_t           s_samples;
+static encoder_listener_t s_listener;
+
+// ============ Private function declaration =================
+static void s_edge(int32_t counter, uint32_t now_us);
+
+//============ Private function implementation ===============
+/**
+ * @brief The counter moves one count, A is high on counts 1 and 2 of every line and rises into 1 going up
+ * and into 2 going down
+ */
+static void s_edge(int32_t counter, uint32_t now_us) {
+    bool up = counter > s_counter;
+
+    s_counter = counter;
+    s_hardware.count = (uint16_t)counter;
+    if ((counter & 3) == (up ? 1 : 2)) {
+        s_hardware.edge_count = (uint16_t)counter;
+        s_hardware.edge_us = now_us;
+    }
+}
+
+// ==================== Global function implementation ==========================
+void encoder_init(void) {
+    encoder_reset();
+}
+
+void encoder_reset(void) {
+    s_hardware.now_us = s_now_us;
+    encoder_est_reset(&s_est, &s_hardware);
+    s_samples = 0;
+}
+
+void encoder_get(encoder_state_t* state) {
+    state->stamp = s_stamp;
+    state->samples = s_samples;
+    state->counts = s_est.position;
+    state->distance_mm = s_est.position * geometry_tables.vehicle.mm_per_count;
+    state->speed_mm_s = s_est.speed * geometry_tables.vehicle.mm_per_count;
+}
+
+void encoder_set_listener(encoder_listener_t listener) {
+    s_listener = listener;
+}
+
+/**
+ * @brief Turn the wheel from now on
+ *
+ * @param speed_mm_s Positive forward
+ */
+void sim_encoder_set_speed(float speed_mm_s) {
+    s_speed = speed_mm_s / geometry_tables.vehicle.mm_per_count / 1e6;
+}
+
+/**
+ * @brief Generate the edges up to now in 1 us steps and take the samples that are due
+ *
+ * @param now_us Monotonic time in microseconds
+ */
+void sim_encoder_step(uint32_t now_us) {
+    if (!s_started) {
+        s_started = true;
+        s_now_us = now_us;
+        s_sample_us = now_us + PERIOD_US;
+    }
+
+    while ((int32_t)(now_us - s_now_us) > 0) {
+        s_now_us++;
+        s_position += s_speed;
+
+        // Up to 0.4 counts per us at top speed, one edge at a time anyway
+        int32_t counter = (int32_t)floor(s_position);
+        while (counter != s_counter) {
+            s_edge(s_counter + (counter > s_counter ? 1 : -1), s_now_us);
+        }
+
+        if (s_now_us == s_sample_us) {
+            s_sample_us += PERIOD_US;
+            s_hardware.now_us = s_now_us;
+            encoder_est_update(&s_est, &s_hardware);
+            s_stamp = cycles_now();
+            s_samples++;
+
+            if (s_listener != NULL) {
+                encoder_state_t state;
+                encoder_get(&state);
+                s_listener(&state);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Get the position of the wheel
+ *
+ * @return int32_t Quadrature counts the wheel has turned, what the estimate must match
+ */
+int32_t sim_encoder_get_counts(void) {
+    return s_counter;
+}
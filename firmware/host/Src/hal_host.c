@@ -0,0 +1,228 @@
+/**
+ * @file hal_host.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host stand-in for HAL GPIO, tick and flash
+ * The button is driven from the keyboard of the terminal running the host build:
+ *   b - click (pressed for 100 ms)
+ *   h - toggle press and hold
+ *   q - quit
+ * LED changes are printed.
+ * The flash sectors start erased on every run, programming can only clear bits like the real one. The power
+ * of the flash can be cut in the middle of an operation, see host_flash_cut().
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "main.h"
+
+#define CLICK_MS 100
+
+// ============= Private variables ===================
+// Button has a pull up, idle high
+GPIO_TypeDef          host_gpioa = {.odr = 0, .idr = BUTTON_Pin};
+GPIO_TypeDef          host_gpiob = {0};
+static struct termios s_termios;
+static bool           s_termios_saved;
+static uint32_t       s_release_tick;
+static bool           s_hold;
+uint32_t              host_flash[2 * 128 * 1024 / 4];
+static bool           s_flash_erased; // Sectors filled with 0xFF, done on the first unlock
+static bool           s_flash_unlocked;
+static bool           s_flash_cut;  // Power cut ahead
+static bool           s_flash_down; // Power cut, no operation happens
+static uint32_t       s_flash_ops;  // Operations left before the power is cut
+
+// ============ Private function declaration =================
+static void s_set_button(bool pressed);
+static void s_restore_terminal(void);
+static bool s_flash_powered(bool* torn);
+
+//============ Private function implementation ===============
+static void s_set_button(bool pressed) {
+    if (pressed) {
+        host_gpioa.idr &= ~BUTTON_Pin;
+    } else {
+        host_gpioa.idr |= BUTTON_Pin;
+    }
+}
+
+/**
+ * @brief Count an operation against a power cut
+ *
+ * @param torn Set if the power is cut during this one
+ * @return false if the power is already cut
+ */
+static bool s_flash_powered(bool* torn) {
+    *torn = false;
+    if (s_flash_down) {
+        return false;
+    }
+    if (s_flash_cut && s_flash_ops-- == 0) {
+        *torn = true;
+        s_flash_down = true;
+    }
+    return true;
+}
+
+static void s_restore_terminal(void) {
+    if (s_termios_saved) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &s_termios);
+    }
+}
+
+// ==================== Global function implementation ==========================
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+    // Outputs read back what was written, like the IDR of a push-pull pin
+    uint16_t level = (GPIOx == LED_GPIO_Port && GPIO_Pin == LED_Pin) ? GPIOx->odr : GPIOx->idr;
+    return (level & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    uint16_t old = GPIOx->odr;
+    if (PinState == GPIO_PIN_SET) {
+        GPIOx->odr |= GPIO_Pin;
+    } else {
+        GPIOx->odr &= ~GPIO_Pin;
+    }
+
+    if (GPIOx == LED_GPIO_Port && ((old ^ GPIOx->odr) & LED_Pin)) {
+        printf("[host] LED %s\r\n", (GPIOx->odr & LED_Pin) ? "ON" : "OFF");
+        fflush(stdout);
+    }
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+    HAL_GPIO_WritePin(GPIOx, GPIO_Pin, (GPIOx->odr & GPIO_Pin) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+uint32_t HAL_GetTick(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void HAL_Delay(uint32_t Delay) {
+    usleep(Delay * 1000);
+}
+
+void Error_Handler(void) {
+    fprintf(stderr, "[host] Error_Handler\n");
+    abort();
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+    if (!s_flash_erased) {
+        memset(host_flash, 0xFF, sizeof(host_flash));
+        s_flash_erased = true;
+    }
+    s_flash_unlocked = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+    s_flash_unlocked = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uintptr_t Address, uint64_t Data) {
+    uintptr_t start = (uintptr_t)host_flash;
+    bool      torn;
+
+    if (!s_flash_unlocked || TypeProgram != FLASH_TYPEPROGRAM_WORD || Address % 4 || Address < start ||
+        Address >= start + sizeof(host_flash) || !s_flash_powered(&torn)) {
+        return HAL_ERROR;
+    }
+    // A torn word has only some of its bits programmed
+    host_flash[(Address - start) / 4] &= (uint32_t)Data | (torn ? (uint32_t)rand() : 0);
+    return torn ? HAL_ERROR : HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* SectorError) {
+    uint32_t  words = sizeof(host_flash) / sizeof(host_flash[0]) / 2;
+    uint32_t* sector = &host_flash[(pEraseInit->Sector - FLASH_SECTOR_6) * words];
+    bool      torn;
+
+    *SectorError = 0;
+    if (!s_flash_unlocked || pEraseInit->Sector < FLASH_SECTOR_6 || pEraseInit->Sector > FLASH_SECTOR_7 ||
+        pEraseInit->NbSectors != 1 || !s_flash_powered(&torn)) {
+        *SectorError = pEraseInit->Sector;
+        return HAL_ERROR;
+    }
+    // A torn erase leaves part of the sector as it was
+    for (uint32_t i = 0; i < words; i++) {
+        if (!torn || rand() % 2) {
+            sector[i] = 0xFFFFFFFF;
+        }
+    }
+    return torn ? HAL_ERROR : HAL_OK;
+}
+
+/**
+ * @brief Cut the power of the flash in the middle of an operation
+ *
+ * @param ops Program and erase operations that complete before it, the next one is torn and all after it fail
+ */
+void host_flash_cut(uint32_t ops) {
+    s_flash_cut = true;
+    s_flash_ops = ops;
+}
+
+/**
+ * @brief Power the flash again, as after a reset
+ */
+void host_flash_restore(void) {
+    s_flash_cut = false;
+    s_flash_down = false;
+}
+
+/**
+ * @brief Put the terminal in non-canonical mode so single key presses are read
+ */
+void host_keys_init(void) {
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &s_termios) == 0) {
+        struct termios raw = s_termios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        s_termios_saved = true;
+        atexit(s_restore_terminal);
+    }
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+    printf("[host] Keys: b = click button, h = toggle hold, q = quit\r\n");
+}
+
+/**
+ * @brief Read pending keys and update the button pin
+ */
+void host_keys_poll(void) {
+    char c;
+    while (read(STDIN_FILENO, &c, 1) == 1) {
+        if (c == 'b') {
+            s_set_button(true);
+            s_release_tick = HAL_GetTick() + CLICK_MS;
+        } else if (c == 'h') {
+            s_hold = !s_hold;
+            s_set_button(s_hold);
+        } else if (c == 'q') {
+            exit(0);
+        }
+    }
+
+    if (s_release_tick && (int32_t)(HAL_GetTick() - s_release_tick) >= 0) {
+        s_release_tick = 0;
+        s_set_button(s_hold);
+    }
+}
@@ -0,0 +1,361 @@
+/**
+ * @file health_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Injects failures into one simulated sensor while the lidar ranges and checks the health monitoring
+ * The sensor drops off the bus, gets stuck and NACKs half its transfers in turn, each fault followed by a
+ * healthy period. During every fault it must be removed from the schedule while the other sensors keep the
+ * scan rate of the healthy board, scans must keep coming one by one and never stall for long. Once the fault
+ * is gone it must be rebooted and range again. Last it dies for good and must be given up on.
+ * Reboots range once for the VHV calibration regardless of the neighbours, crosstalk is not checked here.
+ * Before the faults the sensor is removed by failed reads and the I2C interrupt is held off while the clear
+ * after the last one is pending, past the time of its reboot. The reboot must wait for the clear, a transfer
+ * submitted again before it is done corrupts the queue on target.
+ * Exits with 1 if a check fails.
+ *
+ * Usage: health_sim [-i index] [-z zones]
+ *   -i  Sensor to break, default 1
+ *   -z  Beams per sensor, default 1
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "sim.h"
+
+#include "User/lidar.h"
+
+#define STEP_US    10
+#define BOOT_LIMIT 1000000 // Boot must be done within 1 s
+#define SPEED_MM_S 500     // Cruise regime
+#define HEALTHY_MS 1000    // Baseline before the first fault
+#define MIN_RATE   90      // Percent of the baseline scan rate with the sensor removed
+#define MAX_GAP    3       // Scan periods of the baseline between two published scans
+#define RACE_LIMIT 2000    // ms for the failed reads to remove the sensor
+#define RECOVER_MS 2000    // After the race, for the reboot
+
+typedef enum {
+    eFAULT_DROP,  // Off the bus
+    eFAULT_STUCK, // Same result over and over
+    eFAULT_NACK,  // Half the transfers fail
+    eFAULT_DEAD,  // Off the bus for good
+} fault_e;
+
+typedef struct
+{
+    const char* name;
+    fault_e     fault;
+    uint32_t    fault_ms;
+    uint32_t    clear_ms; // Healthy again for, 0 if it never comes back
+} phase_t;
+
+typedef struct
+{
+    uint32_t removed_ms;   // From the start of the fault, 0 if never
+    uint32_t recovered_ms; // From the end of the fault, 0 if never
+    uint32_t scans;        // Scans published while removed
+    uint32_t removed_for;  // ms removed during the fault
+    uint32_t results;      // Of the sensor after the fault
+} outcome_t;
+
+// ============= Private variables ===================
+static uint32_t s_now_us;
+static int      s_failed;
+static uint32_t s_sequence; // Of the last scan read
+static uint32_t s_last_ms;  // A scan was read
+static uint32_t s_max_gap_ms;
+
+// Long enough for a few reboot attempts and for the sensor to prove itself afterwards
+static const phase_t s_phases[] = {
+    {"drop", eFAULT_DROP, 1500, 4000},
+    {"stuck", eFAULT_STUCK, 2000, 4000},
+    {"nack", eFAULT_NACK, 1500, 4000},
+    {"dead", eFAULT_DEAD, 8000, 0},
+};
+
+// ============ Private function declaration =================
+static void     s_run_until(uint32_t end_us);
+static void     s_step(bool i2c);
+static void     s_race(uint8_t victim);
+static void     s_read_scans(void);
+static void     s_inject(uint8_t index, fault_e fault, bool on);
+static uint32_t s_scans(void);
+static void     s_check(bool ok, const char* what, uint8_t index);
+
+//============ Private function implementation ===============
+/**
+ * @brief Advance the simulation in 1 ms steps, reading the scans like a control loop would
+ */
+static void s_run_until(uint32_t end_us) {
+    while ((int32_t)(end_us - s_now_us) > 0) {
+        uint32_t ms_end = s_now_us + 1000;
+        while ((int32_t)(ms_end - s_now_us) > 0) {
+            s_step(true);
+        }
+        s_read_scans();
+    }
+}
+
+/**
+ * @brief One step of STEP_US, without the I2C the transfers neither finish nor call back
+ */
+static void s_step(bool i2c) {
+    s_now_us += STEP_US;
+    sim_lidar_step(s_now_us);
+    if (i2c) {
+        sim_i2c_step(s_now_us);
+    }
+    if (s_now_us % (LIDAR_POLL_MS * 1000) == 0) {
+        lidar_poll(s_now_us / 1000);
+    }
+}
+
+/**
+ * @brief Remove the sensor with failed reads and hold its clear pending until the reboot is due
+ */
+static void s_race(uint8_t victim) {
+    const vl53l1x_t* dev = lidar_get_sensor(victim);
+    lidar_health_t   before, health;
+    lidar_get_health(victim, &before);
+    health = before;
+
+    // The sensor drops off the bus for each of its reads until the failures remove it
+    uint32_t start_ms = s_now_us / 1000;
+    bool     pending = false;
+    while (!pending && s_now_us / 1000 - start_ms < RACE_LIMIT) {
+        uint32_t errors = dev->errors;
+        s_step(true);
+        sim_lidar_set_dead(victim, dev->xfer.read && sim_i2c_is_pending(&dev->xfer));
+        lidar_get_health(victim, &health);
+        pending = health.state == eLIDAR_HEALTH_REMOVED && dev->errors > errors && sim_i2c_is_pending(&dev->xfer);
+        if (s_now_us % 1000 == 0) {
+            s_read_scans();
+        }
+    }
+    sim_lidar_set_dead(victim, false);
+    s_check(pending, "not removed by a failed read", victim);
+
+    // The reboot comes due with the clear still pending
+    uint32_t held_ms = s_now_us / 1000;
+    while (pending && s_now_us / 1000 - held_ms < 2u * (LIDAR_REBOOT_DELAY_MS << health.reboots)) {
+        s_step(false);
+    }
+    held_ms = s_now_us / 1000 - held_ms;
+    pending = pending && sim_i2c_is_pending(&dev->xfer);
+
+    s_run_until(s_now_us + RECOVER_MS * 1000);
+    lidar_get_health(victim, &health);
+
+    printf(
+        "Clear after a failed read held %" PRIu32 " ms, %" PRIu32 " transfers submitted again, %s\n",
+        held_ms,
+        sim_i2c_get_resubmits(),
+        health.recoveries > before.recoveries ? "recovered" : "not recovered"
+    );
+    s_check(pending, "clear not held past the reboot", victim);
+    s_check(sim_i2c_get_resubmits() == 0, "transfer submitted while pending", victim);
+    s_check(health.state == eLIDAR_HEALTH_OK && health.recoveries > before.recoveries, "not recovered", victim);
+}
+
+static void s_read_scans(void) {
+    bool                fresh;
+    const lidar_scan_t* scan = lidar_get_scan(eLIDAR_READER_CONTROL, &fresh);
+    uint32_t            now_ms = s_now_us / 1000;
+
+    if (!fresh) {
+        return;
+    }
+    s_check(scan->sequence == s_sequence + 1, "scan sequence skipped", 0);
+    if (s_sequence && now_ms - s_last_ms > s_max_gap_ms) {
+        s_max_gap_ms = now_ms - s_last_ms;
+    }
+    s_sequence = scan->sequence;
+    s_last_ms = now_ms;
+}
+
+static void s_inject(uint8_t index, fault_e fault, bool on) {
+    switch (fault) {
+        case eFAULT_DROP:
+        case eFAULT_DEAD:
+            sim_lidar_set_dead(index, on);
+            break;
+        case eFAULT_STUCK:
+            sim_lidar_set_stuck(index, on);
+            break;
+        case eFAULT_NACK:
+            sim_lidar_set_nacks(index, on ? 500 : 0);
+            break;
+    }
+}
+
+static uint32_t s_scans(void) {
+    lidar_schedule_t schedule;
+    lidar_get_schedule(&schedule);
+    return schedule.published;
+}
+
+static void s_check(bool ok, const char* what, uint8_t index) {
+    if (!ok) {
+        printf("FAIL %u: %s\n", index, what);
+        s_failed++;
+    }
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    uint8_t victim = 1;
+    uint8_t zones = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            victim = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-z") && i + 1 < argc) {
+            zones = atoi(argv[++i]);
+        } else {
+            printf("Usage: health_sim [-i index] [-z zones]\n");
+            return 2;
+        }
+    }
+    if (victim >= LIDAR_COUNT) {
+        printf("Sensor must be 0 to %u\n", LIDAR_COUNT - 1);
+        return 2;
+    }
+
+    sim_lidar_attach(0, LIDAR1_XSHUT_GPIO_Port, LIDAR1_XSHUT_Pin, LIDAR1_INT_GPIO_Port, LIDAR1_INT_Pin);
+    sim_lidar_attach(1, LIDAR2_XSHUT_GPIO_Port, LIDAR2_XSHUT_Pin, LIDAR2_INT_GPIO_Port, LIDAR2_INT_Pin);
+    sim_lidar_attach(2, LIDAR3_XSHUT_GPIO_Port, LIDAR3_XSHUT_Pin, LIDAR3_INT_GPIO_Port, LIDAR3_INT_Pin);
+    sim_lidar_attach(3, LIDAR4_XSHUT_GPIO_Port, LIDAR4_XSHUT_Pin, LIDAR4_INT_GPIO_Port, LIDAR4_INT_Pin);
+    sim_lidar_attach(4, LIDAR5_XSHUT_GPIO_Port, LIDAR5_XSHUT_Pin, LIDAR5_INT_GPIO_Port, LIDAR5_INT_Pin);
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        sim_lidar_set_distance(i, 200 * (i + 1));
+    }
+
+    lidar_set_speed(SPEED_MM_S);
+    lidar_init();
+    if (!lidar_set_zones(zones)) {
+        printf("Zones must be 1 to %u\n", LIDAR_ZONES_MAX);
+        return 2;
+    }
+    while (!lidar_is_booted() && s_now_us < BOOT_LIMIT) {
+        s_run_until(s_now_us + 1000);
+    }
+    s_check(lidar_is_booted(), "boot did not finish", 0);
+
+    // Baseline with every sensor working
+    uint32_t scans = s_scans();
+    s_run_until(s_now_us + HEALTHY_MS * 1000);
+    float baseline_hz = (s_scans() - scans) * 1000.0f / HEALTHY_MS;
+    s_max_gap_ms = 0;
+    printf("Sensor %u, %u beams, baseline scan %.2f Hz\n", victim, lidar_get_beam_count(), baseline_hz);
+
+    // Scans stop while the I2C is held, the gaps are only checked during the faults
+    s_race(victim);
+    s_max_gap_ms = 0;
+
+    printf(
+        "%-6s %9s %9s %10s %8s %8s %6s %7s %10s\n",
+        "fault",
+        "removed",
+        "scan Hz",
+        "recovered",
+        "results",
+        "timeouts",
+        "reads",
+        "reboots",
+        "state"
+    );
+    for (uint8_t p = 0; p < sizeof(s_phases) / sizeof(s_phases[0]); p++) {
+        const phase_t* phase = &s_phases[p];
+        outcome_t      outcome = {0};
+        lidar_health_t before, health;
+        lidar_get_health(victim, &before);
+
+        // Fault, scans are only counted while the sensor is out of the schedule
+        uint32_t start_ms = s_now_us / 1000;
+        s_inject(victim, phase->fault, true);
+        while (s_now_us / 1000 - start_ms < phase->fault_ms) {
+            uint32_t published = s_scans();
+            s_run_until(s_now_us + 1000);
+            lidar_get_health(victim, &health);
+            if (health.state != eLIDAR_HEALTH_OK && health.removals > before.removals) {
+                outcome.removed_ms = outcome.removed_ms ? outcome.removed_ms : s_now_us / 1000 - start_ms;
+                outcome.scans += s_scans() - published;
+                outcome.removed_for++;
+            }
+        }
+        float degraded_hz = outcome.removed_for ? outcome.scans * 1000.0f / outcome.removed_for : 0;
+
+        // Healthy again
+        uint32_t results = lidar_get_sensor(victim)->results;
+        uint32_t end_ms = s_now_us / 1000;
+        s_inject(victim, phase->fault, false);
+        while (s_now_us / 1000 - end_ms < phase->clear_ms) {
+            s_run_until(s_now_us + 1000);
+            lidar_get_health(victim, &health);
+            if (!outcome.recovered_ms && health.recoveries > before.recoveries && health.state == eLIDAR_HEALTH_OK) {
+                outcome.recovered_ms = s_now_us / 1000 - end_ms;
+            }
+        }
+        outcome.results = lidar_get_sensor(victim)->results - results;
+        lidar_get_health(victim, &health);
+
+        static const char* states[] = {"ok", "removed", "rebooting", "failed"};
+        printf(
+            "%-6s %6" PRIu32 " ms %9.2f %7" PRIu32 " ms %8" PRIu32 " %8" PRIu32 " %6" PRIu32 " %7u %10s\n",
+            phase->name,
+            outcome.removed_ms,
+            degraded_hz,
+            outcome.recovered_ms,
+            outcome.results,
+            health.timeouts - before.timeouts,
+            health.read_errors - before.read_errors,
+            health.reboots,
+            states[health.state]
+        );
+
+        s_check(outcome.removed_ms > 0, "not removed during the fault", p);
+        s_check(degraded_hz * 100 >= baseline_hz * MIN_RATE, "others lost their rate while it was removed", p);
+        if (phase->fault == eFAULT_STUCK) {
+            s_check(health.stuck > before.stuck, "stuck sensor not detected", p);
+        }
+        if (phase->clear_ms) {
+            s_check(outcome.recovered_ms > 0 && health.state == eLIDAR_HEALTH_OK, "not recovered", p);
+            s_check(outcome.results > 0, "no results after the recovery", p);
+        } else {
+            s_check(health.state == eLIDAR_HEALTH_FAILED, "dead sensor not given up on", p);
+        }
+    }
+
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        lidar_health_t health;
+        lidar_get_health(i, &health);
+        if (i != victim) {
+            s_check(health.state == eLIDAR_HEALTH_OK && health.removals == 0, "working sensor removed", i);
+        }
+    }
+
+    lidar_schedule_t schedule;
+    lidar_get_schedule(&schedule);
+    float period_ms = 1000.0f / baseline_hz;
+    printf(
+        "%" PRIu32 " scans published, %" PRIu32 " dropped, longest gap %" PRIu32 " ms (%.1f periods)\n",
+        schedule.published,
+        schedule.dropped,
+        s_max_gap_ms,
+        s_max_gap_ms / period_ms
+    );
+    s_check(s_max_gap_ms <= MAX_GAP * period_ms, "scans stalled", 0);
+    s_check(schedule.running, "schedule stopped", 0);
+
+    printf(s_failed ? "FAILED\n" : "OK\n");
+    return s_failed ? 1 : 0;
+}
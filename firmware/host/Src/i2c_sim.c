@@ -0,0 +1,260 @@
+/**
+ * @file i2c_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host implementation of User/i2c.h on a simulated 400 kHz bus
+ * Transfers are queued and prioritized like on target and complete after their time on the wire,
+ * the done callbacks are called from sim_i2c_step() which stands in for the I2C interrupt.
+ * sim_i2c_lockup() hangs the bus until i2c_poll() recovers it. A transfer submitted again while it is still
+ * queued or on the bus would corrupt the queue on target, here it is counted and dropped.
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim.h"
+
+#include "User/i2c.h"
+
+typedef struct
+{
+    i2c_xfer_t* head;
+    i2c_xfer_t* tail;
+} queue_t;
+
+// ============= Private variables ===================
+static queue_t     s_queues[eI2C_PRIO_COUNT];
+static i2c_xfer_t* s_active; // Transfer on the bus
+static uint32_t    s_now_us;
+static uint32_t    s_started_us; // When the transfer went on the bus
+static uint32_t    s_end_us;     // When the transfer leaves the bus
+static bool        s_locked;     // A slave holds the bus, the transfer on it never ends
+static bool        s_abort;      // Recovered, finish the transfer from the next step
+static uint32_t    s_starts;
+static uint32_t    s_watch_starts;
+static uint32_t    s_watch_ms;
+static uint32_t    s_recoveries;
+static uint32_t    s_resubmits;
+
+static i2c_stats_t s_stats;
+static uint64_t    s_busy_us;
+static uint64_t    s_wait_us[eI2C_PRIO_COUNT];
+static uint32_t    s_waited[eI2C_PRIO_COUNT];
+static uint32_t    s_since_us;
+
+// ============ Private function declaration =================
+static uint32_t s_duration_us(bool read, uint16_t len);
+static void     s_waited_for(const i2c_xfer_t* xfer);
+static void     s_start(void);
+static void     s_finish(bool ok);
+static bool     s_is_pending(const i2c_xfer_t* xfer);
+
+//============ Private function implementation ===============
+/**
+ * @brief Time on the wire, 9 clocks per byte plus start, repeated start and stop
+ */
+static uint32_t s_duration_us(bool read, uint16_t len) {
+    uint32_t bytes = 3 + len + (read ? 1 : 0);
+    uint32_t clocks = bytes * 9 + (read ? 3 : 2);
+    return (clocks * 1000000 + I2C_SPEED_HZ - 1) / I2C_SPEED_HZ;
+}
+
+static void s_waited_for(const i2c_xfer_t* xfer) {
+    uint32_t wait_us = s_now_us - xfer->queued;
+
+    s_wait_us[xfer->priority] += wait_us;
+    s_waited[xfer->priority]++;
+    if (wait_us > s_stats.wait_max_us[xfer->priority]) {
+        s_stats.wait_max_us[xfer->priority] = wait_us;
+    }
+}
+
+/**
+ * @brief Put the head of the highest priority queue on the bus
+ */
+static void s_start(void) {
+    uint8_t p = 0;
+    while (p < eI2C_PRIO_COUNT && s_queues[p].head == NULL) {
+        p++;
+    }
+    if (p == eI2C_PRIO_COUNT) {
+        return;
+    }
+
+    queue_t*    queue = &s_queues[p];
+    i2c_xfer_t* xfer = queue->head;
+    s_waited_for(xfer);
+
+    s_active = xfer;
+    queue->head = xfer->next;
+    if (queue->head == NULL) {
+        queue->tail = NULL;
+    }
+    xfer->next = NULL;
+    s_started_us = s_now_us;
+    s_end_us = s_now_us + s_duration_us(xfer->read, xfer->len);
+    s_starts++;
+}
+
+/**
+ * @brief Take the transfer off the bus at s_now_us, call its callback and start the next one
+ */
+static void s_finish(bool ok) {
+    i2c_xfer_t* xfer = s_active;
+
+    s_busy_us += s_now_us - s_started_us;
+    s_active = NULL;
+    s_stats.transfers++;
+    s_stats.errors += !ok;
+    xfer->done(xfer, ok);
+
+    if (s_active == NULL) {
+        s_start();
+    }
+}
+
+static bool s_is_pending(const i2c_xfer_t* xfer) {
+    if (xfer == s_active) {
+        return true;
+    }
+    for (uint8_t p = 0; p < eI2C_PRIO_COUNT; p++) {
+        for (const i2c_xfer_t* queued = s_queues[p].head; queued; queued = queued->next) {
+            if (queued == xfer) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// ==================== Global function implementation ==========================
+void i2c_init(void) {
+    memset(s_queues, 0, sizeof(s_queues));
+    s_active = NULL;
+    s_locked = false;
+    s_abort = false;
+    i2c_reset_stats();
+}
+
+void i2c_submit(i2c_xfer_t* xfer) {
+    if (s_is_pending(xfer)) {
+        s_resubmits++;
+        return;
+    }
+
+    queue_t* queue = &s_queues[xfer->priority];
+    xfer->next = NULL;
+    xfer->queued = s_now_us;
+
+    if (queue->tail) {
+        queue->tail->next = xfer;
+    } else {
+        queue->head = xfer;
+    }
+    queue->tail = xfer;
+    s_stats.queued[xfer->priority]++;
+    if (s_active == NULL) {
+        s_start();
+    }
+}
+
+bool i2c_is_idle(void) {
+    return s_active == NULL;
+}
+
+/**
+ * @brief Same watchdog as on target, the recovery clocks release the slave
+ */
+void i2c_poll(uint32_t now_ms) {
+    if (s_active == NULL || s_starts != s_watch_starts) {
+        s_watch_starts = s_starts;
+        s_watch_ms = now_ms;
+        return;
+    }
+    if (now_ms - s_watch_ms < I2C_STALL_MS) {
+        return;
+    }
+
+    s_locked = false;
+    s_abort = true;
+    s_stats.recoveries++;
+    s_recoveries++;
+    s_watch_ms = now_ms;
+}
+
+uint32_t i2c_get_recoveries(void) {
+    return s_recoveries;
+}
+
+void i2c_get_stats(i2c_stats_t* stats) {
+    *stats = s_stats;
+    stats->busy_us = s_busy_us;
+    stats->window_us = s_now_us - s_since_us;
+    for (uint8_t p = 0; p < eI2C_PRIO_COUNT; p++) {
+        stats->wait_mean_us[p] = s_waited[p] ? s_wait_us[p] / s_waited[p] : 0;
+    }
+}
+
+void i2c_reset_stats(void) {
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(s_wait_us, 0, sizeof(s_wait_us));
+    memset(s_waited, 0, sizeof(s_waited));
+    s_busy_us = 0;
+    s_since_us = s_now_us;
+}
+
+/**
+ * @brief Complete the runs that have left the bus
+ * 
+ * @param now_us Monotonic time in microseconds
+ */
+void sim_i2c_step(uint32_t now_us) {
+    s_now_us = now_us;
+
+    if (s_abort) {
+        s_abort = false;
+        if (s_active) {
+            s_finish(false);
+        }
+    }
+
+    while (s_active && !s_locked && (int32_t)(now_us - s_end_us) >= 0) {
+        i2c_xfer_t* xfer = s_active;
+
+        bool ok = xfer->read ? sim_lidar_read(xfer->address, xfer->reg, xfer->data, xfer->len)
+                             : sim_lidar_write(xfer->address, xfer->reg, xfer->data, xfer->len);
+
+        // The next transfer follows back to back, also when it is queued by a callback
+        s_now_us = s_end_us;
+        s_finish(ok);
+        s_now_us = now_us;
+    }
+}
+
+/**
+ * @brief Check if a transfer is queued or on the bus, its done callback has not been called yet
+ */
+bool sim_i2c_is_pending(const i2c_xfer_t* xfer) {
+    return s_is_pending(xfer);
+}
+
+/**
+ * @brief Transfers submitted again before they were done, each one a corrupted queue on target
+ */
+uint32_t sim_i2c_get_resubmits(void) {
+    return s_resubmits;
+}
+
+/**
+ * @brief Hang the bus like a slave holding SDA low, the transfer on it or the next one never ends
+ * The bus is released by the recovery in i2c_poll().
+ */
+void sim_i2c_lockup(void) {
+    s_locked = true;
+}
@@ -0,0 +1,560 @@
+/**
+ * @file lidar_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Runs the lidar and VL53L1X driver state machines against simulated sensors in simulated time
+ * Boots the board (XSHUT sequencing and address assignment), ranges for a while and checks the outcome.
+ * The schedule must reach the rate the timing budget allows without two neighbours ranging at the same time.
+ * The simulated targets are sloped so every beam sees its own distance, the beam geometry is printed.
+ * Published scans are read every millisecond like a control loop would, none may be missed or incomplete.
+ * With injected faults the filtered ranges must stay close to the targets while the raw ones do not.
+ * With several speeds the run is split between them, every regime must reach its rate and no scan may be lost
+ * when it changes.
+ * With a cover glass every sensor is calibrated for offset and crosstalk and the board is power cycled, the
+ * calibration must come back from flash and the ranges must be close to the targets despite the glass.
+ * With bus lockups every one must be recovered before a sensor is blamed for it.
+ * Exits with 1 if a check fails.
+ * 
+ * Usage: lidar_sim [-t ms] [-d index] [-z zones] [-f permille] [-r file] [-s mm/s,...] [-c] [-l count]
+ *   -t  Simulated time to range after boot, default 1000 ms
+ *   -d  Sensor that never boots, the others must still come up and keep their rate while it is retried
+ *   -z  Beams per sensor, default 1
+ *   -f  Measurements with a fault per thousand, default 0
+ *   -r  Write the first published scans as lidar_recording.c, the input of the lidar_filter benchmark
+ *   -s  Vehicle speeds, comma separated, default 0
+ *   -c  Cover glass in front of every sensor, calibrate before ranging
+ *   -l  Bus lockups spread over the ranging, default 0
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "sim.h"
+
+#include "User/i2c.h"
+#include "User/lidar.h"
+#include "User/lidar_filter.h"
+#include "User/lidar_recording.h"
+#include "User/nvm.h"
+
+#define STEP_US    10
+#define BOOT_LIMIT 1000000 // Boot must be done within 1 s
+#define MIN_RATE   90      // Percent of the rate the timing budget allows
+#define GRADIENT   10      // Target slope in mm per SPAD column
+#define OUTLIER    30      // Range error in mm that counts as an outlier
+#define SPEEDS_MAX 8
+
+// Calibration, targets as recommended by ST
+#define CALIB_OFFSET_MM 140
+#define CALIB_XTALK_MM  600
+#define CALIB_ERROR     10 // Range error in mm left after the calibration
+#define GLASS_MM(i)     (15 + 5 * (i))
+#define GLASS_CPS(i)    (6000 + 500 * (i))
+
+// ============= Private variables ===================
+static uint32_t s_now_us;
+static int      s_failed;
+
+// ============ Private function declaration =================
+static void s_run_until(uint32_t end_us);
+static bool s_boot(void);
+static void s_calibrate(int dead);
+static void s_check(bool ok, const char* what, uint8_t index);
+static int  s_target_mm(uint8_t sensor, uint8_t roi_center);
+static int  s_error_mm(uint8_t beam, uint16_t distance_mm);
+static bool s_record(FILE* file, const lidar_scan_t* scan, uint8_t index, uint16_t faults);
+
+//============ Private function implementation ===============
+static void s_run_until(uint32_t end_us) {
+    while ((int32_t)(end_us - s_now_us) > 0) {
+        s_now_us += STEP_US;
+        sim_lidar_step(s_now_us);
+        sim_i2c_step(s_now_us);
+        if (s_now_us % (LIDAR_POLL_MS * 1000) == 0) {
+            lidar_poll(s_now_us / 1000);
+        }
+    }
+}
+
+/**
+ * @brief Boot the board and wait for the sequence to finish
+ * 
+ * @return false if it took longer than BOOT_LIMIT
+ */
+static bool s_boot(void) {
+    uint32_t start_us = s_now_us;
+
+    lidar_init();
+    while (!lidar_is_booted() && s_now_us - start_us < BOOT_LIMIT) {
+        s_run_until(s_now_us + STEP_US);
+    }
+    return lidar_is_booted();
+}
+
+/**
+ * @brief Calibrate every working sensor against targets straight ahead, save and power cycle the board
+ */
+static void s_calibrate(int dead) {
+    static const struct
+    {
+        lidar_calib_e kind;
+        uint16_t      target_mm;
+    } steps[] = {{eLIDAR_CALIB_OFFSET, CALIB_OFFSET_MM}, {eLIDAR_CALIB_XTALK, CALIB_XTALK_MM}};
+
+    lidar_stop();
+    s_run_until(s_now_us + 200000);
+
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        for (uint8_t step = 0; step < sizeof(steps) / sizeof(steps[0]); step++) {
+            sim_lidar_set_distance(i, steps[step].target_mm);
+            bool started = lidar_calibrate(i, steps[step].kind, steps[step].target_mm);
+            if (i == dead) {
+                s_check(!started, "calibration of a dead sensor started", i);
+                continue;
+            }
+            s_check(started, "calibration did not start", i);
+            while (lidar_get_calib_state() == eLIDAR_CALIB_RUNNING) {
+                s_run_until(s_now_us + 1000);
+            }
+            s_check(lidar_get_calib_state() == eLIDAR_CALIB_DONE, "calibration failed", i);
+        }
+        sim_lidar_set_distance(i, 200 * (i + 1));
+    }
+    s_check(lidar_save_calibration(), "calibration not saved", 0);
+
+    lidar_calib_t saved;
+    lidar_get_calibration(&saved);
+
+    // Power cycle, every sensor is held in reset until the board boots again
+    GPIO_TypeDef* ports[LIDAR_COUNT] = {
+        LIDAR1_XSHUT_GPIO_Port,
+        LIDAR2_XSHUT_GPIO_Port,
+        LIDAR3_XSHUT_GPIO_Port,
+        LIDAR4_XSHUT_GPIO_Port,
+        LIDAR5_XSHUT_GPIO_Port,
+    };
+    uint16_t pins[LIDAR_COUNT] = {
+        LIDAR1_XSHUT_Pin,
+        LIDAR2_XSHUT_Pin,
+        LIDAR3_XSHUT_Pin,
+        LIDAR4_XSHUT_Pin,
+        LIDAR5_XSHUT_Pin,
+    };
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        HAL_GPIO_WritePin(ports[i], pins[i], GPIO_PIN_RESET);
+    }
+    s_run_until(s_now_us + 10000);
+    s_check(s_boot(), "boot after the calibration did not finish", 0);
+
+    lidar_calib_t loaded;
+    lidar_get_calibration(&loaded);
+    s_check(!memcmp(&saved, &loaded, sizeof(saved)), "calibration not loaded from flash", 0);
+
+    printf("%-3s %8s %8s %10s %10s\n", "#", "glass mm", "offset", "glass cps", "xtalk cps");
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        printf("%-3u %8d %8d %10d %10u\n", i, GLASS_MM(i), loaded.offset_mm[i], GLASS_CPS(i), loaded.xtalk_cps[i]);
+        if (i == dead) {
+            continue;
+        }
+        s_check((loaded.offset_valid >> i) & (loaded.xtalk_valid >> i) & 1, "calibration missing", i);
+        s_check(lidar_get_sensor(i)->offset_mm == loaded.offset_mm[i], "offset not written after boot", i);
+        s_check(lidar_get_sensor(i)->xtalk_cps == loaded.xtalk_cps[i], "crosstalk not written after boot", i);
+    }
+    printf("Calibration loaded after a power cycle, %" PRIu32 " bytes of flash left\n", nvm_get_free());
+}
+
+static void s_check(bool ok, const char* what, uint8_t index) {
+    if (!ok) {
+        printf("FAIL %u: %s\n", index, what);
+        s_failed++;
+    }
+}
+
+/**
+ * @brief Distance the simulated sensor reports for a region of interest
+ */
+static int s_target_mm(uint8_t sensor, uint8_t roi_center) {
+    int column = (roi_center - 128) / 8;
+    return 200 * (sensor + 1) + GRADIENT * (column - 8);
+}
+
+static int s_error_mm(uint8_t beam, uint16_t distance_mm) {
+    lidar_beam_t geometry;
+    lidar_get_beam(beam, &geometry);
+    return abs((int)distance_mm - s_target_mm(geometry.sensor, geometry.roi_center));
+}
+
+/**
+ * @brief Append a scan to the recording, writes the file header before the first and the end after the last
+ * 
+ * @return true when the recording is complete
+ */
+static bool s_record(FILE* file, const lidar_scan_t* scan, uint8_t index, uint16_t faults) {
+    if (index == 0) {
+        fprintf(
+            file,
+            "/**\n"
+            " * @file lidar_recording.c\n"
+            " * @brief Lidar scans recorded with 'lidar_sim -z %u -f %u -r <file>', do not edit\n"
+            " */\n\n"
+            "#include \"User/lidar_recording.h\"\n\n"
+            "const lidar_recording_t lidar_recording[LIDAR_RECORDING_SCANS] = {\n",
+            LIDAR_RECORDING_BEAMS / LIDAR_COUNT,
+            faults
+        );
+    }
+
+    fprintf(file, "    {\n        .status = {");
+    for (uint8_t b = 0; b < scan->beams; b++) {
+        fprintf(file, b ? ", %u" : "%u", scan->status[b]);
+    }
+    fprintf(file, "},\n        .distance_mm = {");
+    for (uint8_t b = 0; b < scan->beams; b++) {
+        fprintf(file, b ? ", %u" : "%u", scan->distance_mm[b]);
+    }
+    fprintf(file, "},\n        .signal_kcps = {");
+    for (uint8_t b = 0; b < scan->beams; b++) {
+        fprintf(file, b ? ", %u" : "%u", scan->signal_kcps[b]);
+    }
+    fprintf(file, "},\n    },\n");
+
+    if (index + 1 < LIDAR_RECORDING_SCANS) {
+        return false;
+    }
+    fprintf(file, "};\n");
+    return true;
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    uint32_t run_ms = 1000;
+    int      dead = -1;
+    uint8_t  zones = 1;
+    uint16_t faults = 0;
+    FILE*    recording = NULL;
+    int32_t  speeds[SPEEDS_MAX] = {0};
+    uint8_t  speed_count = 1;
+    bool     glass = false;
+    uint32_t lockups = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            run_ms = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            dead = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-z") && i + 1 < argc) {
+            zones = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            faults = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            char* next = argv[++i];
+            for (speed_count = 0; speed_count < SPEEDS_MAX && *next; speed_count++) {
+                speeds[speed_count] = strtol(next, &next, 10);
+                next += *next == ',';
+            }
+        } else if (!strcmp(argv[i], "-c")) {
+            glass = true;
+        } else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+            lockups = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            recording = fopen(argv[++i], "w");
+            if (!recording) {
+                perror(argv[i]);
+                return 2;
+            }
+        } else {
+            printf(
+                "Usage: lidar_sim [-t ms] [-d index] [-z zones] [-f permille] [-r file] [-s mm/s,...] [-c] [-l count]\n"
+            );
+            return 2;
+        }
+    }
+    if (recording && zones * LIDAR_COUNT != LIDAR_RECORDING_BEAMS) {
+        printf("Recordings have %u beams, use -z %u\n", LIDAR_RECORDING_BEAMS, LIDAR_RECORDING_BEAMS / LIDAR_COUNT);
+        return 2;
+    }
+
+    sim_lidar_attach(0, LIDAR1_XSHUT_GPIO_Port, LIDAR1_XSHUT_Pin, LIDAR1_INT_GPIO_Port, LIDAR1_INT_Pin);
+    sim_lidar_attach(1, LIDAR2_XSHUT_GPIO_Port, LIDAR2_XSHUT_Pin, LIDAR2_INT_GPIO_Port, LIDAR2_INT_Pin);
+    sim_lidar_attach(2, LIDAR3_XSHUT_GPIO_Port, LIDAR3_XSHUT_Pin, LIDAR3_INT_GPIO_Port, LIDAR3_INT_Pin);
+    sim_lidar_attach(3, LIDAR4_XSHUT_GPIO_Port, LIDAR4_XSHUT_Pin, LIDAR4_INT_GPIO_Port, LIDAR4_INT_Pin);
+    sim_lidar_attach(4, LIDAR5_XSHUT_GPIO_Port, LIDAR5_XSHUT_Pin, LIDAR5_INT_GPIO_Port, LIDAR5_INT_Pin);
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        sim_lidar_set_distance(i, 200 * (i + 1));
+        sim_lidar_set_gradient(i, GRADIENT);
+        sim_lidar_set_dead(i, i == dead);
+        sim_lidar_set_faults(i, faults);
+        if (glass) {
+            sim_lidar_set_glass(i, GLASS_MM(i), GLASS_CPS(i));
+        }
+    }
+
+    // Boot
+    lidar_set_speed(speeds[0]);
+    lidar_init();
+    if (!lidar_set_zones(zones)) {
+        printf("Zones must be 1 to %u\n", LIDAR_ZONES_MAX);
+        return 2;
+    }
+    while (!lidar_is_booted() && s_now_us < BOOT_LIMIT) {
+        s_run_until(s_now_us + STEP_US);
+    }
+    s_check(lidar_is_booted(), "boot did not finish", 0);
+    printf("Boot done after %" PRIu32 " us\n", s_now_us);
+    if (glass) {
+        s_calibrate(dead);
+    }
+
+    // Range
+    uint32_t start_us = s_now_us;
+    uint32_t locked = 0;
+    i2c_reset_stats();
+    uint32_t counts[LIDAR_COUNT];
+    uint32_t measurements[LIDAR_COUNT];
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        counts[i] = lidar_get_sensor(i)->results;
+        measurements[i] = sim_lidar_get_measurements(i);
+    }
+    lidar_schedule_t schedule;
+    lidar_get_schedule(&schedule);
+    lidar_schedule_t before = schedule;
+    uint32_t         scans = schedule.scans;
+    uint8_t          phase = 0;
+    uint32_t         regime_ms[eLIDAR_REGIMES] = {0}; // Simulated time, the schedule measures host time
+
+    // Read the published scans like a consumer, they must arrive one by one and complete
+    uint32_t fresh_scans = 0;
+    uint32_t ranges = 0;
+    uint32_t raw_outliers = 0;      // Valid status but far from the target
+    uint32_t filtered_outliers = 0; // Valid after filtering but far from the target
+    uint32_t raw_invalid = 0;       // Status other than valid
+    uint32_t filtered_invalid = 0;
+    uint32_t warm = 0; // Bit per beam, filtered once
+    uint32_t sequence = lidar_get_scan(eLIDAR_READER_CONTROL, NULL)->sequence;
+    while ((int32_t)(start_us + run_ms * 1000 - s_now_us) > 0) {
+        s_run_until(s_now_us + 1000);
+
+        lidar_get_schedule(&schedule);
+        regime_ms[schedule.regime]++;
+
+        if (locked < lockups && (s_now_us - start_us) / 1000 >= (locked + 1) * run_ms / (lockups + 1)) {
+            sim_i2c_lockup();
+            locked++;
+        }
+
+        uint8_t now_phase = (uint64_t)(s_now_us - start_us) * speed_count / (run_ms * 1000);
+        if (now_phase != phase && now_phase < speed_count) {
+            phase = now_phase;
+            lidar_set_speed(speeds[phase]);
+        }
+
+        bool                fresh;
+        const lidar_scan_t* scan = lidar_get_scan(eLIDAR_READER_CONTROL, &fresh);
+        if (fresh) {
+            fresh_scans++;
+            s_check(scan->sequence == sequence + 1, "scan sequence skipped", 0);
+            s_check(scan->beams == lidar_get_beam_count(), "scan with the wrong number of beams", 0);
+            for (uint8_t b = 0; b < scan->beams; b++) {
+                lidar_beam_t beam;
+                lidar_get_beam(b, &beam);
+                bool valid = (scan->valid >> b) & 1;
+
+                if (beam.sensor == dead) {
+                    s_check(!valid, "filtered range of a dead sensor", b);
+                    continue;
+                }
+                s_check(faults || lockups || scan->status[b] == 0, "scan beam without a range", b);
+                if (fresh_scans < LIDAR_FILTER_MEDIAN) {
+                    continue; // Filter history not full yet
+                }
+                s_check(faults || lockups || valid, "scan beam without a filtered range", b);
+                warm |= (uint32_t)valid << b;
+                if (!((warm >> b) & 1)) {
+                    continue; // A fault during the warm up, the history is not full yet
+                }
+                ranges++;
+                raw_outliers += scan->status[b] == 0 && s_error_mm(b, scan->distance_mm[b]) > OUTLIER;
+                filtered_outliers += valid && s_error_mm(b, scan->filtered_mm[b]) > OUTLIER;
+                raw_invalid += scan->status[b] != 0;
+                filtered_invalid += !valid;
+            }
+            if (recording && s_record(recording, scan, fresh_scans - 1, faults)) {
+                fclose(recording);
+                recording = NULL;
+            }
+            sequence = scan->sequence;
+        }
+    }
+    i2c_stats_t bus;
+    i2c_get_stats(&bus);
+    lidar_get_schedule(&schedule);
+    scans = schedule.scans - scans;
+
+    // Every sensor ranges once per slot of its group, a slot is one timing budget of the regime
+    float ideal = 0;
+    for (uint8_t r = 0; r < eLIDAR_REGIMES; r++) {
+        ideal += (float)regime_ms[r] / (LIDAR_GROUPS * lidar_get_regime(r)->budget_ms);
+    }
+    float aggregate_hz = 0;
+
+    printf("%-3s %-5s %-8s %8s %8s %8s\n", "#", "addr", "state", "results", "errors", "Hz");
+    for (uint8_t i = 0; i < LIDAR_COUNT; i++) {
+        const vl53l1x_t* sensor = lidar_get_sensor(i);
+        uint32_t         results = sensor->results - counts[i];
+        float            hz = results * 1000.0f / run_ms;
+
+        aggregate_hz += hz;
+        printf(
+            "%-3u 0x%02x  %-8u %8" PRIu32 " %8" PRIu32 " %8.2f\n",
+            i,
+            sensor->address,
+            sensor->state,
+            sensor->results,
+            sensor->errors,
+            hz
+        );
+
+        lidar_health_t health;
+        lidar_get_health(i, &health);
+        if (i == dead) {
+            s_check(health.state != eLIDAR_HEALTH_OK && health.recoveries == 0, "dead sensor not removed", i);
+            continue;
+        }
+        s_check(health.removals == 0, "working sensor removed", i);
+        s_check(sensor->state == eVL53L1X_RANGING, "not ranging", i);
+        s_check(sensor->address == LIDAR_BASE_ADDRESS + i, "wrong address", i);
+        // A lockup may cost every sensor a result, the last one may still be read
+        s_check((results + 1 + lockups) * 100 >= ideal * MIN_RATE, "rate below the timing budget", i);
+        s_check(results <= (scans + 1) * zones, "more results than scans", i);
+        s_check(results + 1 + lockups >= sim_lidar_get_measurements(i) - measurements[i], "results not read", i);
+    }
+
+    printf(
+        "%-5s %-6s %-4s %4s %4s %8s %8s %6s %6s %6s\n",
+        "beam",
+        "sensor",
+        "zone",
+        "spad",
+        "cols",
+        "az [deg]",
+        "fov",
+        "count",
+        "mm",
+        "status"
+    );
+    for (uint8_t b = 0; b < lidar_get_beam_count(); b++) {
+        lidar_beam_t  beam;
+        lidar_range_t range = {0};
+        lidar_get_beam(b, &beam);
+        bool valid = lidar_get_range(b, &range);
+
+        printf(
+            "%-5u %-6u %-4u %4u %4u %8.1f %8.1f %6" PRIu32 " %6u %6u\n",
+            b,
+            beam.sensor,
+            beam.zone,
+            beam.roi_center,
+            beam.roi_width,
+            beam.azimuth_deg,
+            beam.width_deg,
+            range.count,
+            range.result.distance_mm,
+            range.result.status
+        );
+
+        if (beam.sensor == dead) {
+            continue;
+        }
+        if (!faults) {
+            s_check(valid && range.result.status == 0, "beam without a valid range", b);
+            int error = s_error_mm(b, range.result.distance_mm);
+            s_check(error <= (glass ? CALIB_ERROR : SIM_LIDAR_NOISE_MM), "beam range from the wrong zone", b);
+        }
+        if (b > 0) {
+            lidar_beam_t previous;
+            lidar_get_beam(b - 1, &previous);
+            s_check(beam.azimuth_deg > previous.azimuth_deg, "beams not ordered counter clockwise", b);
+        }
+    }
+    s_check(sim_lidar_get_collisions() == 0, "address collision on the bus", 0);
+    s_check(sim_lidar_get_crosstalk() == 0, "neighbours ranged at the same time", 0);
+    s_check(fresh_scans + 1 >= scans && schedule.dropped == before.dropped, "scans not published", 0);
+    s_check(filtered_outliers * 4 <= raw_outliers, "filter passes outliers", 0);
+    s_check(filtered_invalid * 4 <= raw_invalid, "filter does not bridge invalid ranges", 0);
+    s_check(!recording, "too few scans to record", 0);
+
+    printf("%-8s %6s %6s %6s %8s %8s %8s\n", "regime", "mode", "budget", "ms", "scans", "scan Hz", "allows");
+    for (uint8_t r = 0; r < eLIDAR_REGIMES; r++) {
+        const lidar_regime_t* regime = lidar_get_regime(r);
+        uint32_t              regime_scans = schedule.regime_scans[r] - before.regime_scans[r];
+        float                 hz = regime_ms[r] ? regime_scans * 1000.0f / regime_ms[r] : 0;
+        float                 allows = 1000.0f / (zones * LIDAR_GROUPS * regime->budget_ms);
+
+        printf(
+            "%-8s %6s %6u %6" PRIu32 " %8" PRIu32 " %8.2f %8.2f\n",
+            regime->name,
+            regime->mode == eVL53L1X_SHORT ? "short" : "long",
+            regime->budget_ms,
+            regime_ms[r],
+            regime_scans,
+            hz,
+            allows
+        );
+        bool fast_enough = (regime_scans + 1) * 100000.0f >= allows * regime_ms[r] * MIN_RATE;
+        s_check(fast_enough, "regime rate below its timing budget", r);
+    }
+
+    printf(
+        "%" PRIu32 " scans published, %u beams, scan %.2f Hz (budget allows %.2f Hz), aggregate %.2f Hz, %" PRIu32 " crosstalk\n",
+        fresh_scans,
+        lidar_get_beam_count(),
+        scans * 1000.0f / run_ms,
+        ideal * 1000.0f / (zones * run_ms),
+        aggregate_hz,
+        sim_lidar_get_crosstalk()
+    );
+
+    printf(
+        "%" PRIu32 " ranges, outliers %" PRIu32 " raw and %" PRIu32 " filtered, invalid %" PRIu32 " raw and %" PRIu32
+        " filtered\n",
+        ranges,
+        raw_outliers,
+        filtered_outliers,
+        raw_invalid,
+        filtered_invalid
+    );
+
+    s_check(bus.recoveries == lockups, "bus lockup not recovered", 0);
+
+    printf(
+        "I2C busy %" PRIu32 " us of %" PRIu32 " us (%.2f %%), %" PRIu32 " transfers, %" PRIu32 " errors, %" PRIu32
+        " recoveries\n",
+        bus.busy_us,
+        bus.window_us,
+        100.0 * bus.busy_us / bus.window_us,
+        bus.transfers,
+        bus.errors,
+        bus.recoveries
+    );
+    printf(
+        "I2C wait mean/max us: high %" PRIu32 "/%" PRIu32 ", normal %" PRIu32 "/%" PRIu32 ", low %" PRIu32 "/%" PRIu32
+        "\n",
+        bus.wait_mean_us[eI2C_PRIO_HIGH],
+        bus.wait_max_us[eI2C_PRIO_HIGH],
+        bus.wait_mean_us[eI2C_PRIO_NORMAL],
+        bus.wait_max_us[eI2C_PRIO_NORMAL],
+        bus.wait_mean_us[eI2C_PRIO_LOW],
+        bus.wait_max_us[eI2C_PRIO_LOW]
+    );
+    printf(s_failed ? "FAILED\n" : "OK\n");
+    return s_failed ? 1 : 0;
+}
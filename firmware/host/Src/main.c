@@ -0,0 +1,93 @@
+/**
+ * @file main.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Entry point of the host build, the application runs on the FreeRTOS POSIX port
+ * Tasks are created by the same Core/Src/freertos.c as on target. The host I/O task stands in for the
+ * interrupts: it polls the pseudo terminal and keyboard and advances the simulated lidar sensors and I2C bus.
+ * It also triggers the control cycles in place of TIM4.
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#include "cmsis_os.h"
+#include "host.h"
+#include "main.h"
+#include "sim.h"
+
+#include "User/control.h"
+#include "User/cycles.h"
+
+// ============= Private variables ===================
+static osThreadId s_io_task;
+
+// ============ Private function declaration =================
+static uint32_t s_now_us(void);
+static void     s_io_task_fn(void const* argument);
+
+//============ Private function implementation ===============
+static uint32_t s_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static void s_io_task_fn(void const* argument) {
+    uint32_t control_us = s_now_us();
+
+    host_keys_init();
+
+    for (;;) {
+        uint32_t now = s_now_us();
+        host_cdc_poll();
+        host_keys_poll();
+        sim_lidar_step(now);
+        sim_i2c_step(now);
+        sim_encoder_step(now);
+        sim_motor_step(now);
+        sim_battery_step(now);
+        if ((int32_t)(now - control_us) >= 0) {
+            control_us += CONTROL_PERIOD_US;
+            control_trigger();
+        }
+        osDelay(1);
+    }
+}
+
+// ==================== Global function implementation ==========================
+void MX_FREERTOS_Init(void);
+
+/**
+ * @brief Referenced by osSystickHandler() in cmsis_os.c, the POSIX port ticks from a signal instead
+ */
+void xPortSysTickHandler(void) {}
+
+int main(void) {
+    cycles_init();
+
+    // Simulated lidar board, targets at increasing distance
+    sim_lidar_attach(0, LIDAR1_XSHUT_GPIO_Port, LIDAR1_XSHUT_Pin, LIDAR1_INT_GPIO_Port, LIDAR1_INT_Pin);
+    sim_lidar_attach(1, LIDAR2_XSHUT_GPIO_Port, LIDAR2_XSHUT_Pin, LIDAR2_INT_GPIO_Port, LIDAR2_INT_Pin);
+    sim_lidar_attach(2, LIDAR3_XSHUT_GPIO_Port, LIDAR3_XSHUT_Pin, LIDAR3_INT_GPIO_Port, LIDAR3_INT_Pin);
+    sim_lidar_attach(3, LIDAR4_XSHUT_GPIO_Port, LIDAR4_XSHUT_Pin, LIDAR4_INT_GPIO_Port, LIDAR4_INT_Pin);
+    sim_lidar_attach(4, LIDAR5_XSHUT_GPIO_Port, LIDAR5_XSHUT_Pin, LIDAR5_INT_GPIO_Port, LIDAR5_INT_Pin);
+    for (uint8_t i = 0; i < 5; i++) {
+        sim_lidar_set_distance(i, 300 * (i + 1));
+    }
+
+    MX_FREERTOS_Init();
+
+    osThreadDef(hostIoTask, s_io_task_fn, osPriorityHigh, 0, 256);
+    s_io_task = osThreadCreate(osThread(hostIoTask), NULL);
+
+    osKernelStart();
+
+    // Only reached if the scheduler could not start
+    Error_Handler();
+    return 1;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file motor_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host implementation of User/motor.h, records the waveform of the H-bridge inputs
+ * Commands compute the waveform with the same motor_pwm.c as on target and leave it pending like the
+ * preload registers of TIM1. sim_motor_step() runs the PWM periods of a 96 MHz timer and takes the pending
+ * waveform at the start of a period, every change is recorded with the time of that period.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+#include "User/motor.h"
+
+#define TIMER_HZ 96000000
+
+typedef enum {
+    eCOMMAND_DRIVE,
+    eCOMMAND_BRAKE,
+    eCOMMAND_COAST,
+} command_e;
+
+// ============= Private variables ===================
+static motor_pwm_t        s_pwm;     // Pending, as written to the preload registers
+static motor_pwm_t        s_active;  // Running period
+static motor_decay_e      s_decay = eMOTOR_DECAY_COAST;
+static command_e          s_command = eCOMMAND_COAST;
+static float              s_duty;
+static uint32_t           s_hz = MOTOR_PWM_HZ;
+static bool               s_started;
+static double             s_period_us; // Start of the next period
+static sim_motor_record_t s_records[SIM_MOTOR_RECORDS];
+static uint32_t           s_head;
+static uint32_t           s_tail;
+
+// ============ Private function declaration =================
+static void s_apply(void);
+
+//============ Private function implementation ===============
+static void s_apply(void) {
+    switch (s_command) {
+    case eCOMMAND_DRIVE:
+        motor_pwm_drive(&s_pwm, s_duty, s_decay);
+        break;
+    case eCOMMAND_BRAKE:
+        motor_pwm_brake(&s_pwm);
+        break;
+    case eCOMMAND_COAST:
+        motor_pwm_coast(&s_pwm);
+        break;
+    }
+}
+
+// ==================== Global function implementation ==========================
+void motor_init(void) {
+    s_pwm.period = TIMER_HZ / (2 * s_hz);
+    s_apply();
+}
+
+bool motor_set_frequency(uint32_t hz) {
+    if (hz < MOTOR_PWM_HZ_MIN || hz > MOTOR_PWM_HZ_MAX) {
+        return false;
+    }
+    s_hz = hz;
+    s_pwm.period = TIMER_HZ / (2 * hz);
+    s_apply();
+    return true;
+}
+
+uint32_t motor_get_frequency(void) {
+    return s_hz;
+}
+
+void motor_set_decay(motor_decay_e decay) {
+    s_decay = decay;
+    s_apply();
+}
+
+void motor_set(float duty) {
+    s_duty = duty;
+    s_command = eCOMMAND_DRIVE;
+    s_apply();
+}
+
+void motor_brake(void) {
+    s_command = eCOMMAND_BRAKE;
+    s_apply();
+}
+
+void motor_coast(void) {
+    s_command = eCOMMAND_COAST;
+    s_apply();
+}
+
+float motor_get(void) {
+    return s_command == eCOMMAND_DRIVE ? s_duty : 0;
+}
+
+/**
+ * @brief Run the PWM periods that start up to now
+ *
+ * @param now_us Monotonic time in microseconds
+ */
+void sim_motor_step(uint32_t now_us) {
+    if (s_pwm.period == 0) {
+        return; // Not initialized, the timer is not running
+    }
+    if (!s_started) {
+        s_started = true;
+        s_period_us = now_us;
+    }
+
+    while (s_period_us <= now_us) {
+        if (s_pwm.period != s_active.period || s_pwm.in1 != s_active.in1 || s_pwm.in2 != s_active.in2) {
+            s_active = s_pwm;
+            s_records[s_head % SIM_MOTOR_RECORDS] = (sim_motor_record_t){(uint32_t)s_period_us, s_active};
+            s_head++;
+            if (s_head - s_tail > SIM_MOTOR_RECORDS) {
+                s_tail = s_head - SIM_MOTOR_RECORDS;
+            }
+        }
+        s_period_us += 2.0 * s_active.period * 1e6 / TIMER_HZ;
+    }
+}
+
+/**
+ * @brief Take the recorded changes of the waveform, oldest first
+ *
+ * @param records Filled
+ * @param max Size of records
+ * @return uint32_t Records taken, the oldest are lost beyond SIM_MOTOR_RECORDS
+ */
+uint32_t sim_motor_read(sim_motor_record_t* records, uint32_t max) {
+    uint32_t n = 0;
+
+    while (s_tail != s_head && n < max) {
+        records[n++] = s_records[s_tail % SIM_MOTOR_RECORDS];
+        s_tail++;
+    }
+    return n;
+}
+
+/**
+ * @brief Get the waveform of the running period
+ */
+void sim_motor_get_active(motor_pwm_t* pwm) {
+    *pwm = s_active;
+}
@@ -0,0 +1,171 @@
+/**
+ * @file nvm_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Records in flash against power cuts, in every step of a copy to the other sector
+ * A numbered record is written over and over next to one that never changes, through several copies to the
+ * other sector. Sector 6 starts with left over program code and the first records go to sector 7 like they
+ * did before there were copies. Now and then a write is cut short, and every write that copies, because the
+ * sector is full or a torn record is in the way, is cut after each of its flash operations in turn until one
+ * completes. After a cut the flash is powered again and read as after a reset: the numbered record must be
+ * the new one or the one before, the other one unchanged.
+ * Exits with 1 if a check fails.
+ *
+ * Usage: nvm_sim [-n writes]
+ *   -n  Writes of the numbered record, default 8000
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+
+#include "User/nvm.h"
+
+#define RECORD_BYTES (4 * (2 + NVM_RECORD_MAX / 4)) // Header, data and CRC
+#define CUT_EVERY    1000                         // One in this many plain writes is cut short
+#define CUT_MAX_OPS  1000                         // A copy takes far less
+
+typedef struct
+{
+    uint32_t number;
+    uint8_t  fill[NVM_RECORD_MAX - 4];
+} numbered_t;
+
+typedef struct
+{
+    uint32_t writes;
+    uint32_t copies;
+    uint32_t cuts;
+    uint32_t copy_cuts; // Cuts of a write that copies
+    uint32_t lost;      // Records that could not be read after a cut
+    uint32_t wrong;     // Records read with other contents
+} stats_t;
+
+// ============= Private variables ===================
+static uint8_t  s_fixed[40];
+static uint32_t s_latest; // Number in flash
+static stats_t  s_stats;
+
+// ============ Private function declaration =================
+static bool s_write(uint32_t number);
+static void s_check(uint32_t number, bool written);
+
+//============ Private function implementation ===============
+static bool s_write(uint32_t number) {
+    numbered_t record;
+
+    memset(&record, (uint8_t)number, sizeof(record));
+    record.number = number;
+    return nvm_write(eNVM_SERVO_CALIB, &record, sizeof(record));
+}
+
+/**
+ * @brief Read the records as after a reset
+ *
+ * @param number Number of the write just done
+ * @param written The write completed, it must be read
+ */
+static void s_check(uint32_t number, bool written) {
+    numbered_t record;
+    uint8_t    fixed[sizeof(s_fixed)];
+    numbered_t want;
+
+    if (!nvm_read(eNVM_SERVO_CALIB, &record, sizeof(record)) || !nvm_read(eNVM_LIDAR_CALIB, fixed, sizeof(fixed))) {
+        s_stats.lost++;
+        return;
+    }
+    memset(&want, (uint8_t)record.number, sizeof(want));
+    want.number = record.number;
+
+    bool ok = record.number == number || (!written && record.number == s_latest);
+    ok = ok && !memcmp(&record, &want, sizeof(record)) && !memcmp(fixed, s_fixed, sizeof(fixed));
+    s_stats.wrong += !ok;
+    s_latest = record.number;
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    uint32_t writes = 8000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            writes = strtoul(argv[++i], NULL, 0);
+        } else {
+            printf("Usage: nvm_sim [-n writes]\n");
+            return 2;
+        }
+    }
+
+    // Program code of an older image in sector 6
+    srand(1);
+    HAL_FLASH_Unlock();
+    HAL_FLASH_Lock();
+    for (uint32_t i = 0; i < NVM_SIZE / 4; i++) {
+        host_flash[i] = (uint32_t)rand() * 2 + (rand() & 1);
+    }
+
+    for (uint8_t i = 0; i < sizeof(s_fixed); i++) {
+        s_fixed[i] = 3 * i + 1;
+    }
+    uint32_t errors = !nvm_write(eNVM_LIDAR_CALIB, s_fixed, sizeof(s_fixed));
+
+    bool copies = false; // The next write copies to the other sector
+    for (uint32_t number = 1; number <= writes; number++) {
+        uint32_t free = nvm_get_free();
+        bool     ok;
+
+        if (copies || free < RECORD_BYTES) {
+            // Cut after every operation of the copy in turn
+            uint32_t ops = 0;
+            do {
+                host_flash_cut(ops);
+                ok = s_write(number);
+                host_flash_restore();
+                s_check(number, ok);
+                s_stats.cuts += !ok;
+                s_stats.copy_cuts += !ok;
+            } while (!ok && ++ops < CUT_MAX_OPS);
+            errors += !ok;
+            copies = false;
+        } else if (rand() % CUT_EVERY == 0) {
+            // Cut short, a torn record makes the next write copy
+            host_flash_cut(rand() % (RECORD_BYTES / 4 + 1));
+            ok = s_write(number);
+            host_flash_restore();
+            s_check(number, ok);
+            s_stats.cuts += !ok;
+            copies = !ok;
+        } else {
+            ok = s_write(number);
+            s_check(number, ok);
+            errors += !ok;
+        }
+        s_stats.writes++;
+        s_stats.copies += nvm_get_free() > free;
+    }
+
+    printf("%8s %8s %8s %10s %8s %8s\n", "writes", "copies", "cuts", "copy cuts", "lost", "wrong");
+    printf(
+        "%8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %10" PRIu32 " %8" PRIu32 " %8" PRIu32 "\n",
+        s_stats.writes,
+        s_stats.copies,
+        s_stats.cuts,
+        s_stats.copy_cuts,
+        s_stats.lost,
+        s_stats.wrong
+    );
+    printf("%" PRIu32 " bytes of flash left, %" PRIu32 " failed writes\n", nvm_get_free(), errors);
+
+    errors += s_stats.lost + s_stats.wrong + (s_stats.copies < 2);
+    printf(errors ? "FAILED\n" : "OK\n");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+/**
+ * @file pcsamp.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host stand-in for the PC-sampling profiler
+ * There is no sampling timer on the host, profile the host build with perf instead.
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "User/pcsamp.h"
+
+void pcsamp_start(uint32_t hz) {}
+
+void pcsamp_stop(void) {}
+
+bool pcsamp_is_running(void) {
+    return false;
+}
+
+bool pcsamp_pop(pcsamp_sample_t* sample) {
+    return false;
+}
+
+uint32_t pcsamp_get_dropped(void) {
+    return 0;
+}
+
+uint32_t pcsamp_get_total(void) {
+    return 0;
+}
@@ -0,0 +1,217 @@
+/**
+ * @file pool_stress.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Block pools allocated and freed from concurrent threads, then the faults of the debug mode
+ * Every thread holds a few blocks of random sizes at a time and fills them with its number and a count. A
+ * block handed to two threads at once is overwritten by the other one, the owner finds that before it frees
+ * it. Afterwards no block may be in use and no fault may have been counted.
+ * Then a double free, a write after free and frees of pointers that are not blocks are made on purpose, each
+ * one must be refused or counted. Exits with 1 on any error.
+ *
+ * Usage: pool_stress [-t ms]
+ *   -t  Run time of the threads, default 1000 ms
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "User/pool.h"
+
+#define THREADS 4
+#define HELD    6 // Blocks per thread at a time
+
+typedef struct
+{
+    uint32_t* block;
+    uint32_t  words;
+    uint32_t  stamp;
+} held_t;
+
+typedef struct
+{
+    uint8_t  index;
+    uint64_t allocs;
+    uint64_t failures;
+    uint64_t corrupted; // Blocks written by someone else while held
+    uint64_t refused;   // Frees of held blocks that failed
+} worker_t;
+
+// ============= Private variables ===================
+static atomic_bool s_stop;
+
+// ============ Private function declaration =================
+static void* s_worker(void* arg);
+#if POOL_DEBUG
+static bool s_faults(void);
+#endif
+
+//============ Private function implementation ===============
+static void* s_worker(void* arg) {
+    worker_t* worker = arg;
+    held_t    held[HELD] = {0};
+    uint32_t  seed = worker->index + 1;
+    uint32_t  count = 0;
+
+    while (!atomic_load(&s_stop)) {
+        held_t* h = &held[rand_r(&seed) % HELD];
+
+        if (h->block != NULL) {
+            for (uint32_t w = 0; w < h->words; w++) {
+                if (h->block[w] != h->stamp) {
+                    worker->corrupted++;
+                    break;
+                }
+            }
+            worker->refused += !pool_free(h->block);
+            h->block = NULL;
+            continue;
+        }
+
+        size_t size = 4 + rand_r(&seed) % POOL_MESSAGE_SIZE;
+        h->block = pool_alloc(size);
+        if (h->block == NULL) {
+            worker->failures++;
+            continue;
+        }
+        worker->allocs++;
+        h->words = size / 4;
+        h->stamp = ((uint32_t)worker->index << 24) | (++count & 0xFFFFFF);
+        for (uint32_t w = 0; w < h->words; w++) {
+            h->block[w] = h->stamp;
+        }
+    }
+
+    for (uint8_t i = 0; i < HELD; i++) {
+        worker->refused += !pool_free(held[i].block);
+    }
+    return NULL;
+}
+
+#if POOL_DEBUG
+/**
+ * @brief Make every fault once and check that it is found, with the statistics reset before
+ */
+static bool s_faults(void) {
+    bool         ok = true;
+    pool_stats_t stats;
+
+    uint8_t* block = pool_alloc(POOL_MESSAGE_SIZE);
+    ok &= pool_free(block);
+    ok &= !pool_free(block);
+    pool_get_stats(ePOOL_MESSAGE, &stats);
+    printf("double free:      %s\n", stats.double_frees == 1 ? "refused" : "MISSED");
+    ok &= stats.double_frees == 1;
+
+    block = pool_alloc(POOL_MESSAGE_SIZE);
+    ok &= pool_free(block);
+    block[POOL_MESSAGE_SIZE / 2] = 1; // Freed blocks are the first ones allocated again
+    uint8_t* again = pool_alloc(POOL_MESSAGE_SIZE);
+    pool_get_stats(ePOOL_MESSAGE, &stats);
+    printf("use after free:   %s\n", (again == block && stats.use_after_free == 1) ? "found" : "MISSED");
+    ok &= again == block && stats.use_after_free == 1;
+    ok &= pool_free(again);
+
+    uint32_t local;
+    block = pool_alloc(POOL_MESSAGE_SIZE);
+    bool foreign = !pool_free(&local) && !pool_free(block + 1);
+    printf("not a block:      %s\n", foreign ? "refused" : "MISSED");
+    ok &= foreign && pool_free(block);
+
+    return ok;
+}
+#endif
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    uint32_t run_ms = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            run_ms = strtoul(argv[++i], NULL, 0);
+        } else {
+            printf("Usage: pool_stress [-t ms]\n");
+            return 2;
+        }
+    }
+
+    pthread_t threads[THREADS];
+    worker_t  workers[THREADS] = {0};
+
+    atomic_store(&s_stop, false);
+    for (uint8_t t = 0; t < THREADS; t++) {
+        workers[t].index = t;
+        pthread_create(&threads[t], NULL, s_worker, &workers[t]);
+    }
+
+    struct timespec sleep = {.tv_sec = run_ms / 1000, .tv_nsec = (run_ms % 1000) * 1000000L};
+    nanosleep(&sleep, NULL);
+    atomic_store(&s_stop, true);
+
+    uint64_t errors = 0;
+    printf("%-7s %12s %10s %10s %8s\n", "thread", "allocs", "failures", "corrupted", "refused");
+    for (uint8_t t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        printf(
+            "%-7u %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %8" PRIu64 "\n",
+            t,
+            workers[t].allocs,
+            workers[t].failures,
+            workers[t].corrupted,
+            workers[t].refused
+        );
+        errors += workers[t].corrupted + workers[t].refused;
+    }
+
+    printf(
+        "%-8s %5s %6s %6s %6s %10s %8s %11s %14s\n",
+        "pool",
+        "size",
+        "blocks",
+        "in use",
+        "high",
+        "allocs",
+        "failures",
+        "double free",
+        "use after free"
+    );
+    for (pool_e p = 0; p < ePOOLS; p++) {
+        pool_stats_t stats;
+        pool_get_stats(p, &stats);
+        printf(
+            "%-8s %5u %6u %6" PRIu32 " %6" PRIu32 " %10" PRIu32 " %8" PRIu32 " %11" PRIu32 " %14" PRIu32 "\n",
+            stats.name,
+            stats.size,
+            stats.blocks,
+            stats.in_use,
+            stats.high_water,
+            stats.allocs,
+            stats.failures,
+            stats.double_frees,
+            stats.use_after_free
+        );
+        errors += stats.in_use != 0 || stats.high_water > stats.blocks;
+        errors += stats.double_frees + stats.use_after_free;
+    }
+
+#if POOL_DEBUG
+    pool_reset_stats();
+    errors += !s_faults();
+#else
+    printf("POOL_DEBUG off, faults not checked\n");
+#endif
+
+    printf(errors ? "FAILED\n" : "OK\n");
+    return errors ? 1 : 0;
+}
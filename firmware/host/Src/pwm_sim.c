@@ -0,0 +1,194 @@
+/**
+ * @file pwm_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Motor PWM waveform against a script of commands, recorded by the host mock of User/motor.h
+ * Every command of the script is sent in the middle of a PWM period, drive commands right after a different
+ * duty that must never show. The recorded waveform must change once, at the start of the next period, and
+ * drive the commanded share of the period with the off time coasting or braking as set.
+ * Exits with 1 if a check fails.
+ *
+ * Usage: pwm_sim
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim.h"
+
+#include "User/motor.h"
+
+#define TIMER_HZ     96000000
+#define COMMAND_US   1000 // Between the commands of the script
+#define COMMAND_SKEW 17   // Commands come this far into a period
+
+typedef enum {
+    eACTION_SET,
+    eACTION_BRAKE,
+    eACTION_COAST,
+    eACTION_DECAY,
+    eACTION_FREQUENCY,
+} action_e;
+
+typedef struct
+{
+    action_e action;
+    float    arg;
+} command_t;
+
+// ============= Private variables ===================
+static const command_t s_script[] = {
+    {eACTION_SET, 0.5f},
+    {eACTION_SET, 1.0f},
+    {eACTION_SET, -0.25f},
+    {eACTION_DECAY, eMOTOR_DECAY_BRAKE},
+    {eACTION_SET, 0.75f},
+    {eACTION_SET, -1.0f},
+    {eACTION_FREQUENCY, 10000},
+    {eACTION_SET, 0.1f},
+    {eACTION_BRAKE, 0},
+    {eACTION_DECAY, eMOTOR_DECAY_COAST},
+    {eACTION_SET, 0.001f},
+    {eACTION_FREQUENCY, 500},
+    {eACTION_SET, -0.6f},
+    {eACTION_COAST, 0},
+};
+
+static const char* s_actions[] = {"set", "brake", "coast", "decay", "freq"};
+
+// ============ Private function declaration =================
+static float s_period_us(uint32_t hz);
+
+//============ Private function implementation ===============
+static float s_period_us(uint32_t hz) {
+    return 2.0f * (TIMER_HZ / (2 * hz)) * 1e6f / TIMER_HZ;
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    uint32_t      now_us = 0;
+    float         duty = 0;
+    motor_decay_e decay = eMOTOR_DECAY_COAST;
+    action_e      state = eACTION_COAST;
+    uint32_t      hz = MOTOR_PWM_HZ;
+    int           failed = 0;
+
+    if (argc > 1) {
+        printf("Usage: pwm_sim\n");
+        return 2;
+    }
+
+    motor_init();
+    sim_motor_step(now_us);
+    sim_motor_record_t record;
+    if (sim_motor_read(&record, 1) != 1 || record.pwm.in1 || record.pwm.in2) {
+        printf("FAIL init: not coasting\n");
+        failed++;
+    }
+
+    printf("%-6s %6s %8s %8s %6s %6s %6s %8s\n", "cmd", "arg", "sent us", "at us", "period", "in1", "in2", "voltage");
+    for (uint8_t i = 0; i < sizeof(s_script) / sizeof(s_script[0]); i++) {
+        const command_t* command = &s_script[i];
+        float            period_us = s_period_us(hz);
+        bool             change = true;
+
+        now_us += COMMAND_US;
+        sim_motor_step(now_us);
+        now_us += COMMAND_SKEW;
+        sim_motor_step(now_us);
+
+        switch (command->action) {
+        case eACTION_SET:
+            motor_set(-command->arg);
+            motor_set(command->arg);
+            duty = command->arg;
+            state = eACTION_SET;
+            break;
+        case eACTION_BRAKE:
+            motor_brake();
+            state = eACTION_BRAKE;
+            break;
+        case eACTION_COAST:
+            motor_coast();
+            state = eACTION_COAST;
+            break;
+        case eACTION_DECAY:
+            motor_set_decay((motor_decay_e)command->arg);
+            decay = (motor_decay_e)command->arg;
+            change = state == eACTION_SET; // Braking and coasting have no off time
+            break;
+        case eACTION_FREQUENCY:
+            change = motor_set_frequency((uint32_t)command->arg);
+            if (change != (command->arg >= MOTOR_PWM_HZ_MIN && command->arg <= MOTOR_PWM_HZ_MAX)) {
+                printf("FAIL freq %.0f: range not checked\n", command->arg);
+                failed++;
+            }
+            if (change) {
+                hz = (uint32_t)command->arg;
+            }
+            break;
+        }
+
+        uint32_t sent_us = now_us;
+        sim_motor_step(now_us + (uint32_t)(2 * period_us));
+        uint32_t n = sim_motor_read(&record, 1);
+        if (n != (change ? 1 : 0) || sim_motor_read(&record, 1)) {
+            printf("FAIL %s: waveform changed %s\n", s_actions[command->action], change ? "not once" : "anyway");
+            failed++;
+            continue;
+        }
+        if (!n) {
+            printf("%-6s %6.3g %8u %8s\n", s_actions[command->action], command->arg, sent_us, "-");
+            continue;
+        }
+
+        const motor_pwm_t* pwm = &record.pwm;
+        float              voltage = ((float)pwm->in1 - pwm->in2) / pwm->period;
+        printf(
+            "%-6s %6.3g %8u %8u %6u %6u %6u %8.4f\n",
+            s_actions[command->action],
+            command->arg,
+            sent_us,
+            record.at_us,
+            pwm->period,
+            pwm->in1,
+            pwm->in2,
+            voltage
+        );
+
+        if (record.at_us <= sent_us || record.at_us > sent_us + period_us) {
+            printf("FAIL %s: not taken at the start of the next period\n", s_actions[command->action]);
+            failed++;
+        }
+        if (pwm->period != TIMER_HZ / (2 * hz)) {
+            printf("FAIL %s: period for %u Hz\n", s_actions[command->action], hz);
+            failed++;
+        }
+
+        bool ok = true;
+        if (state == eACTION_BRAKE) {
+            ok = pwm->in1 == pwm->period && pwm->in2 == pwm->period;
+        } else if (state == eACTION_COAST) {
+            ok = pwm->in1 == 0 && pwm->in2 == 0;
+        } else {
+            // Driving for the duty share, the nested pulses of the inputs leave the off time to both high or low
+            uint16_t off = pwm->in1 < pwm->in2 ? pwm->in1 : pwm->in2;
+            uint16_t on = pwm->in1 > pwm->in2 ? pwm->in1 : pwm->in2;
+            ok = fabsf(voltage - duty) <= 0.5f / pwm->period &&
+                 (decay == eMOTOR_DECAY_COAST ? off == 0 : on == pwm->period);
+        }
+        if (!ok) {
+            printf("FAIL %s: waveform does not match the command\n", s_actions[command->action]);
+            failed++;
+        }
+    }
+
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file ring_stress.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Bytes through a ring between two threads, read in place like the coms TX ring is by USB
+ * The producer puts a sequence of bytes derived from their number and retries when the ring is full. The
+ * consumer peeks, holds the bytes for a while like a transfer in flight, checks that they are still the ones
+ * it peeked and in sequence, and consumes all or part of them. Every byte must arrive once and in order, and
+ * every failed put must be counted as dropped. Exits with 1 on any error.
+ *
+ * Usage: ring_stress [-t ms]
+ *   -t  Run time, default 1000 ms
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "User/ring.h"
+
+typedef struct
+{
+    uint64_t bytes;
+    uint64_t peeks;
+    uint64_t partial;     // Peeks consumed only in part
+    uint64_t overwritten; // Bytes changed while held
+    uint64_t disorder;    // Bytes out of sequence
+} consumer_t;
+
+// ============= Private variables ===================
+static RING(s_ring, 256);
+
+static atomic_bool s_stop;
+static atomic_bool s_done;
+static uint64_t    s_sent;
+static uint64_t    s_full; // Failed puts
+
+// ============ Private function declaration =================
+static uint8_t s_byte(uint64_t n);
+static void*   s_producer(void* arg);
+static void*   s_consumer(void* arg);
+
+//============ Private function implementation ===============
+static uint8_t s_byte(uint64_t n) {
+    return (uint8_t)(n * 7 + (n >> 8));
+}
+
+static void* s_producer(void* arg) {
+    uint64_t n = 0;
+
+    while (!atomic_load(&s_stop)) {
+        if (ring_put(&s_ring, s_byte(n))) {
+            n++;
+        } else {
+            s_full++;
+        }
+    }
+    s_sent = n;
+    atomic_store(&s_done, true);
+    return NULL;
+}
+
+static void* s_consumer(void* arg) {
+    consumer_t* consumer = arg;
+    uint8_t     copy[256];
+    uint32_t    seed = 1;
+
+    for (;;) {
+        // Done is loaded before the ring, nothing is left once it is set and the ring is empty
+        bool           done = atomic_load(&s_done);
+        uint16_t       len;
+        const uint8_t* data = ring_peek(&s_ring, &len);
+
+        if (data == NULL) {
+            if (done) {
+                break;
+            }
+            continue;
+        }
+        consumer->peeks++;
+
+        // In flight, the producer keeps adding meanwhile
+        memcpy(copy, data, len);
+        sched_yield();
+        if (memcmp(copy, data, len)) {
+            consumer->overwritten++;
+        }
+
+        uint16_t take = rand_r(&seed) % 4 ? len : 1 + rand_r(&seed) % len;
+        consumer->partial += take < len;
+        for (uint16_t i = 0; i < take; i++) {
+            consumer->disorder += data[i] != s_byte(consumer->bytes);
+            consumer->bytes++;
+        }
+        ring_consume(&s_ring, take);
+    }
+    return NULL;
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    uint32_t run_ms = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            run_ms = strtoul(argv[++i], NULL, 0);
+        } else {
+            printf("Usage: ring_stress [-t ms]\n");
+            return 2;
+        }
+    }
+
+    pthread_t  producer;
+    pthread_t  consumer_thread;
+    consumer_t consumer = {0};
+
+    atomic_store(&s_stop, false);
+    pthread_create(&producer, NULL, s_producer, NULL);
+    pthread_create(&consumer_thread, NULL, s_consumer, &consumer);
+
+    struct timespec sleep = {.tv_sec = run_ms / 1000, .tv_nsec = (run_ms % 1000) * 1000000L};
+    nanosleep(&sleep, NULL);
+    atomic_store(&s_stop, true);
+
+    pthread_join(producer, NULL);
+    pthread_join(consumer_thread, NULL);
+
+    ring_stats_t stats;
+    ring_get_stats(&s_ring, &stats);
+
+    uint64_t errors = 0;
+    printf(
+        "%12s %12s %10s %10s %8s %12s %9s\n",
+        "sent",
+        "received",
+        "peeks",
+        "partial",
+        "full",
+        "overwritten",
+        "disorder"
+    );
+    printf(
+        "%12" PRIu64 " %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %8" PRIu64 " %12" PRIu64 " %9" PRIu64 "\n",
+        s_sent,
+        consumer.bytes,
+        consumer.peeks,
+        consumer.partial,
+        s_full,
+        consumer.overwritten,
+        consumer.disorder
+    );
+    printf(
+        "size %u, used %u, high water %u, dropped %" PRIu32 "\n",
+        stats.size,
+        stats.used,
+        stats.high_water,
+        stats.dropped
+    );
+    errors += consumer.overwritten + consumer.disorder;
+    errors += consumer.bytes != s_sent || stats.used != 0;
+    errors += stats.high_water > stats.size || stats.dropped != (uint32_t)s_full;
+
+    printf(errors ? "FAILED\n" : "OK\n");
+    return errors ? 1 : 0;
+}
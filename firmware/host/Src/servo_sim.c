@@ -0,0 +1,98 @@
+/**
+ * @file servo_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host implementation of User/servo.h, keeps the pulse and frame rate the timer would output
+ * Angles are mapped with the same servo_map.c as on target and the calibration is kept in the simulated
+ * flash through nvm.c. The output changes as soon as it is written, frame by frame timing is not simulated.
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+#include "User/nvm.h"
+#include "User/servo.h"
+
+// ============= Private variables ===================
+static servo_calib_t s_calib;
+static float         s_pulse_us;
+static bool          s_started;
+
+// ==================== Global function implementation ==========================
+void servo_init(void) {
+    if (!nvm_read(eNVM_SERVO_CALIB, &s_calib, sizeof(s_calib)) || !servo_map_valid(&s_calib)) {
+        s_calib = servo_calib_default;
+    }
+    s_pulse_us = s_calib.pulse_us[eSERVO_CENTER];
+    s_started = true;
+}
+
+void servo_set(float steer_deg) {
+    s_pulse_us = servo_map_pulse(&s_calib, steer_deg);
+}
+
+bool servo_set_pulse(float pulse_us) {
+    if (!(pulse_us >= SERVO_PULSE_MIN_US && pulse_us <= SERVO_PULSE_MAX_US)) {
+        return false;
+    }
+    s_pulse_us = pulse_us;
+    return true;
+}
+
+float servo_get_pulse(void) {
+    return s_pulse_us;
+}
+
+float servo_get(void) {
+    return servo_map_angle(&s_calib, s_pulse_us);
+}
+
+bool servo_set_point(servo_point_e point) {
+    servo_calib_t calib = s_calib;
+
+    calib.pulse_us[point] = s_pulse_us;
+    if (!servo_map_valid(&calib)) {
+        return false;
+    }
+    s_calib = calib;
+    return true;
+}
+
+bool servo_set_frame(uint16_t frame_hz) {
+    if (frame_hz < SERVO_FRAME_HZ_MIN || frame_hz > SERVO_FRAME_HZ_MAX) {
+        return false;
+    }
+    s_calib.frame_hz = frame_hz;
+    return true;
+}
+
+void servo_get_calibration(servo_calib_t* calib) {
+    *calib = s_calib;
+}
+
+bool servo_save_calibration(void) {
+    return nvm_write(eNVM_SERVO_CALIB, &s_calib, sizeof(s_calib));
+}
+
+bool servo_clear_calibration(void) {
+    s_calib = servo_calib_default;
+    s_pulse_us = s_calib.pulse_us[eSERVO_CENTER];
+    return nvm_erase(eNVM_SERVO_CALIB);
+}
+
+/**
+ * @brief Get the output of the timer
+ *
+ * @param pulse_us Pulse width, 0 before servo_init() started the pulses
+ * @param frame_hz Frame rate
+ */
+void sim_servo_get_output(float* pulse_us, uint16_t* frame_hz) {
+    *pulse_us = s_started ? s_pulse_us : 0;
+    *frame_hz = s_calib.frame_hz;
+}
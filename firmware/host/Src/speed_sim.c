@@ -0,0 +1,148 @@
+/**
+ * @file speed_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Speed and travel of the encoder estimator against a simulated wheel, crawl to top speed
+ * The wheel of encoder_sim.c drives a profile of phases, from crawling to top speed, backwards, a ramp
+ * and a stop. Every sample the M/T speed of encoder.h is compared to the true speed, next to the plain
+ * M method, counts per sample period, from the same counter.
+ * The M/T error must stay within SPEED_ERROR once a phase has settled, the counts must be exact at every
+ * sample and the speed must be 0 after a stop, exits with 1 otherwise.
+ *
+ * Usage: speed_sim
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim.h"
+
+#include "User/encoder.h"
+#include "User/encoder_est.h"
+#include "User/geometry.h"
+
+#define PERIOD_US   (1000000 / ENCODER_RATE_HZ)
+#define SPEED_ERROR 0.01f // Largest relative M/T error once settled
+
+typedef struct
+{
+    const char* name;
+    float       from_mm_s;   // Speed at the start of the phase
+    float       to_mm_s;     // Speed at the end, ramped linearly in between
+    uint32_t    duration_ms;
+    uint32_t    settle_ms;   // Not checked at the start, a capture interval must pass first
+} phase_t;
+
+typedef struct
+{
+    float    mean;
+    float    max;
+    uint32_t n;
+} stats_t;
+
+// ============= Private variables ===================
+static const phase_t s_phases[] = {
+    {"crawl", 2, 2, 1000, 100},
+    {"slow", 50, 50, 500, 20},
+    {"cruise", 1000, 1000, 500, 10},
+    {"top", 5000, 5000, 500, 10},
+    {"reverse", -1000, -1000, 500, 10},
+    {"ramp", 1000, 3000, 2000, 10},
+    {"stop", 0, 0, 500, ENCODER_EST_STOP_US / 1000 + 1},
+};
+
+// ============ Private function declaration =================
+static void s_add(stats_t* stats, float error);
+
+//============ Private function implementation ===============
+static void s_add(stats_t* stats, float error) {
+    stats->mean += fabsf(error);
+    stats->max = fmaxf(stats->max, fabsf(error));
+    stats->n++;
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    uint32_t now_us = 0;
+    int32_t  counts = 0;
+    int      failed = 0;
+
+    if (argc > 1) {
+        printf("Usage: speed_sim\n");
+        return 2;
+    }
+
+    sim_encoder_step(now_us);
+    encoder_init();
+
+    printf("%.5f mm per count, %u Hz samples\n", geometry_tables.vehicle.mm_per_count, ENCODER_RATE_HZ);
+    printf("%-8s %8s %10s %10s %10s %10s\n", "phase", "mm/s", "M/T mean%", "M/T max%", "M mean%", "M max%");
+
+    for (uint8_t p = 0; p < sizeof(s_phases) / sizeof(s_phases[0]); p++) {
+        const phase_t* phase = &s_phases[p];
+        stats_t        mt = {0}, m = {0};
+        bool           count_error = false;
+        bool           stopped = true;
+
+        for (uint32_t ms = 0; ms < phase->duration_ms; ms++) {
+            float speed = phase->from_mm_s + (phase->to_mm_s - phase->from_mm_s) * ms / phase->duration_ms;
+            sim_encoder_set_speed(speed);
+            now_us += PERIOD_US;
+            sim_encoder_step(now_us);
+
+            encoder_state_t state;
+            encoder_get(&state);
+            float speed_m = (state.counts - counts) * geometry_tables.vehicle.mm_per_count * ENCODER_RATE_HZ;
+            counts = state.counts;
+
+            if (state.counts != sim_encoder_get_counts()) {
+                count_error = true;
+            }
+            if (ms < phase->settle_ms) {
+                continue;
+            }
+            if (speed == 0) {
+                stopped = stopped && state.speed_mm_s == 0;
+                continue;
+            }
+            s_add(&mt, (state.speed_mm_s - speed) / speed);
+            s_add(&m, (speed_m - speed) / speed);
+        }
+
+        if (mt.n) {
+            printf(
+                "%-8s %8.0f %10.3f %10.3f %10.2f %10.2f\n",
+                phase->name,
+                phase->to_mm_s,
+                100 * mt.mean / mt.n,
+                100 * mt.max,
+                100 * m.mean / m.n,
+                100 * m.max
+            );
+        } else {
+            printf("%-8s %8.0f %10s %10s %10s %10s\n", phase->name, phase->to_mm_s, "-", "-", "-", "-");
+        }
+
+        if (count_error) {
+            printf("FAIL %s: counts differ from the wheel\n", phase->name);
+            failed++;
+        }
+        if (mt.max > SPEED_ERROR) {
+            printf("FAIL %s: speed error above %.1f %%\n", phase->name, 100 * SPEED_ERROR);
+            failed++;
+        }
+        if (!stopped) {
+            printf("FAIL %s: not standing still\n", phase->name);
+            failed++;
+        }
+    }
+
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file steer_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Steering angle to servo pulse through the calibration and its limits, against the host mock of
+ * User/servo.h
+ * Steers across full lock and beyond with the default calibration, one with the center off the middle and a
+ * servo fitted the other way around, and reads the angle back. Pulses and frame rates out of range, a center
+ * outside the ends and invalid calibrations in flash must be refused. Exits with 1 if a check fails.
+ *
+ * Usage: steer_sim
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim.h"
+
+#include "User/geometry.h"
+#include "User/nvm.h"
+#include "User/servo.h"
+
+#define PULSE_TOL_US 0.01f
+#define ANGLE_TOL    0.001f // Degrees
+
+// ============= Private variables ===================
+static uint32_t s_errors;
+
+// ============ Private function declaration =================
+static void  s_check(const char* name, float want, float got, float tol);
+static float s_pulse(void);
+static void  s_sweep(const char* calib, const float* pulse_us);
+static void  s_flash(const servo_calib_t* calib);
+
+//============ Private function implementation ===============
+static void s_check(const char* name, float want, float got, float tol) {
+    bool ok = fabsf(got - want) <= tol;
+
+    printf("%-40s %10.3f %10.3f %s\n", name, want, got, ok ? "" : "<-");
+    s_errors += !ok;
+}
+
+static float s_pulse(void) {
+    float    pulse_us;
+    uint16_t frame_hz;
+
+    sim_servo_get_output(&pulse_us, &frame_hz);
+    return pulse_us;
+}
+
+/**
+ * @brief Steer from beyond full lock right to beyond full lock left and back from the pulse
+ *
+ * @param calib Name of the calibration in use
+ * @param pulse_us Left, center and right pulse of the calibration in use
+ */
+static void s_sweep(const char* calib, const float* pulse_us) {
+    static const float shares[] = {-2, -1, -0.5f, -0.1f, 0, 0.1f, 0.5f, 1, 2};
+    float              max = geometry_tables.vehicle.steer_max_deg;
+    char               name[64];
+
+    for (uint8_t i = 0; i < sizeof(shares) / sizeof(shares[0]); i++) {
+        float share = fmaxf(-1, fminf(1, shares[i]));
+        float center = pulse_us[eSERVO_CENTER];
+        float end = pulse_us[share >= 0 ? eSERVO_LEFT : eSERVO_RIGHT];
+
+        servo_set(shares[i] * max);
+        snprintf(name, sizeof(name), "%s %+5.1f deg pulse", calib, shares[i] * max);
+        s_check(name, center + (end - center) * fabsf(share), s_pulse(), PULSE_TOL_US);
+        snprintf(name, sizeof(name), "%s %+5.1f deg angle", calib, shares[i] * max);
+        s_check(name, share * max, servo_get(), ANGLE_TOL);
+    }
+}
+
+static void s_flash(const servo_calib_t* calib) {
+    nvm_write(eNVM_SERVO_CALIB, calib, sizeof(*calib));
+    servo_init();
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    servo_calib_t calib;
+    uint16_t      frame_hz;
+    float         pulse_us;
+    char          name[64];
+
+    printf("%-40s %10s %10s\n", "check", "want", "got");
+
+    s_check("pulse before init", 0, s_pulse(), 0);
+    servo_init();
+    sim_servo_get_output(&pulse_us, &frame_hz);
+    s_check("pulse after init", servo_calib_default.pulse_us[eSERVO_CENTER], pulse_us, 0);
+    s_check("frame after init [Hz]", servo_calib_default.frame_hz, frame_hz, 0);
+    s_sweep("default", servo_calib_default.pulse_us);
+
+    // Limits of the raw pulse and the frame rate, a refused one leaves the output as it is
+    servo_set(0);
+    s_check("pulse 499.9 refused", false, servo_set_pulse(499.9f), 0);
+    s_check("pulse 2500.1 refused", false, servo_set_pulse(2500.1f), 0);
+    s_check("pulse NaN refused", false, servo_set_pulse(NAN), 0);
+    s_check("pulse kept", servo_calib_default.pulse_us[eSERVO_CENTER], s_pulse(), 0);
+    s_check("pulse 500 taken", true, servo_set_pulse(SERVO_PULSE_MIN_US), 0);
+    s_check("pulse 2500 taken", true, servo_set_pulse(SERVO_PULSE_MAX_US), 0);
+    s_check("pulse output", SERVO_PULSE_MAX_US, s_pulse(), 0);
+    s_check("frame 49 Hz refused", false, servo_set_frame(SERVO_FRAME_HZ_MIN - 1), 0);
+    s_check("frame 334 Hz refused", false, servo_set_frame(SERVO_FRAME_HZ_MAX + 1), 0);
+    s_check("frame 333 Hz taken", true, servo_set_frame(SERVO_FRAME_HZ_MAX), 0);
+    sim_servo_get_output(&pulse_us, &frame_hz);
+    s_check("frame output [Hz]", SERVO_FRAME_HZ_MAX, frame_hz, 0);
+
+    // Calibrate point by point, the center off the middle of the ends
+    static const float         offset[eSERVO_POINTS] = {2000, 1450, 1000};
+    static const servo_point_e order[] = {eSERVO_CENTER, eSERVO_LEFT, eSERVO_RIGHT};
+    for (uint8_t i = 0; i < eSERVO_POINTS; i++) {
+        servo_set_pulse(offset[order[i]]);
+        s_check("point taken", true, servo_set_point(order[i]), 0);
+    }
+    s_sweep("offset", offset);
+    servo_set_pulse(2100);
+    s_check("center outside the ends refused", false, servo_set_point(eSERVO_CENTER), 0);
+    servo_set_pulse(1450);
+    s_check("left on the center refused", false, servo_set_point(eSERVO_LEFT), 0);
+    servo_get_calibration(&calib);
+    s_check("center kept", offset[eSERVO_CENTER], calib.pulse_us[eSERVO_CENTER], 0);
+    s_check("left kept", offset[eSERVO_LEFT], calib.pulse_us[eSERVO_LEFT], 0);
+
+    // Saved and loaded again, then cleared back to the default
+    s_check("saved", true, servo_save_calibration(), 0);
+    servo_init();
+    servo_get_calibration(&calib);
+    s_check("center loaded", offset[eSERVO_CENTER], calib.pulse_us[eSERVO_CENTER], 0);
+    s_check("pulse after init", offset[eSERVO_CENTER], s_pulse(), 0);
+    s_check("cleared", true, servo_clear_calibration(), 0);
+    servo_init();
+    servo_get_calibration(&calib);
+    s_check("cleared stays after init", servo_calib_default.pulse_us[eSERVO_LEFT], calib.pulse_us[eSERVO_LEFT], 0);
+    s_check("frame of the default [Hz]", servo_calib_default.frame_hz, calib.frame_hz, 0);
+
+    // Servo fitted the other way around, a longer pulse steers to the right
+    calib = (servo_calib_t){.pulse_us = {1100, 1500, 1900}, .frame_hz = 200};
+    s_flash(&calib);
+    servo_get_calibration(&calib);
+    s_check("reversed loaded", 1100, calib.pulse_us[eSERVO_LEFT], 0);
+    s_check("reversed frame [Hz]", 200, calib.frame_hz, 0);
+    s_sweep("reversed", calib.pulse_us);
+
+    // Invalid calibrations in flash fall back to the default
+    static const servo_calib_t invalid[] = {
+        {.pulse_us = {1900, 2000, 1100}, .frame_hz = 50},
+        {.pulse_us = {1900, 1500, 1500}, .frame_hz = 50},
+        {.pulse_us = {2600, 1500, 1100}, .frame_hz = 50},
+        {.pulse_us = {1900, 1500, 400}, .frame_hz = 50},
+        {.pulse_us = {1900, 1500, 1100}, .frame_hz = 49},
+        {.pulse_us = {1900, 1500, 1100}, .frame_hz = 334},
+    };
+    for (uint8_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        s_flash(&invalid[i]);
+        servo_get_calibration(&calib);
+        snprintf(name, sizeof(name), "invalid %u in flash, default used", i);
+        bool defaults = calib.frame_hz == servo_calib_default.frame_hz;
+        for (uint8_t p = 0; p < eSERVO_POINTS; p++) {
+            defaults = defaults && calib.pulse_us[p] == servo_calib_default.pulse_us[p];
+        }
+        s_check(name, true, defaults, 0);
+    }
+
+    printf(s_errors ? "FAILED\n" : "OK\n");
+    return s_errors ? 1 : 0;
+}
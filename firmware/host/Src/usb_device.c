@@ -0,0 +1,104 @@
+/**
+ * @file usb_device.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Host stand-in for the USB CDC virtual COM port
+ * A pseudo terminal replaces the virtual COM port, connect to it with any terminal program,
+ * e.g. 'picocom /dev/pts/N'. Received bytes are handed to coms_add_rx() like CDC_Receive_FS() does.
+ * A transfer is written to the terminal at once and completes on the next poll, like the transmit complete
+ * interrupt it then calls coms_tx_done().
+ * @version 0.1
+ * @date 2023-11-23
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "host.h"
+#include "usbd_cdc_if.h"
+
+#include "User/coms.h"
+
+// ============= Private variables ===================
+static int           s_master = -1;
+static int           s_slave = -1; // Kept open so reads do not fail while no terminal is connected
+static volatile bool s_tx_busy;
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Open the pseudo terminal
+ */
+void host_cdc_init(void) {
+    s_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (s_master < 0 || grantpt(s_master) || unlockpt(s_master)) {
+        perror("[host] pty");
+        exit(1);
+    }
+
+    const char* name = ptsname(s_master);
+    s_slave = open(name, O_RDWR | O_NOCTTY);
+    if (s_slave >= 0) {
+        struct termios tio;
+        tcgetattr(s_slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(s_slave, TCSANOW, &tio);
+    }
+    fcntl(s_master, F_SETFL, fcntl(s_master, F_GETFL) | O_NONBLOCK);
+
+    printf("[host] Virtual COM port: %s\r\n", name);
+    fflush(stdout);
+}
+
+/**
+ * @brief Forward received bytes to coms and complete the last transfer
+ */
+void host_cdc_poll(void) {
+    uint8_t buffer[64];
+    ssize_t len;
+    while ((len = read(s_master, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < len; i++) {
+            coms_add_rx(buffer[i]);
+        }
+    }
+
+    if (s_tx_busy) {
+        // As atomic as the interrupt it stands in for
+        taskENTER_CRITICAL();
+        s_tx_busy = false;
+        coms_tx_done();
+        taskEXIT_CRITICAL();
+    }
+}
+
+/**
+ * @brief Send data to the terminal, busy until the next poll
+ */
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len) {
+    if (s_tx_busy) {
+        return USBD_BUSY;
+    }
+    if (s_master >= 0 && write(s_master, Buf, Len) < 0) {
+        return USBD_FAIL;
+    }
+    s_tx_busy = true;
+    return USBD_OK;
+}
+
+/**
+ * @brief Same entry point as the generated USB init, called from the default task
+ */
+void MX_USB_DEVICE_Init(void) {
+    host_cdc_init();
+}
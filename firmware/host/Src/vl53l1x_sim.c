@@ -0,0 +1,509 @@
+/**
+ * @file vl53l1x_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Simulated VL53L1X sensors
+ * Models what the driver depends on: reset through XSHUT, boot time, NACK until booted, the address register,
+ * start/stop, periodic or single shot results with GPIO1 raised on the attached EXTI pin and the interrupt clear.
+ * A measurement takes the timing budget set in the timeout registers, in short distance mode (VCSEL period A
+ * of 7) targets beyond SIM_LIDAR_SHORT_MM fail with a signal fail. Sensors are mounted in a fan in index
+ * order, a measurement that overlaps one of a neighbour is counted as crosstalk. The target seen through the
+ * region of interest can be sloped, its distance then depends on the SPAD column of the region center.
+ * Faults can be injected into a share of the measurements: sigma and signal failures, wrap around,
+ * weak returns with a valid status and outliers with a valid status.
+ * Failures of the whole sensor can be injected at any time: a dead sensor stops answering on the bus and
+ * ranging, a stuck one repeats its last result and a flaky one NACKs a share of the transfers.
+ * A cover glass adds a range offset and crosstalk, the crosstalk pulls ranges towards the sensor by its share of
+ * the signal. Both are reduced by the offset and crosstalk compensation registers, which reset to 0 with XSHUT.
+ * Other configuration registers are stored but do not change the measurement.
+ * @version 0.1
+ * @date 2023-11-24
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "main.h"
+#include "sim.h"
+
+#include "User/vl53l1x.h"
+
+#define REG_I2C_SLAVE_DEVICE_ADDRESS 0x0001
+#define REG_XTALK_PLANE_OFFSET_KCPS  0x0016
+#define REG_PART_TO_PART_OFFSET_MM   0x001E
+#define REG_GPIO_HV_MUX_CTRL         0x0030
+#define REG_GPIO_TIO_HV_STATUS       0x0031
+#define REG_TIMEOUT_MACROP_A         0x005E
+#define REG_VCSEL_PERIOD_A           0x0060
+#define REG_ROI_CENTRE_SPAD          0x007F
+#define REG_SYSTEM_INTERRUPT_CLEAR   0x0086
+#define REG_SYSTEM_MODE_START        0x0087
+#define REG_RESULT_RANGE_STATUS      0x0089
+#define REG_FIRMWARE_SYSTEM_STATUS   0x00E5
+#define REG_IDENTIFICATION_MODEL_ID  0x010F
+
+#define MODE_START_RANGE  0x40
+#define MODE_START_SINGLE 0x10
+
+#define SIGNAL_KCPS 2000 // Of a valid range
+#define SPADS       16   // Enabled for a range
+
+typedef struct
+{
+    uint16_t macrop_a;
+    uint32_t budget_us;
+} sim_budget_t;
+
+typedef struct
+{
+    GPIO_TypeDef* xshut_port;
+    uint16_t      xshut_pin;
+    GPIO_TypeDef* int_port;
+    uint16_t      int_pin;
+    bool          attached;
+    bool          dead;    // Does not answer on the bus or range
+    bool          stuck;   // Repeats the last result
+    bool          result;  // Result registers hold a measurement since the reset
+    bool          powered; // XSHUT high
+    bool          booted;
+    bool          ranging;
+    bool          single; // Stop after the next measurement
+    bool          irq;    // GPIO1 asserted
+    uint32_t      boot_us;
+    uint32_t      start_us; // Emitter on for the measurement in progress
+    uint32_t      next_us;  // Measurement in progress done
+    uint32_t      last_start_us;
+    uint32_t      last_end_us;
+    uint8_t       address;
+    uint8_t       regs[256];
+    uint16_t      distance_mm;
+    int16_t       gradient_mm; // Per SPAD column from the center of the array
+    uint16_t      faults;      // Per mille of the measurements
+    uint16_t      nacks;       // Per mille of the transfers
+    int16_t       glass_mm;    // Offset added by the cover glass
+    uint16_t      glass_cps;   // Crosstalk of the cover glass per SPAD
+    uint32_t      measurements;
+} sim_lidar_t;
+
+// ============= Private variables ===================
+static sim_lidar_t s_lidars[SIM_LIDAR_MAX];
+static uint32_t    s_now_us;
+static uint32_t    s_collisions; // Transfers answered by more than one sensor
+static uint32_t    s_crosstalk;  // Measurements overlapping one of a neighbour
+static uint32_t    s_rng = 0x1234567;
+
+// Budgets of the ULD, short and long distance mode
+static const sim_budget_t s_budgets[] = {
+    {0x001D, 15000},
+    {0x0051, 20000},
+    {0x00D6, 33000},
+    {0x01AE, 50000},
+    {0x02E1, 100000},
+    {0x03E1, 200000},
+    {0x0591, 500000},
+    {0x001E, 20000},
+    {0x0060, 33000},
+    {0x00AD, 50000},
+    {0x01CC, 100000},
+    {0x02D9, 200000},
+    {0x048F, 500000},
+};
+
+// ============ Private function declaration =================
+static void         s_reset(sim_lidar_t* lidar);
+static void         s_set_irq(sim_lidar_t* lidar, bool irq);
+static uint32_t     s_random(void);
+static int32_t      s_glass(sim_lidar_t* lidar, int32_t target);
+static void         s_measure(sim_lidar_t* lidar);
+static uint32_t     s_budget_us(sim_lidar_t* lidar);
+static uint8_t      s_roi_column(sim_lidar_t* lidar);
+static uint32_t     s_period_us(sim_lidar_t* lidar);
+static bool         s_overlaps(uint8_t index, uint32_t start_us, uint32_t end_us);
+static sim_lidar_t* s_find(uint8_t address);
+static uint8_t      s_get(sim_lidar_t* lidar, uint16_t reg);
+static void         s_set(sim_lidar_t* lidar, uint16_t reg, uint8_t value);
+
+//============ Private function implementation ===============
+static void s_reset(sim_lidar_t* lidar) {
+    memset(lidar->regs, 0, sizeof(lidar->regs));
+    lidar->address = VL53L1X_DEFAULT_ADDRESS;
+    lidar->regs[REG_I2C_SLAVE_DEVICE_ADDRESS] = VL53L1X_DEFAULT_ADDRESS;
+    lidar->booted = false;
+    lidar->ranging = false;
+    lidar->result = false;
+    s_set_irq(lidar, false);
+}
+
+static void s_set_irq(sim_lidar_t* lidar, bool irq) {
+    bool active_low = lidar->regs[REG_GPIO_HV_MUX_CTRL] & 0x10;
+    bool was_low = !(lidar->int_port->idr & lidar->int_pin);
+
+    lidar->irq = irq;
+    lidar->regs[REG_GPIO_TIO_HV_STATUS] = irq != active_low;
+
+    bool low = irq == active_low;
+    if (low) {
+        lidar->int_port->idr &= ~lidar->int_pin;
+    } else {
+        lidar->int_port->idr |= lidar->int_pin;
+    }
+
+    // EXTI is configured for the falling edge
+    if (low && !was_low) {
+        HAL_GPIO_EXTI_Callback(lidar->int_pin);
+    }
+}
+
+static uint32_t s_random(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+/**
+ * @brief Range through the cover glass with what the compensation registers leave of its errors
+ */
+static int32_t s_glass(sim_lidar_t* lidar, int32_t target) {
+    const uint8_t* regs = lidar->regs;
+    int32_t        plane = (regs[REG_XTALK_PLANE_OFFSET_KCPS] << 8) | regs[REG_XTALK_PLANE_OFFSET_KCPS + 1];
+    int32_t        offset = (int16_t)((regs[REG_PART_TO_PART_OFFSET_MM] << 8) | regs[REG_PART_TO_PART_OFFSET_MM + 1]);
+    int32_t        xtalk_cps = lidar->glass_cps - plane * 1000 / 512;
+
+    return target - target * xtalk_cps * SPADS / (SIGNAL_KCPS * 1000) + lidar->glass_mm + offset / 4;
+}
+
+static void s_measure(sim_lidar_t* lidar) {
+    int32_t  noise = (int32_t)(s_random() % (2 * SIM_LIDAR_NOISE_MM + 1)) - SIM_LIDAR_NOISE_MM;
+    int32_t  target = lidar->distance_mm + lidar->gradient_mm * (s_roi_column(lidar) - 8);
+    int32_t  distance = s_glass(lidar, target) + noise;
+    uint8_t  status = 9; // Range valid
+    uint16_t signal = SIGNAL_KCPS / 8;
+    uint16_t ambient = 100 / 8;
+
+    if (s_random() % 1000 < lidar->faults) {
+        int32_t error = (int32_t)(s_random() % 601) - 300;
+
+        switch (s_random() % 5) {
+            case 0: // Sigma fail
+                status = 6;
+                distance += error;
+                break;
+            case 1: // Signal fail
+                status = 4;
+                signal = 40 / 8;
+                distance += error;
+                break;
+            case 2: // Wrap around, the target is beyond the unambiguous range
+                status = 7;
+                distance %= 200;
+                break;
+            case 3: // Weak return the sensor still calls valid
+                signal = 120 / 8;
+                distance += error;
+                break;
+            default: // Outlier with a valid status, e.g. a reflection
+                distance += 300 + error / 2;
+                break;
+        }
+    }
+    if (lidar->regs[REG_VCSEL_PERIOD_A] == 0x07 && target > SIM_LIDAR_SHORT_MM) {
+        status = 4;
+        signal = 100 / 8;
+        distance = SIM_LIDAR_SHORT_MM + (distance % 200);
+    }
+    distance = distance < 0 ? 0 : distance;
+
+    uint8_t* result = &lidar->regs[REG_RESULT_RANGE_STATUS];
+    if (lidar->stuck && lidar->result) {
+        status = result[0];
+        distance = (result[13] << 8) | result[14];
+        signal = (result[15] << 8) | result[16];
+    }
+    lidar->result = true;
+    memset(result, 0, VL53L1X_RESULT_SIZE);
+    result[0] = status;
+    result[3] = SPADS;
+    result[7] = ambient >> 8;
+    result[8] = ambient & 0xFF;
+    result[13] = distance >> 8;
+    result[14] = distance & 0xFF;
+    result[15] = signal >> 8;
+    result[16] = signal & 0xFF;
+
+    uint8_t index = (uint8_t)(lidar - s_lidars);
+    if ((index > 0 && s_overlaps(index - 1, lidar->start_us, lidar->next_us)) ||
+        (index + 1 < SIM_LIDAR_MAX && s_overlaps(index + 1, lidar->start_us, lidar->next_us))) {
+        s_crosstalk++;
+    }
+    lidar->last_start_us = lidar->start_us;
+    lidar->last_end_us = lidar->next_us;
+
+    lidar->measurements++;
+    s_set_irq(lidar, true);
+}
+
+static uint32_t s_budget_us(sim_lidar_t* lidar) {
+    uint16_t macrop_a = (lidar->regs[REG_TIMEOUT_MACROP_A] << 8) | lidar->regs[REG_TIMEOUT_MACROP_A + 1];
+
+    for (uint8_t i = 0; i < sizeof(s_budgets) / sizeof(s_budgets[0]); i++) {
+        if (s_budgets[i].macrop_a == macrop_a) {
+            return s_budgets[i].budget_us;
+        }
+    }
+    return 100000;
+}
+
+/**
+ * @brief SPAD column of the region of interest center, inverse of the numbering in the ULD
+ */
+static uint8_t s_roi_column(sim_lidar_t* lidar) {
+    uint8_t spad = lidar->regs[REG_ROI_CENTRE_SPAD];
+    return spad >= 128 ? (spad - 128) / 8 : 15 - spad / 8;
+}
+
+/**
+ * @brief Time between measurements when ranging continuously, never shorter than the budget
+ */
+static uint32_t s_period_us(sim_lidar_t* lidar) {
+    uint32_t budget_us = s_budget_us(lidar);
+    return budget_us > SIM_LIDAR_PERIOD_US ? budget_us : SIM_LIDAR_PERIOD_US;
+}
+
+/**
+ * @brief Check if the emitter of a sensor was on at some point of the interval
+ */
+static bool s_overlaps(uint8_t index, uint32_t start_us, uint32_t end_us) {
+    sim_lidar_t* lidar = &s_lidars[index];
+    if (!lidar->attached) {
+        return false;
+    }
+
+    bool last = lidar->last_end_us != lidar->last_start_us && (int32_t)(lidar->last_start_us - end_us) < 0 &&
+                (int32_t)(lidar->last_end_us - start_us) > 0;
+    bool now = lidar->ranging && (int32_t)(lidar->start_us - end_us) < 0 && (int32_t)(lidar->next_us - start_us) > 0;
+    return last || now;
+}
+
+static sim_lidar_t* s_find(uint8_t address) {
+    sim_lidar_t* found = NULL;
+
+    for (uint8_t i = 0; i < SIM_LIDAR_MAX; i++) {
+        sim_lidar_t* lidar = &s_lidars[i];
+        if (lidar->attached && lidar->booted && !lidar->dead && lidar->address == address) {
+            if (found) {
+                s_collisions++;
+            } else {
+                found = lidar;
+            }
+        }
+    }
+    if (found && found->nacks && s_random() % 1000 < found->nacks) {
+        return NULL;
+    }
+    return found;
+}
+
+static uint8_t s_get(sim_lidar_t* lidar, uint16_t reg) {
+    if (reg == REG_IDENTIFICATION_MODEL_ID) {
+        return 0xEA;
+    } else if (reg == REG_IDENTIFICATION_MODEL_ID + 1) {
+        return 0xCC;
+    }
+    return reg < sizeof(lidar->regs) ? lidar->regs[reg] : 0;
+}
+
+static void s_set(sim_lidar_t* lidar, uint16_t reg, uint8_t value) {
+    if (reg >= sizeof(lidar->regs) || reg == REG_GPIO_TIO_HV_STATUS) {
+        // Status is read only, the default configuration write covers it
+        return;
+    }
+    lidar->regs[reg] = value;
+
+    if (reg == REG_GPIO_HV_MUX_CTRL) {
+        s_set_irq(lidar, lidar->irq); // Polarity changed
+    } else if (reg == REG_SYSTEM_INTERRUPT_CLEAR && (value & 0x01)) {
+        s_set_irq(lidar, false);
+    } else if (reg == REG_SYSTEM_MODE_START) {
+        lidar->ranging = value == MODE_START_RANGE || value == MODE_START_SINGLE;
+        lidar->single = value == MODE_START_SINGLE;
+        lidar->start_us = s_now_us + (lidar->single ? 0 : s_period_us(lidar) - s_budget_us(lidar));
+        lidar->next_us = lidar->start_us + s_budget_us(lidar);
+    }
+}
+
+// ==================== Global function implementation ==========================
+/**
+ * @brief Connect a simulated sensor to its XSHUT and GPIO1 pins
+ */
+void sim_lidar_attach(
+    uint8_t index, GPIO_TypeDef* xshut_port, uint16_t xshut_pin, GPIO_TypeDef* int_port, uint16_t int_pin
+) {
+    sim_lidar_t* lidar = &s_lidars[index];
+
+    lidar->xshut_port = xshut_port;
+    lidar->xshut_pin = xshut_pin;
+    lidar->int_port = int_port;
+    lidar->int_pin = int_pin;
+    lidar->attached = true;
+    lidar->powered = false;
+    lidar->distance_mm = 1000;
+    int_port->idr |= int_pin; // Pull up
+    s_reset(lidar);
+}
+
+/**
+ * @brief Set the distance to the target in front of the sensor
+ */
+void sim_lidar_set_distance(uint8_t index, uint16_t distance_mm) {
+    s_lidars[index].distance_mm = distance_mm;
+}
+
+/**
+ * @brief Slope the target, the distance changes with the SPAD column of the region of interest
+ */
+void sim_lidar_set_gradient(uint8_t index, int16_t mm_per_column) {
+    s_lidars[index].gradient_mm = mm_per_column;
+}
+
+/**
+ * @brief Failure injection, a dead sensor does not answer on the bus and stops ranging
+ * Set before the boot it never boots, set later it drops off the bus. Cleared it carries on where it was.
+ */
+void sim_lidar_set_dead(uint8_t index, bool dead) {
+    s_lidars[index].dead = dead;
+}
+
+/**
+ * @brief Failure injection, a stuck sensor repeats its last result until it is reset
+ */
+void sim_lidar_set_stuck(uint8_t index, bool stuck) {
+    s_lidars[index].stuck = stuck;
+}
+
+/**
+ * @brief Failure injection, a share of the transfers to the sensor are not acknowledged
+ * 
+ * @param index Sensor
+ * @param permille Transfers NACKed per thousand
+ */
+void sim_lidar_set_nacks(uint8_t index, uint16_t permille) {
+    s_lidars[index].nacks = permille;
+}
+
+/**
+ * @brief Failure injection, a share of the measurements get a fault
+ * 
+ * @param index Sensor
+ * @param permille Measurements with a fault per thousand
+ */
+void sim_lidar_set_faults(uint8_t index, uint16_t permille) {
+    s_lidars[index].faults = permille;
+}
+
+/**
+ * @brief Put a cover glass in front of the sensor
+ * 
+ * @param index Sensor
+ * @param offset_mm Added to every range
+ * @param xtalk_cps Signal per SPAD returned by the glass, in counts per second as the ULD reports it
+ */
+void sim_lidar_set_glass(uint8_t index, int16_t offset_mm, uint16_t xtalk_cps) {
+    s_lidars[index].glass_mm = offset_mm;
+    s_lidars[index].glass_cps = xtalk_cps;
+}
+
+/**
+ * @brief Advance the sensors to the given time
+ * 
+ * @param now_us Monotonic time in microseconds
+ */
+void sim_lidar_step(uint32_t now_us) {
+    s_now_us = now_us;
+
+    for (uint8_t i = 0; i < SIM_LIDAR_MAX; i++) {
+        sim_lidar_t* lidar = &s_lidars[i];
+        if (!lidar->attached) {
+            continue;
+        }
+
+        bool xshut = lidar->xshut_port->odr & lidar->xshut_pin;
+        if (!xshut) {
+            if (lidar->powered) {
+                lidar->powered = false;
+                s_reset(lidar);
+            }
+            continue;
+        }
+
+        if (!lidar->powered) {
+            lidar->powered = true;
+            lidar->boot_us = now_us + SIM_LIDAR_BOOT_US;
+        }
+
+        if (!lidar->booted && !lidar->dead && (int32_t)(now_us - lidar->boot_us) >= 0) {
+            lidar->booted = true;
+            lidar->regs[REG_FIRMWARE_SYSTEM_STATUS] = 0x01;
+        }
+
+        if (lidar->ranging && !lidar->dead && (int32_t)(now_us - lidar->next_us) >= 0) {
+            s_measure(lidar);
+            if (lidar->single) {
+                lidar->ranging = false;
+            } else {
+                lidar->start_us += s_period_us(lidar);
+                lidar->next_us = lidar->start_us + s_budget_us(lidar);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Register read on the bus
+ * 
+ * @return false if no sensor acknowledged the address
+ */
+bool sim_lidar_read(uint8_t address, uint16_t reg, uint8_t* data, uint16_t len) {
+    sim_lidar_t* lidar = s_find(address);
+    if (lidar == NULL) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < len; i++) {
+        data[i] = s_get(lidar, reg + i);
+    }
+    return true;
+}
+
+/**
+ * @brief Register write on the bus, a new address takes effect after the transfer
+ * 
+ * @return false if no sensor acknowledged the address
+ */
+bool sim_lidar_write(uint8_t address, uint16_t reg, const uint8_t* data, uint16_t len) {
+    sim_lidar_t* lidar = s_find(address);
+    if (lidar == NULL) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < len; i++) {
+        s_set(lidar, reg + i, data[i]);
+    }
+    lidar->address = lidar->regs[REG_I2C_SLAVE_DEVICE_ADDRESS] & 0x7F;
+    return true;
+}
+
+uint32_t sim_lidar_get_measurements(uint8_t index) {
+    return s_lidars[index].measurements;
+}
+
+uint32_t sim_lidar_get_collisions(void) {
+    return s_collisions;
+}
+
+uint32_t sim_lidar_get_crosstalk(void) {
+    return s_crosstalk;
+}
@@ -0,0 +1,259 @@
+/**
+ * @file wheel_sim.c
+ * @author Isak Åslund (aslundisak@gmail.com)
+ * @brief Wheel speed controller against a plant model of the motor and car
+ * The car is a first order system driven by the average voltage of the recorded H-bridge waveform of
+ * motor_sim.c, with static friction and a load. Its speed turns the simulated encoder, whose samples run
+ * the controller of wheel.c like the sample interrupt does on target. The battery has an internal
+ * resistance, the motor current sags its voltage and the simulated ADC of battery_sim.c measures it.
+ * Every scenario settles at a speed, then steps to another one and prints the rise time to 90 %, the
+ * overshoot and the settling time to 2 % of the step, the remaining error and the lowest battery voltage.
+ * Scenarios vary battery voltage and load, one drives into saturation, one only uses the feedforward to
+ * show what the loop fixes. Closed loop scenarios must settle within SETTLE_MS with little overshoot and
+ * error. Two accelerate on a weak pack, with the low voltage policy it must stay above BROWNOUT_V without
+ * cutting the motor, without it shows how low the pack would sag. Exits with 1 if a check fails.
+ *
+ * Usage: wheel_sim
+ * @version 0.1
+ * @date 2023-11-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim.h"
+
+#include "User/battery.h"
+#include "User/encoder.h"
+#include "User/motor.h"
+#include "User/wheel.h"
+
+#define PLANT_STEP_US  50     // Integration step, one PWM period
+#define PLANT_NOMINAL  4.8f   // Battery voltage of the top speed
+#define PLANT_TOP_MM_S 5000.0f
+#define PLANT_TAU_S    0.15f
+#define PLANT_STATIC   0.05f  // Duty lost to static friction
+#define PLANT_STALL_A  4.0f   // Motor current standing still at full duty and nominal voltage
+#define BROWNOUT_V     3.6f   // The regulator of the MCU drops out below
+#define PHASE_MS       1000   // Of every phase
+#define SETTLE_MS      600    // From the step, includes the ramp of the target
+#define OVERSHOOT_MAX  0.05f  // Of the step
+#define ERROR_MAX      0.01f  // Of the speed, averaged over the last ERROR_MS
+#define ERROR_MS       200
+
+typedef struct
+{
+    const char* name;
+    float       battery_v;  // Open circuit
+    float       resistance; // Of the battery, ohm
+    float       load;       // Duty the load takes, against forward
+    bool        closed;     // Feedback, else feedforward only
+    bool        policy;     // Low voltage policy on
+    float       before_mm_s;
+    float       after_mm_s;
+} scenario_t;
+
+typedef struct
+{
+    float rise_ms;
+    float overshoot;
+    float settle_ms;
+    float error;
+    float min_v;
+} result_t;
+
+// ============= Private variables ===================
+static const scenario_t s_scenarios[] = {
+    {"nominal", 4.8f, 0, 0, true, true, 0, 1500},
+    {"low bat", 4.2f, 0, 0, true, true, 0, 1500},
+    {"high bat", 5.6f, 0, 0, true, true, 0, 1500},
+    {"uphill", 4.8f, 0, 0.10f, true, true, 500, 2000},
+    {"downhill", 4.8f, 0, -0.10f, true, true, 2000, 500},
+    {"reverse", 4.8f, 0, 0, true, true, 1500, -1000},
+    {"crawl", 4.2f, 0, 0.05f, true, true, 0, 100},
+    {"windup", 4.2f, 0, 0, true, true, 8000, 2000},
+    {"open", 4.2f, 0, 0.05f, false, true, 0, 1500},
+    {"sag", 4.3f, 0.5f, 0.10f, true, true, 0, 3000},
+    {"sag nopol", 4.3f, 0.5f, 0.10f, true, false, 0, 3000},
+};
+
+static float    s_speed_mm_s;
+static float    s_battery_v;
+static float    s_min_v;
+static uint32_t s_now_us;
+
+// ============ Private function declaration =================
+static void s_run(const scenario_t* scenario, float command_mm_s, float* trace);
+
+//============ Private function implementation ===============
+/**
+ * @brief Drive at a command for a phase, trace gets the speed of every ms
+ */
+static void s_run(const scenario_t* scenario, float command_mm_s, float* trace) {
+    wheel_set(command_mm_s);
+
+    for (uint32_t ms = 0; ms < PHASE_MS; ms++) {
+        for (uint32_t us = 0; us < 1000; us += PLANT_STEP_US) {
+            motor_pwm_t pwm;
+            sim_motor_get_active(&pwm);
+
+            // Average voltage of the waveform, friction against the motion or holding the car while it stands
+            float duty = ((float)pwm.in1 - pwm.in2) / pwm.period;
+            float drive = duty * s_battery_v / PLANT_NOMINAL;
+            float force = drive - scenario->load;
+            float friction = s_speed_mm_s != 0 ? copysignf(PLANT_STATIC, s_speed_mm_s)
+                                               : copysignf(fminf(fabsf(force), PLANT_STATIC), force);
+
+            float speed = s_speed_mm_s + ((force - friction) * PLANT_TOP_MM_S - s_speed_mm_s) * PLANT_STEP_US * 1e-6f /
+                                             PLANT_TAU_S;
+            if (s_speed_mm_s != 0 && (speed > 0) != (s_speed_mm_s > 0)) {
+                speed = 0; // Stops before it can go the other way
+            }
+            s_speed_mm_s = speed;
+
+            // The motor current against the back EMF flows from the battery for the duty share of the period
+            float current = fmaxf(PLANT_STALL_A * (drive - s_speed_mm_s / PLANT_TOP_MM_S) * duty, 0);
+            s_battery_v = scenario->battery_v - scenario->resistance * current;
+            s_min_v = fminf(s_min_v, s_battery_v);
+
+            s_now_us += PLANT_STEP_US;
+            sim_battery_set_mv(1000 * s_battery_v);
+            sim_battery_step(s_now_us);
+            sim_encoder_set_speed(s_speed_mm_s);
+            sim_encoder_step(s_now_us);
+            sim_motor_step(s_now_us);
+        }
+        trace[ms] = s_speed_mm_s;
+    }
+}
+
+// ==================== Global function implementation ==========================
+int main(int argc, char** argv) {
+    static float        trace[PHASE_MS];
+    wheel_pid_config_t* config;
+    int                 failed = 0;
+
+    if (argc > 1) {
+        printf("Usage: wheel_sim\n");
+        return 2;
+    }
+
+    motor_init();
+    sim_motor_step(s_now_us);
+    sim_encoder_step(s_now_us);
+    sim_battery_step(s_now_us);
+    encoder_init();
+    wheel_init();
+    config = wheel_get_config();
+
+    printf(
+        "%-9s %5s %5s %5s %6s %6s %8s %9s %9s %7s %6s\n",
+        "scenario",
+        "V",
+        "ohm",
+        "load",
+        "from",
+        "to",
+        "rise ms",
+        "overshoot",
+        "settle ms",
+        "error",
+        "min V"
+    );
+    for (uint8_t i = 0; i < sizeof(s_scenarios) / sizeof(s_scenarios[0]); i++) {
+        const scenario_t*        scenario = &s_scenarios[i];
+        const wheel_pid_config_t gains = *config;
+
+        if (!scenario->closed) {
+            config->kp = config->ki = config->kd = 0;
+        }
+        battery_init();
+        if (!scenario->policy) {
+            battery_get_config()->low_mv = battery_get_config()->cutoff_mv = 0;
+        }
+        s_battery_v = scenario->battery_v;
+        wheel_reset_timing();
+        s_run(scenario, scenario->before_mm_s, trace);
+        float from = s_speed_mm_s;
+        s_min_v = s_battery_v;
+        s_run(scenario, scenario->after_mm_s, trace);
+        *config = gains;
+
+        // Against the step the car actually made, saturated scenarios start below their command
+        float    to = scenario->after_mm_s;
+        float    step = to - from;
+        float    direction = step > 0 ? 1 : -1;
+        result_t result = {-1, 0, 0, 0, s_min_v};
+        for (uint32_t ms = 0; ms < PHASE_MS; ms++) {
+            float progress = (trace[ms] - from) / step;
+            if (result.rise_ms < 0 && progress >= 0.9f) {
+                result.rise_ms = ms + 1;
+            }
+            result.overshoot = fmaxf(result.overshoot, (trace[ms] - to) * direction / fabsf(step));
+            if (fabsf(trace[ms] - to) > 0.02f * fabsf(step)) {
+                result.settle_ms = ms + 1;
+            }
+            if (ms >= PHASE_MS - ERROR_MS) {
+                result.error += (trace[ms] - to) / fabsf(to) / ERROR_MS;
+            }
+        }
+
+        printf(
+            "%-9s %5.1f %5.2f %5.2f %6.0f %6.0f %8.0f %8.1f%% %9.0f %6.2f%% %6.2f\n",
+            scenario->name,
+            scenario->battery_v,
+            scenario->resistance,
+            scenario->load,
+            from,
+            to,
+            result.rise_ms,
+            100 * result.overshoot,
+            result.settle_ms,
+            100 * result.error,
+            result.min_v
+        );
+
+        prof_stats_t exec, period;
+        wheel_get_timing(&exec, &period);
+        if (exec.count != 2 * PHASE_MS) {
+            printf("FAIL %s: controller ran %u times in %u ms\n", scenario->name, exec.count, 2 * PHASE_MS);
+            failed++;
+        }
+        if (scenario->resistance > 0) {
+            battery_state_t battery;
+            battery_get(&battery);
+            if (scenario->policy && result.min_v < BROWNOUT_V) {
+                printf("FAIL %s: battery sagged below %.1f V\n", scenario->name, BROWNOUT_V);
+                failed++;
+            }
+            if (scenario->policy && battery.cutoffs != 0) {
+                printf("FAIL %s: motor cut %u times\n", scenario->name, battery.cutoffs);
+                failed++;
+            }
+            continue;
+        }
+        if (!scenario->closed) {
+            continue;
+        }
+        if (result.rise_ms < 0 || result.settle_ms > SETTLE_MS) {
+            printf("FAIL %s: not settled within %u ms\n", scenario->name, SETTLE_MS);
+            failed++;
+        }
+        if (result.overshoot > OVERSHOOT_MAX) {
+            printf("FAIL %s: overshoot above %.0f %%\n", scenario->name, 100 * OVERSHOOT_MAX);
+            failed++;
+        }
+        if (fabsf(result.error) > ERROR_MAX) {
+            printf("FAIL %s: error above %.0f %%\n", scenario->name, 100 * ERROR_MAX);
+            failed++;
+        }
+    }
+
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed ? 1 : 0;
+}
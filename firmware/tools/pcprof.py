@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Symbolize samples from the 'pcsamp' CLI command and print a profile.
+
+Samples are either read from a captured terminal log or pulled live over the
+virtual COM port (needs pyserial):
+
+    python tools/pcprof.py build/Debug/donatello.elf --log capture.txt
+    python tools/pcprof.py build/Debug/donatello.elf --port /dev/ttyACM0 --hz 2000 --seconds 10
+
+Prints a flat profile (self samples per function) and writes folded stacks
+'task;caller;function count' usable by flamegraph.pl / speedscope. The caller
+is taken from the stacked LR, so it is only an approximation of the real
+caller (leaf functions and functions that have not pushed LR yet).
+"""
+
+import argparse
+import bisect
+import collections
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+SAMPLE_RE = re.compile(r"^S ([0-9a-fA-F]{8}) ([0-9a-fA-F]{8}) (\S+)")
+
+
+class Symbols:
+    """Address to function name lookup built from 'nm' output."""
+
+    def __init__(self, elf, nm):
+        out = subprocess.run([nm, "-n", "-S", "--defined-only", "-C", elf], check=True, capture_output=True, text=True)
+        self.starts = []
+        self.entries = []
+        for line in out.stdout.splitlines():
+            parts = line.split(maxsplit=3)
+            if len(parts) != 4 or parts[2] not in "tTwW":
+                continue
+            start = int(parts[0], 16) & ~1
+            self.starts.append(start)
+            self.entries.append((start, int(parts[1], 16), parts[3]))
+
+    def lookup(self, addr):
+        addr &= ~1  # Thumb bit
+        i = bisect.bisect_right(self.starts, addr) - 1
+        if i >= 0:
+            start, size, name = self.entries[i]
+            if addr < start + max(size, 2):
+                return name
+        return "0x%08x" % addr
+
+
+def read_log(path):
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = SAMPLE_RE.match(line.strip())
+            if m:
+                yield int(m.group(1), 16), int(m.group(2), 16), m.group(3)
+
+
+def read_port(port, hz, seconds):
+    import serial  # pyserial, only needed for live capture
+
+    with serial.Serial(port, timeout=0.2) as ser:
+        ser.write(("pcsamp start %d\r" % hz).encode())
+        end = time.time() + seconds
+        while time.time() < end:
+            time.sleep(0.2)
+            ser.write(b"pcsamp dump\r")
+            buf = b""
+            while b"pcsamp end" not in buf:
+                chunk = ser.read(4096)
+                if not chunk:
+                    break
+                buf += chunk
+            for line in buf.decode(errors="replace").splitlines():
+                m = SAMPLE_RE.match(line.strip())
+                if m:
+                    yield int(m.group(1), 16), int(m.group(2), 16), m.group(3)
+        ser.write(b"pcsamp stop\r")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("elf", help="ELF file the samples were taken from")
+    parser.add_argument("--log", help="Terminal log containing 'pcsamp dump' output")
+    parser.add_argument("--port", help="Virtual COM port to sample live from")
+    parser.add_argument("--hz", type=int, default=2000, help="Sample rate for live capture")
+    parser.add_argument("--seconds", type=float, default=5.0, help="Duration of live capture")
+    parser.add_argument("--folded", default="pcprof.folded", help="Output file for folded stacks")
+    parser.add_argument("--top", type=int, default=30, help="Number of functions in the flat profile")
+    parser.add_argument("--nm", default=shutil.which("arm-none-eabi-nm") or "nm", help="nm executable")
+    args = parser.parse_args()
+
+    if not args.log and not args.port:
+        parser.error("one of --log or --port is required")
+
+    symbols = Symbols(args.elf, args.nm)
+    samples = read_log(args.log) if args.log else read_port(args.port, args.hz, args.seconds)
+
+    flat = collections.Counter()
+    folded = collections.Counter()
+    tasks = collections.Counter()
+    total = 0
+    for pc, lr, task in samples:
+        func = symbols.lookup(pc)
+        caller = symbols.lookup(lr)
+        flat[func] += 1
+        tasks[task] += 1
+        folded["%s;%s;%s" % (task, caller, func) if caller != func else "%s;%s" % (task, func)] += 1
+        total += 1
+
+    if not total:
+        print("No samples found", file=sys.stderr)
+        return 1
+
+    print("%d samples\n" % total)
+    print("%8s %7s  %s" % ("samples", "%", "task"))
+    for task, n in tasks.most_common():
+        print("%8d %6.2f%%  %s" % (n, 100.0 * n / total, task))
+    print("\n%8s %7s  %s" % ("samples", "%", "function"))
+    for func, n in flat.most_common(args.top):
+        print("%8d %6.2f%%  %s" % (n, 100.0 * n / total, func))
+
+    with open(args.folded, "w") as f:
+        for stack, n in sorted(folded.items()):
+            f.write("%s %d\n" % (stack, n))
+    print("\nFolded stacks written to %s" % args.folded)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
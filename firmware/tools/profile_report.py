@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Compare flash/RAM size and cycle counts between build profiles.
+
+Builds every preset, reads the section sizes with arm-none-eabi-size and, when
+a port is given, flashes each build with STM32_Programmer_CLI, runs
+'bench run all <reps> masked' over the virtual COM port and collects the
+cycles/op of every benchmark. Prints a markdown table per metric:
+
+    python tools/profile_report.py
+    python tools/profile_report.py --port /dev/ttyACM0 --reps 200
+
+Run from the firmware folder.
+"""
+
+import argparse
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+PRESETS = ["Debug", "RelWithDebInfo", "Release", "MinSizeRel"]
+BENCH_RE = re.compile(r"^(\S+)\s+(\d+)\s+([\d.]+)\s+([\d.]+)\s+([\d.]+)\s+([\d.]+)")
+
+
+def build(preset):
+    subprocess.run(["cmake", "--preset", preset], check=True, stdout=subprocess.DEVNULL)
+    subprocess.run(["cmake", "--build", "--preset", preset], check=True, stdout=subprocess.DEVNULL)
+    return "build/%s/donatello.elf" % preset
+
+
+def sizes(elf, size_tool):
+    out = subprocess.run([size_tool, "-B", elf], check=True, capture_output=True, text=True).stdout
+    text, data, bss = (int(v) for v in out.splitlines()[1].split()[:3])
+    return {"flash": text + data, "ram": data + bss}
+
+
+def flash(elf):
+    subprocess.run(["STM32_Programmer_CLI", "-c", "port=SWD", "-w", elf, "-v", "-rst"], check=True)
+
+
+def bench(port, reps):
+    import serial  # pyserial, only needed for on-target numbers
+
+    results = {}
+    time.sleep(3)  # USB enumeration after reset
+    with serial.Serial(port, timeout=1) as ser:
+        ser.write(("bench run all %d masked\r" % reps).encode())
+        buf = b""
+        deadline = time.time() + 60
+        while time.time() < deadline:
+            chunk = ser.read(4096)
+            if not chunk and buf:
+                break
+            buf += chunk
+    for line in buf.decode(errors="replace").splitlines():
+        m = BENCH_RE.match(line.strip())
+        if m:
+            results[m.group(1)] = float(m.group(3))
+    return results
+
+
+def table(title, rows, columns):
+    print("\n### %s\n" % title)
+    print("| | " + " | ".join(columns) + " |")
+    print("|---" * (len(columns) + 1) + "|")
+    for name, values in rows.items():
+        print("| %s | %s |" % (name, " | ".join(values.get(c, "-") for c in columns)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--presets", nargs="+", default=PRESETS, help="Presets to compare")
+    parser.add_argument("--port", help="Virtual COM port, flashes and benchmarks every build when given")
+    parser.add_argument("--reps", type=int, default=100, help="Benchmark repetitions")
+    parser.add_argument("--size", default=shutil.which("arm-none-eabi-size") or "size", help="size executable")
+    args = parser.parse_args()
+
+    memory = {"flash [B]": {}, "ram [B]": {}}
+    cycles = {}
+    for preset in args.presets:
+        elf = build(preset)
+        s = sizes(elf, args.size)
+        memory["flash [B]"][preset] = str(s["flash"])
+        memory["ram [B]"][preset] = str(s["ram"])
+
+        if args.port:
+            flash(elf)
+            for name, value in bench(args.port, args.reps).items():
+                cycles.setdefault(name, {})[preset] = "%.1f" % value
+
+    table("Memory", memory, args.presets)
+    if cycles:
+        table("Cycles per operation (interrupts masked)", cycles, args.presets)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Report the RAM of an image per subsystem from the linker map file.
+
+Adds up the .data and .bss input sections of every object file and groups the
+objects by subsystem, see SUBSYSTEMS. Stack and heap reserved by the linker
+script are a subsystem of their own, the FreeRTOS heap (task stacks and kernel
+objects) is the ucHeap array of heap_4.c. Runs after every target build:
+
+    python tools/ram_report.py build/Debug/donatello.map
+    python tools/ram_report.py build/Debug/donatello.map --detail 5
+    python tools/ram_report.py build/Debug/donatello.map --min-free 8192
+
+--detail lists the largest sections of every subsystem, with -fdata-sections
+each one is a variable. --min-free fails when less RAM than that is left.
+With LTO (Release, MinSizeRel) the variables are in objects of the link time
+optimizer and count as other, the Debug build shows where they come from.
+Run from the firmware folder.
+"""
+
+import argparse
+import collections
+import re
+import sys
+
+# First match wins, against the object file path as it appears in the map
+SUBSYSTEMS = [
+    ("usb", r"USB_DEVICE/|STM32_USB_Device_Library/|stm32f4xx_hal_pcd|stm32f4xx_ll_usb|usb_device"),
+    ("coms", r"/coms\.c|/ring\.c"),
+    ("cli", r"/cli\.c|embedded_cli"),
+    ("rtos heap", r"/heap_\d\.c"),
+    ("rtos", r"FreeRTOS/|/freertos\.c|cmsis_os"),
+    ("lidar", r"/lidar|/vl53l1x"),
+    ("drive", r"/wheel|/motor|/encoder|/servo|/odom|/control|/battery|/geometry"),
+    ("messaging", r"/bus\.c|/pool\.c"),
+    ("profiling", r"/prof\.c|/pcsamp|/bench|/cycles"),
+    ("io", r"/button|/lwbtn|/i2c\.c|/nvm\.c"),
+    ("hal", r"Drivers/|/stm32f4xx_|/system_stm32|/main\.c|/sysmem|/syscalls|startup_"),
+    ("libc", r"\.a\(|crt\w*\.o"),
+]
+
+RAM_SECTIONS = [".data", ".bss", "._user_heap_stack"]
+RESERVED = "stack + heap (linker script)"
+
+OUTPUT_RE = re.compile(r"^(\.\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+))?")
+INPUT_RE = re.compile(r"^ (\S+)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*))?$")
+CONTINUATION_RE = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+REGION_RE = re.compile(r"^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)")
+
+
+def subsystem(obj):
+    obj = re.sub(r"CMakeFiles/[^/]+\.dir/", "", obj)  # Not the name of the target
+    for name, pattern in SUBSYSTEMS:
+        if re.search(pattern, obj):
+            return name
+    return "other"
+
+
+def parse(path):
+    """Return the RAM region length (None if unknown) and a list of (output, input, size, object)"""
+    ram = None
+    sections = []
+    output = None
+    output_size = 0
+    counted = 0
+    pending = None  # Input section whose address and size are on the next line
+    part = "header"
+
+    def close():
+        # What the output section holds besides its input sections: fill and space reserved by the script
+        if output in RAM_SECTIONS and output_size > counted:
+            obj = RESERVED if output == "._user_heap_stack" else "(fill)"
+            sections.append((output, output, output_size - counted, obj))
+
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Memory Configuration"):
+                part = "memory"
+                continue
+            if line.startswith("Linker script and memory map"):
+                part = "map"
+                continue
+            if part == "memory":
+                m = REGION_RE.match(line)
+                if m and m.group(1) == "RAM":
+                    ram = int(m.group(3), 16)
+                continue
+            if part != "map":
+                continue
+
+            if pending is not None:
+                m = CONTINUATION_RE.match(line)
+                if m and output in RAM_SECTIONS:
+                    size = int(m.group(2), 16)
+                    sections.append((output, pending, size, m.group(3)))
+                    counted += size
+                pending = None
+                continue
+
+            if line and not line[0].isspace():
+                close()
+                m = OUTPUT_RE.match(line)
+                output = m.group(1) if m else None
+                output_size = int(m.group(3), 16) if m and m.group(3) else 0
+                counted = 0
+                if m and not m.group(3):
+                    # Long name, the size is on the next line
+                    nxt = next(f, "")
+                    n = CONTINUATION_RE.match(nxt) or re.match(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)", nxt)
+                    output_size = int(n.group(2), 16) if n else 0
+                continue
+
+            if output not in RAM_SECTIONS:
+                continue
+            m = INPUT_RE.match(line)
+            if not m or m.group(1).startswith("*"):
+                continue  # Assignments, symbols, patterns and *fill*
+            if m.group(4) is None:
+                pending = m.group(1)
+                continue
+            size = int(m.group(3), 16)
+            sections.append((output, m.group(1), size, m.group(4)))
+            counted += size
+    close()
+    return ram, sections
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("map", help="Linker map file, e.g. build/Debug/donatello.map")
+    parser.add_argument("--detail", type=int, default=0, metavar="N", help="List the N largest sections of each")
+    parser.add_argument("--min-free", type=int, default=0, metavar="BYTES", help="Fail if less RAM is left")
+    args = parser.parse_args()
+
+    ram, sections = parse(args.map)
+    data = collections.Counter()
+    bss = collections.Counter()
+    largest = collections.defaultdict(list)
+    for output, name, size, obj in sections:
+        if size == 0:
+            continue
+        group = RESERVED if obj == RESERVED else subsystem(obj)
+        (data if output == ".data" else bss)[group] += size
+        largest[group].append((size, name, obj))
+
+    groups = sorted(set(data) | set(bss), key=lambda g: -(data[g] + bss[g]))
+    total = sum(data.values()) + sum(bss.values())
+    width = max([len(g) for g in groups] + [9])
+
+    print("RAM per subsystem, %s" % args.map)
+    print("%-*s %7s %7s %7s %6s" % (width, "subsystem", "data", "bss", "total", "%"))
+    for g in groups:
+        used = data[g] + bss[g]
+        print("%-*s %7d %7d %7d %5.1f%%" % (width, g, data[g], bss[g], used, 100.0 * used / total))
+        for size, name, obj in sorted(largest[g], reverse=True)[: args.detail]:
+            label = re.sub(r"^\.(s?bss|data)\.", "", name)
+            print("  %-*s %7d  %s" % (width + 14, label, size, obj.split("/")[-1]))
+    print("%-*s %7d %7d %7d" % (width, "total", sum(data.values()), sum(bss.values()), total))
+
+    if ram is None:
+        return 0
+    free = ram - total
+    print("%d of %d bytes of RAM used, %d free" % (total, ram, free))
+    if free < args.min_free:
+        print("Less than %d bytes of RAM free" % args.min_free, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())